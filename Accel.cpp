@@ -0,0 +1,145 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include "Accel.h"
+
+using namespace std;
+
+namespace accel{
+
+  namespace {
+    const char* NAMES[N_FUNCTIONS] = {"memcpy", "memset", "strlen",
+      "memcmp"};
+
+    const data32 V0 = 2;
+    const data32 A0 = 4;
+    const data32 A1 = 5;
+    const data32 A2 = 6;
+  }
+
+  Accelerator::Accelerator(const CostModel& cost) : cost{cost} {
+    nCalls.fill(0);
+    nBytes.fill(0);
+  }
+
+  Function Accelerator::byName(const string& name){
+    for(int f = 0; f < N_FUNCTIONS; f++)
+      if(name == NAMES[f])
+        return (Function) f;
+    return N_FUNCTIONS;
+  }
+
+  void Accelerator::add(data32 address, Function f){
+    functions[address] = f;
+  }
+
+  void Accelerator::addSymbols(const vector<elf::Symbol>& symbols){
+    for(const elf::Symbol& s : symbols){
+      Function f = byName(s.name);
+      if(f != N_FUNCTIONS)
+        add(s.address, f);
+    }
+  }
+
+  void Accelerator::loadMap(const string& filename){
+    ifstream file(filename);
+    if(!file){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Accelerator>> can't open " << filename <<
+        endl;
+      throw std::exception();
+    }
+    string line;
+    while(getline(file, line)){
+      istringstream fields(line.substr(0, line.find('#')));
+      string name;
+      string address;
+      if(!(fields >> name))
+        continue;
+      Function f = byName(name);
+      if(f == N_FUNCTIONS || !(fields >> address)){
+        BOOST_LOG_TRIVIAL(fatal) << "<<Accelerator>> " << filename << ": "
+          "expected memcpy, memset, strlen or memcmp and an address, got " <<
+          line << endl;
+        throw std::exception();
+      }
+      add(stoul(address, nullptr, 0), f);
+    }
+  }
+
+  bool Accelerator::intercepts(data32 address) const{
+    return functions.count(address) != 0;
+  }
+
+  unsigned long Accelerator::call(data32 address, MemoryUnit& mainMem,
+      MemoryUnit& rf){
+    Function f = functions.at(address);
+    data32 a0 = rf.ld(A0);
+    data32 a1 = rf.ld(A1);
+    data32 a2 = rf.ld(A2);
+    unsigned long bytes = 0;
+    switch(f){
+      case MEMCPY: {
+        data32 i = 0;
+        //whole words when both sides line up
+        if((a0 & 3) == (a1 & 3)){
+          for(; i < a2 && ((a0 + i) & 3) != 0; i++)
+            mainMem.stByte(a0 + i, mainMem.ldByte(a1 + i));
+          for(; a2 - i >= 4; i += 4)
+            mainMem.sw((a0 + i) >> 2, mainMem.ld((a1 + i) >> 2));
+        }
+        for(; i < a2; i++)
+          mainMem.stByte(a0 + i, mainMem.ldByte(a1 + i));
+        rf.sw(V0, a0);
+        bytes = 2ul * a2;
+        break;
+      }
+      case MEMSET: {
+        data8 c = a1;
+        data32 word = c * 0x01010101u;
+        data32 i = 0;
+        for(; i < a2 && ((a0 + i) & 3) != 0; i++)
+          mainMem.stByte(a0 + i, c);
+        for(; a2 - i >= 4; i += 4)
+          mainMem.sw((a0 + i) >> 2, word);
+        for(; i < a2; i++)
+          mainMem.stByte(a0 + i, c);
+        rf.sw(V0, a0);
+        bytes = a2;
+        break;
+      }
+      case STRLEN: {
+        data32 n = 0;
+        while(mainMem.ldByte(a0 + n) != 0)
+          n++;
+        rf.sw(V0, n);
+        bytes = n + 1;
+        break;
+      }
+      case MEMCMP: {
+        signedData32 result = 0;
+        data32 i = 0;
+        for(; i < a2 && result == 0; i++)
+          result = (signedData32) mainMem.ldByte(a0 + i) -
+            (signedData32) mainMem.ldByte(a1 + i);
+        rf.sw(V0, result);
+        bytes = 2ul * i;
+        break;
+      }
+      default:
+        break;
+    }
+    nCalls[f]++;
+    nBytes[f] += bytes;
+    return cost.perCall + (unsigned long) (cost.perByte * bytes);
+  }
+
+  unsigned long Accelerator::getNCalls(Function f) const{
+    return nCalls[f];
+  }
+
+  unsigned long Accelerator::getNBytes(Function f) const{
+    return nBytes[f];
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef ACCEL_H_INCLUDED
+#define ACCEL_H_INCLUDED
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Mem.h"
+#include "Elf.h"
+
+using namespace std;
+using namespace mem;
+/*
+ * Host native guest libc during fast forward. A FunctionalCore with an
+ * Accelerator (FunctionalCore::setAccelerator) that is about to fetch the
+ * first instruction of a known memcpy, memset, strlen or memcmp runs it on
+ * the host instead, straight against guest memory, and goes on where the
+ * function would have returned to. Instead of the instructions the guest
+ * would have run it counts a cost, perCall plus perByte per byte touched.
+ *
+ * Functions are known by the address of their first instruction, from an
+ * ELF symbol table or a map file of "name address" lines (address decimal
+ * or 0x hex, # starts a comment). They take the usual o32 arguments and
+ * return in $v0, pointers being byte addresses as lb and sb take them.
+ *
+ * Only use it where nothing looks at the instructions themselves: outside
+ * the region of interest, with no trace or profile being taken. Detach it
+ * (nullptr) to fall back to simulating every instruction.
+ */
+namespace accel{
+
+  enum Function{
+    MEMCPY, MEMSET, STRLEN, MEMCMP,
+    N_FUNCTIONS
+  };
+
+  struct CostModel{
+    /* instructions counted per call */
+    unsigned long perCall = 10;
+    /* and per byte read or written */
+    double perByte = 1;
+  };
+
+  class Accelerator{
+    private:
+      /* first instruction -> function */
+      unordered_map<data32, Function> functions;
+      CostModel cost;
+      array<unsigned long, N_FUNCTIONS> nCalls;
+      array<unsigned long, N_FUNCTIONS> nBytes;
+
+    public:
+      Accelerator(const CostModel& cost = CostModel());
+
+      /*
+       * returns: the function called name, N_FUNCTIONS if none
+       */
+      static Function byName(const string& name);
+
+      void add(data32 address, Function f);
+
+      /*
+       * adds every symbol named like one of the functions
+       */
+      void addSymbols(const vector<elf::Symbol>& symbols);
+
+      /*
+       * adds the functions in a map file, see above
+       * throws: exception if it can't be read, or names something else
+       */
+      void loadMap(const string& filename);
+
+      /*
+       * returns: whether a function starts at address
+       */
+      bool intercepts(data32 address) const;
+
+      /*
+       * runs the function starting at address, leaving its result in $v0
+       * params:
+       *   rf: with its arguments
+       * returns: the instructions to count for it
+       */
+      unsigned long call(data32 address, MemoryUnit& mainMem,
+          MemoryUnit& rf);
+
+      unsigned long getNCalls(Function f) const;
+      unsigned long getNBytes(Function f) const;
+  };
+}
+#endif
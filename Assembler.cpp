@@ -0,0 +1,458 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <cstring>
+#include <elf.h>
+#include <endian.h>
+#include <fstream>
+#include <iomanip>
+#include <exception>
+#include "Assembler.h"
+#include "Debug.h"
+
+using namespace std;
+
+namespace assembler{
+
+  Assembler::Assembler(){
+    lastWrite.fill(-HAZARD_DISTANCE);
+    //nothing may live at address 0, jumps go to target - 1
+    code.push_back(0);
+  }
+
+  void Assembler::waitFor(Reg r){
+    if(r == 0)
+      return;
+    while((long) code.size() - lastWrite[r] < HAZARD_DISTANCE)
+      code.push_back(0);
+  }
+
+  void Assembler::emit(data32 instr, vector<Reg> reads, int write){
+    for(Reg r : reads)
+      waitFor(r);
+    if(write > 0)
+      lastWrite[write] = code.size();
+    code.push_back(instr);
+  }
+
+  void Assembler::delaySlots(){
+    for(int i = 0; i < DELAY_SLOTS; i++)
+      code.push_back(0);
+  }
+
+  void Assembler::rInstr(Reg rs, Reg rt, Reg rd, unsigned int shamt,
+      unsigned int func, vector<Reg> reads, int write){
+    emit(constructRInstr(rs, rt, rd, shamt, func), reads, write);
+  }
+
+  void Assembler::iInstr(unsigned int opcode, Reg rs, Reg rt, long imm,
+      vector<Reg> reads, int write){
+    if(imm < -0x8000 || imm > 0xffff){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Assembler>> immediate " << imm <<
+        " does not fit in 16 bits" << endl;
+      throw std::exception();
+    }
+    emit(constructIInstr(opcode, rs, rt, (unsigned short) imm), reads, write);
+  }
+
+  void Assembler::branch(unsigned int opcode, Reg rs, Reg rt,
+      const string& label){
+    waitFor(rs);
+    waitFor(rt);
+    fixups.push_back({true, code.size(), label, 0, BRANCH});
+    code.push_back(constructIInstr(opcode, rs, rt, 0));
+    delaySlots();
+  }
+
+  void Assembler::label(const string& name){
+    codeLabels[name] = code.size();
+  }
+
+  //R-Type. Note the operand order for subu and the shifts, see Assembler.h
+  void Assembler::addu(Reg rd, Reg a, Reg b){
+    rInstr(a, b, rd, 0, 0x21, {a, b}, rd);
+  }
+  void Assembler::subu(Reg rd, Reg a, Reg b){
+    rInstr(b, a, rd, 0, 0x23, {a, b}, rd);
+  }
+  void Assembler::and_(Reg rd, Reg a, Reg b){
+    rInstr(a, b, rd, 0, 0x24, {a, b}, rd);
+  }
+  void Assembler::or_(Reg rd, Reg a, Reg b){
+    rInstr(a, b, rd, 0, 0x25, {a, b}, rd);
+  }
+  void Assembler::xor_(Reg rd, Reg a, Reg b){
+    rInstr(a, b, rd, 0, 0x26, {a, b}, rd);
+  }
+  void Assembler::nor(Reg rd, Reg a, Reg b){
+    rInstr(a, b, rd, 0, 0x27, {a, b}, rd);
+  }
+  void Assembler::slt(Reg rd, Reg a, Reg b){
+    rInstr(a, b, rd, 0, 0x2a, {a, b}, rd);
+  }
+  void Assembler::sltu(Reg rd, Reg a, Reg b){
+    rInstr(a, b, rd, 0, 0x2b, {a, b}, rd);
+  }
+  void Assembler::sll(Reg rd, Reg a, unsigned int shamt){
+    rInstr(a, 0, rd, shamt, 0x0, {a}, rd);
+  }
+  void Assembler::srl(Reg rd, Reg a, unsigned int shamt){
+    rInstr(a, 0, rd, shamt, 0x2, {a}, rd);
+  }
+  void Assembler::sra(Reg rd, Reg a, unsigned int shamt){
+    rInstr(a, 0, rd, shamt, 0x3, {a}, rd);
+  }
+  void Assembler::sllv(Reg rd, Reg a, Reg amount){
+    rInstr(a, amount, rd, 0, 0x4, {a, amount}, rd);
+  }
+  void Assembler::srlv(Reg rd, Reg a, Reg amount){
+    rInstr(a, amount, rd, 0, 0x6, {a, amount}, rd);
+  }
+  void Assembler::mult(Reg a, Reg b){
+    rInstr(a, b, 0, 0, 0x18, {a, b}, -1);
+  }
+  void Assembler::multu(Reg a, Reg b){
+    rInstr(a, b, 0, 0, 0x19, {a, b}, -1);
+  }
+  void Assembler::div(Reg a, Reg b){
+    rInstr(a, b, 0, 0, 0x1a, {a, b}, -1);
+  }
+  void Assembler::divu(Reg a, Reg b){
+    rInstr(a, b, 0, 0, 0x1b, {a, b}, -1);
+  }
+  //hi/lo are read and written in writeback, so no hazard there
+  void Assembler::mfhi(Reg rd){
+    rInstr(0, 0, rd, 0, 0x10, {}, rd);
+  }
+  void Assembler::mflo(Reg rd){
+    rInstr(0, 0, rd, 0, 0x12, {}, rd);
+  }
+  void Assembler::move(Reg rd, Reg a){
+    rInstr(a, 0, rd, 0, 0x11, {a}, rd);
+  }
+  void Assembler::jr(Reg a){
+    rInstr(a, 0, 0, 0, 0x8, {a}, -1);
+    delaySlots();
+  }
+  void Assembler::syscall(){
+    rInstr(0, 0, 0, 0, 0xc, {}, -1);
+    //fetch runs on behind a syscall until it quits in writeback, keep that
+    //out of the data
+    delaySlots();
+  }
+  void Assembler::sync(){
+    rInstr(0, 0, 0, 0, 0xf, {}, -1);
+  }
+  void Assembler::nop(){
+    code.push_back(0);
+  }
+
+  //I-Type
+  void Assembler::addiu(Reg rt, Reg rs, long imm){
+    iInstr(0x9, rs, rt, imm, {rs}, rt);
+  }
+  void Assembler::slti(Reg rt, Reg rs, long imm){
+    iInstr(0xa, rs, rt, imm, {rs}, rt);
+  }
+  void Assembler::andi(Reg rt, Reg rs, unsigned long imm){
+    iInstr(0xc, rs, rt, imm, {rs}, rt);
+  }
+  void Assembler::lui(Reg rt, unsigned long imm){
+    iInstr(0xf, 0, rt, imm, {}, rt);
+  }
+  void Assembler::lw(Reg rt, Reg base, long offset){
+    iInstr(0x23, base, rt, offset, {base}, rt);
+  }
+  void Assembler::sw(Reg val, Reg base, long offset){
+    iInstr(0x2b, val, base, offset, {val, base}, -1);
+  }
+  void Assembler::ll(Reg rt, Reg base, long offset){
+    iInstr(0x30, base, rt, offset, {base}, rt);
+  }
+  void Assembler::sc(Reg val, Reg base, long offset){
+    iInstr(0x38, base, val, offset, {val, base}, val);
+  }
+  void Assembler::lb(Reg rt, Reg base, long offset){
+    iInstr(0x20, base, rt, offset, {base}, rt);
+  }
+  void Assembler::lbu(Reg rt, Reg base, long offset){
+    iInstr(0x24, base, rt, offset, {base}, rt);
+  }
+  void Assembler::lh(Reg rt, Reg base, long offset){
+    iInstr(0x21, base, rt, offset, {base}, rt);
+  }
+  void Assembler::lhu(Reg rt, Reg base, long offset){
+    iInstr(0x25, base, rt, offset, {base}, rt);
+  }
+  void Assembler::sb(Reg val, Reg base, long offset){
+    iInstr(0x28, val, base, offset, {val, base}, -1);
+  }
+  void Assembler::sh(Reg val, Reg base, long offset){
+    iInstr(0x29, val, base, offset, {val, base}, -1);
+  }
+  void Assembler::beq(Reg a, Reg b, const string& label){
+    branch(0x4, a, b, label);
+  }
+  void Assembler::bne(Reg a, Reg b, const string& label){
+    branch(0x5, a, b, label);
+  }
+  void Assembler::bltz(Reg a, const string& label){
+    branch(0x1, a, 0, label);
+  }
+
+  //J-Type
+  void Assembler::j(const string& label){
+    fixups.push_back({true, code.size(), label, 0, JUMP});
+    code.push_back(constructJInstr(0x2, 0));
+    delaySlots();
+  }
+  void Assembler::jal(const string& label){
+    fixups.push_back({true, code.size(), label, 0, JUMP});
+    lastWrite[31] = code.size();
+    code.push_back(constructJInstr(0x3, 0));
+    delaySlots();
+  }
+
+  //macros
+  void Assembler::li(Reg rt, data32 value){
+    signedData32 s = (signedData32) value;
+    if(s >= -0x8000 && s < 0x8000){
+      addiu(rt, 0, s);
+    } else {
+      //addiu sign extends, so borrow from the upper half when needed
+      short lo = (short) (value & 0xffff);
+      lui(rt, ((value - (signedData32) lo) >> 16) & 0xffff);
+      addiu(rt, rt, lo);
+    }
+  }
+
+  void Assembler::la(Reg rt, const string& label, long offset){
+    fixups.push_back({true, code.size(), label, offset, HI});
+    lui(rt, 0);
+    //the lo half goes in the addiu, which may end up behind nops
+    waitFor(rt);
+    fixups.push_back({true, code.size(), label, offset, LO});
+    addiu(rt, rt, 0);
+  }
+
+  //data
+  void Assembler::dataLabel(const string& name){
+    dataLabels[name] = data.size();
+  }
+  void Assembler::word(data32 value){
+    data.push_back(value);
+  }
+  void Assembler::words(const vector<data32>& values){
+    data.insert(data.end(), values.begin(), values.end());
+  }
+  void Assembler::wordLabel(const string& label, long offset){
+    fixups.push_back({false, data.size(), label, offset, WORD});
+    data.push_back(0);
+  }
+  void Assembler::space(size_t nWords){
+    data.insert(data.end(), nWords, 0);
+  }
+
+  data32 Assembler::resolve(const string& label) const{
+    auto c = codeLabels.find(label);
+    if(c != codeLabels.end())
+      return c->second;
+    auto d = dataLabels.find(label);
+    if(d != dataLabels.end())
+      return code.size() + d->second;
+    BOOST_LOG_TRIVIAL(fatal) << "<<Assembler>> undefined label " << label
+      << endl;
+    throw std::exception();
+  }
+
+  data32 Assembler::dataAddress(const string& label) const{
+    return resolve(label);
+  }
+
+  vector<data32> Assembler::assemble(){
+    for(const Fixup& f : fixups){
+      data32 target = resolve(f.label) + f.offset;
+      data32& slot = f.inCode ? code[f.index] : data[f.index];
+      switch(f.kind){
+        case BRANCH:
+        case JUMP: {
+          //a taken branch to x continues at x + 1
+          data32 imm = target - 1;
+          data32 limit = f.kind == BRANCH ? 0xffff : 0x3ffffff;
+          if(target == 0 || imm > limit){
+            BOOST_LOG_TRIVIAL(fatal) << "<<Assembler>> target " << f.label <<
+              " is out of range" << endl;
+            throw std::exception();
+          }
+          slot |= imm;
+          break;
+        }
+        case HI:
+          slot |= ((target - (signedData32) (short) (target & 0xffff)) >> 16)
+            & 0xffff;
+          break;
+        case LO:
+          slot |= target & 0xffff;
+          break;
+        case WORD:
+          slot = target;
+          break;
+      }
+    }
+    vector<data32> image = code;
+    image.insert(image.end(), data.begin(), data.end());
+    return image;
+  }
+
+  void Assembler::writeHex(const string& filename,
+      const vector<data32>& words){
+    ofstream out(filename);
+    out << hex << setfill('0');
+    for(data32 w : words)
+      out << setw(8) << w << "\n";
+  }
+
+  namespace {
+    /* for writing ELF's big endian fields */
+    uint16_t be(uint16_t x){
+      return htobe16(x);
+    }
+
+    uint32_t be(uint32_t x){
+      return htobe32(x);
+    }
+  }
+
+  void Assembler::writeElf(const string& filename){
+    vector<data32> image = assemble();
+    const size_t WORD = sizeof(data32);
+    size_t codeWords = code.size();
+    //trailing zero data takes no room in the file
+    size_t dataFileWords = data.size();
+    while(dataFileWords > 0 && data[dataFileWords - 1] == 0)
+      dataFileWords--;
+
+    //sections, in order
+    enum { TEXT = 1, DATA, BSS, SYMTAB, STRTAB, SHSTRTAB, N_SECTIONS };
+    string shstrtab(1, '\0');
+    array<size_t, N_SECTIONS> names = {};
+    const char* sectionNames[] = {"", ".text", ".data", ".bss", ".symtab",
+      ".strtab", ".shstrtab"};
+    for(size_t i = TEXT; i < N_SECTIONS; i++){
+      names[i] = shstrtab.size();
+      shstrtab += sectionNames[i];
+      shstrtab += '\0';
+    }
+
+    //the labels by address, so the table is the same every time
+    vector<pair<data32, pair<string, bool>>> labels;
+    for(const auto& l : codeLabels)
+      labels.push_back({(data32) l.second, {l.first, true}});
+    for(const auto& l : dataLabels)
+      labels.push_back({(data32) (codeWords + l.second),
+          {l.first, false}});
+    sort(labels.begin(), labels.end());
+    string strtab(1, '\0');
+    vector<Elf32_Sym> syms(1, Elf32_Sym{});
+    for(const auto& l : labels){
+      Elf32_Sym sym = {};
+      sym.st_name = be((uint32_t) strtab.size());
+      strtab += l.second.first;
+      strtab += '\0';
+      sym.st_value = be((uint32_t) (l.first * WORD));
+      sym.st_info = ELF32_ST_INFO(STB_GLOBAL,
+          l.second.second ? STT_FUNC : STT_OBJECT);
+      uint16_t section = l.second.second ? TEXT :
+        l.first < codeWords + dataFileWords ? DATA : BSS;
+      sym.st_shndx = be(section);
+      syms.push_back(sym);
+    }
+
+    //the layout: headers, code, data, then the tables
+    size_t phoff = sizeof(Elf32_Ehdr);
+    size_t textOff = phoff + 2 * sizeof(Elf32_Phdr);
+    size_t dataOff = textOff + codeWords * WORD;
+    size_t symOff = dataOff + dataFileWords * WORD;
+    size_t strOff = symOff + syms.size() * sizeof(Elf32_Sym);
+    size_t shstrOff = strOff + strtab.size();
+    size_t shoff = (shstrOff + shstrtab.size() + WORD - 1) / WORD * WORD;
+
+    Elf32_Ehdr eh = {};
+    memcpy(eh.e_ident, ELFMAG, SELFMAG);
+    eh.e_ident[EI_CLASS] = ELFCLASS32;
+    eh.e_ident[EI_DATA] = ELFDATA2MSB;
+    eh.e_ident[EI_VERSION] = EV_CURRENT;
+    eh.e_type = be((uint16_t) ET_EXEC);
+    eh.e_machine = be((uint16_t) EM_MIPS);
+    eh.e_version = be((uint32_t) EV_CURRENT);
+    eh.e_entry = 0;
+    eh.e_phoff = be((uint32_t) phoff);
+    eh.e_shoff = be((uint32_t) shoff);
+    eh.e_ehsize = be((uint16_t) sizeof(Elf32_Ehdr));
+    eh.e_phentsize = be((uint16_t) sizeof(Elf32_Phdr));
+    eh.e_phnum = be((uint16_t) 2);
+    eh.e_shentsize = be((uint16_t) sizeof(Elf32_Shdr));
+    eh.e_shnum = be((uint16_t) N_SECTIONS);
+    eh.e_shstrndx = be((uint16_t) SHSTRTAB);
+
+    array<Elf32_Phdr, 2> ph = {};
+    ph[0].p_type = be((uint32_t) PT_LOAD);
+    ph[0].p_offset = be((uint32_t) textOff);
+    ph[0].p_vaddr = ph[0].p_paddr = 0;
+    ph[0].p_filesz = ph[0].p_memsz = be((uint32_t) (codeWords * WORD));
+    ph[0].p_flags = be((uint32_t) (PF_R | PF_X));
+    ph[0].p_align = be((uint32_t) WORD);
+    ph[1].p_type = be((uint32_t) PT_LOAD);
+    ph[1].p_offset = be((uint32_t) dataOff);
+    ph[1].p_vaddr = ph[1].p_paddr = be((uint32_t) (codeWords * WORD));
+    ph[1].p_filesz = be((uint32_t) (dataFileWords * WORD));
+    ph[1].p_memsz = be((uint32_t) (data.size() * WORD));
+    ph[1].p_flags = be((uint32_t) (PF_R | PF_W));
+    ph[1].p_align = be((uint32_t) WORD);
+
+    array<Elf32_Shdr, N_SECTIONS> sh = {};
+    auto section = [&](size_t i, uint32_t type, uint32_t flags, size_t addr,
+        size_t offset, size_t size){
+      sh[i].sh_name = be((uint32_t) names[i]);
+      sh[i].sh_type = be(type);
+      sh[i].sh_flags = be(flags);
+      sh[i].sh_addr = be((uint32_t) addr);
+      sh[i].sh_offset = be((uint32_t) offset);
+      sh[i].sh_size = be((uint32_t) size);
+      sh[i].sh_addralign = be((uint32_t) 1);
+    };
+    section(TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, textOff,
+        codeWords * WORD);
+    section(DATA, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, codeWords * WORD,
+        dataOff, dataFileWords * WORD);
+    section(BSS, SHT_NOBITS, SHF_ALLOC | SHF_WRITE,
+        (codeWords + dataFileWords) * WORD, symOff,
+        (data.size() - dataFileWords) * WORD);
+    section(SYMTAB, SHT_SYMTAB, 0, 0, symOff, syms.size() * sizeof(Elf32_Sym));
+    sh[SYMTAB].sh_link = be((uint32_t) STRTAB);
+    //every symbol is global
+    sh[SYMTAB].sh_info = be((uint32_t) 1);
+    sh[SYMTAB].sh_entsize = be((uint32_t) sizeof(Elf32_Sym));
+    section(STRTAB, SHT_STRTAB, 0, 0, strOff, strtab.size());
+    section(SHSTRTAB, SHT_STRTAB, 0, 0, shstrOff, shstrtab.size());
+
+    vector<data32> words(image.begin(), image.begin() + codeWords +
+        dataFileWords);
+    for(data32& w : words)
+      w = be(w);
+    ofstream out(filename, ios::binary);
+    out.write((const char*) &eh, sizeof(eh));
+    out.write((const char*) ph.data(), sizeof(ph));
+    out.write((const char*) words.data(), words.size() * WORD);
+    out.write((const char*) syms.data(), syms.size() * sizeof(Elf32_Sym));
+    out.write(strtab.data(), strtab.size());
+    out.write(shstrtab.data(), shstrtab.size());
+    out.write("\0\0\0", shoff - shstrOff - shstrtab.size());
+    out.write((const char*) sh.data(), sizeof(sh));
+    if(!out){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Assembler>> can't write " << filename <<
+        endl;
+      throw std::exception();
+    }
+  }
+}
@@ -0,0 +1,202 @@
+#ifndef ASSEMBLER_H_INCLUDED
+#define ASSEMBLER_H_INCLUDED
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include "Mem.h"
+
+using namespace std;
+using namespace mem;
+/*
+ * A tiny assembler for the dialect of MIPS that this simulator executes, so
+ * programs can be built without a cross compiler. It is not gcc's MIPS. The
+ * differences, as implemented by the pipeline stages, are:
+ *   - addresses (pc, lw, sw) are word indices, not byte addresses. Only
+ *     the byte and halfword loads and stores take byte addresses, 4 bytes
+ *     to a word from its most significant (see Mem.h)
+ *   - branch and jump immediates are absolute, and a taken branch to x
+ *     continues at x + 1. The assembler takes care of the - 1
+ *   - up to 5 instructions behind a branch, jump or syscall are fetched and
+ *     executed before it takes effect. The assembler pads them with nops
+ *   - registers are read in decode and written in writeback, with nothing
+ *     forwarded, so a reader has to be 4 instructions behind its writer. The
+ *     assembler pads with nops until that holds
+ *   - subu is rt - rs, shifts shift rs, sw stores rs at rt + imm. ll and
+ *     sc are word addressed and as in MIPS, sc storing rt at rs + imm
+ * The method signatures below hide all of that and read like normal MIPS,
+ * e.g. subu(rd, a, b) is rd = a - b and sw(val, base, off) is
+ * mem[base + off] = val.
+ *
+ * Code is laid out from address 0 followed by the data words. Address 0 is
+ * always a nop so that no label can sit there.
+ */
+namespace assembler{
+
+  typedef unsigned int Reg;
+
+  class Assembler{
+    private:
+      enum FixupKind { BRANCH, JUMP, HI, LO, WORD };
+      struct Fixup{
+        bool inCode;
+        size_t index;
+        string label;
+        long offset;
+        FixupKind kind;
+      };
+
+      vector<data32> code;
+      vector<data32> data;
+      unordered_map<string, size_t> codeLabels;
+      unordered_map<string, size_t> dataLabels;
+      vector<Fixup> fixups;
+      /* position of the last instruction to write each register */
+      array<long, 32> lastWrite;
+
+      /*
+       * pads with nops until register r can be read safely
+       */
+      void waitFor(Reg r);
+
+      /*
+       * emits an instruction after making its source registers safe to read
+       * params:
+       *   instr: the encoded instruction
+       *   reads: registers read in decode
+       *   write: the register written in writeback, or -1
+       */
+      void emit(data32 instr, vector<Reg> reads, int write);
+
+      /* the nops behind a branch or jump */
+      void delaySlots();
+
+      void rInstr(Reg rs, Reg rt, Reg rd, unsigned int shamt,
+          unsigned int func, vector<Reg> reads, int write);
+      void iInstr(unsigned int opcode, Reg rs, Reg rt, long imm,
+          vector<Reg> reads, int write);
+      void branch(unsigned int opcode, Reg rs, Reg rt, const string& label);
+
+      /*
+       * returns: the address of a code or data label
+       * throws: exception if it was never defined
+       */
+      data32 resolve(const string& label) const;
+
+    public:
+      /* instructions between a writer and reader of a register */
+      static const int HAZARD_DISTANCE = 4;
+      /* instructions executed behind a branch or jump */
+      static const int DELAY_SLOTS = 5;
+
+      Assembler();
+
+      /*
+       * defines a code label at the current position
+       */
+      void label(const string& name);
+
+      //R-Type
+      void addu(Reg rd, Reg a, Reg b);
+      void subu(Reg rd, Reg a, Reg b);
+      void and_(Reg rd, Reg a, Reg b);
+      void or_(Reg rd, Reg a, Reg b);
+      void xor_(Reg rd, Reg a, Reg b);
+      void nor(Reg rd, Reg a, Reg b);
+      void slt(Reg rd, Reg a, Reg b);
+      void sltu(Reg rd, Reg a, Reg b);
+      void sll(Reg rd, Reg a, unsigned int shamt);
+      void srl(Reg rd, Reg a, unsigned int shamt);
+      void sra(Reg rd, Reg a, unsigned int shamt);
+      void sllv(Reg rd, Reg a, Reg amount);
+      void srlv(Reg rd, Reg a, Reg amount);
+      void mult(Reg a, Reg b);
+      void multu(Reg a, Reg b);
+      void div(Reg a, Reg b);
+      void divu(Reg a, Reg b);
+      void mfhi(Reg rd);
+      void mflo(Reg rd);
+      void move(Reg rd, Reg a);
+      void jr(Reg a);
+      void syscall();
+      void sync();
+      void nop();
+
+      //I-Type
+      void addiu(Reg rt, Reg rs, long imm);
+      void slti(Reg rt, Reg rs, long imm);
+      void andi(Reg rt, Reg rs, unsigned long imm);
+      void lui(Reg rt, unsigned long imm);
+      void lw(Reg rt, Reg base, long offset);
+      void sw(Reg val, Reg base, long offset);
+      void lb(Reg rt, Reg base, long offset);
+      void lbu(Reg rt, Reg base, long offset);
+      void lh(Reg rt, Reg base, long offset);
+      void lhu(Reg rt, Reg base, long offset);
+      void sb(Reg val, Reg base, long offset);
+      void sh(Reg val, Reg base, long offset);
+      /* sc leaves 1 in val if it stored, 0 if not (see Atomics.h) */
+      void ll(Reg rt, Reg base, long offset);
+      void sc(Reg val, Reg base, long offset);
+      void beq(Reg a, Reg b, const string& label);
+      void bne(Reg a, Reg b, const string& label);
+      void bltz(Reg a, const string& label);
+
+      //J-Type
+      void j(const string& label);
+      void jal(const string& label);
+
+      //macros
+      /*
+       * loads a 32 bit constant
+       */
+      void li(Reg rt, data32 value);
+      /*
+       * loads the address of a code or data label
+       */
+      void la(Reg rt, const string& label, long offset = 0);
+
+      //data
+      /*
+       * defines a data label at the current end of the data
+       */
+      void dataLabel(const string& name);
+      void word(data32 value);
+      void words(const vector<data32>& values);
+      /*
+       * a word that holds the address of a label (plus offset)
+       */
+      void wordLabel(const string& label, long offset = 0);
+      void space(size_t nWords);
+
+      /*
+       * resolves all the labels
+       * returns: the program image, code followed by data
+       * throws: exception on an undefined label or an out of range target
+       */
+      vector<data32> assemble();
+
+      /*
+       * returns: the address a data label will end up at. Only valid after
+       * the code is finished
+       */
+      data32 dataAddress(const string& label) const;
+
+      /*
+       * writes words one per line as hex, the format MachineCodeFileReader
+       * reads
+       */
+      static void writeHex(const string& filename,
+          const vector<data32>& words);
+
+      /*
+       * assembles, then writes a big endian ELF32 MIPS executable of the
+       * program as ElfFile loads it: the code in one segment at 0, entered
+       * at 0, the data in another after it, its zero tail as .bss. Code
+       * labels become function symbols, data labels object ones
+       * throws: exception as assemble, or if filename can't be written
+       */
+      void writeElf(const string& filename);
+  };
+}
+#endif
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include "Atomics.h"
+
+using namespace std;
+
+namespace atomics{
+
+  LinkRegister::LinkRegister(size_t core) : core{core}, deferred{false},
+    cycle{0}, linked{false}, linkAddr{0}, waiting{false}, waitingSC{false},
+    scAddr{0}, scValue{0}, scCycle{0}, result{false}, spinning{false},
+    spinAddr{0}, spinStart{0}, nSyncs{0} {}
+
+  void LinkRegister::setCycle(unsigned long cycle){
+    this->cycle = cycle;
+  }
+
+  void LinkRegister::loadLinked(data32 addr){
+    linked = true;
+    linkAddr = addr;
+    locks[addr].nLoadLinked++;
+    if(!spinning || spinAddr != addr){
+      spinning = true;
+      spinAddr = addr;
+      spinStart = cycle;
+    }
+  }
+
+  void LinkRegister::finish(data32 addr, bool stored){
+    LockStats& s = locks[addr];
+    s.nStoreConditional++;
+    if(stored){
+      s.nAcquired++;
+      if(spinning && spinAddr == addr)
+        s.spinCycles += cycle - spinStart;
+      spinning = false;
+    } else {
+      s.nFailed++;
+    }
+    linked = false;
+  }
+
+  void LinkRegister::beginStoreConditional(data32 addr, data32 value){
+    if(!deferred)
+      return;
+    waiting = true;
+    waitingSC = true;
+    scAddr = addr;
+    scValue = value;
+    scCycle = cycle;
+  }
+
+  bool LinkRegister::storeConditional(data32 addr, data32 value,
+      MemoryUnit& mem){
+    if(deferred)
+      return result;
+    bool stored = linked && linkAddr == addr;
+    if(stored)
+      mem.sw(addr, value);
+    finish(addr, stored);
+    return stored;
+  }
+
+  void LinkRegister::sync(){
+    nSyncs++;
+    if(deferred)
+      waiting = true;
+  }
+
+  bool LinkRegister::isWaiting() const{
+    return waiting;
+  }
+
+  void LinkRegister::lineLost(data32 line, unsigned int lineWords){
+    if(linked && linkAddr / lineWords == line)
+      linked = false;
+  }
+
+  const map<data32, LockStats>& LinkRegister::getLockStats() const{
+    return locks;
+  }
+
+  unsigned long LinkRegister::getNSyncs() const{
+    return nSyncs;
+  }
+
+  Arbiter::Arbiter(unsigned int lineWords) : lineWords{lineWords} {}
+
+  void Arbiter::attach(LinkRegister& link){
+    link.deferred = true;
+    links.push_back(&link);
+  }
+
+  void Arbiter::breakOthers(data32 line, size_t core){
+    for(LinkRegister* l : links)
+      if(l->core != core)
+        l->lineLost(line, lineWords);
+  }
+
+  void Arbiter::resolve(const unordered_map<data32, size_t>& written,
+      MemoryUnit& shared){
+    for(const pair<const data32, size_t>& w : written)
+      breakOthers(w.first / lineWords, w.second);
+
+    vector<LinkRegister*> order;
+    for(LinkRegister* l : links)
+      if(l->waitingSC)
+        order.push_back(l);
+    //attached in core order, which breaks the ties
+    stable_sort(order.begin(), order.end(),
+        [](const LinkRegister* a, const LinkRegister* b){
+          return a->scCycle < b->scCycle;
+        });
+    for(LinkRegister* l : order){
+      bool stored = l->linked && l->linkAddr == l->scAddr;
+      if(stored){
+        shared.sw(l->scAddr, l->scValue);
+        breakOthers(l->scAddr / lineWords, l->core);
+      }
+      l->result = stored;
+      l->finish(l->scAddr, stored);
+    }
+    for(LinkRegister* l : links)
+      l->waiting = l->waitingSC = false;
+  }
+
+  map<data32, LockStats> Arbiter::getLockStats() const{
+    map<data32, LockStats> total;
+    for(const LinkRegister* l : links){
+      for(const pair<const data32, LockStats>& lock : l->locks){
+        LockStats& t = total[lock.first];
+        t.nLoadLinked += lock.second.nLoadLinked;
+        t.nStoreConditional += lock.second.nStoreConditional;
+        t.nFailed += lock.second.nFailed;
+        t.nAcquired += lock.second.nAcquired;
+        t.spinCycles += lock.second.spinCycles;
+      }
+    }
+    return total;
+  }
+
+  void Arbiter::report(ostream& out, size_t nLocks) const{
+    map<data32, LockStats> total = getLockStats();
+    if(total.empty() && none_of(links.begin(), links.end(),
+          [](const LinkRegister* l){ return l->nSyncs > 0; }))
+      return;
+    for(const LinkRegister* l : links){
+      unsigned long nSC = 0, nFailed = 0;
+      for(const pair<const data32, LockStats>& lock : l->locks){
+        nSC += lock.second.nStoreConditional;
+        nFailed += lock.second.nFailed;
+      }
+      out << "core " << l->core << ": " << nSC << " sc, " << nFailed <<
+        " failed (" << (nSC ? 100.0 * nFailed / nSC : 0) << "%), " <<
+        l->nSyncs << " syncs" << endl;
+    }
+
+    vector<pair<data32, LockStats>> worst(total.begin(), total.end());
+    stable_sort(worst.begin(), worst.end(), [](
+          const pair<data32, LockStats>& a, const pair<data32, LockStats>& b){
+        return a.second.spinCycles > b.second.spinCycles;
+      });
+    for(size_t i = 0; i < worst.size() && i < nLocks; i++){
+      const LockStats& s = worst[i].second;
+      out << "lock at word 0x" << hex << worst[i].first << dec << ": " <<
+        s.nAcquired << " acquired, " << s.nStoreConditional << " sc, " <<
+        s.nFailed << " failed (" << (s.nStoreConditional ?
+            100.0 * s.nFailed / s.nStoreConditional : 0) << "%), " <<
+        s.spinCycles << " spin cycles (" << (s.nAcquired ?
+            (double) s.spinCycles / s.nAcquired : 0) << " per acquire)" <<
+        endl;
+    }
+  }
+}
@@ -0,0 +1,175 @@
+#ifndef ATOMICS_H_INCLUDED
+#define ATOMICS_H_INCLUDED
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "Mem.h"
+
+using namespace std;
+using namespace mem;
+/*
+ * ll, sc and sync. Each core has a link register, set by ll to the word it
+ * loaded. An sc to that word stores its value and writes 1 to its rt if the
+ * link still holds, and otherwise writes 0 and stores nothing. Every sc
+ * clears the link.
+ *
+ * On its own a core's link only goes by what that core does, as nothing
+ * else stores. Under MultiCoreSim an Arbiter takes the links over, and an
+ * sc or a sync makes its core wait for the barrier (see MultiCore.h):
+ *   - the plain stores are published first, and a store by another core to
+ *     a linked line breaks the link, since the ll may have read the word
+ *     before it
+ *   - then the waiting sc's go in cycle order (core order within a cycle),
+ *     each that succeeds storing straight to the shared memory and breaking
+ *     the other links to its line
+ * A line is coh.lineWords words with caches, one word without. With caches
+ * a core's link also breaks when its L1 loses the line, evicted, invalidated
+ * by another's store or by the L2 (see Coherence.h). The wait itself takes
+ * no cycles, the core picks up from where it stopped in the next quantum.
+ * sync waits so that the core's stores before it are seen by every core
+ * before anything after it is done, the store buffer being the CoreMem.
+ *
+ * The counts are per lock, the word an ll or sc is to. A lock is spun on
+ * from the first ll to it until an sc to it succeeds, and those cycles are
+ * its spin cycles.
+ */
+namespace atomics{
+
+  struct LockStats{
+    unsigned long nLoadLinked = 0;
+    unsigned long nStoreConditional = 0;
+    /* sc's that stored nothing */
+    unsigned long nFailed = 0;
+    /* sc's that succeeded */
+    unsigned long nAcquired = 0;
+    /* from the first ll to each successful sc */
+    unsigned long spinCycles = 0;
+  };
+
+  class Arbiter;
+
+  class LinkRegister{
+    private:
+      size_t core;
+      /* waits for an Arbiter */
+      bool deferred;
+      unsigned long cycle;
+      bool linked;
+      data32 linkAddr;
+      /* an sc or sync the Arbiter is yet to see */
+      bool waiting;
+      bool waitingSC;
+      data32 scAddr;
+      data32 scValue;
+      unsigned long scCycle;
+      /* what the Arbiter made of the last sc */
+      bool result;
+      /* the lock being spun on, since when */
+      bool spinning;
+      data32 spinAddr;
+      unsigned long spinStart;
+      map<data32, LockStats> locks;
+      unsigned long nSyncs;
+
+      friend class Arbiter;
+
+      /* counts an sc to addr that did or did not store */
+      void finish(data32 addr, bool stored);
+
+    public:
+      LinkRegister(size_t core = 0);
+
+      /*
+       * sets the cycle the next ll and sc are counted at
+       */
+      void setCycle(unsigned long cycle);
+
+      /*
+       * links addr, a word address. The load itself is the caller's
+       */
+      void loadLinked(data32 addr);
+
+      /*
+       * an sc reaching memory access. Under an Arbiter the core waits for it
+       * from here, see isWaiting
+       */
+      void beginStoreConditional(data32 addr, data32 value);
+
+      /*
+       * the sc leaving memory access: on its own, stores value at addr in
+       * mem if addr is linked. Under an Arbiter, says what it made of it
+       * returns: whether it stored
+       */
+      bool storeConditional(data32 addr, data32 value, MemoryUnit& mem);
+
+      /*
+       * a sync reaching memory access, which under an Arbiter waits
+       */
+      void sync();
+
+      /*
+       * returns: whether an sc or sync waits for the Arbiter
+       */
+      bool isWaiting() const;
+
+      /*
+       * breaks the link if it is to a word of line, lineWords words long
+       */
+      void lineLost(data32 line, unsigned int lineWords);
+
+      /*
+       * returns: per lock counts, for the words ll or sc went to
+       */
+      const map<data32, LockStats>& getLockStats() const;
+
+      unsigned long getNSyncs() const;
+  };
+
+  /*
+   * the cores' links under MultiCoreSim, resolved at each barrier
+   */
+  class Arbiter{
+    private:
+      vector<LinkRegister*> links;
+      unsigned int lineWords;
+
+      /* breaks every link to line but core's */
+      void breakOthers(data32 line, size_t core);
+
+    public:
+      /*
+       * params:
+       *   lineWords: words in a line, the granule a store breaks links in
+       */
+      Arbiter(unsigned int lineWords);
+
+      /*
+       * takes link over, so that its sc's and syncs wait for resolve. Not
+       * owned
+       */
+      void attach(LinkRegister& link);
+
+      /*
+       * breaks the links the stores just published hit, then runs the
+       * waiting sc's against shared and lets every core go on. Only while no
+       * core runs
+       * params:
+       *   written: the words published and the core that stored each
+       */
+      void resolve(const unordered_map<data32, size_t>& written,
+          MemoryUnit& shared);
+
+      /*
+       * returns: the per lock counts of every core added up
+       */
+      map<data32, LockStats> getLockStats() const;
+
+      /*
+       * writes each core's sc failure rate and the nLocks locks with the
+       * most spin cycles to out, nothing if there were no ll, sc or sync
+       */
+      void report(ostream& out, size_t nLocks = 8) const;
+  };
+}
+#endif
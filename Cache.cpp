@@ -0,0 +1,143 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <exception>
+#include "Cache.h"
+
+using namespace std;
+
+namespace cache{
+
+  namespace {
+    bool isPowerOf2(unsigned int n){
+      return n != 0 && (n & (n - 1)) == 0;
+    }
+  }
+
+  void CacheStats::merge(const CacheStats& other){
+    accesses += other.accesses;
+    misses += other.misses;
+  }
+
+  double CacheStats::missRatio() const{
+    return accesses ? (double) misses / accesses : 0;
+  }
+
+  Cache::Cache(unsigned int nSets, unsigned int ways,
+      unsigned int lineWords) : nSets{nSets}, ways{ways},
+    lineWords{lineWords}, lines((size_t) nSets * ways), fill(nSets, 0) {
+    if(!isPowerOf2(nSets) || ways == 0 || !isPowerOf2(lineWords)){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Cache>> bad geometry, " << nSets <<
+        " sets of " << ways << " ways of " << lineWords << " words" << endl;
+      throw std::exception();
+    }
+  }
+
+  bool Cache::access(data32 address){
+    return accessLine(address / lineWords);
+  }
+
+  bool Cache::accessLine(data32 line){
+    stats.accesses++;
+    unsigned int set = line & (nSets - 1);
+    data32* first = &lines[(size_t) set * ways];
+    unsigned int& n = fill[set];
+    data32* found = find(first, first + n, line);
+    bool hit = found != first + n;
+    if(!hit){
+      stats.misses++;
+      //evict the least recent, or take a free way
+      if(n < ways)
+        n++;
+      found = first + n - 1;
+    }
+    //move to the front
+    move_backward(first, found, found + 1);
+    *first = line;
+    return hit;
+  }
+
+  const CacheStats& Cache::getStats() const{
+    return stats;
+  }
+
+  ShardedCacheSim::Shard::Shard(unsigned int nSets, unsigned int ways) :
+    cache(nSets, ways, 1), queue(QUEUE_BATCHES) {}
+
+  ShardedCacheSim::ShardedCacheSim(unsigned int nSets, unsigned int ways,
+      unsigned int lineWords, unsigned int nShards) : nSets{nSets},
+    lineWords{lineWords}, finished{false} {
+    //checks the geometry before any thread starts
+    Cache(nSets, ways, lineWords);
+    if(nShards == 0)
+      nShards = thread::hardware_concurrency();
+    nShards = min(max(nShards, 1u), nSets);
+    while(!isPowerOf2(nShards))
+      nShards &= nShards - 1;
+
+    //shard i has sets i, i + nShards ... as its sets 0, 1 ...
+    for(unsigned int i = 0; i < nShards; i++)
+      shards.push_back(make_unique<Shard>(nSets / nShards, ways));
+    for(unique_ptr<Shard>& s : shards){
+      Shard* shard = s.get();
+      shard->pending.reserve(BATCH);
+      shard->worker = thread([shard](){
+        while(true){
+          vector<data32> batch = shard->queue.pop();
+          //an empty batch is the end
+          if(batch.empty())
+            return;
+          for(data32 line : batch)
+            shard->cache.accessLine(line);
+        }
+      });
+    }
+  }
+
+  void ShardedCacheSim::send(Shard& shard){
+    shard.queue.push(move(shard.pending));
+    shard.pending = vector<data32>();
+    shard.pending.reserve(BATCH);
+  }
+
+  void ShardedCacheSim::access(data32 address){
+    data32 line = address / lineWords;
+    unsigned int set = line & (nSets - 1);
+    size_t nShards = shards.size();
+    Shard& shard = *shards[set & (nShards - 1)];
+    //the same line with the shard's bits taken out of the set index
+    data32 tag = line / nSets;
+    shard.pending.push_back(tag * (nSets / nShards) + set / nShards);
+    if(shard.pending.size() == BATCH)
+      send(shard);
+  }
+
+  CacheStats ShardedCacheSim::finish(){
+    if(!finished){
+      finished = true;
+      for(unique_ptr<Shard>& shard : shards){
+        if(!shard->pending.empty())
+          send(*shard);
+        shard->queue.push(vector<data32>());
+      }
+      for(unique_ptr<Shard>& shard : shards)
+        shard->worker.join();
+    }
+    CacheStats total;
+    for(unique_ptr<Shard>& shard : shards)
+      total.merge(shard->cache.getStats());
+    return total;
+  }
+
+  const CacheStats& ShardedCacheSim::getShardStats(size_t shard) const{
+    return shards.at(shard)->cache.getStats();
+  }
+
+  size_t ShardedCacheSim::getNShards() const{
+    return shards.size();
+  }
+
+  ShardedCacheSim::~ShardedCacheSim(){
+    finish();
+  }
+}
@@ -0,0 +1,125 @@
+#ifndef CACHE_H_INCLUDED
+#define CACHE_H_INCLUDED
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Mem.h"
+#include "SpscQueue.h"
+
+using namespace std;
+using namespace mem;
+using namespace pool;
+/*
+ * Trace driven cache simulation: a set associative LRU cache that only keeps
+ * tags and counts hits and misses, and a driver that simulates one such
+ * cache on several threads.
+ *
+ * Sets never interact, so ShardedCacheSim splits the sets between shards,
+ * set % nShards, and gives each shard its own thread and its own smaller
+ * Cache holding just its sets. The thread feeding it routes every address
+ * to its shard through an SpscQueue, in batches, and the shards' counts are
+ * summed at the end. The result is exactly that of one Cache.
+ */
+namespace cache{
+
+  struct CacheStats{
+    uint64_t accesses = 0;
+    uint64_t misses = 0;
+
+    void merge(const CacheStats& other);
+    double missRatio() const;
+  };
+
+  class Cache{
+    private:
+      unsigned int nSets;
+      unsigned int ways;
+      unsigned int lineWords;
+      /* each set's lines, most recently used first */
+      vector<data32> lines;
+      /* lines each set holds so far */
+      vector<unsigned int> fill;
+      CacheStats stats;
+
+    public:
+      /*
+       * params:
+       *   nSets: a power of 2
+       *   ways: lines per set
+       *   lineWords: words per line, a power of 2
+       * throws: exception if a size is not as above
+       */
+      Cache(unsigned int nSets, unsigned int ways, unsigned int lineWords);
+
+      /*
+       * returns: whether the word at address hit
+       */
+      bool access(data32 address);
+
+      /*
+       * as access, for a line number (address / lineWords)
+       */
+      bool accessLine(data32 line);
+
+      const CacheStats& getStats() const;
+  };
+
+  class ShardedCacheSim{
+    private:
+      /* addresses go to a shard this many at a time */
+      static const size_t BATCH = 1024;
+      /* batches in flight per shard */
+      static const size_t QUEUE_BATCHES = 64;
+
+      struct Shard{
+        Cache cache;
+        SpscQueue<vector<data32>> queue;
+        /* what the feeding thread has yet to send */
+        vector<data32> pending;
+        thread worker;
+
+        Shard(unsigned int nSets, unsigned int ways);
+      };
+
+      unsigned int nSets;
+      unsigned int lineWords;
+      vector<unique_ptr<Shard>> shards;
+      bool finished;
+
+      void send(Shard& shard);
+
+    public:
+      /*
+       * starts the shard threads
+       * params:
+       *   nSets, ways, lineWords: the cache, as for Cache
+       *   nShards: threads, 0 for one per hardware thread. Capped at nSets
+       *     and rounded down to a power of 2
+       * throws: exception as Cache
+       */
+      ShardedCacheSim(unsigned int nSets, unsigned int ways,
+          unsigned int lineWords, unsigned int nShards = 0);
+
+      /*
+       * one access, from the thread that made this
+       */
+      void access(data32 address);
+
+      /*
+       * sends what is left, stops the shards and sums their counts. Further
+       * accesses are not allowed
+       */
+      CacheStats finish();
+
+      /*
+       * returns: one shard's counts, valid after finish
+       */
+      const CacheStats& getShardStats(size_t shard) const;
+
+      size_t getNShards() const;
+
+      ~ShardedCacheSim();
+  };
+}
+#endif
@@ -0,0 +1,270 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Checkpoint.h"
+
+using namespace std;
+using namespace functional;
+
+namespace checkpoint{
+
+  namespace {
+    const char MAGIC[8] = {'C', 'C', 'A', 'C', 'K', 'P', 'T', '1'};
+    const char RECORD_MAGIC[8] = {'C', 'K', 'P', 'T', 'R', 'E', 'C', 'D'};
+    const uint32_t VERSION = 1;
+    /* records and pages start at multiples of this */
+    const size_t ALIGN = DirtyTrackingMem::PAGE_WORDS * sizeof(data32);
+
+    struct Header{
+      char magic[8];
+      uint32_t version;
+      uint32_t pad;
+      uint64_t memWords;
+    };
+
+    /* followed by nPages page numbers */
+    struct RecordHeader{
+      char magic[8];
+      uint64_t nExecuted;
+      data64 acc;
+      data32 pc;
+      data32 regs[32];
+      uint32_t nPages;
+    };
+
+    size_t aligned(size_t bytes){
+      return (bytes + ALIGN - 1) / ALIGN * ALIGN;
+    }
+
+    void checkQuiet(const FunctionalCore& core){
+      if(!core.isQuiet()){
+        BOOST_LOG_TRIVIAL(fatal) << "<<Checkpoint>> checkpoint at " <<
+          core.getNExecuted() << " with a branch or link in flight" << endl;
+        throw std::exception();
+      }
+    }
+
+    ArchState stateOf(const FunctionalCore& core){
+      ArchState state;
+      state.nExecuted = core.getNExecuted();
+      state.pc = core.getPc();
+      state.acc = core.getAccumulator();
+      state.regs = core.getRegisters();
+      return state;
+    }
+  }
+
+  Checkpointer::Checkpointer(DirtyTrackingMem& mainMem) : mainMem{mainMem} {
+    //loading the program is not a change
+    mainMem.takeDirty();
+  }
+
+  shared_ptr<const Checkpoint> Checkpointer::take(const FunctionalCore& core){
+    checkQuiet(core);
+    (ArchState&) last = stateOf(core);
+    size_t size = mainMem.getSize();
+    for(data32 page : mainMem.takeDirty()){
+      data32 base = page * DirtyTrackingMem::PAGE_WORDS;
+      auto words = make_shared<vector<data32>>(
+          min<size_t>(DirtyTrackingMem::PAGE_WORDS, size - base));
+      for(size_t i = 0; i < words->size(); i++)
+        (*words)[i] = mainMem.ld(base + i);
+      last.pages[page] = words;
+    }
+    return make_shared<const Checkpoint>(last);
+  }
+
+  void restore(const Checkpoint& c, const ProgramImage& image,
+      MemoryUnit& mainMem, MemoryUnit& rf){
+    mainMem.storeBlock(0, const_cast<data32*>(image->data()), image->size());
+    rf.sw(31, image->size() - 1);
+    for(const pair<const data32, Page>& page : c.pages)
+      mainMem.storeBlock(page.first * DirtyTrackingMem::PAGE_WORDS,
+          const_cast<data32*>(page.second->data()), page.second->size());
+    for(data32 i = 0; i < 32; i++)
+      rf.sw(i, c.regs[i]);
+  }
+
+  void start(const ArchState& c, Processor5S& p){
+    p.setAccumulator(c.acc);
+    p.setPc(c.pc);
+  }
+
+  CheckpointWriter::CheckpointWriter(const string& filename,
+      DirtyTrackingMem& mainMem) : out{filename, ios::binary},
+    mainMem{mainMem}, nWritten{0} {
+    Header h = {};
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.memWords = mainMem.getSize();
+    out.write((const char*) &h, sizeof(h));
+    vector<char> pad(ALIGN - sizeof(h), 0);
+    out.write(pad.data(), pad.size());
+    if(!out){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Checkpoint>> can't write " << filename <<
+        endl;
+      throw std::exception();
+    }
+  }
+
+  void CheckpointWriter::write(const FunctionalCore& core){
+    checkQuiet(core);
+    ArchState state = stateOf(core);
+    vector<data32> pages = mainMem.takeDirty();
+    sort(pages.begin(), pages.end());
+
+    RecordHeader h = {};
+    memcpy(h.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    h.nExecuted = state.nExecuted;
+    h.acc = state.acc;
+    h.pc = state.pc;
+    copy(state.regs.begin(), state.regs.end(), h.regs);
+    h.nPages = pages.size();
+    size_t headerBytes = sizeof(h) + pages.size() * sizeof(data32);
+    out.write((const char*) &h, sizeof(h));
+    out.write((const char*) pages.data(), pages.size() * sizeof(data32));
+    vector<char> pad(aligned(headerBytes) - headerBytes, 0);
+    out.write(pad.data(), pad.size());
+
+    vector<data32> words(DirtyTrackingMem::PAGE_WORDS);
+    size_t size = mainMem.getSize();
+    for(data32 page : pages){
+      data32 base = page * DirtyTrackingMem::PAGE_WORDS;
+      fill(words.begin(), words.end(), 0);
+      for(size_t i = 0; i < words.size() && base + i < size; i++)
+        words[i] = mainMem.ld(base + i);
+      out.write((const char*) words.data(), ALIGN);
+    }
+    out.flush();
+    if(!out){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Checkpoint>> writing checkpoint " <<
+        nWritten << " failed" << endl;
+      throw std::exception();
+    }
+    nWritten++;
+  }
+
+  size_t CheckpointWriter::getNWritten() const{
+    return nWritten;
+  }
+
+  CheckpointReader::CheckpointReader(const string& filename) : fd{-1},
+    filename{filename}, memWords{0} {
+    fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    Header h;
+    if(fd < 0 || fstat(fd, &st) != 0 ||
+        pread(fd, &h, sizeof(h), 0) != sizeof(h) ||
+        memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Checkpoint>> " << filename << " is not "
+        "a checkpoint file" << endl;
+      if(fd >= 0)
+        ::close(fd);
+      throw std::exception();
+    }
+    memWords = h.memWords;
+    size_t size = st.st_size;
+    size_t offset = ALIGN;
+    while(offset < size){
+      RecordHeader r;
+      Record record;
+      bool ok = pread(fd, &r, sizeof(r), offset) == sizeof(r) &&
+        memcmp(r.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC)) == 0;
+      if(ok){
+        record.pages.resize(r.nPages);
+        size_t bytes = r.nPages * sizeof(data32);
+        ok = pread(fd, record.pages.data(), bytes, offset + sizeof(r)) ==
+          (ssize_t) bytes;
+        record.pagesOffset = offset + aligned(sizeof(r) + bytes);
+        offset = record.pagesOffset + r.nPages * ALIGN;
+        ok = ok && offset <= size;
+      }
+      if(!ok){
+        BOOST_LOG_TRIVIAL(fatal) << "<<Checkpoint>> " << filename << " is "
+          "truncated after " << records.size() << " checkpoints" << endl;
+        ::close(fd);
+        throw std::exception();
+      }
+      record.state.nExecuted = r.nExecuted;
+      record.state.pc = r.pc;
+      record.state.acc = r.acc;
+      copy(r.regs, r.regs + 32, record.state.regs.begin());
+      records.push_back(move(record));
+    }
+  }
+
+  size_t CheckpointReader::getNCheckpoints() const{
+    return records.size();
+  }
+
+  uint64_t CheckpointReader::getMemWords() const{
+    return memWords;
+  }
+
+  const ArchState& CheckpointReader::getState(size_t i) const{
+    return records.at(i).state;
+  }
+
+  unique_ptr<MappedMem> CheckpointReader::restore(size_t i,
+      MemoryUnit& rf) const{
+    if(i >= records.size()){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Checkpoint>> " << filename << " has " <<
+        records.size() << " checkpoints, not " << i + 1 << endl;
+      throw std::exception();
+    }
+    //each page's latest copy up to i
+    map<data32, size_t> latest;
+    for(size_t r = 0; r <= i; r++)
+      for(size_t p = 0; p < records[r].pages.size(); p++)
+        latest[records[r].pages[p]] = records[r].pagesOffset + p * ALIGN;
+
+    auto mainMem = make_unique<MappedMem>(memWords, "MainMem");
+    bool mappable = (size_t) sysconf(_SC_PAGESIZE) == ALIGN;
+    vector<data32> words(DirtyTrackingMem::PAGE_WORDS);
+    auto it = latest.begin();
+    while(it != latest.end()){
+      //a run of pages next to each other in memory and in the file
+      auto end = next(it);
+      size_t n = 1;
+      while(end != latest.end() && end->first == it->first + n &&
+          end->second == it->second + n * ALIGN){
+        end++;
+        n++;
+      }
+      data32 addr = it->first * DirtyTrackingMem::PAGE_WORDS;
+      size_t nWords = min<size_t>(n * DirtyTrackingMem::PAGE_WORDS,
+          memWords - addr);
+      if(mappable){
+        mainMem->mapFile(fd, it->second, addr, nWords);
+      } else {
+        //host pages that are not the file's, so read instead
+        for(size_t p = 0; p < n; p++){
+          size_t pageWords = min<size_t>(DirtyTrackingMem::PAGE_WORDS,
+              memWords - addr);
+          if(pread(fd, words.data(), ALIGN, it->second + p * ALIGN) !=
+              (ssize_t) ALIGN){
+            BOOST_LOG_TRIVIAL(fatal) << "<<Checkpoint>> can't read " <<
+              filename << endl;
+            throw std::exception();
+          }
+          mainMem->storeBlock(addr, words.data(), pageWords);
+          addr += pageWords;
+        }
+      }
+      it = end;
+    }
+    const ArchState& state = records[i].state;
+    for(data32 r = 0; r < 32; r++)
+      rf.sw(r, state.regs[r]);
+    return mainMem;
+  }
+
+  CheckpointReader::~CheckpointReader(){
+    ::close(fd);
+  }
+}
@@ -0,0 +1,154 @@
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+#include <array>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Mem.h"
+#include "Processor.h"
+#include "Functional.h"
+
+using namespace std;
+using namespace mem;
+/*
+ * Architectural checkpoints of a functional run: the registers, the
+ * accumulator, the pc and the memory pages written since the program was
+ * loaded, enough to start a Processor5S there with an empty pipe.
+ *
+ * Checkpoints of one run share the pages neither wrote: taking one copies
+ * only the pages written since the last, as DirtyTrackingMem reports them.
+ *
+ * They can also go to a file, as a chain: each one after the first holds
+ * only the pages written since the one before. The format, in host byte
+ * order, is a 4096 byte header (magic, version, memory size in words), then
+ * per checkpoint
+ *
+ *   a record    magic, instructions executed, pc, hi/lo, registers, the
+ *               number of pages and their numbers in ascending order,
+ *               padded to a multiple of 4096 bytes
+ *   its pages   PAGE_WORDS words each, the last one zero padded
+ *
+ * so every page sits at a page aligned offset. CheckpointReader restores
+ * one by mapping each page's latest copy up to it from the file, copy on
+ * write, over a MappedMem: nothing is read until the run touches it.
+ */
+namespace checkpoint{
+
+  typedef shared_ptr<const vector<data32>> Page;
+
+  /* everything but memory */
+  struct ArchState{
+    /* instructions executed before it */
+    unsigned long nExecuted;
+    data32 pc;
+    data64 acc;
+    array<data32, 32> regs;
+  };
+
+  struct Checkpoint : ArchState{
+    /* every page written since loading, by page number (PAGE_WORDS) */
+    map<data32, Page> pages;
+  };
+
+  class Checkpointer{
+    private:
+      DirtyTrackingMem& mainMem;
+      Checkpoint last;
+
+    public:
+      /*
+       * params:
+       *   mainMem: what the functional core runs on, loaded and clean
+       */
+      Checkpointer(DirtyTrackingMem& mainMem);
+
+      /*
+       * params:
+       *   core: running on mainMem, and quiet (FunctionalCore::isQuiet)
+       * throws: exception if core is not quiet
+       */
+      shared_ptr<const Checkpoint> take(
+          const functional::FunctionalCore& core);
+  };
+
+  /*
+   * loads image as ProgramLoader does, then the checkpoint's pages and
+   * registers
+   */
+  void restore(const Checkpoint& c, const ProgramImage& image,
+      MemoryUnit& mainMem, MemoryUnit& rf);
+
+  /*
+   * points p, fresh on memories restore was given, at the checkpoint
+   */
+  void start(const ArchState& c, Processor5S& p);
+
+  class CheckpointWriter{
+    private:
+      ofstream out;
+      DirtyTrackingMem& mainMem;
+      size_t nWritten;
+
+    public:
+      /*
+       * params:
+       *   mainMem: what the functional core runs on, tracking since before
+       *     the program was loaded, so the first checkpoint has it all
+       * throws: exception if filename can't be written
+       */
+      CheckpointWriter(const string& filename, DirtyTrackingMem& mainMem);
+
+      /*
+       * appends a checkpoint of core, with the pages written since the last
+       * params:
+       *   core: running on mainMem, and quiet (FunctionalCore::isQuiet)
+       * throws: exception if core is not quiet or the write fails
+       */
+      void write(const functional::FunctionalCore& core);
+
+      size_t getNWritten() const;
+  };
+
+  class CheckpointReader{
+    private:
+      /* where a checkpoint's pages are */
+      struct Record{
+        ArchState state;
+        vector<data32> pages;
+        size_t pagesOffset;
+      };
+
+      int fd;
+      string filename;
+      uint64_t memWords;
+      vector<Record> records;
+
+    public:
+      /*
+       * reads the records, leaving the pages for restore
+       * throws: exception if filename is not a whole checkpoint file
+       */
+      CheckpointReader(const string& filename);
+
+      size_t getNCheckpoints() const;
+
+      /* the main memory size the checkpoints were taken with */
+      uint64_t getMemWords() const;
+
+      const ArchState& getState(size_t i) const;
+
+      /*
+       * params:
+       *   i: which checkpoint
+       *   rf: loaded with its registers
+       * returns: main memory as it was at checkpoint i, mapped from the file
+       * throws: exception if i is out of range or mapping fails
+       */
+      unique_ptr<MappedMem> restore(size_t i, MemoryUnit& rf) const;
+
+      ~CheckpointReader();
+  };
+}
+#endif
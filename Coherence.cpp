@@ -0,0 +1,373 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <climits>
+#include <exception>
+#include <iomanip>
+#include "Coherence.h"
+
+using namespace std;
+
+namespace coherence{
+
+  namespace {
+    const size_t MAX_CORES = 64;
+    const unsigned int MAX_LINE_WORDS = 32;
+
+    uint64_t bit(size_t core){
+      return (uint64_t) 1 << core;
+    }
+  }
+
+  L1Cache::L1Cache(const SharedL2& l2, size_t core,
+      const SimConfig& config) : l2{l2}, core{core},
+    nSets{config.cohL1Sets}, ways{config.cohL1Ways},
+    lineWords{config.cohLineWords}, config{config},
+    lines(config.cohL1Sets * config.cohL1Ways, {0, INVALID, 0, 0}),
+    cycle{0}, useCount{0}, link{nullptr}, base{0} {}
+
+  L1Cache::Line* L1Cache::find(data32 line){
+    Line* set = &lines[(line % nSets) * ways];
+    for(unsigned int w = 0; w < ways; w++)
+      if(set[w].state != INVALID && set[w].line == line)
+        return &set[w];
+    return nullptr;
+  }
+
+  L1Cache::Line* L1Cache::victim(data32 line){
+    Line* set = &lines[(line % nSets) * ways];
+    Line* v = &set[0];
+    for(unsigned int w = 0; w < ways; w++){
+      if(set[w].state == INVALID){
+        v = &set[w];
+        break;
+      }
+      if(set[w].lastUsed < v->lastUsed)
+        v = &set[w];
+    }
+    if(v->state != INVALID){
+      if(v->state == MODIFIED)
+        stats.writebacks++;
+      log.push_back({cycle, EVICT, v->line, 0, false, false});
+      if(link != nullptr)
+        link->lineLost(v->line, lineWords);
+    }
+    v->line = line;
+    return v;
+  }
+
+  bool L1Cache::invalidate(data32 line, unsigned long cycle, size_t other){
+    Line* l = find(line);
+    if(l == nullptr || l->acquiredAt > cycle ||
+        (l->acquiredAt == cycle && core > other))
+      return false;
+    l->state = INVALID;
+    if(link != nullptr)
+      link->lineLost(line, lineWords);
+    return true;
+  }
+
+  bool L1Cache::downgrade(data32 line, unsigned long cycle, size_t other){
+    Line* l = find(line);
+    if(l == nullptr || l->state < EXCLUSIVE || l->acquiredAt > cycle ||
+        (l->acquiredAt == cycle && core > other))
+      return false;
+    if(l->state == MODIFIED)
+      stats.writebacks++;
+    l->state = SHARED;
+    return true;
+  }
+
+  void L1Cache::setCycle(unsigned long cycle){
+    this->cycle = cycle;
+  }
+
+  void L1Cache::setLinkRegister(atomics::LinkRegister* link){
+    this->link = link;
+  }
+
+  void L1Cache::setBase(data32 base){
+    this->base = base;
+  }
+
+  unsigned int L1Cache::access(data32 addr, bool store){
+    stats.accesses++;
+    addr += base;
+    data32 line = addr / lineWords;
+    unsigned int offset = addr % lineWords;
+    Line* l = find(line);
+    if(l != nullptr && (!store || l->state >= EXCLUSIVE)){
+      stats.hits++;
+      l->lastUsed = ++useCount;
+      if(store){
+        l->state = MODIFIED;
+        log.push_back({cycle, STORE, line, offset, false, false});
+      }
+      return config.memLatency;
+    }
+
+    //as the directory was at the last resolve
+    const SharedL2::Entry* entry = l2.find(line);
+    bool othersHold = entry != nullptr && (entry->sharers & ~bit(core)) != 0;
+    bool coherenceMiss = false;
+    bool falseSharing = false;
+    unsigned int cycles;
+    if(l != nullptr){
+      stats.upgrades++;
+      cycles = config.memLatency;
+    } else {
+      stats.misses++;
+      auto was = lost.find(line);
+      if(was != lost.end()){
+        coherenceMiss = true;
+        falseSharing = (was->second & (1u << offset)) == 0;
+        stats.coherenceMisses++;
+        if(falseSharing)
+          stats.falseSharingMisses++;
+        lost.erase(was);
+      }
+      if(entry != nullptr && entry->owner >= 0 &&
+          entry->owner != (int) core){
+        stats.interventions++;
+        cycles = config.cohInterventionLatency;
+      } else if(entry != nullptr){
+        stats.l2Hits++;
+        cycles = config.cohL2Latency;
+      } else {
+        stats.memAccesses++;
+        cycles = config.cohMemLatency;
+      }
+      l = victim(line);
+    }
+    if(store && othersHold)
+      cycles += config.cohInvalidationLatency;
+    l->state = store ? MODIFIED : othersHold ? SHARED : EXCLUSIVE;
+    l->acquiredAt = cycle;
+    l->lastUsed = ++useCount;
+    log.push_back({cycle, store ? WRITE : READ, line, offset, coherenceMiss,
+        falseSharing});
+    return cycles;
+  }
+
+  const L1Stats& L1Cache::getStats() const{
+    return stats;
+  }
+
+  SharedL2::SharedL2(size_t nCores, const SimConfig& config) :
+    nSets{config.cohL2Sets}, ways{config.cohL2Ways},
+    lineWords{config.cohLineWords}, config{config},
+    entries(config.cohL2Sets * config.cohL2Ways, {0, false, 0, -1, 0}),
+    useCount{0} {
+    if(nCores > MAX_CORES || lineWords > MAX_LINE_WORDS ||
+        config.cohL1Sets == 0){
+      BOOST_LOG_TRIVIAL(fatal) << "<<SharedL2>> can't keep " << nCores <<
+        " cores coherent on lines of " << lineWords << " words in " <<
+        config.cohL1Sets << " sets" << endl;
+      throw std::exception();
+    }
+    for(size_t i = 0; i < nCores; i++)
+      l1s.push_back(make_unique<L1Cache>(*this, i, this->config));
+  }
+
+  L1Cache& SharedL2::getL1(size_t core){
+    return *l1s.at(core);
+  }
+
+  unsigned int SharedL2::getLineWords() const{
+    return lineWords;
+  }
+
+  const SharedL2::Entry* SharedL2::find(data32 line) const{
+    const Entry* set = &entries[(line % nSets) * ways];
+    for(unsigned int w = 0; w < ways; w++)
+      if(set[w].valid && set[w].line == line)
+        return &set[w];
+    return nullptr;
+  }
+
+  SharedL2::Entry& SharedL2::fill(data32 line){
+    Entry* found = const_cast<Entry*>(find(line));
+    if(found != nullptr)
+      return *found;
+    //the least recently used line no L1 has, if there is one
+    Entry* set = &entries[(line % nSets) * ways];
+    Entry* v = nullptr;
+    for(unsigned int w = 0; w < ways; w++){
+      Entry& e = set[w];
+      if(!e.valid){
+        v = &e;
+        break;
+      }
+      if(v == nullptr || (e.sharers == 0) > (v->sharers == 0) ||
+          ((e.sharers == 0) == (v->sharers == 0) && e.lastUsed < v->lastUsed))
+        v = &e;
+    }
+    if(v->valid){
+      for(size_t c = 0; c < l1s.size(); c++)
+        if((v->sharers & bit(c)) && l1s[c]->invalidate(v->line, ULONG_MAX, 0))
+          l1s[c]->stats.backInvalidations++;
+    }
+    *v = {line, true, 0, -1, 0};
+    return *v;
+  }
+
+  void SharedL2::invalidateOthers(Entry& entry, unsigned long cycle,
+      size_t core, unsigned int offset){
+    for(size_t c = 0; c < l1s.size(); c++){
+      if(c == core || !(entry.sharers & bit(c)))
+        continue;
+      L1Cache& other = *l1s[c];
+      //one that took it back since keeps it, its own event comes later
+      if(!other.invalidate(entry.line, cycle, core))
+        continue;
+      entry.sharers &= ~bit(c);
+      other.stats.invalidations++;
+      other.lost[entry.line] = 1u << offset;
+      lineStats[entry.line].invalidations++;
+    }
+    entry.owner = core;
+  }
+
+  void SharedL2::stored(data32 line, unsigned int offset, size_t core){
+    for(size_t c = 0; c < l1s.size(); c++){
+      if(c == core)
+        continue;
+      auto was = l1s[c]->lost.find(line);
+      if(was != l1s[c]->lost.end())
+        was->second |= 1u << offset;
+    }
+  }
+
+  void SharedL2::resolve(){
+    //every core's events, by cycle, then core, then the order logged
+    struct Ordered{
+      unsigned long cycle;
+      size_t core;
+      size_t index;
+    };
+    vector<Ordered> order;
+    for(size_t c = 0; c < l1s.size(); c++)
+      for(size_t i = 0; i < l1s[c]->log.size(); i++)
+        order.push_back({l1s[c]->log[i].cycle, c, i});
+    sort(order.begin(), order.end(), [](const Ordered& a,
+          const Ordered& b){
+        if(a.cycle != b.cycle)
+          return a.cycle < b.cycle;
+        return a.core != b.core ? a.core < b.core : a.index < b.index;
+      });
+
+    for(const Ordered& o : order){
+      L1Cache& l1 = *l1s[o.core];
+      const L1Cache::Event& e = l1.log[o.index];
+      if(e.kind == L1Cache::EVICT){
+        Entry* entry = const_cast<Entry*>(find(e.line));
+        if(entry != nullptr){
+          entry->sharers &= ~bit(o.core);
+          if(entry->owner == (int) o.core)
+            entry->owner = -1;
+        }
+        continue;
+      }
+      if(e.kind == L1Cache::STORE){
+        stored(e.line, e.offset, o.core);
+        continue;
+      }
+
+      Entry& entry = fill(e.line);
+      entry.lastUsed = ++useCount;
+      if(e.coherenceMiss){
+        LineStats& s = lineStats[e.line];
+        s.coherenceMisses++;
+        if(e.falseSharing)
+          s.falseSharingMisses++;
+      }
+      if(e.kind == L1Cache::WRITE){
+        invalidateOthers(entry, e.cycle, o.core, e.offset);
+        entry.sharers |= bit(o.core);
+        stored(e.line, e.offset, o.core);
+        continue;
+      }
+      if(entry.owner >= 0 && entry.owner != (int) o.core &&
+          l1s[entry.owner]->downgrade(e.line, e.cycle, o.core)){
+        lineStats[e.line].interventions++;
+        entry.owner = -1;
+      }
+      entry.sharers |= bit(o.core);
+      //it took the line as the last resolve left it, others may have since
+      L1Cache::Line* l = l1.find(e.line);
+      if(l == nullptr || l->acquiredAt != e.cycle || l->state < EXCLUSIVE)
+        continue;
+      if(entry.sharers == bit(o.core))
+        entry.owner = o.core;
+      else if(l->state == EXCLUSIVE)
+        l->state = SHARED;
+      else
+        invalidateOthers(entry, e.cycle, o.core, e.offset);
+    }
+    for(unique_ptr<L1Cache>& l1 : l1s)
+      l1->log.clear();
+  }
+
+  const map<data32, LineStats>& SharedL2::getLineStats() const{
+    return lineStats;
+  }
+
+  L1Stats SharedL2::getTotals() const{
+    L1Stats t;
+    for(const unique_ptr<L1Cache>& l1 : l1s){
+      const L1Stats& s = l1->stats;
+      t.accesses += s.accesses;
+      t.hits += s.hits;
+      t.misses += s.misses;
+      t.upgrades += s.upgrades;
+      t.l2Hits += s.l2Hits;
+      t.memAccesses += s.memAccesses;
+      t.interventions += s.interventions;
+      t.coherenceMisses += s.coherenceMisses;
+      t.falseSharingMisses += s.falseSharingMisses;
+      t.invalidations += s.invalidations;
+      t.backInvalidations += s.backInvalidations;
+      t.writebacks += s.writebacks;
+    }
+    return t;
+  }
+
+  void SharedL2::report(ostream& out, size_t nLines) const{
+    vector<L1Stats> rows;
+    for(const unique_ptr<L1Cache>& l1 : l1s)
+      rows.push_back(l1->stats);
+    rows.push_back(getTotals());
+    for(size_t i = 0; i < rows.size(); i++){
+      const L1Stats& s = rows[i];
+      if(i < l1s.size())
+        out << "L1 " << i << ": ";
+      else
+        out << "L1s: ";
+      out << s.accesses << " accesses, " << s.misses << " misses (" <<
+        s.l2Hits << " from the L2, " << s.memAccesses << " from memory, " <<
+        s.interventions << " from other L1s), " << s.upgrades <<
+        " upgrades, " << s.coherenceMisses << " coherence misses (" <<
+        s.falseSharingMisses << " false sharing), " << s.invalidations <<
+        " invalidations, " << s.backInvalidations <<
+        " back invalidations, " << s.writebacks << " writebacks" << endl;
+    }
+
+    vector<pair<data32, LineStats>> worst(lineStats.begin(),
+        lineStats.end());
+    stable_sort(worst.begin(), worst.end(), [](
+          const pair<data32, LineStats>& a, const pair<data32, LineStats>& b){
+        return a.second.coherenceMisses > b.second.coherenceMisses;
+      });
+    for(size_t i = 0; i < worst.size() && i < nLines; i++){
+      const LineStats& s = worst[i].second;
+      if(s.coherenceMisses == 0)
+        break;
+      data32 first = worst[i].first * lineWords;
+      out << "line of words 0x" << hex << first << "-0x" <<
+        first + lineWords - 1 << dec << ": " << s.coherenceMisses <<
+        " coherence misses (" << s.falseSharingMisses <<
+        " false sharing), " << s.invalidations << " invalidations, " <<
+        s.interventions << " interventions" << endl;
+    }
+  }
+}
@@ -0,0 +1,264 @@
+#ifndef COHERENCE_H_INCLUDED
+#define COHERENCE_H_INCLUDED
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Mem.h"
+#include "Config.h"
+#include "Atomics.h"
+
+using namespace std;
+using namespace mem;
+using namespace config;
+/*
+ * Timing of a multi core data side: a private L1 per core kept coherent
+ * with MESI, under a shared L2 that includes them all and keeps the
+ * directory, which cores hold each line and which one, if any, owns it.
+ * Only the time loads and stores take in memory access comes from here,
+ * the data itself is where MultiCoreSim keeps it (see MultiCore.h).
+ *
+ * A load or store that hits, in any valid state for a load and in E or M
+ * for a store (E silently becoming M), takes ma.memLatency. Otherwise the
+ * core takes the line, in S if anyone else has it and E if not for a load,
+ * and in M for a store, and
+ *   - from the owner's L1 if another core has it in E or M (the owner
+ *     drops to S): coh.interventionLatency
+ *   - else from the L2: coh.l2Latency
+ *   - else from memory: coh.memLatency
+ * A store to a line others hold (an upgrade from S, or a miss) adds
+ * coh.invalidationLatency, for invalidating them. An L2 eviction
+ * invalidates the line in every L1, to stay inclusive.
+ *
+ * As the stores in MultiCoreSim, what a core does to the others only
+ * happens at the barrier. In a quantum each L1 goes by its own lines and
+ * by the directory as the last barrier left it, and logs its misses,
+ * upgrades, evictions and stores. resolve replays every core's log in
+ * cycle order (core order within a cycle) against the directory and the
+ * other L1s. A line a core took after an event it is replaying is left
+ * alone, it is the later event that counts. So the results are the same
+ * whatever the host threads do, and coherence traffic is seen up to a
+ * quantum late.
+ *
+ * A miss on a line the core lost to another's store is a coherence miss.
+ * It is true sharing if a word the core wants was stored by another core
+ * since, and false sharing if only other words of the line were. The
+ * counts are kept per line too, to find the lines padding would help.
+ *
+ * A core's ll/sc link breaks when its L1 loses the linked line in any of
+ * these ways.
+ */
+namespace coherence{
+
+  enum State{ INVALID, SHARED, EXCLUSIVE, MODIFIED };
+
+  /* one core's counts */
+  struct L1Stats{
+    unsigned long accesses = 0;
+    unsigned long hits = 0;
+    unsigned long misses = 0;
+    /* stores to a line held in S */
+    unsigned long upgrades = 0;
+    /* misses served from the L2 */
+    unsigned long l2Hits = 0;
+    /* and from memory */
+    unsigned long memAccesses = 0;
+    /* and from another L1 */
+    unsigned long interventions = 0;
+    unsigned long coherenceMisses = 0;
+    /* of those, the ones to words no other core stored */
+    unsigned long falseSharingMisses = 0;
+    /* lines taken from this L1 by other cores' stores */
+    unsigned long invalidations = 0;
+    /* and by the L2 evicting them */
+    unsigned long backInvalidations = 0;
+    /* modified lines evicted */
+    unsigned long writebacks = 0;
+  };
+
+  /* counts for one line, over every core */
+  struct LineStats{
+    unsigned long invalidations = 0;
+    unsigned long interventions = 0;
+    unsigned long coherenceMisses = 0;
+    unsigned long falseSharingMisses = 0;
+  };
+
+  class SharedL2;
+
+  class L1Cache{
+    private:
+      /* what resolve replays */
+      enum EventKind{ READ, WRITE, STORE, EVICT };
+      struct Event{
+        unsigned long cycle;
+        EventKind kind;
+        data32 line;
+        /* the word stored, for WRITE and STORE */
+        unsigned int offset;
+        /* a coherence miss, for READ and WRITE */
+        bool coherenceMiss;
+        bool falseSharing;
+      };
+      struct Line{
+        data32 line;
+        State state;
+        /* when it was last taken, to order it against the others' events */
+        unsigned long acquiredAt;
+        unsigned long lastUsed;
+      };
+
+      const SharedL2& l2;
+      size_t core;
+      unsigned int nSets;
+      unsigned int ways;
+      unsigned int lineWords;
+      const SimConfig& config;
+      vector<Line> lines;
+      unsigned long cycle;
+      unsigned long useCount;
+      vector<Event> log;
+      /* lines lost to other cores' stores, and the words stored since */
+      unordered_map<data32, uint32_t> lost;
+      /* broken by losing its line, if set */
+      atomics::LinkRegister* link;
+      /* added to every address, see setBase */
+      data32 base;
+      L1Stats stats;
+
+      Line* find(data32 line);
+      /* returns: the way to put line in, evicting what is there */
+      Line* victim(data32 line);
+
+      friend class SharedL2;
+
+      /*
+       * for resolve: takes line away, if this L1 took it before cycle
+       * (or in it, after core other)
+       * returns: whether it did
+       */
+      bool invalidate(data32 line, unsigned long cycle, size_t other);
+
+      /*
+       * for resolve: drops an owned line to S, as invalidate
+       */
+      bool downgrade(data32 line, unsigned long cycle, size_t other);
+
+    public:
+      /*
+       * see SharedL2::getL1
+       */
+      L1Cache(const SharedL2& l2, size_t core, const SimConfig& config);
+
+      /*
+       * sets the cycle the next accesses are logged at
+       */
+      void setCycle(unsigned long cycle);
+
+      /*
+       * breaks link (see Atomics.h) whenever this L1 loses the linked line
+       * from now on, nullptr to stop. Not owned
+       */
+      void setLinkRegister(atomics::LinkRegister* link);
+
+      /*
+       * adds base to the addresses accesses are to from now on, for a core
+       * running a relocated program (see RelocatedMem), so the L1 goes by
+       * where the words are in memory
+       */
+      void setBase(data32 base);
+
+      /*
+       * a load or store of the word at addr, a word address
+       * returns: the cycles it takes
+       */
+      unsigned int access(data32 addr, bool store);
+
+      const L1Stats& getStats() const;
+  };
+
+  class SharedL2{
+    private:
+      struct Entry{
+        data32 line;
+        bool valid;
+        /* bit per core holding it */
+        uint64_t sharers;
+        /* the core holding it in E or M, -1 for none */
+        int owner;
+        unsigned long lastUsed;
+      };
+
+      unsigned int nSets;
+      unsigned int ways;
+      unsigned int lineWords;
+      SimConfig config;
+      vector<Entry> entries;
+      unsigned long useCount;
+      vector<unique_ptr<L1Cache>> l1s;
+      map<data32, LineStats> lineStats;
+
+      /*
+       * returns: line's entry, filling it in if it is not there, which may
+       *   evict another line from the L2 and so from the L1s
+       */
+      Entry& fill(data32 line);
+      /*
+       * for a store by core to line: every other core holding it loses it
+       */
+      void invalidateOthers(Entry& entry, unsigned long cycle, size_t core,
+          unsigned int offset);
+      /* adds the word stored to what the cores that lost line missed */
+      void stored(data32 line, unsigned int offset, size_t core);
+
+      /*
+       * returns: line's directory entry, nullptr if the L2 doesn't have it
+       */
+      const Entry* find(data32 line) const;
+
+      friend class L1Cache;
+
+    public:
+      /*
+       * params:
+       *   nCores: at most 64
+       *   config: the coh. sizes and latencies and ma.memLatency
+       * throws: exception if a size is 0, the line is over 32 words or
+       *   there are too many cores
+       */
+      SharedL2(size_t nCores, const SimConfig& config);
+
+      /*
+       * returns: core's L1. Only that core's thread may use it between
+       *   resolves
+       */
+      L1Cache& getL1(size_t core);
+
+      unsigned int getLineWords() const;
+
+      /*
+       * replays what every L1 logged since the last resolve. Only while no
+       * core runs
+       */
+      void resolve();
+
+      /*
+       * returns: per line counts, for the lines that had any
+       */
+      const map<data32, LineStats>& getLineStats() const;
+
+      /*
+       * returns: the cores' counts added up
+       */
+      L1Stats getTotals() const;
+
+      /*
+       * writes the totals, each core's and the nLines lines with the most
+       * coherence misses to out
+       */
+      void report(ostream& out, size_t nLines = 8) const;
+  };
+}
+#endif
@@ -0,0 +1,192 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <climits>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include "Config.h"
+
+using namespace std;
+
+namespace config{
+
+  namespace {
+    struct Knob{
+      const char* key;
+      unsigned int SimConfig::* field;
+      /* relative cost of the unit at one cycle, see SimConfig::cost */
+      double weight;
+      /* whether 0 is a setting, usually for none */
+      bool zeroOk = false;
+    };
+
+    const Knob KNOBS[] = {
+      {"if.latency", &SimConfig::ifLatency, 1},
+      {"id.latency", &SimConfig::idLatency, 1},
+      {"ex.latency", &SimConfig::exLatency, 2},
+      {"ex.mulLatency", &SimConfig::mulLatency, 4},
+      {"ex.divLatency", &SimConfig::divLatency, 4},
+      {"ma.latency", &SimConfig::maLatency, 1},
+      {"ma.memLatency", &SimConfig::memLatency, 8},
+      {"wb.latency", &SimConfig::wbLatency, 1},
+      //not hardware
+      {"wb.syscallLatency", &SimConfig::syscallLatency, 0},
+      //sizes, which SimConfig::cost does not weigh
+      {"ooo.width", &SimConfig::oooWidth, 0},
+      {"ooo.robSize", &SimConfig::robSize, 0},
+      {"ooo.iqSize", &SimConfig::iqSize, 0},
+      {"ooo.queues", &SimConfig::nQueues, 0},
+      {"ooo.lsqSize", &SimConfig::lsqSize, 0},
+      {"ooo.physRegs", &SimConfig::physRegs, 0},
+      {"ooo.memPorts", &SimConfig::memPorts, 0},
+      {"ss.width", &SimConfig::ssWidth, 0},
+      {"ss.memOps", &SimConfig::ssMemOps, 0},
+      {"ss.mulDivOps", &SimConfig::ssMulDivOps, 0},
+      {"ss.branches", &SimConfig::ssBranches, 0},
+      {"mc.cores", &SimConfig::mcCores, 0},
+      {"mc.quantum", &SimConfig::mcQuantum, 0},
+      {"mp.quantum", &SimConfig::mpQuantum, 0},
+      {"mp.switchCost", &SimConfig::mpSwitchCost, 0, true},
+      {"coh.l1Sets", &SimConfig::cohL1Sets, 0, true},
+      {"coh.l1Ways", &SimConfig::cohL1Ways, 0},
+      {"coh.lineWords", &SimConfig::cohLineWords, 0},
+      {"coh.l2Sets", &SimConfig::cohL2Sets, 0},
+      {"coh.l2Ways", &SimConfig::cohL2Ways, 0},
+      {"coh.l2Latency", &SimConfig::cohL2Latency, 0},
+      {"coh.memLatency", &SimConfig::cohMemLatency, 0},
+      {"coh.interventionLatency", &SimConfig::cohInterventionLatency, 0},
+      {"coh.invalidationLatency", &SimConfig::cohInvalidationLatency, 0},
+      {"fe.queueWords", &SimConfig::fetchQueueWords, 0, true},
+      {"fe.lineWords", &SimConfig::fetchLineWords, 0},
+      {"fe.loopBufferWords", &SimConfig::loopBufferWords, 0, true},
+    };
+    const string MEM_WORDS_KEY = "mem.words";
+
+    string trim(const string& s){
+      size_t start = s.find_first_not_of(" \t\r");
+      if(start == string::npos)
+        return "";
+      size_t end = s.find_last_not_of(" \t\r");
+      return s.substr(start, end - start + 1);
+    }
+
+    uint64_t parseNumber(const string& key, const string& value){
+      try{
+        size_t used;
+        uint64_t n = stoull(value, &used, 0);
+        if(used == value.size())
+          return n;
+      } catch(const std::exception&){}
+      BOOST_LOG_TRIVIAL(fatal) << "<<Config>> bad value " << value << " for "
+        << key << endl;
+      throw std::exception();
+    }
+  }
+
+  void SimConfig::set(const string& key, const string& value){
+    uint64_t n = parseNumber(key, value);
+    if(key == MEM_WORDS_KEY){
+      if(n == 0){
+        BOOST_LOG_TRIVIAL(fatal) << "<<Config>> " << key << " must be at "
+          "least 1" << endl;
+        throw std::exception();
+      }
+      memWords = n;
+      return;
+    }
+    for(const Knob& k : KNOBS){
+      if(key == k.key){
+        if(n == 0 && !k.zeroOk){
+          BOOST_LOG_TRIVIAL(fatal) << "<<Config>> " << key << " must be at "
+            "least 1" << endl;
+          throw std::exception();
+        }
+        //rather than wrap, which would also give it another hash
+        if(n > UINT_MAX){
+          BOOST_LOG_TRIVIAL(fatal) << "<<Config>> " << key << " must be at "
+            "most " << UINT_MAX << endl;
+          throw std::exception();
+        }
+        this->*k.field = n;
+        return;
+      }
+    }
+    BOOST_LOG_TRIVIAL(fatal) << "<<Config>> unknown key " << key << endl;
+    throw std::exception();
+  }
+
+  void SimConfig::set(const string& assignment){
+    size_t eq = assignment.find('=');
+    if(eq == string::npos){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Config>> expected key=value, got " <<
+        assignment << endl;
+      throw std::exception();
+    }
+    set(trim(assignment.substr(0, eq)), trim(assignment.substr(eq + 1)));
+  }
+
+  void SimConfig::loadFile(const string& filename){
+    ifstream file(filename);
+    if(!file){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Config>> can't open " << filename << endl;
+      throw std::exception();
+    }
+    string section;
+    string line;
+    while(getline(file, line)){
+      line = trim(line.substr(0, line.find_first_of(";#")));
+      if(line.empty())
+        continue;
+      if(line.front() == '[' && line.back() == ']'){
+        section = trim(line.substr(1, line.size() - 2)) + ".";
+        continue;
+      }
+      size_t eq = line.find('=');
+      if(eq == string::npos){
+        BOOST_LOG_TRIVIAL(fatal) << "<<Config>> " << filename << ": expected "
+          "key = value, got " << line << endl;
+        throw std::exception();
+      }
+      set(section + trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+    }
+  }
+
+  string SimConfig::toString() const{
+    ostringstream out;
+    for(const Knob& k : KNOBS)
+      out << k.key << "=" << this->*k.field << " ";
+    out << MEM_WORDS_KEY << "=" << memWords;
+    return out.str();
+  }
+
+  uint64_t SimConfig::hash() const{
+    string s = toString();
+    return fnv1a(s.data(), s.size());
+  }
+
+  double SimConfig::cost() const{
+    double total = 0;
+    for(const Knob& k : KNOBS)
+      if(k.weight != 0)
+        total += k.weight / (this->*k.field);
+    return total;
+  }
+
+  vector<string> SimConfig::keys(){
+    vector<string> all;
+    for(const Knob& k : KNOBS)
+      all.push_back(k.key);
+    all.push_back(MEM_WORDS_KEY);
+    return all;
+  }
+
+  uint64_t fnv1a(const void* bytes, size_t size, uint64_t seed){
+    const unsigned char* b = (const unsigned char*) bytes;
+    uint64_t h = seed;
+    for(size_t i = 0; i < size; i++){
+      h ^= b[i];
+      h *= 0x100000001b3ull;
+    }
+    return h;
+  }
+}
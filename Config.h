@@ -0,0 +1,177 @@
+#ifndef CONFIG_H_INCLUDED
+#define CONFIG_H_INCLUDED
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+/*
+ * The timing and sizing knobs of a simulation. A config starts from the
+ * defaults (the original hardwired values), then takes an INI file and then
+ * key=value overrides, e.g. from the command line. Keys are section.name:
+ *
+ *   [ex]
+ *   latency = 1       ; every instruction in EX
+ *   mulLatency = 4    ; mult, multu
+ *   divLatency = 12   ; div, divu
+ *   [ma]
+ *   memLatency = 3    ; lw, sw
+ *   [mem]
+ *   words = 0x100000  ; main memory
+ *   [fe]              ; Processor5S's front end, see FrontEnd.h
+ *   queueWords = 0    ; fetch queue, 0 for none: IF reads memory itself
+ *   lineWords = 4     ; words per fetch access, each taking if.latency
+ *   loopBufferWords = 0 ; 0 for none
+ *
+ *   [wb]
+ *   syscallLatency = 1 ; at least, for a syscall's host work
+ *   [ooo]             ; ProcessorOoO only, see OoO.h
+ *   width = 4         ; fetched, dispatched, issued and retired per cycle
+ *   robSize = 64
+ *   iqSize = 32       ; per issue queue
+ *   queues = 1        ; 1 unified issue queue, 3 for int, mul/div and mem
+ *   lsqSize = 32
+ *   physRegs = 96     ; at least 34, for 32 registers and hi/lo
+ *   memPorts = 1      ; loads and stores issued per cycle
+ *   [ss]              ; ProcessorSS only, see Superscalar.h
+ *   width = 2         ; instructions fetched and issued per cycle
+ *   memOps = 1        ; loads and stores issued together
+ *   mulDivOps = 1     ; multiplies and divides issued together
+ *   branches = 1      ; branches and jumps issued together
+ *   [mc]              ; MultiCoreSim only, see MultiCore.h
+ *   cores = 2         ; Processor5S cores, each on a host thread
+ *   quantum = 1000    ; cycles the cores run between barriers
+ *   [mp]              ; MultiProgramSim only, see MultiProgram.h
+ *   quantum = 10000   ; cycles a program runs before the next one's turn
+ *   switchCost = 100  ; cycles a switch takes, after the pipe drains
+ *   [coh]             ; MultiCoreSim's and MultiProgramSim's caches, see
+ *                     ; Coherence.h
+ *   l1Sets = 0        ; per core L1 data cache, 0 for none
+ *   l1Ways = 4        ; an L1 hit takes ma.memLatency
+ *   lineWords = 8     ; at most 32
+ *   l2Sets = 512      ; the shared L2, inclusive
+ *   l2Ways = 8
+ *   l2Latency = 10    ; an L1 miss the L2 has
+ *   memLatency = 50   ; one it does not
+ *   interventionLatency = 20 ; one another L1 owns
+ *   invalidationLatency = 10 ; added to a store others hold the line of
+ *
+ * and the same for if.latency, id.latency, ma.latency and wb.latency.
+ * Values may be decimal or 0x hex. ; and # start comments. Only
+ * fe.queueWords, fe.loopBufferWords, mp.switchCost and coh.l1Sets may be
+ * 0.
+ *
+ * The pipeline itself stays five stages, only its timing is configurable.
+ */
+namespace config{
+
+  class SimConfig{
+    public:
+      /* stage latencies in cycles */
+      unsigned int ifLatency = 1;
+      unsigned int idLatency = 1;
+      unsigned int exLatency = 1;
+      unsigned int mulLatency = 1;
+      unsigned int divLatency = 1;
+      unsigned int maLatency = 1;
+      unsigned int memLatency = 1;
+      unsigned int wbLatency = 1;
+      /* the least a syscall's writeback takes (see Syscall.h) */
+      unsigned int syscallLatency = 1;
+      /* ProcessorOoO's sizes */
+      unsigned int oooWidth = 4;
+      unsigned int robSize = 64;
+      unsigned int iqSize = 32;
+      unsigned int nQueues = 1;
+      unsigned int lsqSize = 32;
+      unsigned int physRegs = 96;
+      unsigned int memPorts = 1;
+      /* Processor5S's front end, off with no queue */
+      unsigned int fetchQueueWords = 0;
+      unsigned int fetchLineWords = 4;
+      unsigned int loopBufferWords = 0;
+      /* ProcessorSS's width and pairing rules */
+      unsigned int ssWidth = 2;
+      unsigned int ssMemOps = 1;
+      unsigned int ssMulDivOps = 1;
+      unsigned int ssBranches = 1;
+      /* MultiCoreSim's cores and the cycles between their barriers */
+      unsigned int mcCores = 2;
+      unsigned int mcQuantum = 1000;
+      /* MultiProgramSim's time slice and what a switch costs */
+      unsigned int mpQuantum = 10000;
+      unsigned int mpSwitchCost = 100;
+      /* MultiCoreSim's coherent caches, none without L1 sets, and
+       * MultiProgramSim's */
+      unsigned int cohL1Sets = 0;
+      unsigned int cohL1Ways = 4;
+      unsigned int cohLineWords = 8;
+      unsigned int cohL2Sets = 512;
+      unsigned int cohL2Ways = 8;
+      unsigned int cohL2Latency = 10;
+      unsigned int cohMemLatency = 50;
+      unsigned int cohInterventionLatency = 20;
+      unsigned int cohInvalidationLatency = 10;
+      /* words of main memory */
+      uint64_t memWords = 1 << 20;
+
+      /*
+       * sets one knob
+       * throws: exception on an unknown key or a bad value
+       */
+      void set(const string& key, const string& value);
+
+      /*
+       * sets a knob from "key=value"
+       * throws: exception if it is not of that form, or as set
+       */
+      void set(const string& assignment);
+
+      /*
+       * applies an INI file on top of the current values
+       * throws: exception if the file can't be read, or as set
+       */
+      void loadFile(const string& filename);
+
+      /*
+       * returns: every knob as key=value, in a fixed order
+       */
+      string toString() const;
+
+      /*
+       * returns: a hash of toString, stable across runs and builds
+       */
+      uint64_t hash() const;
+
+      /*
+       * A rough hardware cost, for trading off against CPI. Every unit costs
+       * its weight (see Config.cpp) divided by its latency, so making a unit
+       * twice as fast doubles its cost. Memory size is not counted.
+       */
+      double cost() const;
+
+      /*
+       * returns: all the keys set accepts
+       */
+      static vector<string> keys();
+  };
+
+  /*
+   * The version of the timing model, for results cached across builds (see
+   * runSweep.cpp). Bump it whenever the same config and program would take
+   * a different number of cycles:
+   *   1 the first configurable timing
+   *   2 syscalls handled in WB, taking wb.syscallLatency
+   *   3 the fe.* front end
+   *   4 programs ending at the loader's syscall, the replayer's front end
+   *     and its skipping of unfetched delay slots
+   */
+  const uint64_t MODEL_VERSION = 4;
+
+  /*
+   * returns: 64 bit FNV-1a of the bytes, for hashes that outlive the process
+   */
+  uint64_t fnv1a(const void* bytes, size_t size,
+      uint64_t seed = 0xcbf29ce484222325ull);
+}
+#endif
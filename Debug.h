@@ -1,3 +1,5 @@
+#ifndef DEBUG_H_INCLUDED
+#define DEBUG_H_INCLUDED
 #include <iostream>
 #include <bitset>
 #define BOOST_LOG_DYN_LINK
@@ -13,8 +15,8 @@
  * takes in the values of each subset of an R instruction, and returns the 
  * integer value of the instruction
  */
-unsigned int constructRInstr(unsigned int rs, unsigned int rt, unsigned int rd,
-    unsigned int shamt, unsigned int func){
+inline unsigned int constructRInstr(unsigned int rs, unsigned int rt,
+    unsigned int rd, unsigned int shamt, unsigned int func){
   unsigned int instr = 0;
   instr += rs << 21;
   instr += rt << 16;
@@ -29,7 +31,7 @@ unsigned int constructRInstr(unsigned int rs, unsigned int rt, unsigned int rd,
  * takes in the values of each subset of an I instruction, and returns the 
  * integer value of the instruction
  */
-unsigned int constructIInstr(unsigned int opcode, unsigned char rs,
+inline unsigned int constructIInstr(unsigned int opcode, unsigned char rs,
     unsigned char rtOrRD, unsigned short val){
   unsigned int instr = 0;
   instr += opcode << 26;
@@ -44,7 +46,7 @@ unsigned int constructIInstr(unsigned int opcode, unsigned char rs,
  * integer value of the instruction.
  * Really don't use a value outside permisible range of 28 bytes
  */
-unsigned int constructJInstr(unsigned int opcode, unsigned int val){
+inline unsigned int constructJInstr(unsigned int opcode, unsigned int val){
   unsigned int instr = 0;
   instr += opcode << 26;
   instr += val;
@@ -64,3 +66,4 @@ unsigned int constructJInstr(unsigned int opcode, unsigned int val){
 //    );
 //
 //}
+#endif
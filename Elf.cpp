@@ -0,0 +1,218 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <cstring>
+#include <elf.h>
+#include <endian.h>
+#include <exception>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Elf.h"
+
+using namespace std;
+
+namespace elf{
+
+  namespace {
+    /* the file's fields are big endian, these read them */
+    uint16_t be(uint16_t x){
+      return be16toh(x);
+    }
+
+    uint32_t be(uint32_t x){
+      return be32toh(x);
+    }
+
+    const size_t WORD = sizeof(data32);
+  }
+
+  void ElfFile::fail(const string& what) const{
+    BOOST_LOG_TRIVIAL(fatal) << "<<ElfFile>> " << filename << ": " << what <<
+      endl;
+    throw std::exception();
+  }
+
+  ElfFile::ElfFile(const string& filename) : filename{filename}, fd{-1},
+    base{nullptr}, size{0}, entry{0} {
+    fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0){
+      if(fd >= 0)
+        ::close(fd);
+      fail("can't be read");
+    }
+    size = st.st_size;
+    if(size < sizeof(Elf32_Ehdr)){
+      ::close(fd);
+      fail("is not an ELF file");
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapped == MAP_FAILED){
+      ::close(fd);
+      fail("can't be mapped");
+    }
+    base = (const unsigned char*) mapped;
+
+    //a constructor that throws gets no destructor
+    struct Guard{
+      ElfFile* f;
+      ~Guard(){
+        if(f)
+          f->release();
+      }
+    } guard{this};
+
+    const Elf32_Ehdr* eh = (const Elf32_Ehdr*) base;
+    if(memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0)
+      fail("is not an ELF file");
+    if(eh->e_ident[EI_CLASS] != ELFCLASS32 ||
+        eh->e_ident[EI_DATA] != ELFDATA2MSB)
+      fail("is not a big endian 32 bit ELF file");
+    if(be(eh->e_machine) != EM_MIPS || be(eh->e_type) != ET_EXEC)
+      fail("is not a MIPS executable");
+    if(be(eh->e_entry) % WORD != 0)
+      fail("has an entry point that is not word aligned");
+    entry = be(eh->e_entry) / WORD;
+
+    size_t phoff = be(eh->e_phoff);
+    size_t phnum = be(eh->e_phnum);
+    if(be(eh->e_phentsize) != sizeof(Elf32_Phdr) ||
+        phoff + phnum * sizeof(Elf32_Phdr) > size)
+      fail("has a broken program header table");
+    for(size_t i = 0; i < phnum; i++){
+      const Elf32_Phdr* ph = (const Elf32_Phdr*)
+        (base + phoff + i * sizeof(Elf32_Phdr));
+      if(be(ph->p_type) != PT_LOAD)
+        continue;
+      size_t offset = be(ph->p_offset);
+      size_t vaddr = be(ph->p_vaddr);
+      size_t filesz = be(ph->p_filesz);
+      size_t memsz = be(ph->p_memsz);
+      if(vaddr % WORD != 0 || offset % WORD != 0)
+        fail("has a segment that is not word aligned");
+      if(offset + filesz > size || filesz > memsz)
+        fail("has a segment past its end");
+      Segment s;
+      s.address = vaddr / WORD;
+      s.offset = offset;
+      s.fileBytes = filesz;
+      //a partial last word is zero padded
+      s.fileWords = (filesz + WORD - 1) / WORD;
+      s.memWords = (memsz + WORD - 1) / WORD;
+      segments.push_back(s);
+    }
+    if(segments.empty())
+      fail("has nothing to load");
+    readSymbols();
+    guard.f = nullptr;
+  }
+
+  void ElfFile::readSymbols(){
+    const Elf32_Ehdr* eh = (const Elf32_Ehdr*) base;
+    size_t shoff = be(eh->e_shoff);
+    size_t shnum = be(eh->e_shnum);
+    //stripped
+    if(shoff == 0 || shnum == 0)
+      return;
+    if(be(eh->e_shentsize) != sizeof(Elf32_Shdr) ||
+        shoff + shnum * sizeof(Elf32_Shdr) > size)
+      fail("has a broken section header table");
+    const Elf32_Shdr* sections = (const Elf32_Shdr*) (base + shoff);
+    for(size_t i = 0; i < shnum; i++){
+      if(be(sections[i].sh_type) != SHT_SYMTAB)
+        continue;
+      size_t link = be(sections[i].sh_link);
+      if(link >= shnum)
+        fail("has a symbol table without strings");
+      size_t symOffset = be(sections[i].sh_offset);
+      size_t symSize = be(sections[i].sh_size);
+      size_t strOffset = be(sections[link].sh_offset);
+      size_t strSize = be(sections[link].sh_size);
+      if(symOffset + symSize > size || strOffset + strSize > size)
+        fail("has a symbol table past its end");
+      const char* strings = (const char*) (base + strOffset);
+      for(size_t j = 0; j < symSize / sizeof(Elf32_Sym); j++){
+        const Elf32_Sym* sym = (const Elf32_Sym*)
+          (base + symOffset + j * sizeof(Elf32_Sym));
+        unsigned char type = ELF32_ST_TYPE(sym->st_info);
+        size_t name = be(sym->st_name);
+        if(be(sym->st_shndx) == SHN_UNDEF || name == 0 || name >= strSize ||
+            (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE))
+          continue;
+        Symbol s;
+        s.name = string(strings + name,
+            strnlen(strings + name, strSize - name));
+        s.address = be(sym->st_value) / WORD;
+        s.size = (be(sym->st_size) + WORD - 1) / WORD;
+        s.function = type == STT_FUNC;
+        symbols.push_back(s);
+      }
+    }
+    stable_sort(symbols.begin(), symbols.end(),
+        [](const Symbol& a, const Symbol& b){ return a.address < b.address; });
+  }
+
+  bool ElfFile::isElf(const string& filename){
+    char magic[SELFMAG];
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+      return false;
+    bool elf = pread(fd, magic, SELFMAG, 0) == SELFMAG &&
+      memcmp(magic, ELFMAG, SELFMAG) == 0;
+    ::close(fd);
+    return elf;
+  }
+
+  void ElfFile::load(MemoryUnit& mainMem) const{
+    for(const Segment& s : segments){
+      if(s.address + s.memWords > mainMem.getSize())
+        fail("needs more than the " + to_string(mainMem.getSize()) +
+            " words of main memory");
+      //only the segment's own bytes, whatever follows it in the file
+      vector<data32> words(s.fileWords, 0);
+      memcpy(words.data(), base + s.offset, s.fileBytes);
+      for(data32& w : words)
+        w = be32toh(w);
+      //the rest, .bss, is already zero
+      mainMem.storeBlock(s.address, words.data(), words.size());
+    }
+  }
+
+  data32 ElfFile::getEntry() const{
+    return entry;
+  }
+
+  data32 ElfFile::getEnd() const{
+    data32 end = 0;
+    for(const Segment& s : segments)
+      end = max<data32>(end, s.address + s.memWords);
+    return end;
+  }
+
+  const vector<Symbol>& ElfFile::getSymbols() const{
+    return symbols;
+  }
+
+  const Symbol* ElfFile::symbolAt(data32 address) const{
+    auto it = upper_bound(symbols.begin(), symbols.end(), address,
+        [](data32 a, const Symbol& s){ return a < s.address; });
+    if(it == symbols.begin())
+      return nullptr;
+    return &*prev(it);
+  }
+
+  void ElfFile::release(){
+    if(base)
+      munmap((void*) base, size);
+    if(fd >= 0)
+      ::close(fd);
+    base = nullptr;
+    fd = -1;
+  }
+
+  ElfFile::~ElfFile(){
+    release();
+  }
+}
@@ -0,0 +1,103 @@
+#ifndef ELF_H_INCLUDED
+#define ELF_H_INCLUDED
+#include <string>
+#include <vector>
+#include "Mem.h"
+
+using namespace std;
+using namespace mem;
+/*
+ * Loads big endian 32 bit MIPS ELF executables, straight from the file
+ * rather than through a hex dump of .text.
+ *
+ * The file is mapped read only. Every PT_LOAD segment is copied into main
+ * memory at its address, its words swapped to host order; what a segment
+ * has in memory past its file contents (.bss) is left alone, since memory
+ * that was never written reads as zero. The pc starts at e_entry. Symbols
+ * come from .symtab, for profiles to name addresses by.
+ *
+ * ELF addresses are in bytes and this simulator's in words, so every
+ * address here, segment, entry and symbol, is the ELF one divided by 4,
+ * and segments must be word aligned. The code must be in the simulator's
+ * dialect (see Assembler.h), Assembler::writeElf writes such files.
+ */
+namespace elf{
+
+  struct Symbol{
+    string name;
+    data32 address;
+    /* in words, 0 if not known */
+    data32 size;
+    bool function;
+  };
+
+  class ElfFile{
+    private:
+      struct Segment{
+        data32 address;
+        /* where its words start in the file */
+        size_t offset;
+        /* bytes in the file, the last word may be partial */
+        size_t fileBytes;
+        size_t fileWords;
+        size_t memWords;
+      };
+
+      string filename;
+      int fd;
+      const unsigned char* base;
+      size_t size;
+      data32 entry;
+      vector<Segment> segments;
+      /* by address */
+      vector<Symbol> symbols;
+
+      /*
+       * throws: exception naming the file and what
+       */
+      [[noreturn]] void fail(const string& what) const;
+
+      void readSymbols();
+
+      /* unmaps and closes the file */
+      void release();
+
+    public:
+      /*
+       * params:
+       *   filename: a big endian ELF32 MIPS executable
+       * throws: exception if it is not one, or can't be read
+       */
+      ElfFile(const string& filename);
+      ElfFile(const ElfFile&) = delete;
+      ElfFile& operator=(const ElfFile&) = delete;
+
+      /*
+       * returns: whether filename starts like an ELF file
+       */
+      static bool isElf(const string& filename);
+
+      /*
+       * copies the segments' file contents into mainMem
+       */
+      void load(MemoryUnit& mainMem) const;
+
+      data32 getEntry() const;
+
+      /*
+       * returns: the first word after every segment, in memory
+       */
+      data32 getEnd() const;
+
+      const vector<Symbol>& getSymbols() const;
+
+      /*
+       * returns: the symbol address is in, or the last one before it,
+       *   nullptr if there is none
+       */
+      const Symbol* symbolAt(data32 address) const;
+
+      ~ElfFile();
+  };
+}
+#endif
@@ -0,0 +1,146 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <exception>
+#include "FrontEnd.h"
+
+using namespace std;
+
+namespace frontend{
+
+  namespace {
+    const data32 NO_ADDR = (data32) -1;
+  }
+
+  FetchUnit::FetchUnit(MemoryUnit& mem, unsigned int lineWords,
+      unsigned int queueWords, unsigned int accessLatency,
+      unsigned int loopBufferWords) : mem{mem}, lineWords{lineWords},
+    queueWords{queueWords}, accessLatency{accessLatency}, fetchAddr{0},
+    inFlight{false}, fromLoopBuffer{false}, cyclesLeft{0}, waiting{false},
+    wanted{0}, redirected{false},
+    loopBuffer(loopBufferWords, {NO_ADDR, 0}) {
+    if(lineWords == 0 || queueWords < lineWords){
+      BOOST_LOG_TRIVIAL(fatal) << "<<FetchUnit>> a queue of " << queueWords
+        << " words can't hold a line of " << lineWords << endl;
+      throw std::exception();
+    }
+  }
+
+  void FetchUnit::copyStateFrom(const FetchUnit& other){
+    queue = other.queue;
+    fetchAddr = other.fetchAddr;
+    inFlight = other.inFlight;
+    fromLoopBuffer = other.fromLoopBuffer;
+    cyclesLeft = other.cyclesLeft;
+    waiting = other.waiting;
+    wanted = other.wanted;
+    redirected = other.redirected;
+    loopBuffer = other.loopBuffer;
+    stats = other.stats;
+  }
+
+  void FetchUnit::flush(){
+    stats.nWordsDiscarded += queue.size();
+    queue.clear();
+    inFlight = false;
+    waiting = false;
+    fill(loopBuffer.begin(), loopBuffer.end(),
+        pair<data32, data32>(NO_ADDR, 0));
+  }
+
+  unsigned int FetchUnit::lineLeft() const{
+    return lineWords - fetchAddr % lineWords;
+  }
+
+  bool FetchUnit::inLoopBuffer(data32 addr) const{
+    return !loopBuffer.empty() &&
+      loopBuffer[addr % loopBuffer.size()].first == addr;
+  }
+
+  void FetchUnit::startAccess(){
+    if(inFlight || fetchAddr >= mem.getSize() ||
+        queue.size() + lineLeft() > queueWords)
+      return;
+    fromLoopBuffer = true;
+    for(data32 a = fetchAddr; a < fetchAddr + lineLeft(); a++)
+      fromLoopBuffer = fromLoopBuffer && inLoopBuffer(a);
+    inFlight = true;
+    cyclesLeft = fromLoopBuffer ? 1 : accessLatency;
+  }
+
+  void FetchUnit::request(data32 addr){
+    waiting = true;
+    wanted = addr;
+    data32 next = queue.empty() ? fetchAddr : queue.front().first;
+    if(addr == next){
+      startAccess();
+      return;
+    }
+    stats.nRedirects++;
+    stats.nWordsDiscarded += queue.size();
+    queue.clear();
+    inFlight = false;
+    fetchAddr = addr;
+    redirected = true;
+    startAccess();
+  }
+
+  bool FetchUnit::has(data32 addr) const{
+    return addr >= mem.getSize() ||
+      (!queue.empty() && queue.front().first == addr);
+  }
+
+  data32 FetchUnit::take(data32 addr){
+    waiting = false;
+    redirected = false;
+    if(queue.empty() || queue.front().first != addr)
+      return mem.ld(addr);
+    data32 word = queue.front().second;
+    queue.pop_front();
+    return word;
+  }
+
+  void FetchUnit::tick(){
+    if(inFlight && --cyclesLeft == 0){
+      inFlight = false;
+      unsigned int n = lineLeft();
+      for(data32 a = fetchAddr; a < fetchAddr + n; a++){
+        data32 word;
+        if(fromLoopBuffer){
+          word = loopBuffer[a % loopBuffer.size()].second;
+        } else {
+          word = a < mem.getSize() ? mem.ld(a) : 0;
+          if(!loopBuffer.empty())
+            loopBuffer[a % loopBuffer.size()] = {a, word};
+        }
+        queue.push_back({a, word});
+      }
+      stats.nWordsFetched += n;
+      if(fromLoopBuffer)
+        stats.nLoopBufferLines++;
+      else
+        stats.nAccesses++;
+      fetchAddr += n;
+    }
+    startAccess();
+    if(waiting && !has(wanted)){
+      if(redirected)
+        stats.redirectBubbles++;
+      else
+        stats.starvedBubbles++;
+    }
+  }
+
+  const FetchStats& FetchUnit::getStats() const{
+    return stats;
+  }
+
+  void FetchUnit::report(ostream& out) const{
+    out << "front end: " << stats.nAccesses << " accesses, " <<
+      stats.nLoopBufferLines << " lines from the loop buffer, " <<
+      stats.nWordsFetched << " words fetched, " << stats.nWordsDiscarded <<
+      " discarded on " << stats.nRedirects << " redirects" << endl;
+    out << "front end bubbles: " << stats.redirectBubbles <<
+      " after redirects, " << stats.starvedBubbles << " starved" << endl;
+  }
+}
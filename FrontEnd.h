@@ -0,0 +1,139 @@
+#ifndef FRONTEND_H_INCLUDED
+#define FRONTEND_H_INCLUDED
+#include <deque>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "Mem.h"
+
+using namespace std;
+using namespace mem;
+/*
+ * A decoupled front end for Processor5S. Without it InstructionFetch reads
+ * its word from main memory itself, taking if.latency for each. With it
+ * (fe.queueWords > 0) a FetchUnit runs ahead of the pc instead:
+ *
+ *   - each access reads from the next address to the end of its aligned
+ *     line of fe.lineWords words, in if.latency cycles, and only starts
+ *     once the fetch queue has room for all of it
+ *   - InstructionFetch takes its word off the queue in one cycle, and waits
+ *     while the queue does not have it yet
+ *   - asking for anything but the next word (a taken branch, a new pc)
+ *     throws the queue and the access in flight away and starts over there
+ *   - a loop buffer of fe.loopBufferWords (0 for none), direct mapped on
+ *     the address, keeps the words read. A line it has every word of comes
+ *     out of it in one cycle, without an access, so a loop that fits runs
+ *     from it after its first trip
+ *
+ * What gets fetched behind a branch is decided by the pipe as before, the
+ * queue only changes how long fetches take. Reads past main memory's
+ * getSize are left to InstructionFetch to make one word at a time, as it
+ * did without a front end. Running ahead reads words no instruction is
+ * fetched from, which a VirtualMem gives physical words to.
+ */
+namespace frontend{
+
+  struct FetchStats{
+    /* accesses to memory, one per line or part line */
+    unsigned long nAccesses = 0;
+    /* lines that came out of the loop buffer instead */
+    unsigned long nLoopBufferLines = 0;
+    unsigned long nWordsFetched = 0;
+    /* fetched and thrown away by redirects */
+    unsigned long nWordsDiscarded = 0;
+    unsigned long nRedirects = 0;
+    /* cycles InstructionFetch waited on the queue after a redirect */
+    unsigned long redirectBubbles = 0;
+    /* and the rest of the cycles it waited on it */
+    unsigned long starvedBubbles = 0;
+  };
+
+  class FetchUnit{
+    private:
+      MemoryUnit& mem;
+      unsigned int lineWords;
+      unsigned int queueWords;
+      unsigned int accessLatency;
+      /* address and word, oldest first */
+      deque<pair<data32, data32>> queue;
+      /* where the next access starts */
+      data32 fetchAddr;
+      bool inFlight;
+      bool fromLoopBuffer;
+      /* cycles left on the access in flight */
+      unsigned int cyclesLeft;
+      /* the word InstructionFetch is waiting for, if it is */
+      bool waiting;
+      data32 wanted;
+      /* whether that wait started with a redirect */
+      bool redirected;
+      /* address and word, at address % size */
+      vector<pair<data32, data32>> loopBuffer;
+      FetchStats stats;
+
+      /* words from fetchAddr to the end of its line */
+      unsigned int lineLeft() const;
+
+      /* starts the next access, if there is room for it */
+      void startAccess();
+
+      bool inLoopBuffer(data32 addr) const;
+
+    public:
+      /*
+       * params:
+       *   mem: where instructions are read from
+       *   lineWords: words per access
+       *   queueWords: fetch queue size, at least lineWords
+       *   accessLatency: cycles per access
+       *   loopBufferWords: loop buffer size, 0 for none
+       * throws: exception if the queue can't hold a line
+       */
+      FetchUnit(MemoryUnit& mem, unsigned int lineWords,
+          unsigned int queueWords, unsigned int accessLatency,
+          unsigned int loopBufferWords);
+
+      /*
+       * makes this a copy of other, on this unit's memory and sizes, which
+       * must match other's. For cloning a processor mid run
+       */
+      void copyStateFrom(const FetchUnit& other);
+
+      /*
+       * drops everything fetched ahead, the loop buffer and the access in
+       * flight, for when what is in memory at those addresses changes
+       */
+      void flush();
+
+      /*
+       * asks for the word at addr, redirecting the unit unless it is the
+       * next one
+       */
+      void request(data32 addr);
+
+      /*
+       * returns: whether the word asked for is at the head of the queue, or
+       *   can't be, being past the end of memory
+       */
+      bool has(data32 addr) const;
+
+      /*
+       * returns: the word asked for, off the queue, or read straight from
+       *   memory past its end
+       */
+      data32 take(data32 addr);
+
+      /*
+       * advances a cycle: finishes or starts an access
+       */
+      void tick();
+
+      const FetchStats& getStats() const;
+
+      /*
+       * writes the stats to out
+       */
+      void report(ostream& out) const;
+  };
+}
+#endif
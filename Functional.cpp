@@ -0,0 +1,397 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <atomic>
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+#include "Functional.h"
+#include "SpscQueue.h"
+
+using namespace std;
+using namespace pool;
+
+namespace functional{
+
+  namespace {
+    /* instructions fetched behind a branch before it redirects */
+    const data32 DELAY_SLOTS = 5;
+
+    typedef SpscQueue<vector<TraceRecord>> RecordQueue;
+
+    /*
+     * the timing side's end of the queue. An empty batch is the end
+     */
+    class QueueSource : public RecordSource{
+      private:
+        RecordQueue& queue;
+        vector<TraceRecord> batch;
+        size_t next_;
+        bool ended;
+
+      public:
+        QueueSource(RecordQueue& queue) : queue{queue}, next_{0},
+          ended{false} {}
+
+        bool next(TraceRecord& r) override{
+          if(next_ == batch.size()){
+            if(ended)
+              return false;
+            batch = queue.pop();
+            next_ = 0;
+            if(batch.empty()){
+              ended = true;
+              return false;
+            }
+          }
+          r = batch[next_++];
+          return true;
+        }
+    };
+  }
+
+  FunctionalCore::FunctionalCore(MemoryUnit& mainMem, MemoryUnit& rf,
+      data32 startPc) : mainMem{mainMem}, rf{rf}, acc{0}, n{0},
+    pc{startPc}, syscalls{nullptr}, accelerator{nullptr}, reserved{false},
+    reservation{0} {
+    for(data32 i = 0; i < 32; i++)
+      regs[i] = rf.ld(i);
+    writes.fill({false, false, 0, 0});
+    redirects.fill({false, 0});
+  }
+
+  void FunctionalCore::setSyscalls(sys::SyscallEmulator* emulator){
+    syscalls = emulator;
+  }
+
+  void FunctionalCore::setAccelerator(accel::Accelerator* accelerator){
+    this->accelerator = accelerator;
+  }
+
+  void FunctionalCore::retire(Write& w){
+    if(w.valid){
+      regs[w.reg] = w.value;
+      rf.sw(w.reg, w.value);
+      w.valid = false;
+    }
+  }
+
+  bool FunctionalCore::step(TraceRecord& r){
+    //writeback of the instruction four back happens before this decode
+    retire(writes[n % 4]);
+    pair<bool, data32>& redirect = redirects[n % 8];
+    if(redirect.first){
+      pc = redirect.second;
+      redirect.first = false;
+    }
+    //a call to a function run on the host, which returns at once, as a jr
+    //$31 would. The link has long retired, since this is past the delay
+    //slots of the jal
+    if(accelerator != nullptr && accelerator->intercepts(pc) && isQuiet()){
+      drain();
+      n += accelerator->call(pc, mainMem, rf);
+      for(data32 i = 0; i < 32; i++)
+        regs[i] = rf.ld(i);
+      pc = regs[31] + 1;
+    }
+    data32 fetchPc = pc++;
+    //the jal or jalr three back is leaving execute as this is fetched
+    Write& linking = writes[(n + 1) % 4];
+    if(linking.link){
+      //the record went out with the link this would be without redirects
+      if(linking.value != fetchPc + 2){
+        BOOST_LOG_TRIVIAL(fatal) << "<<FunctionalCore>> a link at " <<
+          fetchPc - 3 << " was redirected, jal and jalr in delay slots are "
+          "not supported" << endl;
+        throw std::exception();
+      }
+      linking.link = false;
+    }
+
+    data32 word = mainMem.ld(fetchPc);
+    unsigned int opcode = word >> 26;
+    data32 rsN = (word >> 21) & 0x1f;
+    data32 rtN = (word >> 16) & 0x1f;
+    data32 rdN = (word >> 11) & 0x1f;
+    data32 shamt = (word >> 6) & 0x1f;
+    unsigned int func = word & 0x3f;
+    data32 immediate = word & 0xffff;
+    short offset = (short) immediate;
+    data32 rs = regs[rsN];
+    data32 rt = regs[rtN];
+
+    Write& w = writes[n % 4];
+    auto write = [&](data32 reg, data32 value){
+      w = {true, false, reg, value};
+    };
+    r.pc = fetchPc;
+    r.word = word;
+    r.address = 0;
+    r.redirect = false;
+    r.target = 0;
+    bool quit = false;
+    data32 target = 0;
+
+    //the operand order, signedness and truncation are Execute's and
+    //WriteBack's, see Pipeline.cpp
+    if(opcode == 0){
+      switch(func){
+        case 0x20: case 0x21: write(rdN, rt + rs); break;
+        case 0x22: case 0x23: write(rdN, rt - rs); break;
+        case 0x0: write(rdN, rs << shamt); break;
+        case 0x4: write(rdN, rs << (rt & 0x1f)); break;
+        case 0x2: write(rdN, rs >> shamt); break;
+        case 0x6: write(rdN, rs >> (rt & 0x1f)); break;
+        case 0x3: write(rdN, (signedData32) rs >> shamt); break;
+        case 0x7: write(rdN, (signedData32) rs >> (rt & 0x1f)); break;
+        case 0x24: write(rdN, rs & rt); break;
+        case 0x25: write(rdN, rs | rt); break;
+        case 0x26: write(rdN, rs ^ rt); break;
+        case 0x27: write(rdN, ~(rs | rt)); break;
+        case 0x2a: write(rdN, (signedData32) rs < (signedData32) rt); break;
+        case 0x2b: write(rdN, rs < rt); break;
+        case 0x18:
+          acc = (signedData64) (signedData32) rs *
+            (signedData64) (signedData32) rt;
+          break;
+        case 0x19: acc = (data64) rs * (data64) rt; break;
+        case 0x1a: {
+          data64 quotient = (signedData32) rs / (signedData32) rt;
+          data64 rem = (signedData32) rs % (signedData32) rt;
+          acc = (rem << 32) + quotient;
+          break;
+        }
+        case 0x1b: {
+          data64 quotient = rs / rt;
+          data64 rem = rs % rt;
+          acc = (rem << 32) + quotient;
+          break;
+        }
+        case 0x10: write(rdN, acc >> 32); break;
+        case 0x12: write(rdN, (data32) acc); break;
+        case 0x11: write(rdN, rs); break;
+        case 0x8: r.redirect = true; target = rs; break;
+        case 0x9:
+          w = {true, true, rdN, fetchPc + DELAY_SLOTS};
+          r.redirect = true;
+          target = rs;
+          break;
+        case 0xc:
+          if(syscalls == nullptr || syscalls->isEndMarker(fetchPc)){
+            quit = true;
+            break;
+          }
+          //in writeback, after every write before it
+          drain();
+          quit = syscalls->handle(mainMem, rf);
+          for(data32 i = 0; i < 32; i++)
+            regs[i] = rf.ld(i);
+          break;
+        case 0x1: break;
+        //sync, one core's accesses are in order already
+        case 0xf: break;
+        default:
+          BOOST_LOG_TRIVIAL(fatal) << "<<FunctionalCore>> invalid function "
+            "code 0x" << hex << func << " at " << dec << fetchPc << endl;
+          throw std::exception();
+      }
+    } else {
+      switch(opcode){
+        case 0x4: r.redirect = rs == rt; target = immediate; break;
+        case 0x5: r.redirect = rs != rt; target = immediate; break;
+        case 0x1: r.redirect = (signedData32) rs < 0; target = immediate;
+          break;
+        case 0x8: case 0x9: write(rtN, (signedData32) rs + offset); break;
+        case 0xa: write(rtN, (signedData32) rs < offset); break;
+        case 0xb: write(rtN, rs < (unsigned short) immediate); break;
+        case 0xc: write(rtN, (unsigned short) rs & immediate); break;
+        case 0xd: write(rtN, (unsigned short) rs | immediate); break;
+        case 0xe: write(rtN, (unsigned short) rs ^ immediate); break;
+        case 0xf: write(rtN, immediate << 16); break;
+        case 0x23:
+          r.address = (signedData32) rs + offset;
+          write(rtN, mainMem.ld(r.address));
+          break;
+        //byte and halfword accesses by byte address, traced by word
+        case 0x20: case 0x21: case 0x24: case 0x25: {
+          data32 byteAddr = (signedData32) rs + offset;
+          r.address = byteAddr >> 2;
+          if(opcode == 0x20)
+            write(rtN, (signedData32) (signed char) mainMem.ldByte(byteAddr));
+          else if(opcode == 0x24)
+            write(rtN, mainMem.ldByte(byteAddr));
+          else if(opcode == 0x21)
+            write(rtN, (signedData32) (signedData16)
+                mainMem.ldHalf(byteAddr));
+          else
+            write(rtN, mainMem.ldHalf(byteAddr));
+          break;
+        }
+        case 0x2b:
+          //sw stores rs at rt + offset
+          r.address = (signedData32) rt + offset;
+          mainMem.sw(r.address, rs);
+          break;
+        case 0x30:
+          r.address = (signedData32) rs + offset;
+          write(rtN, mainMem.ld(r.address));
+          reserved = true;
+          reservation = r.address;
+          break;
+        case 0x38:
+          //sc stores rt at rs + offset, and writes rt with whether it did
+          r.address = (signedData32) rs + offset;
+          if(reserved && reservation == r.address){
+            mainMem.sw(r.address, rt);
+            write(rtN, 1);
+          } else {
+            write(rtN, 0);
+          }
+          reserved = false;
+          break;
+        case 0x28: case 0x29: {
+          data32 byteAddr = (signedData32) rt + offset;
+          r.address = byteAddr >> 2;
+          if(opcode == 0x28)
+            mainMem.stByte(byteAddr, rs);
+          else
+            mainMem.stHalf(byteAddr, rs);
+          break;
+        }
+        case 0x2: case 0x3:
+          r.redirect = true;
+          target = (fetchPc & 0xf0000000) | (word & 0x3ffffff);
+          if(opcode == 0x3)
+            w = {true, true, 31, fetchPc + DELAY_SLOTS};
+          break;
+        default:
+          BOOST_LOG_TRIVIAL(fatal) << "<<FunctionalCore>> invalid opcode 0x"
+            << hex << opcode << " at " << dec << fetchPc << endl;
+          throw std::exception();
+      }
+    }
+    if(r.redirect){
+      r.target = target;
+      redirects[(n + DELAY_SLOTS + 1) % 8] = {true, target + 1};
+    }
+    decode(r);
+    //the trace keeps a jal's link
+    if(opcode == 0x3)
+      r.address = w.value;
+    n++;
+    return !quit;
+  }
+
+  void FunctionalCore::drain(){
+    for(unsigned long i = n; i < n + 4; i++)
+      retire(writes[i % 4]);
+  }
+
+  bool FunctionalCore::isQuiet() const{
+    for(const Write& w : writes)
+      if(w.link)
+        return false;
+    for(const pair<bool, data32>& redirect : redirects)
+      if(redirect.first)
+        return false;
+    return true;
+  }
+
+  data32 FunctionalCore::getPc() const{
+    const pair<bool, data32>& redirect = redirects[n % 8];
+    return redirect.first ? redirect.second : pc;
+  }
+
+  array<data32, 32> FunctionalCore::getRegisters() const{
+    array<data32, 32> out;
+    copy(regs, regs + 32, out.begin());
+    //oldest first
+    for(unsigned long i = n; i < n + 4; i++)
+      if(writes[i % 4].valid)
+        out[writes[i % 4].reg] = writes[i % 4].value;
+    return out;
+  }
+
+  data64 FunctionalCore::getAccumulator() const{
+    return acc;
+  }
+
+  unsigned long FunctionalCore::getNExecuted() const{
+    return n;
+  }
+
+  DecoupledSim::DecoupledSim(MemoryUnit& mainMem, MemoryUnit& rf,
+      const SimConfig& config) : mainMem{mainMem}, rf{rf}, config{config},
+    nRetired{0}, currentCycle{0}, syscalls{nullptr} {}
+
+  void DecoupledSim::setSyscalls(sys::SyscallEmulator* emulator){
+    syscalls = emulator;
+  }
+
+  void DecoupledSim::run(data32 startPc){
+    RecordQueue queue(QUEUE_BATCHES);
+    atomic<bool> stop{false};
+    bool failed = false;
+
+    thread functional([&](){
+      FunctionalCore core(mainMem, rf, startPc);
+      core.setSyscalls(syscalls);
+      vector<TraceRecord> batch;
+      batch.reserve(BATCH);
+      //hands a batch over, or gives up if the timing side has
+      auto send = [&](vector<TraceRecord>& b){
+        while(!queue.tryPush(b)){
+          if(stop.load(memory_order_relaxed))
+            return false;
+          this_thread::yield();
+        }
+        return true;
+      };
+      try{
+        bool running = true;
+        while(running && !stop.load(memory_order_relaxed)){
+          TraceRecord r;
+          running = core.step(r);
+          batch.push_back(r);
+          if(batch.size() == BATCH || !running){
+            if(!send(batch))
+              break;
+            batch = vector<TraceRecord>();
+            batch.reserve(BATCH);
+          }
+        }
+        core.drain();
+      } catch(const std::exception&){
+        failed = true;
+      }
+      vector<TraceRecord> end;
+      send(end);
+    });
+
+    QueueSource source(queue);
+    TraceReplayer replayer(source, config);
+    try{
+      replayer.run();
+    } catch(const std::exception&){
+      stop = true;
+      functional.join();
+      throw;
+    }
+    stop = true;
+    functional.join();
+    if(failed){
+      //already logged as fatal where it was thrown
+      throw std::exception();
+    }
+    nRetired = replayer.getNRetired();
+    currentCycle = replayer.getCurrentCycle();
+  }
+
+  unsigned long DecoupledSim::getNRetired() const{
+    return nRetired;
+  }
+
+  unsigned long DecoupledSim::getCurrentCycle() const{
+    return currentCycle;
+  }
+}
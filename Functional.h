@@ -0,0 +1,168 @@
+#ifndef FUNCTIONAL_H_INCLUDED
+#define FUNCTIONAL_H_INCLUDED
+#include <array>
+#include "Mem.h"
+#include "Config.h"
+#include "Trace.h"
+#include "Syscall.h"
+#include "Accel.h"
+
+using namespace std;
+using namespace mem;
+using namespace config;
+using namespace trace;
+/*
+ * Functional first simulation: a functional core works out what every
+ * instruction does, and a timing model works out how long it takes, on two
+ * threads.
+ *
+ * FunctionalCore executes instructions in the order Processor5S fetches them
+ * at full speed (all latencies 1), with the same quirks, since they decide
+ * the results:
+ *   - registers are read in decode and written in writeback, so a write is
+ *     only seen by the fourth instruction after it and later
+ *   - a branch or jump redirects in writeback, after the 5 instructions
+ *     behind it, and a taken one to x goes on at x + 1
+ *   - jal and jalr link the pc as they leave execute, plus 2, which is the
+ *     pc of the third instruction after them
+ * decoding the word directly rather than through Instruction. It stops at
+ * the syscall, which it does not run the instructions behind, unless
+ * syscalls are emulated (see Syscall.h). An emulated one sees every write
+ * before it, and the three instructions behind it see what it writes,
+ * where Processor5S's would not; the Assembler pads them with nops.
+ *
+ * DecoupledSim runs a FunctionalCore on its own thread, which hands batches
+ * of resolved records (see Trace.h) through an SpscQueue to a TraceReplayer
+ * on the calling thread. The queue is bounded, so the functional side runs
+ * at most that far ahead. The results in memory and the register file are
+ * the functional core's, the cycles the replayer's. Those are the same as
+ * Processor5S's under the conditions TraceReplayer states, and the replayer
+ * throws otherwise. The one exception is a link left in a register: it is
+ * the full speed one, where Processor5S's moves with the timing. There is
+ * no branch prediction, so no wrong path to roll back: the functional core
+ * only ever runs the committed path.
+ */
+namespace functional{
+
+  class FunctionalCore{
+    private:
+      /* a register write not yet seen by decode */
+      struct Write{
+        bool valid;
+        /* a link, checked by the third instruction after */
+        bool link;
+        data32 reg;
+        data32 value;
+      };
+
+      MemoryUnit& mainMem;
+      MemoryUnit& rf;
+      data32 regs[32];
+      data64 acc;
+      /* fetch order index of the next instruction */
+      unsigned long n;
+      data32 pc;
+      /* instruction i's write, at i % 4 */
+      array<Write, 4> writes;
+      /* where fetch i goes when a redirect lands on it, at i % 8 */
+      array<pair<bool, data32>, 8> redirects;
+      sys::SyscallEmulator* syscalls;
+      accel::Accelerator* accelerator;
+      /* the word ll linked, if it still is. Nothing else stores */
+      bool reserved;
+      data32 reservation;
+
+      void retire(Write& w);
+
+    public:
+      /*
+       * params:
+       *   mainMem: the program and its data
+       *   rf: the register file, read now and written as instructions retire
+       *   startPc: where to start
+       */
+      FunctionalCore(MemoryUnit& mainMem, MemoryUnit& rf, data32 startPc);
+
+      /*
+       * runs syscalls on emulator from now on, rather than ending at the
+       * first, nullptr to stop. The emulator is not owned
+       */
+      void setSyscalls(sys::SyscallEmulator* emulator);
+
+      /*
+       * runs the libc functions accelerator knows on the host from now on
+       * (see Accel.h), nullptr to simulate them again. Their cost counts
+       * as executed instructions. The accelerator is not owned
+       */
+      void setAccelerator(accel::Accelerator* accelerator);
+
+      /*
+       * executes the next instruction
+       * params:
+       *   r: filled with it, as TraceReader would read it
+       * returns: false if it was the syscall that ends the program
+       * throws: exception on an instruction Processor5S does not implement
+       */
+      bool step(TraceRecord& r);
+
+      /*
+       * makes every write so far visible in the register file
+       */
+      void drain();
+
+      /*
+       * returns: whether no branch or link is still in flight, so the next
+       *   instruction could start an empty pipe (Processor5S::setPc)
+       */
+      bool isQuiet() const;
+
+      /*
+       * returns: where the next instruction will be fetched from
+       */
+      data32 getPc() const;
+
+      /*
+       * returns: the registers as they will be once every write so far is
+       *   seen, leaving the register file alone
+       */
+      array<data32, 32> getRegisters() const;
+
+      data64 getAccumulator() const;
+
+      unsigned long getNExecuted() const;
+  };
+
+  class DecoupledSim{
+    private:
+      MemoryUnit& mainMem;
+      MemoryUnit& rf;
+      SimConfig config;
+      unsigned long nRetired;
+      unsigned long currentCycle;
+      sys::SyscallEmulator* syscalls;
+
+    public:
+      /* records per batch through the queue */
+      static const size_t BATCH = 4096;
+      /* batches the functional core may run ahead */
+      static const size_t QUEUE_BATCHES = 16;
+
+      DecoupledSim(MemoryUnit& mainMem, MemoryUnit& rf,
+          const SimConfig& config);
+
+      /*
+       * as FunctionalCore::setSyscalls, for the functional side
+       */
+      void setSyscalls(sys::SyscallEmulator* emulator);
+
+      /*
+       * runs the program from startPc to its syscall
+       * throws: exception if either side does
+       */
+      void run(data32 startPc);
+
+      unsigned long getNRetired() const;
+      unsigned long getCurrentCycle() const;
+  };
+}
+#endif
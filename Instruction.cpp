@@ -41,6 +41,12 @@ namespace instruction{
     //You should never reach here
   }
 
+  bool Instruction::isSubword() const{
+    unsigned long opcode = getSlice<26,32>().to_ulong();
+    return opcode == 0x20 || opcode == 0x21 || opcode == 0x24 ||
+      opcode == 0x25 || opcode == 0x28 || opcode == 0x29;
+  }
+
   std::string Instruction::toString() const{
     return getType() + " " + instr.to_string();
   }
@@ -66,14 +72,16 @@ namespace instruction{
         {std::bitset<6>(0x23), "I-Type:lw"},
         {std::bitset<6>(0x2b), "I-Type:sw"},
         {bitset<6>(0x1), "I-Type:bltz"},
-        //Note following instructions go to different sizes, but I treat them
-        //as load word so you can run straight assmebly from gcc Xcompiler
-        {bitset<6>(0x20), "I-Type:lw"},
-        {bitset<6>(0x21), "I-Type:lw"},
-        {bitset<6>(0x24), "I-Type:lw"},
-        {bitset<6>(0x25), "I-Type:lw"},
-        {bitset<6>(0x28), "I-Type:sw"},
-        {bitset<6>(0x29), "I-Type:sw"}
+        //byte and halfword loads and stores address bytes, see Mem.h
+        {bitset<6>(0x20), "I-Type:lb"},
+        {bitset<6>(0x21), "I-Type:lh"},
+        {bitset<6>(0x24), "I-Type:lbu"},
+        {bitset<6>(0x25), "I-Type:lhu"},
+        {bitset<6>(0x28), "I-Type:sb"},
+        {bitset<6>(0x29), "I-Type:sh"},
+        //word addressed, sc with real MIPS operands, see Assembler.h
+        {bitset<6>(0x30), "I-Type:ll"},
+        {bitset<6>(0x38), "I-Type:sc"}
       }
    );
 
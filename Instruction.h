@@ -44,6 +44,7 @@ namespace instruction{
         {0x3,"sra"},
         {0x7,"srav"},
         {0xc,"syscall"},
+        {0xf,"sync"},
         {0x11,"move"},
         {0x9,"jalr"},
         //completely unimplemented
@@ -97,6 +98,12 @@ namespace instruction{
        * FUNC_2_MNEMONIC
        */
       std::string getFuncType() const;
+
+      /*
+       * returns: whether it is a byte or halfword load or store, whose
+       *   address is a byte address rather than a word's
+       */
+      bool isSubword() const;
   };
 
   bool operator==(const Instruction& left, const Instruction& right);
@@ -0,0 +1,18 @@
+#ifndef LOG_H_INCLUDED
+#define LOG_H_INCLUDED
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+/*
+ * Debug records go through Boost.Log's process wide core, which every
+ * simulator instance would then contend on. They are only compiled in with
+ * CCA_DEBUG_LOG (make DEBUG_LOG=1). Without it the statement is still type
+ * checked, but never evaluated.
+ *
+ * Fatal records stay on BOOST_LOG_TRIVIAL, they are followed by a throw.
+ */
+#ifdef CCA_DEBUG_LOG
+#define LOG_DEBUG BOOST_LOG_TRIVIAL(debug)
+#else
+#define LOG_DEBUG if(true){} else BOOST_LOG_TRIVIAL(debug)
+#endif
+#endif
@@ -2,9 +2,14 @@
 #include <boost/log/trivial.hpp>
 #include <exception>
 #include <algorithm>
+#include <cstring>
 #include <unordered_map>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "Mem.h"
+#include "Profile.h"
+#include "Log.h"
 
 using namespace std;
 
@@ -20,6 +25,56 @@ namespace mem{
 
   MemoryUnit::MemoryUnit(): name(""){}
 
+  namespace {
+    /* bits of a word to shift a byte or halfword at byteAddr down by */
+    data32 byteShift(data32 byteAddr){
+      return (3 - (byteAddr & 3)) * 8;
+    }
+
+    data32 halfShift(data32 byteAddr){
+      return (2 - (byteAddr & 2)) * 8;
+    }
+
+    void checkHalfAligned(const std::string& name, data32 byteAddr){
+      if(byteAddr & 1){
+        BOOST_LOG_TRIVIAL(fatal) << "<<" << name << ">> halfword access at "
+          "unaligned byte address " << byteAddr << std::endl;
+        throw std::exception();
+      }
+    }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    /* xored into a byte address to find the guest byte in a host word */
+    const data32 BYTE_LANE = 3;
+    const data32 HALF_LANE = 2;
+#else
+    const data32 BYTE_LANE = 0;
+    const data32 HALF_LANE = 0;
+#endif
+  }
+
+  data8 MemoryUnit::ldByte(data32 byteAddr){
+    return ld(byteAddr >> 2) >> byteShift(byteAddr);
+  }
+
+  data16 MemoryUnit::ldHalf(data32 byteAddr){
+    checkHalfAligned(getName(), byteAddr);
+    return ld(byteAddr >> 2) >> halfShift(byteAddr);
+  }
+
+  void MemoryUnit::stByte(data32 byteAddr, data8 value){
+    data32 shift = byteShift(byteAddr);
+    data32 word = ld(byteAddr >> 2) & ~(0xffu << shift);
+    sw(byteAddr >> 2, word | ((data32) value << shift));
+  }
+
+  void MemoryUnit::stHalf(data32 byteAddr, data16 value){
+    checkHalfAligned(getName(), byteAddr);
+    data32 shift = halfShift(byteAddr);
+    data32 word = ld(byteAddr >> 2) & ~(0xffffu << shift);
+    sw(byteAddr >> 2, word | ((data32) value << shift));
+  }
+
   /*
    * throws: exception if address is invalid
    */
@@ -67,8 +122,9 @@ namespace mem{
    * throws: exception if address is invalid
    */
   data32 DRAM::ld(unsigned int addr){
+    PROFILE_SCOPE(MEM_LD);
     isValidAddr(addr);
-    BOOST_LOG_TRIVIAL(debug) << "<<" << getName() << ">>" << " loading " << 
+    LOG_DEBUG << "<<" << getName() << ">>" << " loading " << 
       addr << "." << std::endl;
     return mem[addr];
   }
@@ -81,8 +137,9 @@ namespace mem{
    * throws: exception if address is invalid
    */
   void DRAM::sw(unsigned int addr, data32 word){
+    PROFILE_SCOPE(MEM_SW);
     isValidAddr(addr);
-    BOOST_LOG_TRIVIAL(debug) << "<<" << getName() << ">>" << "storing " << 
+    LOG_DEBUG << "<<" << getName() << ">>" << "storing " << 
       word << " @" << addr << "." << std::endl;
     mem[addr] = word;
   }
@@ -92,11 +149,35 @@ namespace mem{
   }
 
   void DRAM::storeBlock(data32 addr, data32* words, size_t size){
-    BOOST_LOG_TRIVIAL(debug) << "<<" << getName() << ">>" << " loading block of" 
+    LOG_DEBUG << "<<" << getName() << ">>" << " loading block of" 
       << size << " words starting at mem[" << addr << "]" << endl;
     copy(words, &words[size], &mem[addr]);
   }
 
+  data8 DRAM::ldByte(data32 byteAddr){
+    isValidAddr(byteAddr >> 2);
+    return ((data8*) mem)[byteAddr ^ BYTE_LANE];
+  }
+
+  data16 DRAM::ldHalf(data32 byteAddr){
+    checkHalfAligned(getName(), byteAddr);
+    isValidAddr(byteAddr >> 2);
+    data16 half;
+    memcpy(&half, (data8*) mem + (byteAddr ^ HALF_LANE), sizeof(half));
+    return half;
+  }
+
+  void DRAM::stByte(data32 byteAddr, data8 value){
+    isValidAddr(byteAddr >> 2);
+    ((data8*) mem)[byteAddr ^ BYTE_LANE] = value;
+  }
+
+  void DRAM::stHalf(data32 byteAddr, data16 value){
+    checkHalfAligned(getName(), byteAddr);
+    isValidAddr(byteAddr >> 2);
+    memcpy((data8*) mem + (byteAddr ^ HALF_LANE), &value, sizeof(value));
+  }
+
   DRAM::~DRAM(){
     delete [] mem;
   }
@@ -117,10 +198,12 @@ namespace mem{
   }
 
   data32 VirtualMem::ld(unsigned int addr){
+    PROFILE_SCOPE(MEM_LD);
     return mem->ld(lookup(addr));
   }
 
   void VirtualMem::sw(unsigned int addr, data32 word){
+    PROFILE_SCOPE(MEM_SW);
     mem->sw(lookup(addr), word);
   }
 
@@ -130,6 +213,27 @@ namespace mem{
     }
   }
 
+  //the byte offset into the word stays the same, only the word moves
+  data8 VirtualMem::ldByte(data32 byteAddr){
+    PROFILE_SCOPE(MEM_LD);
+    return mem->ldByte(lookup(byteAddr >> 2) << 2 | (byteAddr & 3));
+  }
+
+  data16 VirtualMem::ldHalf(data32 byteAddr){
+    PROFILE_SCOPE(MEM_LD);
+    return mem->ldHalf(lookup(byteAddr >> 2) << 2 | (byteAddr & 3));
+  }
+
+  void VirtualMem::stByte(data32 byteAddr, data8 value){
+    PROFILE_SCOPE(MEM_SW);
+    mem->stByte(lookup(byteAddr >> 2) << 2 | (byteAddr & 3), value);
+  }
+
+  void VirtualMem::stHalf(data32 byteAddr, data16 value){
+    PROFILE_SCOPE(MEM_SW);
+    mem->stHalf(lookup(byteAddr >> 2) << 2 | (byteAddr & 3), value);
+  }
+
   const string& VirtualMem::getName(){
     return mem->getName();
   }
@@ -142,4 +246,235 @@ namespace mem{
     return mem->getSize();
   }
 
+  RelocatedMem::RelocatedMem(MemoryUnit& mem, data32 base, data32 size) :
+    MemoryUnit(mem.getName()), mem{mem}, base{0}, size{0} {
+    setWindow(base, size);
+  }
+
+  void RelocatedMem::setWindow(data32 base, data32 size){
+    if((uint64_t) base + size > mem.getSize()){
+      BOOST_LOG_TRIVIAL(fatal) << "<<" << getName() << ">> a window of " <<
+        size << " words at " << base << " is past the end of memory" <<
+        std::endl;
+      throw std::exception();
+    }
+    this->base = base;
+    this->size = size;
+  }
+
+  data32 RelocatedMem::getBase() const{
+    return base;
+  }
+
+  data32 RelocatedMem::relocate(data32 addr){
+    if(addr >= size){
+      BOOST_LOG_TRIVIAL(fatal) << "<<" << getName() << ">> address " <<
+        addr << " is outside the window of " << size << " words at " <<
+        base << std::endl;
+      throw std::exception();
+    }
+    return base + addr;
+  }
+
+  data32 RelocatedMem::ld(unsigned int addr){
+    return mem.ld(relocate(addr));
+  }
+
+  void RelocatedMem::sw(unsigned int addr, data32 word){
+    mem.sw(relocate(addr), word);
+  }
+
+  void RelocatedMem::storeBlock(data32 addr, data32* words, size_t size){
+    if(size == 0)
+      return;
+    //both ends, so the block is checked whole
+    relocate(addr + size - 1);
+    mem.storeBlock(relocate(addr), words, size);
+  }
+
+  data8 RelocatedMem::ldByte(data32 byteAddr){
+    return mem.ldByte((relocate(byteAddr >> 2) << 2) | (byteAddr & 3));
+  }
+
+  data16 RelocatedMem::ldHalf(data32 byteAddr){
+    return mem.ldHalf((relocate(byteAddr >> 2) << 2) | (byteAddr & 3));
+  }
+
+  void RelocatedMem::stByte(data32 byteAddr, data8 value){
+    mem.stByte((relocate(byteAddr >> 2) << 2) | (byteAddr & 3), value);
+  }
+
+  void RelocatedMem::stHalf(data32 byteAddr, data16 value){
+    mem.stHalf((relocate(byteAddr >> 2) << 2) | (byteAddr & 3), value);
+  }
+
+  size_t RelocatedMem::getSize(){
+    return size;
+  }
+
+  DirtyTrackingMem::DirtyTrackingMem(MemoryUnit& mem) :
+    MemoryUnit(mem.getName()), mem{mem},
+    dirty((mem.getSize() + PAGE_WORDS - 1) / PAGE_WORDS, false) {}
+
+  void DirtyTrackingMem::mark(data32 addr){
+    data32 page = addr >> PAGE_BITS;
+    //past the end is for the wrapped memory to complain about
+    if(page < dirty.size() && !dirty[page]){
+      dirty[page] = true;
+      dirtyPages.push_back(page);
+    }
+  }
+
+  data32 DirtyTrackingMem::ld(unsigned int addr){
+    return mem.ld(addr);
+  }
+
+  void DirtyTrackingMem::sw(unsigned int addr, data32 word){
+    mem.sw(addr, word);
+    mark(addr);
+  }
+
+  void DirtyTrackingMem::storeBlock(data32 addr, data32* words, size_t size){
+    mem.storeBlock(addr, words, size);
+    for(size_t i = 0; i < size; i += PAGE_WORDS)
+      mark(addr + i);
+    if(size > 0)
+      mark(addr + size - 1);
+  }
+
+  size_t DirtyTrackingMem::getSize(){
+    return mem.getSize();
+  }
+
+  vector<data32> DirtyTrackingMem::takeDirty(){
+    for(data32 page : dirtyPages)
+      dirty[page] = false;
+    vector<data32> pages;
+    pages.swap(dirtyPages);
+    return pages;
+  }
+
+  MappedMem::MappedMem(size_t size, std::string name) : MemoryUnit(name),
+    mem{nullptr}, size{size} {
+    size_t page = sysconf(_SC_PAGESIZE);
+    bytes = (size * sizeof(data32) + page - 1) / page * page;
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(mapped == MAP_FAILED){
+      BOOST_LOG_TRIVIAL(fatal) << "<<" << name << ">> can't map " << size <<
+        " words" << endl;
+      throw std::exception();
+    }
+    mem = (data32*) mapped;
+  }
+
+  void MappedMem::isValidAddr(data32 addr){
+    if(addr >= size){
+      BOOST_LOG_TRIVIAL(fatal) << "<<" << getName() <<
+        ">> tried to access invalid memory address was " << addr <<
+        " but size of " << getName() << " is " << size << std::endl;
+      throw std::exception();
+    }
+  }
+
+  void MappedMem::mapFile(int fd, size_t offset, data32 addr, size_t words){
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t at = addr * sizeof(data32);
+    size_t length = words * sizeof(data32);
+    if(at % page != 0 || offset % page != 0 || at + length > bytes ||
+        mmap((char*) mem + at, length, PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_FIXED, fd, offset) == MAP_FAILED){
+      BOOST_LOG_TRIVIAL(fatal) << "<<" << getName() << ">> can't map " <<
+        words << " words at " << addr << " from offset " << offset << endl;
+      throw std::exception();
+    }
+  }
+
+  data32 MappedMem::ld(unsigned int addr){
+    PROFILE_SCOPE(MEM_LD);
+    isValidAddr(addr);
+    return mem[addr];
+  }
+
+  void MappedMem::sw(unsigned int addr, data32 word){
+    PROFILE_SCOPE(MEM_SW);
+    isValidAddr(addr);
+    mem[addr] = word;
+  }
+
+  void MappedMem::storeBlock(data32 addr, data32* words, size_t size){
+    if(size > 0){
+      isValidAddr(addr);
+      isValidAddr(addr + size - 1);
+    }
+    copy(words, words + size, mem + addr);
+  }
+
+  size_t MappedMem::getSize(){
+    return size;
+  }
+
+  MappedMem::~MappedMem(){
+    munmap(mem, bytes);
+  }
+
+  CowMem::CowMem(size_t size, std::string name) : MemoryUnit(name),
+    size{size}, pages((size + PAGE_WORDS - 1) / PAGE_WORDS),
+    owned(pages.size(), false), nOwned{0} {}
+
+  void CowMem::isValidAddr(data32 addr){
+    if(addr >= size){
+      BOOST_LOG_TRIVIAL(fatal) << "<<" << getName() <<
+        ">> tried to access invalid memory address was " << addr <<
+        " but size of " << getName() << " is " << size << std::endl;
+      throw std::exception();
+    }
+  }
+
+  unique_ptr<CowMem> CowMem::clone(){
+    auto c = make_unique<CowMem>(size, getName());
+    c->pages = pages;
+    //shared now, so neither may write in place
+    owned.assign(owned.size(), false);
+    nOwned = 0;
+    return c;
+  }
+
+  data32 CowMem::ld(unsigned int addr){
+    PROFILE_SCOPE(MEM_LD);
+    isValidAddr(addr);
+    const Page& page = pages[addr >> PAGE_BITS];
+    return page == nullptr ? 0 : page[addr & (PAGE_WORDS - 1)];
+  }
+
+  void CowMem::sw(unsigned int addr, data32 word){
+    PROFILE_SCOPE(MEM_SW);
+    isValidAddr(addr);
+    data32 n = addr >> PAGE_BITS;
+    if(!owned[n]){
+      Page copied(new data32[PAGE_WORDS]);
+      if(pages[n] == nullptr)
+        fill(copied.get(), copied.get() + PAGE_WORDS, 0);
+      else
+        copy(pages[n].get(), pages[n].get() + PAGE_WORDS, copied.get());
+      pages[n] = copied;
+      owned[n] = true;
+      nOwned++;
+    }
+    pages[n][addr & (PAGE_WORDS - 1)] = word;
+  }
+
+  void CowMem::storeBlock(data32 addr, data32* words, size_t size){
+    for(size_t i = 0; i < size; i++)
+      sw(addr + i, words[i]);
+  }
+
+  size_t CowMem::getSize(){
+    return size;
+  }
+
+  size_t CowMem::getNOwnedPages() const{
+    return nOwned;
+  }
+
 }
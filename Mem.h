@@ -1,6 +1,8 @@
 #ifndef MEM_INCLUDED
 #define MEM_INCLUDED
+#include <memory>
 #include <unordered_map>
+#include <vector>
 #include <boost/log/trivial.hpp>
 #define BOOST_LOG_DYN_LINK
 
@@ -22,6 +24,10 @@ namespace mem{
    * Base interface for all memory objects
    * Abstract class
    * For simplicity, memory units will operate in terms of words of 4 byte
+   *
+   * Bytes and halfwords are reached by byte address: byte address b is byte
+   * b % 4 of word b / 4, counted big endian as on the guest, so byte 0 is
+   * the word's most significant. Halfwords must be aligned
    */
   class MemoryUnit{
     private:
@@ -53,6 +59,18 @@ namespace mem{
        */
       virtual void storeBlock(data32 addr, data32* words, size_t size) = 0;
 
+      /*
+       * sized loads and stores by byte address. These go through ld and sw,
+       * memories that can do better override them
+       * params:
+       *   byteAddr: the byte address, even for halfwords
+       * throws: exception if a halfword is not aligned, or as ld and sw
+       */
+      virtual data8 ldByte(data32 byteAddr);
+      virtual data16 ldHalf(data32 byteAddr);
+      virtual void stByte(data32 byteAddr, data8 value);
+      virtual void stHalf(data32 byteAddr, data16 value);
+
       const std::string& getName();
 
       virtual ~MemoryUnit() = default;
@@ -116,6 +134,16 @@ namespace mem{
      */
     void storeBlock(data32 addr, data32* words, size_t size);
 
+    /*
+     * sized accesses straight into the word array, one host load or store
+     * each: the words are kept in host order, so a guest byte is found by
+     * flipping the lane on little endian hosts rather than by swapping
+     */
+    data8 ldByte(data32 byteAddr);
+    data16 ldHalf(data32 byteAddr);
+    void stByte(data32 byteAddr, data8 value);
+    void stHalf(data32 byteAddr, data16 value);
+
     size_t getSize();
 
     /*
@@ -171,6 +199,14 @@ namespace mem{
        */
       void storeBlock(data32 addr, data32* words, size_t size);
 
+      /*
+       * sized accesses, passed on to the wrapped memory
+       */
+      data8 ldByte(data32 byteAddr);
+      data16 ldHalf(data32 byteAddr);
+      void stByte(data32 byteAddr, data8 value);
+      void stHalf(data32 byteAddr, data16 value);
+
       const std::string& getName();
 
       ~VirtualMem();
@@ -178,6 +214,188 @@ namespace mem{
       size_t getSize();
     
   };
+
+  /*
+   * Passes everything through to another MemoryUnit, remembering which
+   * pages were written since it was last asked. Checkpoints (Checkpoint.h)
+   * use this to copy only what changed.
+   *
+   * The wrapped MemoryUnit is not owned
+   */
+  class DirtyTrackingMem : public MemoryUnit{
+    private:
+      MemoryUnit& mem;
+      /* per page, whether it is in dirtyPages */
+      vector<bool> dirty;
+      vector<data32> dirtyPages;
+
+      void mark(data32 addr);
+
+    public:
+      static const data32 PAGE_BITS = 10;
+      static const data32 PAGE_WORDS = 1 << PAGE_BITS;
+
+      DirtyTrackingMem(MemoryUnit& mem);
+
+      data32 ld(unsigned int addr);
+
+      void sw(unsigned int addr, data32 word);
+
+      void storeBlock(data32 addr, data32* words, size_t size);
+
+      size_t getSize();
+
+      /*
+       * returns: the pages written since the last call, in the order they
+       *   were first written, and forgets them
+       */
+      vector<data32> takeDirty();
+  };
+
+  /*
+   * A window onto words base to base + size of another MemoryUnit, seen
+   * from address 0: a base and bound relocation register, which lets
+   * programs built to run from 0 share one memory. The window can be moved,
+   * to switch from one program to another.
+   *
+   * The wrapped MemoryUnit is not owned
+   */
+  class RelocatedMem : public MemoryUnit{
+    private:
+      MemoryUnit& mem;
+      data32 base;
+      data32 size;
+
+      /*
+       * returns: where addr is in the wrapped memory
+       * throws: exception if addr is outside the window
+       */
+      data32 relocate(data32 addr);
+
+    public:
+      /*
+       * throws: exception as setWindow
+       */
+      RelocatedMem(MemoryUnit& mem, data32 base, data32 size);
+
+      /*
+       * moves the window
+       * throws: exception if it doesn't fit in the wrapped memory
+       */
+      void setWindow(data32 base, data32 size);
+
+      data32 getBase() const;
+
+      data32 ld(unsigned int addr);
+      void sw(unsigned int addr, data32 word);
+      void storeBlock(data32 addr, data32* words, size_t size);
+      data8 ldByte(data32 byteAddr);
+      data16 ldHalf(data32 byteAddr);
+      void stByte(data32 byteAddr, data8 value);
+      void stHalf(data32 byteAddr, data16 value);
+      size_t getSize();
+  };
+
+  /*
+   * Main memory in an anonymous mapping, into which parts of a file can be
+   * mapped copy on write: they are read in as they are touched, and writes
+   * stay private to this memory. Checkpoint restores (Checkpoint.h) use it
+   * so only the pages a run touches are ever read.
+   */
+  class MappedMem : public MemoryUnit{
+    private:
+      data32* mem;
+      size_t size;
+      /* the mapping, whole host pages */
+      size_t bytes;
+
+      /*
+       * throws: exception if address is invalid
+       */
+      void isValidAddr(data32 addr);
+
+    public:
+      /*
+       * params:
+       *   size: in words, all zero
+       * throws: exception if it can't be mapped
+       */
+      MappedMem(size_t size, std::string name);
+
+      /*
+       * maps words of fd from offset over the memory at addr, copy on write
+       * params:
+       *   offset, addr * 4: multiples of the host page size
+       * throws: exception if that fails
+       */
+      void mapFile(int fd, size_t offset, data32 addr, size_t words);
+
+      data32 ld(unsigned int addr);
+
+      void sw(unsigned int addr, data32 word);
+
+      void storeBlock(data32 addr, data32* words, size_t size);
+
+      size_t getSize();
+
+      ~MappedMem();
+  };
+
+  /*
+   * Main memory in pages shared copy on write between clones. clone is
+   * cheap, it only copies the page table; after it, the first write to a
+   * page by either memory copies that page for itself. Each memory tracks
+   * which pages it wrote since it was made or last cloned, so memory only
+   * grows with how far clones diverge. Pages never written are not
+   * allocated and read as zero.
+   *
+   * Clones can run on different threads: a memory only ever writes pages
+   * it copied itself. clone must not race with the memory it clones
+   */
+  class CowMem : public MemoryUnit{
+    private:
+      typedef shared_ptr<data32[]> Page;
+
+      size_t size;
+      vector<Page> pages;
+      /* per page, whether this memory copied it and so may write it */
+      vector<bool> owned;
+      size_t nOwned;
+
+      /*
+       * throws: exception if address is invalid
+       */
+      void isValidAddr(data32 addr);
+
+    public:
+      static const data32 PAGE_BITS = 10;
+      static const data32 PAGE_WORDS = 1 << PAGE_BITS;
+
+      /*
+       * params:
+       *   size: in words, all zero
+       */
+      CowMem(size_t size, std::string name);
+
+      /*
+       * returns: a memory with the same contents, sharing every page
+       */
+      unique_ptr<CowMem> clone();
+
+      data32 ld(unsigned int addr);
+
+      void sw(unsigned int addr, data32 word);
+
+      void storeBlock(data32 addr, data32* words, size_t size);
+
+      size_t getSize();
+
+      /*
+       * returns: the pages this memory wrote since it was made or last
+       *   cloned, which it holds a copy of its own
+       */
+      size_t getNOwnedPages() const;
+  };
 }
 
 #endif
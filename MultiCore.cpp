@@ -0,0 +1,280 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "MultiCore.h"
+
+using namespace std;
+
+namespace multicore{
+
+  namespace {
+    const int A0 = 4;
+    const int A1 = 5;
+
+    /*
+     * the threads wait here for each other, and the last to arrive runs
+     * completion before letting them all go
+     */
+    class Barrier{
+      private:
+        mutex lock;
+        condition_variable released;
+        size_t nThreads;
+        size_t nWaiting;
+        unsigned long generation;
+        function<void()> completion;
+
+      public:
+        Barrier(size_t nThreads, function<void()> completion) :
+          nThreads{nThreads}, nWaiting{0}, generation{0},
+          completion{completion} {}
+
+        void wait(){
+          unique_lock<mutex> held(lock);
+          unsigned long arrivedIn = generation;
+          if(++nWaiting == nThreads){
+            completion();
+            nWaiting = 0;
+            generation++;
+            released.notify_all();
+            return;
+          }
+          released.wait(held, [&](){ return generation != arrivedIn; });
+        }
+    };
+  }
+
+  CoreMem::CoreMem(MemoryUnit& shared, string name) : MemoryUnit{name},
+    shared{shared} {}
+
+  data32 CoreMem::ld(unsigned int addr){
+    if(!pending.empty()){
+      auto found = pending.find(addr);
+      if(found != pending.end()){
+        const PendingWord& p = found->second;
+        if(p.mask == ~0u)
+          return p.word;
+        return (shared.ld(addr) & ~p.mask) | (p.word & p.mask);
+      }
+    }
+    return shared.ld(addr);
+  }
+
+  void CoreMem::store(data32 addr, data32 word, data32 mask){
+    PendingWord& p = pending.insert({addr, {0, 0}}).first->second;
+    p.word = (p.word & ~mask) | (word & mask);
+    p.mask |= mask;
+  }
+
+  void CoreMem::sw(unsigned int addr, data32 word){
+    store(addr, word, ~0u);
+  }
+
+  void CoreMem::stByte(data32 byteAddr, data8 value){
+    data32 shift = (3 - (byteAddr & 3)) * 8;
+    store(byteAddr >> 2, (data32) value << shift, 0xffu << shift);
+  }
+
+  void CoreMem::stHalf(data32 byteAddr, data16 value){
+    if(byteAddr & 1){
+      BOOST_LOG_TRIVIAL(fatal) << "<<" << getName() << ">> halfword access "
+        "at unaligned byte address " << byteAddr << endl;
+      throw std::exception();
+    }
+    data32 shift = (2 - (byteAddr & 2)) * 8;
+    store(byteAddr >> 2, (data32) value << shift, 0xffffu << shift);
+  }
+
+  void CoreMem::storeBlock(data32 addr, data32* words, size_t size){
+    for(size_t i = 0; i < size; i++)
+      sw(addr + i, words[i]);
+  }
+
+  size_t CoreMem::getSize(){
+    return shared.getSize();
+  }
+
+  unsigned long CoreMem::publish(unordered_map<data32, size_t>& written,
+      size_t core){
+    unsigned long nRacing = 0;
+    for(const pair<const data32, PendingWord>& store : pending){
+      const PendingWord& p = store.second;
+      //the bytes other cores stored this quantum stay
+      data32 word = p.mask == ~0u ? p.word :
+        (shared.ld(store.first) & ~p.mask) | (p.word & p.mask);
+      shared.sw(store.first, word);
+      auto inserted = written.insert({store.first, core});
+      if(!inserted.second && inserted.first->second != core){
+        nRacing++;
+        inserted.first->second = core;
+      }
+    }
+    pending.clear();
+    return nRacing;
+  }
+
+  size_t CoreMem::getNPending() const{
+    return pending.size();
+  }
+
+  MultiCoreSim::Core::Core(MemoryUnit& shared, size_t i) :
+    mem{shared, "core" + to_string(i)}, rf{32, "rf" + to_string(i)},
+    l1{nullptr}, done{false}, failed{false} {}
+
+  MultiCoreSim::MultiCoreSim(MemoryUnit& shared, MemoryUnit& rf,
+      data32 entry, const SimConfig& config) : shared{shared},
+    config{config}, arbiter{config.cohL1Sets > 0 ? config.cohLineWords : 1} {
+    if(config.cohL1Sets > 0)
+      caches = make_unique<coherence::SharedL2>(config.mcCores, config);
+    for(size_t i = 0; i < config.mcCores; i++){
+      cores.push_back(make_unique<Core>(shared, i));
+      Core& c = *cores.back();
+      for(data32 r = 0; r < 32; r++)
+        c.rf.sw(r, rf.ld(r));
+      c.rf.sw(A0, i);
+      c.rf.sw(A1, config.mcCores);
+      c.p = make_unique<Processor5S>("core" + to_string(i), c.mem, c.rf,
+          entry, "", config);
+      c.p->getLinkRegister() = atomics::LinkRegister(i);
+      arbiter.attach(c.p->getLinkRegister());
+      if(caches != nullptr){
+        c.l1 = &caches->getL1(i);
+        c.p->setDataCache(c.l1);
+        c.l1->setLinkRegister(&c.p->getLinkRegister());
+      }
+    }
+  }
+
+  void MultiCoreSim::setEntry(size_t core, data32 entry){
+    cores.at(core)->p->setPc(entry);
+  }
+
+  void MultiCoreSim::setSyscalls(sys::SyscallEmulator* emulator){
+    for(unique_ptr<Core>& c : cores)
+      c->p->setSyscalls(emulator);
+  }
+
+  void MultiCoreSim::publish(){
+    unordered_map<data32, size_t> written;
+    for(size_t i = 0; i < cores.size(); i++){
+      Core& c = *cores[i];
+      c.stats.nStoresPublished += c.mem.getNPending();
+      stats.nRacingStores += c.mem.publish(written, i);
+    }
+    if(caches != nullptr)
+      caches->resolve();
+    arbiter.resolve(written, shared);
+  }
+
+  void MultiCoreSim::run(){
+    auto start = chrono::steady_clock::now();
+    bool finished = false;
+    Barrier barrier(cores.size(), [&](){
+      publish();
+      stats.nQuanta++;
+      finished = all_of(cores.begin(), cores.end(),
+          [](const unique_ptr<Core>& c){ return c->done; });
+    });
+    auto work = [&](size_t i){
+      Core& c = *cores[i];
+      const atomics::LinkRegister& link = c.p->getLinkRegister();
+      unsigned long end = 0;
+      while(true){
+        end += config.mcQuantum;
+        try{
+          while(c.p->getCurrentCycle() < end && !c.done &&
+              !link.isWaiting()){
+            if(c.l1 != nullptr)
+              c.l1->setCycle(c.p->getCurrentCycle());
+            c.done = c.p->step();
+          }
+        } catch(const std::exception&){
+          //logged where it was thrown, the others run on to the end
+          c.failed = true;
+          c.done = true;
+        }
+        auto arrived = chrono::steady_clock::now();
+        barrier.wait();
+        c.stats.barrierSeconds += chrono::duration<double>(
+            chrono::steady_clock::now() - arrived).count();
+        //written before the barrier let this thread go
+        if(finished)
+          return;
+      }
+    };
+    vector<thread> threads;
+    for(size_t i = 1; i < cores.size(); i++)
+      threads.emplace_back(work, i);
+    work(0);
+    for(thread& t : threads)
+      t.join();
+
+    stats.hostSeconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    stats.cycles = stats.nRetired = stats.nOps = 0;
+    bool failed = false;
+    for(unique_ptr<Core>& c : cores){
+      c->stats.cycles = c->p->getCurrentCycle();
+      c->stats.nRetired = c->p->getNRetired();
+      c->stats.nOps = c->p->getNOps();
+      stats.cycles = max(stats.cycles, c->stats.cycles);
+      stats.nRetired += c->stats.nRetired;
+      stats.nOps += c->stats.nOps;
+      failed = failed || c->failed;
+    }
+    if(failed){
+      BOOST_LOG_TRIVIAL(fatal) << "<<MultiCoreSim>> a core failed" << endl;
+      throw std::exception();
+    }
+  }
+
+  size_t MultiCoreSim::getNCores() const{
+    return cores.size();
+  }
+
+  const CoreStats& MultiCoreSim::getCoreStats(size_t core) const{
+    return cores.at(core)->stats;
+  }
+
+  const MultiCoreStats& MultiCoreSim::getStats() const{
+    return stats;
+  }
+
+  MemoryUnit& MultiCoreSim::getRegisterFile(size_t core){
+    return cores.at(core)->rf;
+  }
+
+  const coherence::SharedL2* MultiCoreSim::getCaches() const{
+    return caches.get();
+  }
+
+  const atomics::Arbiter& MultiCoreSim::getArbiter() const{
+    return arbiter;
+  }
+
+  void MultiCoreSim::report(ostream& out) const{
+    for(size_t i = 0; i < cores.size(); i++){
+      const CoreStats& s = cores[i]->stats;
+      out << "core " << i << ": " << s.nRetired << " instructions (" <<
+        s.nOps << " not nops) in " << s.cycles << " cycles, IPC " <<
+        (s.cycles ? (double) s.nRetired / s.cycles : 0) << ", " <<
+        s.nStoresPublished << " stores, " << s.barrierSeconds <<
+        " s at barriers" << endl;
+    }
+    out << cores.size() << " cores: " << stats.nRetired <<
+      " instructions in " << stats.cycles << " cycles, IPC " <<
+      (stats.cycles ? (double) stats.nRetired / stats.cycles : 0) << ", " <<
+      stats.nQuanta << " quanta of " << config.mcQuantum << ", " <<
+      stats.nRacingStores << " racing stores, " << stats.hostSeconds <<
+      " s" << endl;
+    if(caches != nullptr)
+      caches->report(out);
+    arbiter.report(out);
+  }
+}
@@ -0,0 +1,208 @@
+#ifndef MULTICORE_H_INCLUDED
+#define MULTICORE_H_INCLUDED
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Mem.h"
+#include "Config.h"
+#include "Processor.h"
+#include "Syscall.h"
+#include "Coherence.h"
+#include "Atomics.h"
+
+using namespace std;
+using namespace mem;
+using namespace config;
+/*
+ * Several Processor5S cores on one guest memory, each stepped by a host
+ * thread of its own. The cores run apart from each other to the end of a
+ * quantum, every mc.quantum cycles, then meet at a barrier, and so on until
+ * every one has ended. A core whose sc or sync has to wait for the barrier
+ * stops there, and takes up the rest of its cycles in the next quantum.
+ *
+ * Each core sees memory through a CoreMem: its loads read the shared
+ * memory, its stores stay in the CoreMem until the barrier, where every
+ * core's are published, core 0's first. So a store is seen by the other
+ * cores from the next quantum on, and the shared memory is only read while
+ * the cores run, which makes a run the same whatever the host threads do.
+ * The quantum trades how late stores are seen for how often the threads
+ * stop: at 1 the cores see each other's stores the next cycle, at 10000
+ * they barely synchronize. Stores two cores make to one word in one
+ * quantum are counted as racing, the later core's store winning. Only the
+ * bytes a store wrote are published, so sb and sh to other bytes of a word
+ * than another core's are kept, though still counted.
+ *
+ * Guest threads start at a fixed entry, the program's unless setEntry says
+ * otherwise, with the loaded registers, $a0 ($4) the core's number and $a1
+ * ($5) the number of cores. A core ends at its syscall, or with syscalls
+ * emulated, at its exit. The emulator is shared, so an exit also ends
+ * every other core at its next syscall.
+ *
+ * With coh.l1Sets > 0 each core's loads and stores are timed by a private
+ * L1 under a shared L2, kept coherent in the same quanta (see Coherence.h).
+ * ll, sc and sync are resolved at the barriers too (see Atomics.h).
+ */
+namespace multicore{
+
+  /*
+   * one core's view of the shared memory
+   */
+  class CoreMem : public MemoryUnit{
+    private:
+      /* a word stored to, and which of its bits were */
+      struct PendingWord{
+        data32 word;
+        data32 mask;
+      };
+
+      MemoryUnit& shared;
+      /* stores since the last publish, by address */
+      unordered_map<data32, PendingWord> pending;
+
+      /* stores the bits of word in mask at addr */
+      void store(data32 addr, data32 word, data32 mask);
+
+    public:
+      /*
+       * params:
+       *   shared: safe to read from several threads at once, as DRAM is.
+       *     VirtualMem is not, it maps addresses on reads
+       */
+      CoreMem(MemoryUnit& shared, string name);
+
+      data32 ld(unsigned int addr);
+      void sw(unsigned int addr, data32 word);
+      void storeBlock(data32 addr, data32* words, size_t size);
+      size_t getSize();
+
+      /*
+       * keep only the bytes stored pending, so that cores storing other
+       * bytes of the same word in a quantum don't undo each other's
+       */
+      void stByte(data32 byteAddr, data8 value);
+      void stHalf(data32 byteAddr, data16 value);
+
+      /*
+       * writes the pending stores to the shared memory, only the bytes
+       * stored of each word
+       * params:
+       *   written: the words stored this quantum so far and the core that
+       *     stored each, which this core's stores go into
+       *   core: this core's number
+       * returns: how many of its stores were to words another core stored
+       */
+      unsigned long publish(unordered_map<data32, size_t>& written,
+          size_t core);
+
+      size_t getNPending() const;
+  };
+
+  struct CoreStats{
+    unsigned long cycles = 0;
+    unsigned long nRetired = 0;
+    unsigned long nOps = 0;
+    /* words this core stored, counted at the barriers */
+    unsigned long nStoresPublished = 0;
+    /* host seconds this core's thread waited at barriers */
+    double barrierSeconds = 0;
+  };
+
+  struct MultiCoreStats{
+    /* barriers met */
+    unsigned long nQuanta = 0;
+    /* words stored by more than one core in a quantum */
+    unsigned long nRacingStores = 0;
+    /* the last core's cycles */
+    unsigned long cycles = 0;
+    unsigned long nRetired = 0;
+    unsigned long nOps = 0;
+    double hostSeconds = 0;
+  };
+
+  class MultiCoreSim{
+    private:
+      struct Core{
+        CoreMem mem;
+        DRAM rf;
+        unique_ptr<Processor5S> p;
+        /* nullptr without caches */
+        coherence::L1Cache* l1;
+        bool done;
+        bool failed;
+        CoreStats stats;
+
+        Core(MemoryUnit& shared, size_t i);
+      };
+
+      MemoryUnit& shared;
+      SimConfig config;
+      vector<unique_ptr<Core>> cores;
+      unique_ptr<coherence::SharedL2> caches;
+      atomics::Arbiter arbiter;
+      MultiCoreStats stats;
+
+      /*
+       * every core's stores into the shared memory, in core order, their
+       * caches' events into the others, then the sc's
+       */
+      void publish();
+
+    public:
+      /*
+       * params:
+       *   shared: the guest memory, with the program in it, safe to read
+       *     from several threads (see CoreMem)
+       *   rf: the registers every core starts with
+       *   entry: where every core starts
+       *   config: each core's timing, mc.cores and mc.quantum, and the
+       *     caches
+       * throws: exception as SharedL2
+       */
+      MultiCoreSim(MemoryUnit& shared, MemoryUnit& rf, data32 entry,
+          const SimConfig& config);
+
+      /*
+       * starts core at entry instead. Meant for before run
+       */
+      void setEntry(size_t core, data32 entry);
+
+      /*
+       * runs syscalls on emulator for every core, from any thread, nullptr
+       * to end each core at its first. The emulator is not owned
+       */
+      void setSyscalls(sys::SyscallEmulator* emulator);
+
+      /*
+       * runs every core until it ends
+       * throws: exception once every core has stopped, if one threw
+       */
+      void run();
+
+      size_t getNCores() const;
+      const CoreStats& getCoreStats(size_t core) const;
+      const MultiCoreStats& getStats() const;
+
+      /*
+       * returns: core's register file
+       */
+      MemoryUnit& getRegisterFile(size_t core);
+
+      /*
+       * returns: the caches, nullptr if the config has none
+       */
+      const coherence::SharedL2* getCaches() const;
+
+      /*
+       * returns: the cores' links, with their ll, sc and sync counts
+       */
+      const atomics::Arbiter& getArbiter() const;
+
+      /*
+       * writes each core's and the aggregate counts to out, and the
+       * caches' and locks'
+       */
+      void report(ostream& out) const;
+  };
+}
+#endif
@@ -0,0 +1,195 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <exception>
+#include "MultiProgram.h"
+
+using namespace std;
+
+namespace multiprogram{
+
+  namespace {
+    /* adds what the L1 counted since then to to */
+    void addSince(coherence::L1Stats& to, const coherence::L1Stats& now,
+        const coherence::L1Stats& then){
+      to.accesses += now.accesses - then.accesses;
+      to.hits += now.hits - then.hits;
+      to.misses += now.misses - then.misses;
+      to.upgrades += now.upgrades - then.upgrades;
+      to.l2Hits += now.l2Hits - then.l2Hits;
+      to.memAccesses += now.memAccesses - then.memAccesses;
+      to.interventions += now.interventions - then.interventions;
+      to.coherenceMisses += now.coherenceMisses - then.coherenceMisses;
+      to.falseSharingMisses += now.falseSharingMisses -
+        then.falseSharingMisses;
+      to.invalidations += now.invalidations - then.invalidations;
+      to.backInvalidations += now.backInvalidations -
+        then.backInvalidations;
+      to.writebacks += now.writebacks - then.writebacks;
+    }
+  }
+
+  MultiProgramSim::MultiProgramSim(MemoryUnit& mainMem, MemoryUnit& rf,
+      const vector<LoadedProgram>& programs, const SimConfig& config) :
+    config{config}, window{mainMem, 0, 0}, rf{32, "rf"}, l1{nullptr} {
+    if(programs.empty()){
+      BOOST_LOG_TRIVIAL(fatal) << "<<MultiProgramSim>> no programs to run" <<
+        endl;
+      throw std::exception();
+    }
+    for(const LoadedProgram& program : programs){
+      Process process;
+      process.program = program;
+      for(data32 r = 0; r < 32; r++)
+        process.context.regs[r] = rf.ld(r);
+      process.context.regs[0] = 0;
+      process.context.regs[31] = program.returnAddr;
+      process.context.acc = 0;
+      process.context.pc = program.entry;
+      process.syscalls = nullptr;
+      process.done = false;
+      processes.push_back(process);
+    }
+    p = make_unique<Processor5S>("MIPSProcessor", window, this->rf,
+        programs[0].entry, "", config);
+    if(config.cohL1Sets > 0){
+      caches = make_unique<coherence::SharedL2>(1, config);
+      l1 = &caches->getL1(0);
+      p->setDataCache(l1);
+    }
+  }
+
+  void MultiProgramSim::setSyscalls(size_t process,
+      sys::SyscallEmulator* emulator){
+    processes.at(process).syscalls = emulator;
+  }
+
+  bool MultiProgramSim::step(){
+    if(l1 != nullptr)
+      l1->setCycle(p->getCurrentCycle());
+    bool quit = p->step();
+    //with one core there is no one to wait for
+    if(caches != nullptr)
+      caches->resolve();
+    return quit;
+  }
+
+  void MultiProgramSim::save(Context& context){
+    for(data32 r = 0; r < 32; r++)
+      context.regs[r] = rf.ld(r);
+    context.acc = p->getAccumulator();
+    context.pc = p->getPc();
+  }
+
+  void MultiProgramSim::switchTo(Process& process){
+    window.setWindow(process.program.base, process.program.size);
+    if(l1 != nullptr)
+      l1->setBase(process.program.base);
+    for(data32 r = 0; r < 32; r++)
+      rf.sw(r, process.context.regs[r]);
+    p->setAccumulator(process.context.acc);
+    p->setSyscalls(process.syscalls);
+    p->setPc(process.context.pc);
+    p->setFetching(true);
+    process.stats.nSlices++;
+  }
+
+  void MultiProgramSim::run(){
+    size_t current = 0;
+    switchTo(processes[current]);
+    while(true){
+      Process& running = processes[current];
+      unsigned long start = p->getCurrentCycle();
+      unsigned long nRetired = p->getNRetired();
+      unsigned long nOps = p->getNOps();
+      coherence::L1Stats cache = l1 != nullptr ? l1->getStats() :
+        coherence::L1Stats();
+      bool quit = false;
+      size_t next = current;
+      while(true){
+        unsigned long end = p->getCurrentCycle() + config.mpQuantum;
+        while(!quit && p->getCurrentCycle() < end)
+          quit = step();
+        //the next one ready, round robin
+        for(size_t k = 1; k < processes.size() && next == current; k++){
+          size_t i = (current + k) % processes.size();
+          if(!processes[i].done)
+            next = i;
+        }
+        //with no one else ready it runs on
+        if(quit || next != current)
+          break;
+      }
+
+      p->setFetching(false);
+      while(!p->isDrained())
+        quit = step() || quit;
+      running.stats.cycles += p->getCurrentCycle() - start;
+      running.stats.nRetired += p->getNRetired() - nRetired;
+      running.stats.nOps += p->getNOps() - nOps;
+      if(l1 != nullptr)
+        addSince(running.stats.cache, l1->getStats(), cache);
+      save(running.context);
+      if(quit){
+        running.done = true;
+        running.stats.finishedAt = p->getCurrentCycle();
+      }
+      if(next == current)
+        break;
+
+      for(unsigned int c = 0; c < config.mpSwitchCost; c++)
+        step();
+      stats.nSwitches++;
+      stats.switchCycles += config.mpSwitchCost;
+      current = next;
+      switchTo(processes[current]);
+    }
+    stats.cycles = p->getCurrentCycle();
+    stats.nRetired = p->getNRetired();
+  }
+
+  size_t MultiProgramSim::getNProcesses() const{
+    return processes.size();
+  }
+
+  const ProcessStats& MultiProgramSim::getProcessStats(size_t process)
+    const{
+    return processes.at(process).stats;
+  }
+
+  const MultiProgramStats& MultiProgramSim::getStats() const{
+    return stats;
+  }
+
+  const array<data32, 32>& MultiProgramSim::getRegisters(size_t process)
+    const{
+    return processes.at(process).context.regs;
+  }
+
+  const coherence::SharedL2* MultiProgramSim::getCaches() const{
+    return caches.get();
+  }
+
+  void MultiProgramSim::report(ostream& out) const{
+    for(size_t i = 0; i < processes.size(); i++){
+      const Process& process = processes[i];
+      const ProcessStats& s = process.stats;
+      out << "program " << i << " (" << process.program.filename << "): " <<
+        s.nRetired << " instructions (" << s.nOps << " not nops) in " <<
+        s.cycles << " cycles, IPC " <<
+        (s.cycles ? (double) s.nRetired / s.cycles : 0) << ", " <<
+        s.nSlices << " slices, ended at cycle " << s.finishedAt << endl;
+      if(caches != nullptr){
+        out << "  L1: " << s.cache.accesses << " accesses, " <<
+          s.cache.misses << " misses (" << (s.cache.accesses ?
+              100.0 * s.cache.misses / s.cache.accesses : 0) << "%, " <<
+          s.cache.l2Hits << " from the L2, " << s.cache.memAccesses <<
+          " from memory)" << endl;
+      }
+    }
+    out << processes.size() << " programs: " << stats.nRetired <<
+      " instructions in " << stats.cycles << " cycles, IPC " <<
+      (stats.cycles ? (double) stats.nRetired / stats.cycles : 0) << ", " <<
+      stats.nSwitches << " switches in quanta of " << config.mpQuantum <<
+      ", " << stats.switchCycles << " cycles switching" << endl;
+  }
+}
@@ -0,0 +1,137 @@
+#ifndef MULTIPROGRAM_H_INCLUDED
+#define MULTIPROGRAM_H_INCLUDED
+#include <array>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "Mem.h"
+#include "Config.h"
+#include "Processor.h"
+#include "Syscall.h"
+#include "Coherence.h"
+
+using namespace std;
+using namespace mem;
+using namespace config;
+/*
+ * Several programs time sliced on one Processor5S, as an OS would, to see
+ * what they do to each other's timing. The programs are loaded into
+ * regions of main memory apart (ProgramLoader::loadProgram with a base),
+ * and each runs in its own through a base and bound window (RelocatedMem)
+ * that a switch moves.
+ *
+ * Programs run in turn, round robin, for mp.quantum cycles each. At the end
+ * of one's quantum, if another is ready, the core stops fetching and lets
+ * the pipe drain, saves the registers, hi/lo and the pc to resume at, then
+ * spends mp.switchCost cycles fetching nothing before restoring the next
+ * one's and fetching from its pc. A program that ends (at its syscall, or
+ * with syscalls emulated at its exit) is drained and switched away from
+ * the same way. The drain is its program's, the switch cost no one's.
+ *
+ * With coh.l1Sets > 0 the loads and stores are timed by an L1 and L2 as in
+ * Coherence.h, with one core, going by where the words are in main memory.
+ * The caches are not flushed on a switch, so programs run on what the
+ * others left in them, and each program's share of the misses shows how
+ * much they thrash each other.
+ */
+namespace multiprogram{
+
+  struct ProcessStats{
+    /* from each switch in to the pipe drained, switch costs not included */
+    unsigned long cycles = 0;
+    unsigned long nRetired = 0;
+    unsigned long nOps = 0;
+    /* times it was switched to, the first start included */
+    unsigned long nSlices = 0;
+    /* the core's cycle it ended in */
+    unsigned long finishedAt = 0;
+    /* the L1's counts while it ran, with caches */
+    coherence::L1Stats cache;
+  };
+
+  struct MultiProgramStats{
+    unsigned long cycles = 0;
+    unsigned long nRetired = 0;
+    unsigned long nSwitches = 0;
+    /* the switch costs paid */
+    unsigned long switchCycles = 0;
+  };
+
+  class MultiProgramSim{
+    private:
+      /* what a switch saves and restores */
+      struct Context{
+        array<data32, 32> regs;
+        data64 acc;
+        data32 pc;
+      };
+      struct Process{
+        LoadedProgram program;
+        Context context;
+        /* nullptr to end at the first syscall */
+        sys::SyscallEmulator* syscalls;
+        bool done;
+        ProcessStats stats;
+      };
+
+      SimConfig config;
+      /* the running program's region */
+      RelocatedMem window;
+      DRAM rf;
+      unique_ptr<coherence::SharedL2> caches;
+      coherence::L1Cache* l1;
+      unique_ptr<Processor5S> p;
+      vector<Process> processes;
+      MultiProgramStats stats;
+
+      /* a cycle of the core, and of the caches */
+      bool step();
+      void save(Context& context);
+      /* makes process the one running, from its saved context */
+      void switchTo(Process& process);
+
+    public:
+      /*
+       * params:
+       *   mainMem: the memory the programs were loaded into
+       *   rf: the registers every program starts with, $31 aside
+       *   programs: as ProgramLoader::getPrograms, at least one
+       *   config: the core's timing, mp.quantum, mp.switchCost and the
+       *     caches
+       * throws: exception if there are no programs, or as SharedL2
+       */
+      MultiProgramSim(MemoryUnit& mainMem, MemoryUnit& rf,
+          const vector<LoadedProgram>& programs, const SimConfig& config);
+
+      /*
+       * runs process's syscalls on emulator, nullptr to end it at its first.
+       * The emulator is not owned
+       */
+      void setSyscalls(size_t process, sys::SyscallEmulator* emulator);
+
+      /*
+       * runs every program to its end
+       */
+      void run();
+
+      size_t getNProcesses() const;
+      const ProcessStats& getProcessStats(size_t process) const;
+      const MultiProgramStats& getStats() const;
+
+      /*
+       * returns: the registers process ended with
+       */
+      const array<data32, 32>& getRegisters(size_t process) const;
+
+      /*
+       * returns: the caches, nullptr if the config has none
+       */
+      const coherence::SharedL2* getCaches() const;
+
+      /*
+       * writes each program's counts and the totals to out
+       */
+      void report(ostream& out) const;
+  };
+}
+#endif
@@ -0,0 +1,446 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <climits>
+#include <exception>
+#include "OoO.h"
+
+using namespace std;
+
+namespace ooo{
+
+  namespace {
+    /* instructions fetched behind a branch before it redirects */
+    const unsigned long DELAY_SLOTS = 5;
+    /* architectural registers renamed, hi/lo being the last */
+    const int N_ARCH = 33;
+    const int HILO = 32;
+    /* the queues when there are three */
+    const int INT_QUEUE = 0;
+    const int MULDIV_QUEUE = 1;
+    const int MEM_QUEUE = 2;
+    const unsigned long NOT_READY = ULONG_MAX;
+  }
+
+  ProcessorOoO::ProcessorOoO(string name, MemoryUnit& mainMem,
+      MemoryUnit& rf, data32 instrStart, const SimConfig& config) :
+    name{name}, mainMem{mainMem}, rf{rf}, config{config},
+    syscalls{nullptr}, currentCycle{0}, nRetired{0}, nOps{0},
+    haveLast{false}, lastSeq{0}, fetchSeq{0}, fetchResumeAt{0},
+    rat(N_ARCH), readyAt(config.physRegs, 0), divFreeAt{0},
+    serializing{false}, done{false} {
+    if(config.physRegs <= (unsigned int) N_ARCH){
+      BOOST_LOG_TRIVIAL(fatal) << "<<ProcessorOoO>> " << name <<
+        " needs more than " << N_ARCH << " physical registers, has " <<
+        config.physRegs << endl;
+      throw std::exception();
+    }
+    if(config.nQueues != 1 && config.nQueues != 3){
+      BOOST_LOG_TRIVIAL(fatal) << "<<ProcessorOoO>> " << name <<
+        " takes 1 or 3 issue queues, not " << config.nQueues << endl;
+      throw std::exception();
+    }
+    for(int a = 0; a < N_ARCH; a++)
+      rat[a] = a;
+    for(int p = N_ARCH; p < (int) config.physRegs; p++)
+      freeRegs.push_back(p);
+    queues.resize(config.nQueues);
+    setPc(instrStart);
+  }
+
+  ProcessorOoO::Entry& ProcessorOoO::entry(unsigned long seq){
+    return rob[seq - nRetired];
+  }
+
+  bool ProcessorOoO::produce(unsigned long seq){
+    while(nRetired + stream.size() <= seq){
+      if(haveLast)
+        return false;
+      TraceRecord r;
+      if(!core->step(r)){
+        haveLast = true;
+        lastSeq = nRetired + stream.size();
+      }
+      stream.push_back(r);
+    }
+    return true;
+  }
+
+  int ProcessorOoO::queueOf(OpClass op) const{
+    if(op == OP_NOP || op == OP_SYSCALL)
+      return -1;
+    if(queues.size() == 1)
+      return 0;
+    if(op == OP_MUL || op == OP_DIV)
+      return MULDIV_QUEUE;
+    if(op == OP_LOAD || op == OP_STORE)
+      return MEM_QUEUE;
+    return INT_QUEUE;
+  }
+
+  void ProcessorOoO::fetch(){
+    if(currentCycle < fetchResumeAt)
+      return;
+    //room for what rename takes in the fetch to rename latency
+    size_t capacity = (size_t) config.oooWidth *
+      (config.ifLatency + config.idLatency);
+    for(unsigned int i = 0; i < config.oooWidth &&
+        fetchQueue.size() < capacity; i++){
+      auto resolved = [&](unsigned long b){
+        return b < nRetired || (b - nRetired < rob.size() &&
+          entry(b).issued && entry(b).doneAt <= currentCycle);
+      };
+      //past a taken branch's delay slots, wait for it to execute
+      while(!redirects.empty() && fetchSeq > redirects.front() +
+          DELAY_SLOTS){
+        if(!resolved(redirects.front())){
+          stats.redirectStalls++;
+          return;
+        }
+        redirects.pop_front();
+      }
+      if(!produce(fetchSeq))
+        return;
+      //executed before fetch got through them, the nops left are not
+      //fetched, as TraceReplayer skips them for Processor5S
+      while(!redirects.empty() && resolved(redirects.front()) &&
+          stream[fetchSeq - nRetired].op == OP_NOP){
+        stream.erase(stream.begin() + (fetchSeq - nRetired));
+        if(haveLast)
+          lastSeq--;
+        stats.nSkipped++;
+        if(!produce(fetchSeq))
+          return;
+      }
+      if(stream[fetchSeq - nRetired].redirect)
+        redirects.push_back(fetchSeq);
+      fetchQueue.push_back({fetchSeq, currentCycle + config.ifLatency +
+          config.idLatency});
+      fetchSeq++;
+    }
+  }
+
+  void ProcessorOoO::rename(){
+    for(unsigned int i = 0; i < config.oooWidth && !fetchQueue.empty();
+        i++){
+      unsigned long seq = fetchQueue.front().first;
+      if(fetchQueue.front().second > currentCycle || serializing)
+        return;
+      const TraceRecord& r = stream[seq - nRetired];
+      //syncs too wait for what is before them, and hold what is after
+      bool serializes = r.op == OP_SYSCALL || isSync(r);
+      if(serializes && !rob.empty())
+        return;
+      if(rob.size() >= config.robSize){
+        stats.robStalls++;
+        return;
+      }
+      int queue = queueOf(r.op);
+      if(queue >= 0 && queues[queue].size() >= config.iqSize){
+        stats.iqStalls++;
+        return;
+      }
+      bool memory = r.op == OP_LOAD || r.op == OP_STORE;
+      if(memory && lsq.size() >= config.lsqSize){
+        stats.lsqStalls++;
+        return;
+      }
+      int dest = r.op == OP_MUL || r.op == OP_DIV ? HILO : r.dest;
+      if(dest >= 0 && freeRegs.empty()){
+        stats.regStalls++;
+        return;
+      }
+
+      Entry e;
+      e.r = r;
+      e.seq = seq;
+      for(int s = 0; s < 2; s++)
+        e.srcs[s] = r.srcs[s] >= 0 ? rat[r.srcs[s]] : -1;
+      e.srcs[2] = readsHiLo(r) ? rat[HILO] : -1;
+      e.dest = dest;
+      e.physDest = e.prevPhys = -1;
+      if(dest >= 0){
+        e.prevPhys = rat[dest];
+        e.physDest = freeRegs.front();
+        freeRegs.pop_front();
+        rat[dest] = e.physDest;
+        readyAt[e.physDest] = NOT_READY;
+      }
+      e.queue = queue;
+      //nops are done as they rename, syscalls when they are oldest
+      e.issued = r.op == OP_NOP;
+      e.doneAt = currentCycle;
+      e.forwardedFrom = -1;
+      e.checked = false;
+      e.last = haveLast && seq == lastSeq;
+      if(serializes)
+        serializing = true;
+      rob.push_back(e);
+      if(queue >= 0)
+        queues[queue].push_back(seq);
+      if(memory)
+        lsq.push_back(seq);
+      fetchQueue.pop_front();
+    }
+  }
+
+  bool ProcessorOoO::addressKnown(const Entry& store) const{
+    int base = store.srcs[1];
+    return base < 0 || (readyAt[base] != NOT_READY &&
+        readyAt[base] + config.exLatency <= currentCycle);
+  }
+
+  long ProcessorOoO::findStore(const Entry& load, bool& blocked){
+    blocked = false;
+    long from = -1;
+    bool waits = waitTable.count(load.r.pc) > 0;
+    for(unsigned long seq : lsq){
+      if(seq >= load.seq)
+        break;
+      const Entry& s = entry(seq);
+      if(s.r.op != OP_STORE)
+        continue;
+      if(addressKnown(s)){
+        if(s.r.address == load.r.address)
+          from = seq;
+      } else if(waits){
+        blocked = true;
+        return -1;
+      }
+    }
+    //a store to the word whose data is not there yet is waited for
+    if(from >= 0 && (!entry(from).issued ||
+          entry(from).doneAt > currentCycle))
+      blocked = true;
+    for(auto d = storeBuffer.rbegin(); from < 0 && d != storeBuffer.rend();
+        d++)
+      if(d->address == load.r.address && d->at > currentCycle)
+        from = d->seq;
+    return from;
+  }
+
+  void ProcessorOoO::issue(){
+    unsigned int nIssued = 0;
+    unsigned int nMem = 0;
+    unsigned int nMulDiv = 0;
+    for(size_t q = 0; q < queues.size(); q++){
+      vector<unsigned long> waiting;
+      for(unsigned long seq : queues[q]){
+        Entry& e = entry(seq);
+        bool ready = nIssued < config.oooWidth;
+        for(int s = 0; s < 3 && ready; s++)
+          ready = e.srcs[s] < 0 || readyAt[e.srcs[s]] <= currentCycle;
+        unsigned long latency = config.exLatency;
+        if(ready){
+          switch(e.r.op){
+            case OP_MUL:
+              ready = nMulDiv == 0;
+              latency = config.mulLatency;
+              break;
+            case OP_DIV:
+              ready = nMulDiv == 0 && divFreeAt <= currentCycle;
+              latency = config.divLatency;
+              break;
+            case OP_LOAD:
+              if(nMem < config.memPorts){
+                bool blocked;
+                e.forwardedFrom = findStore(e, blocked);
+                ready = !blocked;
+                latency += e.forwardedFrom >= 0 ? config.maLatency :
+                  config.memLatency;
+              } else {
+                ready = false;
+              }
+              break;
+            case OP_STORE:
+              ready = nMem < config.memPorts;
+              break;
+            default:
+              break;
+          }
+        }
+        if(!ready){
+          waiting.push_back(seq);
+          continue;
+        }
+        e.issued = true;
+        e.doneAt = currentCycle + latency;
+        if(e.physDest >= 0)
+          readyAt[e.physDest] = e.doneAt;
+        if(e.r.op == OP_MUL || e.r.op == OP_DIV)
+          nMulDiv++;
+        if(e.r.op == OP_DIV)
+          divFreeAt = e.doneAt;
+        if(e.r.op == OP_LOAD || e.r.op == OP_STORE)
+          nMem++;
+        if(e.r.op == OP_LOAD && e.forwardedFrom >= 0)
+          stats.nForwarded++;
+        nIssued++;
+      }
+      queues[q] = waiting;
+      //a unified queue issues width a cycle, split ones width each
+      if(queues.size() > 1)
+        nIssued = 0;
+    }
+  }
+
+  void ProcessorOoO::checkStores(){
+    bool squashed = true;
+    while(squashed){
+      squashed = false;
+      for(size_t i = 0; i < lsq.size() && !squashed; i++){
+        Entry& s = entry(lsq[i]);
+        if(s.r.op != OP_STORE || s.checked || !addressKnown(s))
+          continue;
+        s.checked = true;
+        for(size_t j = i + 1; j < lsq.size(); j++){
+          const Entry& l = entry(lsq[j]);
+          if(l.r.op == OP_LOAD && l.issued &&
+              l.r.address == s.r.address &&
+              l.forwardedFrom < (long) s.seq){
+            stats.nViolations++;
+            waitTable.insert(l.r.pc);
+            squash(l.seq);
+            squashed = true;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  void ProcessorOoO::squash(unsigned long seq){
+    unsigned long n = 0;
+    while(!rob.empty() && rob.back().seq >= seq){
+      const Entry& e = rob.back();
+      if(e.physDest >= 0){
+        rat[e.dest] = e.prevPhys;
+        freeRegs.push_front(e.physDest);
+      }
+      if(e.r.op == OP_SYSCALL || isSync(e.r))
+        serializing = false;
+      rob.pop_back();
+      n++;
+    }
+    for(vector<unsigned long>& queue : queues)
+      queue.erase(remove_if(queue.begin(), queue.end(),
+            [seq](unsigned long s){ return s >= seq; }), queue.end());
+    while(!lsq.empty() && lsq.back() >= seq)
+      lsq.pop_back();
+    while(!redirects.empty() && redirects.back() >= seq)
+      redirects.pop_back();
+    n += fetchQueue.size();
+    fetchQueue.clear();
+    fetchSeq = seq;
+    fetchResumeAt = currentCycle + 1;
+    stats.nSquashed += n;
+  }
+
+  void ProcessorOoO::retire(){
+    for(unsigned int i = 0; i < config.oooWidth && !rob.empty(); i++){
+      Entry& e = rob.front();
+      if(e.r.op == OP_SYSCALL && !e.issued){
+        //the functional core has run it, this is its time
+        e.issued = true;
+        e.doneAt = currentCycle + max(config.wbLatency,
+            config.syscallLatency);
+      }
+      if(!e.issued || e.doneAt > currentCycle)
+        return;
+      //a sync also waits for the stores before it to drain
+      if(isSync(e.r) && !storeBuffer.empty() &&
+          storeBuffer.back().at > currentCycle)
+        return;
+      if(e.prevPhys >= 0)
+        freeRegs.push_back(e.prevPhys);
+      if(e.r.op == OP_SYSCALL || isSync(e.r))
+        serializing = false;
+      if(e.r.op != OP_NOP)
+        nOps++;
+      if(!lsq.empty() && lsq.front() == e.seq)
+        lsq.pop_front();
+      while(!storeBuffer.empty() && storeBuffer.front().at <= currentCycle)
+        storeBuffer.pop_front();
+      if(e.r.op == OP_STORE)
+        storeBuffer.push_back({e.seq, e.r.address, currentCycle +
+            config.memLatency});
+      bool last = e.last;
+      rob.pop_front();
+      stream.pop_front();
+      nRetired++;
+      if(last){
+        done = true;
+        core->drain();
+        return;
+      }
+    }
+  }
+
+  bool ProcessorOoO::step(){
+    if(done)
+      return true;
+    checkStores();
+    retire();
+    if(!done){
+      issue();
+      rename();
+      fetch();
+    }
+    currentCycle++;
+    return done;
+  }
+
+  void ProcessorOoO::start(data32 startI, ostream& report){
+    setPc(startI);
+    runFor(ULONG_MAX);
+    report << "Program Terminating" << endl;
+  }
+
+  bool ProcessorOoO::runFor(unsigned long nInstrs){
+    unsigned long until = nInstrs > ULONG_MAX - nRetired ? ULONG_MAX :
+      nRetired + nInstrs;
+    bool quit = done;
+    while(!quit && nRetired < until){
+      quit = step();
+    }
+    return quit;
+  }
+
+  void ProcessorOoO::setPc(data32 startI){
+    core = make_unique<functional::FunctionalCore>(mainMem, rf, startI);
+    core->setSyscalls(syscalls);
+  }
+
+  void ProcessorOoO::setSyscalls(sys::SyscallEmulator* emulator){
+    syscalls = emulator;
+    core->setSyscalls(emulator);
+  }
+
+  unsigned long ProcessorOoO::getCurrentCycle() const{
+    return currentCycle;
+  }
+
+  unsigned long ProcessorOoO::getNRetired() const{
+    return nRetired;
+  }
+
+  unsigned long ProcessorOoO::getNOps() const{
+    return nOps;
+  }
+
+  const OoOStats& ProcessorOoO::getStats() const{
+    return stats;
+  }
+
+  void ProcessorOoO::report(ostream& out) const{
+    out << nRetired << " instructions in " << currentCycle << " cycles, IPC "
+      << (currentCycle ? (double) nRetired / currentCycle : 0) << endl;
+    out << "loads forwarded " << stats.nForwarded << ", ordering violations "
+      << stats.nViolations << " (" << stats.nSquashed << " squashed)" <<
+      endl;
+    out << "stall cycles: rob " << stats.robStalls << ", issue queue " <<
+      stats.iqStalls << ", lsq " << stats.lsqStalls << ", registers " <<
+      stats.regStalls << ", taken branches " << stats.redirectStalls <<
+      ", delay slots not fetched " << stats.nSkipped << endl;
+  }
+}
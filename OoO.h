@@ -0,0 +1,257 @@
+#ifndef OOO_H_INCLUDED
+#define OOO_H_INCLUDED
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include "Mem.h"
+#include "Config.h"
+#include "Trace.h"
+#include "Functional.h"
+#include "Syscall.h"
+
+using namespace std;
+using namespace mem;
+using namespace config;
+using namespace trace;
+/*
+ * An out of order core, to set against Processor5S on the same programs and
+ * memories. It is timing on top of a FunctionalCore (see Functional.h), as
+ * DecoupledSim is, but on one thread: the functional core works out each
+ * instruction's results, registers and addresses in fetch order, and this
+ * model works out when it could have done so with
+ *   - fetch, rename and retire of up to ooo.width instructions a cycle.
+ *     Fetched instructions reach rename after if.latency + id.latency
+ *   - a register alias table onto ooo.physRegs physical registers, hi/lo
+ *     renamed as one more architectural register. A mapping is freed when
+ *     the instruction that replaced it retires
+ *   - a reorder buffer of ooo.robSize, retiring in order, so what has
+ *     retired is always a precise state
+ *   - one issue queue of ooo.iqSize (ooo.queues = 1) or three, for integer,
+ *     multiply/divide and memory (ooo.queues = 3). Oldest ready issue first.
+ *     Multiplies are pipelined, the divider is not
+ *   - a load/store queue of ooo.lsqSize and ooo.memPorts issues a cycle.
+ *     A store's address is known ex.latency after its base register, its
+ *     data once it issues. A load takes its word from the youngest older
+ *     store to it whose address is known, once that store has its data, in
+ *     ex.latency + ma.latency, and from memory in
+ *     ex.latency + ma.memLatency otherwise. Retired stores take
+ *     ma.memLatency to reach memory, and are forwarded from until then
+ *     too. A load does not wait for older
+ *     stores with unknown addresses, unless it has been caught out before:
+ *     when such a store turns out to write the load's word, the load and
+ *     everything after it are squashed and fetched again, and the load's
+ *     pc waits for older stores from then on
+ * Other latencies are ex.latency, ex.mulLatency and ex.divLatency. A
+ * syscall waits to be the oldest instruction, takes the larger of
+ * wb.latency and wb.syscallLatency, and nothing renames behind it until it
+ * retires. So does a sync, which also retires only once the store buffer
+ * has drained.
+ *
+ * The functional core only ever runs the committed path, so there is no
+ * branch prediction to get wrong. Fetch goes on through the delay slots of
+ * a taken branch or jump (see Assembler.h) and then waits for it to execute.
+ * Slots it has not reached by then are not fetched if they are nops, as
+ * Processor5S would not fetch them either.
+ * Dependences are the decoded ones (see Trace.h) on the last writer, which
+ * is what the assembler's padding makes them. As for DecoupledSim, results
+ * are the functional core's, links included, and the register file holds
+ * them once the program ends.
+ */
+namespace ooo{
+
+  /* what held up the core, in cycles unless stated */
+  struct OoOStats{
+    /* loads that took their word from a store in the queue */
+    unsigned long nForwarded = 0;
+    /* loads caught reading before an older store to their word */
+    unsigned long nViolations = 0;
+    /* instructions thrown away by those, counted each time */
+    unsigned long nSquashed = 0;
+    /* rename held up by a full reorder buffer */
+    unsigned long robStalls = 0;
+    /* rename held up by a full issue queue */
+    unsigned long iqStalls = 0;
+    /* rename held up by a full load/store queue */
+    unsigned long lsqStalls = 0;
+    /* rename held up by no free physical register */
+    unsigned long regStalls = 0;
+    /* fetch waiting on a taken branch or jump */
+    unsigned long redirectStalls = 0;
+    /* delay slot nops the branch executed before fetch reached */
+    unsigned long nSkipped = 0;
+  };
+
+  class ProcessorOoO{
+    private:
+      /* an instruction between rename and retire */
+      struct Entry{
+        TraceRecord r;
+        unsigned long seq;
+        /* architectural register written, -1 for none */
+        int dest;
+        int physDest;
+        /* what dest mapped to before, freed when this retires */
+        int prevPhys;
+        /* physical registers read, -1 for none */
+        int srcs[3];
+        int queue;
+        bool issued;
+        /* when the result is ready, once issued */
+        unsigned long doneAt;
+        /* seq of the store a load forwarded from, -1 from memory */
+        long forwardedFrom;
+        /* whether a store's known address has been checked against loads */
+        bool checked;
+        /* whether this ends the program */
+        bool last;
+      };
+
+      string name;
+      MemoryUnit& mainMem;
+      MemoryUnit& rf;
+      SimConfig config;
+      unique_ptr<functional::FunctionalCore> core;
+      sys::SyscallEmulator* syscalls;
+      unsigned long currentCycle;
+      unsigned long nRetired;
+      unsigned long nOps;
+      OoOStats stats;
+
+      /* records fetched and not retired, the first is seq nRetired */
+      deque<TraceRecord> stream;
+      /* seq of the program's last record, once the core has reached it */
+      bool haveLast;
+      unsigned long lastSeq;
+      /* the next record to fetch */
+      unsigned long fetchSeq;
+      /* fetch waits for this after a squash */
+      unsigned long fetchResumeAt;
+      /* fetched records and the cycle each reaches rename */
+      deque<pair<unsigned long, unsigned long>> fetchQueue;
+      /* taken branches and jumps fetch may not get far past */
+      deque<unsigned long> redirects;
+
+      /* architectural (32 is hi/lo) -> physical */
+      vector<int> rat;
+      /* when each physical register's value is ready */
+      vector<unsigned long> readyAt;
+      deque<int> freeRegs;
+      deque<Entry> rob;
+      /* seqs of the entries waiting in each queue, oldest first */
+      vector<vector<unsigned long>> queues;
+      /* seqs of the loads and stores in the reorder buffer */
+      deque<unsigned long> lsq;
+      /* retired stores on their way to memory: seq, address, when there */
+      struct Drain{
+        unsigned long seq;
+        data32 address;
+        unsigned long at;
+      };
+      deque<Drain> storeBuffer;
+      /* when the divider is free */
+      unsigned long divFreeAt;
+      /* a syscall or sync is in the reorder buffer */
+      bool serializing;
+      /* pcs of loads that wait for older store addresses */
+      unordered_set<data32> waitTable;
+      bool done;
+
+      Entry& entry(unsigned long seq);
+
+      /* makes sure the record seq is in the stream, if there is one */
+      bool produce(unsigned long seq);
+
+      /* returns: the issue queue for an op class */
+      int queueOf(OpClass op) const;
+
+      void fetch();
+      void rename();
+      void issue();
+      /* squashes loads that read before an older store to their word */
+      void checkStores();
+      /* throws away seq and everything younger, to be fetched again */
+      void squash(unsigned long seq);
+      void retire();
+
+      /*
+       * returns: whether a store's address is worked out yet, which is
+       *   ex.latency after its base register is ready, data or not
+       */
+      bool addressKnown(const Entry& store) const;
+
+      /*
+       * returns: the older store a load takes its word from, -1 for memory
+       * params:
+       *   blocked: set if the load has to wait, for that store's data or,
+       *     if its pc is in the wait table, for older store addresses
+       */
+      long findStore(const Entry& load, bool& blocked);
+
+    public:
+      /*
+       * params:
+       *   name: for messages
+       *   mainMem: the program and its data
+       *   rf: the register file, which ends up holding the results
+       *   instrStart: where the program starts, unless start says otherwise
+       *   config: the latencies and the ooo sizes
+       * throws: exception if the ooo sizes can't work, e.g. too few
+       *   physical registers or ooo.queues other than 1 or 3
+       */
+      ProcessorOoO(string name, MemoryUnit& mainMem, MemoryUnit& rf,
+          data32 instrStart, const SimConfig& config = SimConfig());
+
+      /*
+       * advances one cycle
+       * returns: true once the program has ended
+       * throws: exception as FunctionalCore::step
+       */
+      bool step();
+
+      /*
+       * runs from startI to the syscall that ends the program, then writes
+       * "Program Terminating" to report
+       */
+      void start(data32 startI, ostream& report = cout);
+
+      /*
+       * runs on until nInstrs more instructions have retired or the program
+       * has ended, as Processor5S::runFor
+       * returns: true if the program has ended
+       */
+      bool runFor(unsigned long nInstrs);
+
+      /*
+       * starts over at startI, on whatever is in memory and the register
+       * file. Meant for before the first run
+       */
+      void setPc(data32 startI);
+
+      /*
+       * as Processor5S::setSyscalls. The emulator is not owned
+       */
+      void setSyscalls(sys::SyscallEmulator* emulator);
+
+      unsigned long getCurrentCycle() const;
+
+      /*
+       * returns: the number of instructions retired, nops included
+       */
+      unsigned long getNRetired() const;
+
+      /*
+       * returns: the number of those that were not nops
+       */
+      unsigned long getNOps() const;
+
+      const OoOStats& getStats() const;
+
+      /*
+       * writes the retired count, cycles, IPC and stats to out
+       */
+      void report(ostream& out) const;
+  };
+}
+#endif
@@ -5,6 +5,8 @@
 #include <exception>
 #include "Pipeline.h"
 #include "Mem.h"
+#include "Profile.h"
+#include "Log.h"
 
 using namespace std;
 using namespace instruction;
@@ -38,8 +40,9 @@ namespace pipeline{
   MAOut::MAOut() : instr{instruction::Instruction(0)}, regVals(0), comp{0},
     loaded{0}{};
   
-  WBOut::WBOut(data32 addr, bool quit) : StageOut{addr}, quit{quit}{}
-  WBOut::WBOut() : quit{false}{}
+  WBOut::WBOut(data32 addr, bool quit, data32 word, data32 address) :
+    StageOut{addr}, quit{quit}, word{word}, address{address}{}
+  WBOut::WBOut() : quit{false}, word{0}, address{0}{}
 
   bool PipelinePhase::checkInvariants() const{
     return checkCyclesRemaining();
@@ -48,7 +51,7 @@ namespace pipeline{
 
   void PipelinePhase::setCyclesRemaining(int cycles){
    cyclesRemaining = cycles;
-    BOOST_LOG_TRIVIAL(debug) << "<<" + getName() + ">> " << "setting cycle to "
+    LOG_DEBUG << "<<" + getName() + ">> " << "setting cycle to "
       << cyclesRemaining << "." << std::endl;
     //It is required that cycles Remaining should never fall below 0
     assert(checkInvariants());
@@ -75,7 +78,23 @@ namespace pipeline{
   PipelinePhase::PipelinePhase(std::string name, ofstream& log) : name(name),
       log{log}{
     nCyclesPassed = 0;
+    currentAddr = (data32) -1;
     cyclesRemaining = 1;
+    latency = 1;
+  }
+
+  bool PipelinePhase::isEmpty() const{
+    return currentAddr == (data32) -1;
+  }
+
+  void PipelinePhase::setLatency(int cycles){
+    latency = cycles;
+  }
+
+  void PipelinePhase::copyStateFrom(const PipelinePhase& other){
+    nCyclesPassed = other.nCyclesPassed;
+    currentAddr = other.currentAddr;
+    cyclesRemaining = other.cyclesRemaining;
   }
 
   bool PipelinePhase::canUpdateArgs(){
@@ -96,6 +115,9 @@ namespace pipeline{
     }
     setCyclesRemaining(cyclesToSet);
     nCyclesPassed += cycleChange;
+    if(!log.is_open())
+      return;
+    PROFILE_SCOPE(TRACE);
     log << "cycle:" << nCyclesPassed << "\tname:" << getName() << 
       "\taddr:" << currentAddr << endl;
   }
@@ -109,9 +131,11 @@ namespace pipeline{
     mem{ mem }{
     cyclesRemaining = 0;
     args = nullptr;
+    fetchUnit = nullptr;
   }
 
   void InstructionFetch::execute(StageOut** args){
+    PROFILE_SCOPE(IF_EXECUTE);
     assert(canUpdateArgs());
     //Delete the old arguments
     delete this->args;
@@ -119,27 +143,58 @@ namespace pipeline{
     this->args = (*args);
     //Nullify the old pointer so user can't use it anymore
     *args = nullptr;
-    setCyclesRemaining(1);
-    BOOST_LOG_TRIVIAL(debug) << "<<" + getName() + ">> " << "executing args"
-      " with address " << this->args->addr << std::endl;
+    setCyclesRemaining(this->args == nullptr ? 1 : latency);
     currentAddr = (this->args == nullptr ? (data32) -1 : this->args->addr);
+    LOG_DEBUG << "<<" + getName() + ">> " << "executing args"
+      " with address " << currentAddr << std::endl;
+    if(fetchUnit != nullptr && this->args != nullptr)
+      fetchUnit->request(this->args->addr);
+  }
+
+  bool InstructionFetch::isBusy() const{
+    return PipelinePhase::isBusy() || (fetchUnit != nullptr &&
+        args != nullptr && !fetchUnit->has(args->addr));
+  }
+
+  void InstructionFetch::updateCycle(int cycleChange){
+    PipelinePhase::updateCycle(cycleChange);
+    for(int i = 0; fetchUnit != nullptr && i < cycleChange; i++)
+      fetchUnit->tick();
+  }
+
+  void InstructionFetch::setFetchUnit(frontend::FetchUnit* unit){
+    fetchUnit = unit;
   }
 
   StageOut* InstructionFetch::getOut(){
+    PROFILE_SCOPE(IF_GETOUT);
     IFOut* out = nullptr;
     if(args != nullptr){
       if(isBusy()){
         out = new IFOut();
       } else {
         unsigned int addr = args->addr;
-        mem::data32 instrInt = mem.ld(addr);
+        mem::data32 instrInt = fetchUnit != nullptr ?
+          fetchUnit->take(addr) : mem.ld(addr);
         instruction::Instruction instr = instruction::Instruction(instrInt);
         out = new IFOut(addr, instr);
+        //taken off the queue, so isBusy must not wait for it again
+        if(fetchUnit != nullptr){
+          delete args;
+          args = nullptr;
+        }
       }
     }
     return out;
   }
 
+  void InstructionFetch::copyStateFrom(const PipelinePhase& other){
+    PipelinePhase::copyStateFrom(other);
+    const StageOut* from = ((const InstructionFetch&) other).args;
+    delete args;
+    args = from == nullptr ? nullptr : new StageOut(*from);
+  }
+
   InstructionFetch::~InstructionFetch(){
     delete args;
   }
@@ -159,15 +214,16 @@ namespace pipeline{
   }
 
   void InstructionDecode::execute(StageOut** args){
+    PROFILE_SCOPE(ID_EXECUTE);
     assert(canUpdateArgs());
     //Delete the old arguments
     delete this->args;
-    this->cyclesRemaining = 1;
     //save the pointer to the Out
     this->args = (IFOut*) *args;
+    setCyclesRemaining(this->args == nullptr ? 1 : latency);
     //nullptrIFY the users pointer
     *args = nullptr;
-    BOOST_LOG_TRIVIAL(debug) << "<<" + getName() + ">> " << "executing args"
+    LOG_DEBUG << "<<" + getName() + ">> " << "executing args"
       " with instruction " << 
       (this->args == nullptr ? "null" : this->args->instr.toString())
       << std::endl;
@@ -175,6 +231,7 @@ namespace pipeline{
   }
 
   StageOut* InstructionDecode::getOut(){
+    PROFILE_SCOPE(ID_GETOUT);
     IDOut* out = nullptr;
     if(args!=nullptr){
       if(isBusy()){
@@ -210,6 +267,13 @@ namespace pipeline{
     return out;
   }
 
+  void InstructionDecode::copyStateFrom(const PipelinePhase& other){
+    PipelinePhase::copyStateFrom(other);
+    const IFOut* from = ((const InstructionDecode&) other).args;
+    delete args;
+    args = from == nullptr ? nullptr : new IFOut(*from);
+  }
+
   InstructionDecode::~InstructionDecode(){
     delete args;
   }
@@ -217,9 +281,17 @@ namespace pipeline{
   Execute::Execute(std::string name, PC& pc, ofstream& log) : PipelinePhase(name, log), pc{pc}{
     cyclesRemaining = 1;
     args = nullptr;
+    mulLatency = 1;
+    divLatency = 1;
+  }
+
+  void Execute::setMulDivLatency(int mul, int div){
+    mulLatency = mul;
+    divLatency = div;
   }
 
   void Execute::execute(StageOut** args){
+    PROFILE_SCOPE(EX_EXECUTE);
     assert(canUpdateArgs());
     //Delete the old arguments
     delete this->args;
@@ -227,8 +299,17 @@ namespace pipeline{
     this->args = (IDOut*) (*args);
     //Nullify the ptr for user cause they should never use again
     *args = nullptr;
-    setCyclesRemaining(1);
-    BOOST_LOG_TRIVIAL(debug) << "<<" + getName() + ">> " << "executing args"
+    int cycles = this->args == nullptr ? 1 : latency;
+    //by the raw bits, a bad instruction should only throw in getOut
+    if(this->args != nullptr && this->args->instr.getSlice<26,32>() == 0){
+      unsigned long func = this->args->instr.getSlice<0,6>().to_ulong();
+      if(func == 0x18 || func == 0x19)
+        cycles = mulLatency;
+      else if(func == 0x1a || func == 0x1b)
+        cycles = divLatency;
+    }
+    setCyclesRemaining(cycles);
+    LOG_DEBUG << "<<" + getName() + ">> " << "executing args"
       " with instruction " << 
       (this->args == nullptr ? "null" : this->args->instr.toString())
       << std::endl;
@@ -236,6 +317,7 @@ namespace pipeline{
   }
 
   StageOut* Execute::getOut(){
+    PROFILE_SCOPE(EX_GETOUT);
     EXOut* out = nullptr;
     if(args!=nullptr){
       if(isBusy()){
@@ -361,6 +443,9 @@ namespace pipeline{
             comp = (mem::signedData32) rt + (short)immediate;
           } else if (instrType == "I-Type:bltz"){
             comp = (mem::signedData32) rs < 0;
+          } else if (instrType == "I-Type:ll" || instrType == "I-Type:sc"){
+            //based on rs, as in MIPS, sc's value is in rt
+            comp = (mem::signedData32) rs + (short)immediate;
           }
         }
         else if (instrType.find("J-Type") != std::string::npos){
@@ -389,6 +474,13 @@ namespace pipeline{
     return out;
   }
 
+  void Execute::copyStateFrom(const PipelinePhase& other){
+    PipelinePhase::copyStateFrom(other);
+    const IDOut* from = ((const Execute&) other).args;
+    delete args;
+    args = from == nullptr ? nullptr : new IDOut(*from);
+  }
+
   Execute::~Execute(){
     delete args;
   }
@@ -397,9 +489,29 @@ namespace pipeline{
       ofstream& log) : PipelinePhase(name, log), mem{mem}{
       cyclesRemaining = 1;
       args = nullptr;
+      memLatency = 1;
+      dataCache = nullptr;
+      link = nullptr;
     }
 
+  void MemoryAccess::setMemLatency(int cycles){
+    memLatency = cycles;
+  }
+
+  void MemoryAccess::setDataCache(coherence::L1Cache* cache){
+    dataCache = cache;
+  }
+
+  void MemoryAccess::setLinkRegister(atomics::LinkRegister* link){
+    this->link = link;
+  }
+
+  bool MemoryAccess::isBusy() const{
+    return PipelinePhase::isBusy() || (link != nullptr && link->isWaiting());
+  }
+
   void MemoryAccess::execute(StageOut** args){
+    PROFILE_SCOPE(MA_EXECUTE);
     assert(canUpdateArgs());
     //Delete the old arguments
     delete this->args;
@@ -407,8 +519,29 @@ namespace pipeline{
     this->args = (EXOut*) *args;
     //Nullify the ptr for user cause they should never use again
     *args = nullptr;
-    setCyclesRemaining(1);
-    BOOST_LOG_TRIVIAL(debug) << "<<" + getName() + ">> " << "executing args"
+    int cycles = this->args == nullptr ? 1 : latency;
+    //opcodes 0x20 and up are all loads and stores
+    unsigned long opcode = this->args == nullptr ? 0 :
+      this->args->instr.getSlice<26,32>().to_ulong();
+    if(opcode >= 0x20){
+      cycles = memLatency;
+      if(dataCache != nullptr){
+        //lw, sw, ll and sc have word addresses, the others byte addresses
+        data32 addr = (data32) (this->args->instr.isSubword() ?
+            this->args->comp >> 2 : this->args->comp);
+        bool store = opcode == 0x28 || opcode == 0x29 || opcode == 0x2b ||
+          opcode == 0x38;
+        cycles = dataCache->access(addr, store);
+      }
+      if(opcode == 0x38 && link != nullptr)
+        link->beginStoreConditional((data32) this->args->comp,
+            this->args->regVals[1]);
+    } else if(this->args != nullptr && opcode == 0 && link != nullptr &&
+        this->args->instr.getSlice<0,6>().to_ulong() == 0xf){
+      link->sync();
+    }
+    setCyclesRemaining(cycles);
+    LOG_DEBUG << "<<" + getName() + ">> " << "executing args"
       " with instruction " << 
       (this->args == nullptr ? "null" : this->args->instr.toString())
       << std::endl;
@@ -416,6 +549,7 @@ namespace pipeline{
   }
 
   StageOut* MemoryAccess::getOut(){
+    PROFILE_SCOPE(MA_GETOUT);
     MAOut* out = nullptr;
     if(args!=nullptr){
       if(isBusy()){
@@ -429,6 +563,33 @@ namespace pipeline{
           mem.sw(args->comp, rs);
         } else if (instrType == "I-Type:lw"){
           loaded = mem.ld((mem::data32) args->comp);
+        } else if (instrType == "I-Type:lb"){
+          loaded = (mem::signedData32) (signed char)
+            mem.ldByte((mem::data32) args->comp);
+        } else if (instrType == "I-Type:lbu"){
+          loaded = mem.ldByte((mem::data32) args->comp);
+        } else if (instrType == "I-Type:lh"){
+          loaded = (mem::signedData32) (mem::signedData16)
+            mem.ldHalf((mem::data32) args->comp);
+        } else if (instrType == "I-Type:lhu"){
+          loaded = mem.ldHalf((mem::data32) args->comp);
+        } else if (instrType == "I-Type:sb"){
+          mem.stByte(args->comp, args->regVals[0]);
+        } else if (instrType == "I-Type:sh"){
+          mem.stHalf(args->comp, args->regVals[0]);
+        } else if (instrType == "I-Type:ll"){
+          loaded = mem.ld((mem::data32) args->comp);
+          if(link != nullptr)
+            link->loadLinked((mem::data32) args->comp);
+        } else if (instrType == "I-Type:sc"){
+          //rt gets whether it stored
+          if(link == nullptr){
+            mem.sw(args->comp, args->regVals[1]);
+            loaded = 1;
+          } else {
+            loaded = link->storeConditional((mem::data32) args->comp,
+                args->regVals[1], mem);
+          }
         }
         out = new MAOut(args->addr, args->instr, args->regVals, args->comp,
             loaded);
@@ -437,18 +598,37 @@ namespace pipeline{
     return out;
   }
 
+  void MemoryAccess::copyStateFrom(const PipelinePhase& other){
+    PipelinePhase::copyStateFrom(other);
+    const EXOut* from = ((const MemoryAccess&) other).args;
+    delete args;
+    args = from == nullptr ? nullptr : new EXOut(*from);
+  }
+
   MemoryAccess::~MemoryAccess(){
     delete args;
   }
 
   WriteBack::WriteBack(string name, MemoryUnit& rf, data64& acc, PC& pc,
-      ofstream& log) : PipelinePhase(name, log), rf(rf), acc{acc}, pc{pc}
+      ofstream& log) : PipelinePhase(name, log), rf(rf), acc{acc}, pc{pc},
+      syscallLatency{1}, syscalls{nullptr}, mainMem{nullptr}
   {
       cyclesRemaining = 1;
       args = nullptr;
   }
 
+  void WriteBack::setSyscallLatency(int cycles){
+    syscallLatency = cycles;
+  }
+
+  void WriteBack::setSyscalls(sys::SyscallEmulator* emulator,
+      MemoryUnit* mainMem){
+    syscalls = emulator;
+    this->mainMem = mainMem;
+  }
+
   void WriteBack::execute(StageOut** args){
+    PROFILE_SCOPE(WB_EXECUTE);
     assert(canUpdateArgs());
     //Delete the old arguments
     delete this->args;
@@ -456,8 +636,12 @@ namespace pipeline{
     this->args = (MAOut*) *args;
     //Nullify the ptr for user cause they should never use again
     *args = nullptr;
-    setCyclesRemaining(1);
-    BOOST_LOG_TRIVIAL(debug) << "<<" + getName() + ">> " << "executing args"
+    int cycles = this->args == nullptr ? 1 : latency;
+    if(this->args != nullptr &&
+        (this->args->instr.getInstr().to_ulong() & 0xfc00003f) == 0xc)
+      cycles = syscallLatency;
+    setCyclesRemaining(cycles);
+    LOG_DEBUG << "<<" + getName() + ">> " << "executing args"
       " with instruction " << 
       (this->args == nullptr ? "null" : this->args->instr.toString())
       << std::endl;
@@ -467,7 +651,16 @@ namespace pipeline{
   //TODO this is terribly named, you don't really want to get out here.
   //There is no out
   StageOut* WriteBack::getOut(){
-    StageOut* out = new WBOut((data32) -1, false); // assume not quiting
+    PROFILE_SCOPE(WB_GETOUT);
+    //the address is that of the retired instruction, or -1 for a bubble
+    data32 retiredAddr = args == nullptr ? (data32) -1 : args->addr;
+    data32 word = args == nullptr ? 0 : args->instr.getInstr().to_ulong();
+    data32 address = args == nullptr ? 0 : (data32) args->comp;
+    //traces keep word addresses
+    if(args != nullptr && args->instr.isSubword())
+      address >>= 2;
+    // assume not quiting
+    StageOut* out = new WBOut(retiredAddr, false, word, address);
     static const vector<string> simpleRInstrs = {
       "sub", "subu", "addu", "add", "sll", "sllv", "srl", "srlv", "and", "or",
       "xor", "nor", "srav","sra"
@@ -479,7 +672,9 @@ namespace pipeline{
 
     static const vector<string> loadIInstrs = {
       "I-Type:lb", "I-Type:lh", "I-Type:lw", 
-      "I-Type:lbu", "I-Type:lhu", "I-Type:lwu"
+      "I-Type:lbu", "I-Type:lhu", "I-Type:lwu",
+      //sc's loaded is whether it stored
+      "I-Type:ll", "I-Type:sc"
     };
 
     if(args != nullptr){
@@ -502,9 +697,12 @@ namespace pipeline{
         }
 
         if(func == "syscall"){
-          //quiting 
-          delete out;
-          out = new WBOut((data32) -1, true);
+          //quiting, unless emulated and not an exit
+          if(syscalls == nullptr || syscalls->isEndMarker(retiredAddr) ||
+              syscalls->handle(*mainMem, rf)){
+            delete out;
+            out = new WBOut(retiredAddr, true, word, address);
+          }
         } else if(isSimple){
           rf.sw(rdAddr, comp);
         } else if(func == "jr"){ 
@@ -538,9 +736,9 @@ namespace pipeline{
         //Otherwise, unseen r instr or r instr that we don't do anything for
       } else if(instrType.find("I-Type") != std::string::npos){
     //    //Now in I-Instr land
-        data32 rdAddr = args->instr.getSlice<16,20>().to_ulong();
+        data32 rdAddr = args->instr.getSlice<16,21>().to_ulong();
         data16 immediate = args->instr.getSlice<0,16>().to_ulong();
-        data16 loaded = args->loaded;
+        data32 loaded = args->loaded;
         //check if instruction is simple
         bool isSimple = false;
         for(string s : simpleIInstrs){
@@ -590,18 +788,26 @@ namespace pipeline{
     return out;
   }
 
+  void WriteBack::copyStateFrom(const PipelinePhase& other){
+    PipelinePhase::copyStateFrom(other);
+    const MAOut* from = ((const WriteBack&) other).args;
+    delete args;
+    args = from == nullptr ? nullptr : new MAOut(*from);
+  }
+
   WriteBack::~WriteBack(){
     delete args;
   }
 
   void PC::logCurrentIndex(){
-    BOOST_LOG_TRIVIAL(debug) << "<<" + getName() + ">> " << "current index "
+    LOG_DEBUG << "<<" + getName() + ">> " << "current index "
       "is " << this->index << endl;
   }
 
   string PC::getName(){ return name; }
 
-  PC::PC(string name, data32 startIndex) : name{ name }, index{startIndex} {}
+  PC::PC(string name, data32 startIndex) : name{ name }, index{startIndex},
+    redirected{false} {}
   
   StageOut* PC::getOut() const {
     return new StageOut(index);
@@ -609,9 +815,24 @@ namespace pipeline{
 
   void PC::set(data32 index) {
     this->index = index;
+    redirected = true;
     logCurrentIndex();
   }
 
+  bool PC::isRedirected() const{
+    return redirected;
+  }
+
+  data32 PC::get() const{
+    return index;
+  }
+
+  bool PC::takeRedirected(){
+    bool was = redirected;
+    redirected = false;
+    return was;
+  }
+
   void PC::setLowBits(data32 index, unsigned char nBits){
     char sluffBits = 32 - nBits;
     data32 sluffedAdd = ((index << sluffBits) >> sluffBits);
@@ -9,6 +9,10 @@
 
 #include "Mem.h"
 #include "Instruction.h"
+#include "Syscall.h"
+#include "FrontEnd.h"
+#include "Coherence.h"
+#include "Atomics.h"
 
 #define BOOST_LOG_DYN_LINK
 
@@ -93,13 +97,17 @@ namespace pipeline{
   };
 
   /*
-   * Note that the address for WBOut is meaningless because it is never used.
-   * here only for compatability
+   * The address for WBOut is the address of the instruction that was just
+   * retired, or -1 if writeback had nothing to do this cycle (a bubble)
    */
   class WBOut : public StageOut {
     public:
       const bool quit;
-      WBOut(data32 addr, bool quit);
+      /* the retired instruction and its effective address (comp), for
+       * tracing */
+      const data32 word;
+      const data32 address;
+      WBOut(data32 addr, bool quit, data32 word = 0, data32 address = 0);
       WBOut();
   };
 
@@ -107,6 +115,7 @@ namespace pipeline{
     private:
       data32 index;
       string name;
+      bool redirected;
       void logCurrentIndex();
 
     protected:
@@ -126,6 +135,18 @@ namespace pipeline{
        */
       void set(data32 index);
 
+      /*
+       * returns: whether set was called since the last call to this
+       */
+      bool takeRedirected();
+
+      /*
+       * returns: whether set was called since the last takeRedirected, and
+       * the index it was set to, without clearing it
+       */
+      bool isRedirected() const;
+      data32 get() const;
+
       /*
        * sets the lower n bits to the passed value
        */
@@ -166,6 +187,8 @@ namespace pipeline{
       const std::string name;
       /* The number of cycles left before freed */
       int cyclesRemaining; 
+      /* cycles an instruction spends in this stage, 1 unless configured */
+      int latency;
       /*A logger to write the current update stage*/
       ofstream& log;
 
@@ -204,6 +227,12 @@ namespace pipeline{
        */
       virtual bool isBusy() const;
 
+      /*
+       * return bool: True if the last thing executed was a bubble, so the
+       *   stage holds no instruction
+       */
+      bool isEmpty() const;
+
       /*
        * This function is used to update the current cycle. This probably
        * involves decrementing a timer on the current operation
@@ -214,6 +243,19 @@ namespace pipeline{
        */
       virtual void updateCycle(int cycleChange);
 
+      /*
+       * sets the cycles each instruction spends in this stage from now on.
+       * Bubbles always take one
+       */
+      void setLatency(int cycles);
+
+      /*
+       * makes this stage's timing and the instruction in it a copy of
+       * other's, which must be the same kind of stage. The latency stays
+       * this one's. For cloning a processor mid run
+       */
+      virtual void copyStateFrom(const PipelinePhase& other);
+
       /*
        * This function does two things.
        * 1. It stores the arguments needed for this instruction
@@ -245,6 +287,8 @@ namespace pipeline{
       mem::MemoryUnit& mem;
       /* arguments for the current instruction (output from previous stage) */
       StageOut* args;
+      /* where words come from instead of mem, if set. Not owned */
+      frontend::FetchUnit* fetchUnit;
 
     public:
 
@@ -271,6 +315,24 @@ namespace pipeline{
 
       StageOut* getOut();
 
+      /*
+       * also busy while the fetch unit, if any, does not have the word
+       */
+      bool isBusy() const;
+
+      /*
+       * also ticks the fetch unit, if any
+       */
+      void updateCycle(int cycleChange);
+
+      /*
+       * takes words from unit (see FrontEnd.h) from now on rather than
+       * reading them itself, nullptr to go back. Not owned
+       */
+      void setFetchUnit(frontend::FetchUnit* unit);
+
+      void copyStateFrom(const PipelinePhase& other);
+
       virtual ~InstructionFetch();
   };
 
@@ -320,6 +382,8 @@ namespace pipeline{
        */
       StageOut* getOut();
 
+      void copyStateFrom(const PipelinePhase& other);
+
       virtual ~InstructionDecode();
   };
   
@@ -332,10 +396,19 @@ namespace pipeline{
       IDOut* args;
       PC& pc; //TODO I was able to pass in an entire PC object, and assign
       //by initialization to this reference. How?
+      /* latencies of mult(u) and div(u), which write the accumulator */
+      int mulLatency;
+      int divLatency;
 
     public:
       Execute(std::string name, PC& pc, ofstream& log);
 
+      /*
+       * sets the latencies of the multiply and divide instructions, the
+       * others take the stage latency
+       */
+      void setMulDivLatency(int mul, int div);
+
       /*
        * This function does two things.
        * 1. It stores the arguments needed for this instruction
@@ -359,6 +432,8 @@ namespace pipeline{
        */
       StageOut* getOut();
 
+      void copyStateFrom(const PipelinePhase& other);
+
       virtual ~Execute();
   };
 
@@ -371,6 +446,12 @@ namespace pipeline{
     private:
       MemoryUnit& mem;
       EXOut* args;
+      /* latency of loads and stores */
+      int memLatency;
+      /* times loads and stores instead, if set */
+      coherence::L1Cache* dataCache;
+      /* for ll, sc and sync, if set */
+      atomics::LinkRegister* link;
 
     public:
       /*
@@ -378,6 +459,29 @@ namespace pipeline{
        */
       MemoryAccess(std::string name, MemoryUnit& mem, ofstream& log);
 
+      /*
+       * sets the latency of loads and stores, the others take the stage
+       * latency
+       */
+      void setMemLatency(int cycles);
+
+      /*
+       * times loads and stores by cache (see Coherence.h) from now on
+       * rather than by the memory latency, nullptr to go back. Not owned
+       */
+      void setDataCache(coherence::L1Cache* cache);
+
+      /*
+       * ll, sc and sync go by link (see Atomics.h) from now on. Without
+       * one ll is a lw, sc always stores and sync does nothing. Not owned
+       */
+      void setLinkRegister(atomics::LinkRegister* link);
+
+      /*
+       * busy too while an sc or sync waits on the link
+       */
+      bool isBusy() const;
+
       /*
        * This function does two things.
        * 1. It stores the arguments needed for this instruction
@@ -401,6 +505,8 @@ namespace pipeline{
        */
       StageOut* getOut();
 
+      void copyStateFrom(const PipelinePhase& other);
+
       virtual ~MemoryAccess();
   };
 
@@ -413,11 +519,26 @@ namespace pipeline{
       mem::data64& acc;
       MemoryUnit& rf; // the registerfile
       PC& pc;
+      int syscallLatency;
+      /* nullptr to end the program at any syscall */
+      sys::SyscallEmulator* syscalls;
+      MemoryUnit* mainMem;
 
     public:
       WriteBack(std::string name, MemoryUnit& rf, data64& acc, PC& pc,
           ofstream& log);
 
+      /*
+       * sets the latency of syscalls, the others take the stage latency
+       */
+      void setSyscallLatency(int cycles);
+
+      /*
+       * runs syscalls on emulator, against mainMem, rather than ending the
+       * program at each. nullptr to go back to that
+       */
+      void setSyscalls(sys::SyscallEmulator* emulator, MemoryUnit* mainMem);
+
       /*
        * This function does two things.
        * 1. It stores the arguments needed for this instruction
@@ -436,6 +557,8 @@ namespace pipeline{
        */
       StageOut* getOut();
 
+      void copyStateFrom(const PipelinePhase& other);
+
       virtual ~WriteBack();
   };
 
@@ -1,24 +1,51 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <ios>
 #include <array>
+#include <climits>
 #define PIPESIZE 5
 
 #include "Pipeline.h"
 #include "Instruction.h"
 #include "Mem.h"
 #include "Processor.h"
+#include "Config.h"
+#include "Profile.h"
 using namespace std;
 using namespace pipeline;
 using namespace instruction;
 using namespace mem;
 
 Processor5S::Processor5S(string name, MemoryUnit& mainMem, MemoryUnit& rf,
-    data32 instrStart, string logFilename) : 
-    mainMem{mainMem}, rf{rf}, acc{0}, currentCycle{0}, name{name}, 
+    data32 instrStart, string logFilename, const SimConfig& config) : 
+    mainMem{mainMem}, rf{rf}, acc{0}, currentCycle{0}, nRetired{0}, nOps{0},
+    fetched{false}, fetching{true}, tracer{nullptr}, name{name}, 
     pc{"PC",instrStart}, log{logFilename}{
   //set rf[0] = 0 cause MIPS hardwired
   rf.sw(0,0);
+  buildPipe(config);
+}
+
+Processor5S::Processor5S(const Processor5S& other, MemoryUnit& mainMem,
+    MemoryUnit& rf, string logFilename, const SimConfig& config) :
+    mainMem{mainMem}, rf{rf}, acc{other.acc},
+    currentCycle{other.currentCycle}, nRetired{other.nRetired},
+    nOps{other.nOps}, fetched{other.fetched}, fetching{other.fetching},
+    tracer{nullptr},
+    name{other.name}, pc{other.pc}, log{logFilename}{
+  buildPipe(config);
+  for(int i = 0; i < PIPESIZE; i++)
+    pipe[i]->copyStateFrom(*other.pipe[i]);
+  if(fetchUnit != nullptr && other.fetchUnit != nullptr)
+    fetchUnit->copyStateFrom(*other.fetchUnit);
+}
+
+void Processor5S::buildPipe(const SimConfig& config){
   //initialize the pipe
   pipe = array<PipelinePhase*, PIPESIZE>();
   pipe[0] = new InstructionFetch("IF", mainMem, log);
@@ -26,9 +53,29 @@ Processor5S::Processor5S(string name, MemoryUnit& mainMem, MemoryUnit& rf,
   pipe[2] = new Execute("EX", pc, log);
   pipe[3] = new MemoryAccess("MA", mainMem, log);
   pipe[4] = new WriteBack("WB", rf, acc, pc, log);
+  pipe[0]->setLatency(config.ifLatency);
+  pipe[1]->setLatency(config.idLatency);
+  pipe[2]->setLatency(config.exLatency);
+  pipe[3]->setLatency(config.maLatency);
+  pipe[4]->setLatency(config.wbLatency);
+  ((Execute*) pipe[2])->setMulDivLatency(config.mulLatency,
+      config.divLatency);
+  ((MemoryAccess*) pipe[3])->setMemLatency(config.memLatency);
+  ((MemoryAccess*) pipe[3])->setLinkRegister(&link);
+  ((WriteBack*) pipe[4])->setSyscallLatency(
+      max(config.wbLatency, config.syscallLatency));
+  if(config.fetchQueueWords > 0){
+    //if.latency goes to the accesses, taking a word off the queue is 1
+    fetchUnit = make_unique<frontend::FetchUnit>(mainMem,
+        config.fetchLineWords, config.fetchQueueWords, config.ifLatency,
+        config.loopBufferWords);
+    pipe[0]->setLatency(1);
+    ((InstructionFetch*) pipe[0])->setFetchUnit(fetchUnit.get());
+  }
 }
 
 bool Processor5S::updateCycle(int cycles){
+  link.setCycle(currentCycle);
 
   //update all the cycles
   for(PipelinePhase* stage : pipe){
@@ -42,23 +89,131 @@ bool Processor5S::updateCycle(int cycles){
   } while (firstStalling >= 0 && !(pipe[firstStalling]->isBusy()));
   bool stalling = firstStalling > -1;
 
-  StageOut* out = stalling ? nullptr : pc.getOut();
+  fetched = !stalling && fetching;
+  StageOut* out = fetched ? pc.getOut() : nullptr;
   for(int i = firstStalling + 1; i < pipe.size(); i++){
     StageOut* tempOut = pipe[i]->getOut();
     pipe[i]->execute(&out); //this deletes out
     out = tempOut;
   }
-  return ((WBOut*) out)->quit;
+  currentCycle += cycles;
+  //out is null when writeback itself is the stalling stage
+  WBOut* wbOut = (WBOut*) out;
+  bool quit = false;
+  if(wbOut != nullptr){
+    if(wbOut->addr != (data32) -1){
+      nRetired++;
+      if(wbOut->word != 0)
+        nOps++;
+      if(tracer != nullptr)
+        tracer->record(wbOut->addr, wbOut->word, wbOut->address,
+            pc.isRedirected(), pc.get());
+    }
+    quit = wbOut->quit;
+    delete wbOut;
+  }
+  return quit;
+}
+
+bool Processor5S::step(){
+  bool quit = updateCycle(1);
+  bool redirected = pc.takeRedirected();
+  if(fetched || redirected)
+    pc.inc(1);
+  return quit;
 }
 
-void Processor5S::start(int startI){
+void Processor5S::start(int startI, ostream& report){
+  PROFILE_RESET();
   pc.set(startI);
   bool quit = false;
   while(!quit){
-    quit = updateCycle(1);
-    pc.inc(1);
+    quit = step();
+  }
+  report << "Program Terminating" << endl;
+  PROFILE_REPORT(report, nRetired);
+}
+
+bool Processor5S::runFor(unsigned long nInstrs){
+  //saturating, so ULONG_MAX runs to the end
+  unsigned long until = nInstrs > ULONG_MAX - nRetired ? ULONG_MAX :
+    nRetired + nInstrs;
+  bool quit = false;
+  while(!quit && nRetired < until){
+    quit = step();
   }
-  cout << "Program Terminating" << endl;
+  return quit;
+}
+
+bool Processor5S::runForOps(unsigned long nOps){
+  unsigned long until = nOps > ULONG_MAX - this->nOps ? ULONG_MAX :
+    this->nOps + nOps;
+  bool quit = false;
+  while(!quit && this->nOps < until){
+    quit = step();
+  }
+  return quit;
+}
+
+void Processor5S::setPc(data32 startI){
+  pc.set(startI);
+  if(fetchUnit != nullptr)
+    fetchUnit->flush();
+}
+
+data32 Processor5S::getPc() const{
+  return pc.get();
+}
+
+void Processor5S::setFetching(bool on){
+  fetching = on;
+}
+
+bool Processor5S::isDrained() const{
+  for(const PipelinePhase* stage : pipe)
+    if(!stage->isEmpty())
+      return false;
+  return true;
+}
+
+void Processor5S::setAccumulator(data64 value){
+  acc = value;
+}
+
+data64 Processor5S::getAccumulator() const{
+  return acc;
+}
+
+void Processor5S::setSyscalls(sys::SyscallEmulator* emulator){
+  ((WriteBack*) pipe[4])->setSyscalls(emulator, &mainMem);
+}
+
+void Processor5S::setDataCache(coherence::L1Cache* cache){
+  ((MemoryAccess*) pipe[3])->setDataCache(cache);
+}
+
+atomics::LinkRegister& Processor5S::getLinkRegister(){
+  return link;
+}
+
+void Processor5S::setTraceWriter(trace::TraceWriter* writer){
+  tracer = writer;
+}
+
+unsigned int Processor5S::getCurrentCycle() const{
+  return currentCycle;
+}
+
+unsigned long Processor5S::getNRetired() const{
+  return nRetired;
+}
+
+unsigned long Processor5S::getNOps() const{
+  return nOps;
+}
+
+const frontend::FetchUnit* Processor5S::getFetchUnit() const{
+  return fetchUnit.get();
 }
 
 Processor5S::~Processor5S(){
@@ -66,42 +221,137 @@ Processor5S::~Processor5S(){
 }
 
 SizedArr<data32> MachineCodeFileReader::loadFile(string filename){
-  //load file
-  ifstream executableFile;
-  executableFile.open(filename);
-  //count newlines
-  size_t nInstrs = count(istreambuf_iterator<char>(executableFile), 
-             istreambuf_iterator<char>(), '\n');
-  //reset filereader
-  executableFile.seekg(0);
-  //create array based on number of instrs
-  data32* instrs = new data32[nInstrs+1];
-  for(int i = 0; i < nInstrs; i++){
-    executableFile >> hex >> instrs[i];
-  }
+  //the whole file at once, then parsed in place
+  ifstream executableFile(filename, ios::binary);
+  string text((istreambuf_iterator<char>(executableFile)),
+      istreambuf_iterator<char>());
   executableFile.close();
+  vector<data32> words;
+  //at most one word per 2 characters
+  words.reserve(text.size() / 2 + 1);
+  const char* c = text.c_str();
+  char* end;
+  while(true){
+    data32 word = strtoul(c, &end, 16);
+    if(end == c)
+      break;
+    words.push_back(word);
+    c = end;
+  }
+  data32* instrs = new data32[words.size()+1];
+  copy(words.begin(), words.end(), instrs);
   //Write a termination syscall
-  instrs[nInstrs] = 0xc;
+  instrs[words.size()] = 0xc;
   SizedArr<data32> sizedArr;
   sizedArr.arr = instrs;
-  sizedArr.size = nInstrs+1;
+  sizedArr.size = words.size()+1;
   return sizedArr;
 }
 
+ProgramImage MachineCodeFileReader::loadImage(string filename){
+  SizedArr<data32> exeSized = loadFile(filename);
+  ProgramImage image = make_shared<const vector<data32>>(exeSized.arr,
+      exeSized.arr + exeSized.size);
+  delete[] exeSized.arr;
+  return image;
+}
+
 //TODO really? this is the best way?
-ProgramLoader::ProgramLoader(MemoryUnit* mainMem, MemoryUnit* rf) : 
-  exeReader{}, p{"MIPSProcessor", *mainMem, *rf, 0, "pipeline.log"},
-  mainMem{mainMem}, rf{rf} {}
+ProgramLoader::ProgramLoader(MemoryUnit* mainMem, MemoryUnit* rf,
+    string logFilename, const SimConfig& config) : 
+  exeReader{}, p{"MIPSProcessor", *mainMem, *rf, 0, logFilename, config},
+  mainMem{mainMem}, rf{rf}, entry{0}, end{0}, exit{0} {}
+
+data32 ProgramLoader::load(string filename, MemoryUnit& mem){
+  if(!elf::ElfFile::isElf(filename))
+    return load(exeReader.loadImage(filename), mem);
+  elf::ElfFile elfFile(filename);
+  elfFile.load(mem);
+  //the exit condition right after the program, as for images
+  exit = elfFile.getEnd();
+  if(exit >= mem.getSize()){
+    BOOST_LOG_TRIVIAL(fatal) << "<<ProgramLoader>> no room after " <<
+      filename << " for the exit syscall" << endl;
+    throw std::exception();
+  }
+  mem.sw(exit, 0xc);
+  entry = elfFile.getEntry();
+  end = exit + 1;
+  symbols = elfFile.getSymbols();
+  return exit - 1;
+}
+
+data32 ProgramLoader::load(const ProgramImage& image, MemoryUnit& mem){
+  //storeBlock only reads the words
+  mem.storeBlock(0, const_cast<data32*>(image->data()), image->size());
+  entry = 0;
+  end = image->size();
+  //MachineCodeFileReader's, the last word
+  exit = end - 1;
+  symbols.clear();
+  return image->size() - 1;
+}
 
 void ProgramLoader::loadProgram(string filename){
-  SizedArr<data32> exeSized = exeReader.loadFile(filename);
-  mainMem->storeBlock(0, exeSized.arr, exeSized.size);
   //set R$31 to return to the exit condition
-  rf->sw(31,exeSized.size-1);
+  rf->sw(31, load(filename, *mainMem));
+}
+
+void ProgramLoader::loadProgram(const ProgramImage& image){
+  rf->sw(31, load(image, *mainMem));
+}
+
+void ProgramLoader::loadProgram(string filename, data32 base, data32 size){
+  for(const LoadedProgram& other : programs){
+    if(base < other.base + other.size && other.base < base + size){
+      BOOST_LOG_TRIVIAL(fatal) << "<<ProgramLoader>> the region for " <<
+        filename << " overlaps " << other.filename << "'s" << endl;
+      throw std::exception();
+    }
+  }
+  RelocatedMem region(*mainMem, base, size);
+  data32 returnAddr = load(filename, region);
+  programs.push_back({filename, base, size, entry, end, exit, returnAddr});
+}
+
+const vector<LoadedProgram>& ProgramLoader::getPrograms() const{
+  return programs;
+}
+
+void ProgramLoader::run(ostream& report){
+  p.start(entry, report);
+}
+
+data32 ProgramLoader::getEntry() const{
+  return entry;
+}
+
+data32 ProgramLoader::getEnd() const{
+  return end;
+}
+
+data32 ProgramLoader::getExit() const{
+  return exit;
+}
+
+const vector<elf::Symbol>& ProgramLoader::getSymbols() const{
+  return symbols;
+}
+
+const Processor5S& ProgramLoader::getProcessor() const{
+  return p;
+}
+
+Processor5S& ProgramLoader::getProcessor(){
+  return p;
+}
+
+MemoryUnit& ProgramLoader::getRegisterFile(){
+  return *rf;
 }
 
-void ProgramLoader::run(){
-  p.start(0);
+MemoryUnit& ProgramLoader::getMainMemory(){
+  return *mainMem;
 }
 
 ProgramLoader::~ProgramLoader(){
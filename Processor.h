@@ -3,12 +3,22 @@
 #include "Pipeline.h"
 #include "Instruction.h"
 #include "Mem.h"
+#include "Config.h"
+#include "Trace.h"
+#include "Elf.h"
+#include "Syscall.h"
+#include "FrontEnd.h"
+#include "Atomics.h"
 #include<array>
+#include<iostream>
+#include<memory>
+#include<vector>
 
 using namespace std;
 using namespace pipeline;
 using namespace instruction;
 using namespace mem;
+using namespace config;
 
 //TODO how am I to handle memory. Would love to not deal with 4GB of RAM
 //and I need a bit for my instructions
@@ -21,27 +31,159 @@ class Processor5S{
     data64 acc;
     string name;
     unsigned int currentCycle;
+    /* number of instructions that made it out of writeback */
+    unsigned long nRetired;
+    /* of those, the ones that were not nops */
+    unsigned long nOps;
+    /* whether the last cycle took an address from the pc */
+    bool fetched;
+    /* whether cycles may take one, see setFetching */
+    bool fetching;
+    /* records retired instructions when set */
+    trace::TraceWriter* tracer;
+    /* the decoupled front end, if the config has one */
+    unique_ptr<frontend::FetchUnit> fetchUnit;
+    /* for ll, sc and sync */
+    atomics::LinkRegister link;
     ofstream log;
+
+    /*
+     * makes the stages, on this processor's memories, timed by config
+     */
+    void buildPipe(const SimConfig& config);
     
   public:
     /*
      * memSize is the size of MainMemory
      * rfSize is the size of the RegisterFile
+     * logFilename is where the per cycle stage trace goes, "" for no trace
+     * config gives the stage latencies
      */
     Processor5S(string name, MemoryUnit& mainMem, MemoryUnit& rf, 
-        data32 instrStart, string logFilename);
+        data32 instrStart, string logFilename,
+        const SimConfig& config = SimConfig());
+
+    /*
+     * a copy of other as it is mid run, on memories of its own. mainMem and
+     * rf must hold what other's do (CowMem::clone makes that cheap). What
+     * is in flight keeps the timing it has, what comes after goes by config.
+     * other's trace writer is not carried over
+     */
+    Processor5S(const Processor5S& other, MemoryUnit& mainMem,
+        MemoryUnit& rf, string logFilename, const SimConfig& config);
 
     /*
      * The method to advance time for the processor
      * returns true if this cycle caused a quit condition. Otherwise false
      */
     bool updateCycle(int timeToAdvance);
+
+    /*
+     * Advances the processor by one cycle and moves the program counter
+     * along, unless the front of the pipe stalled. A pc redirected in a stall
+     * still moves on, as a taken branch to x continues at x + 1.
+     * This is one iteration of start.
+     * returns true if this cycle caused a quit condition. Otherwise false
+     */
+    bool step();
     
     /*
      * Starts the processor going at location i in main memory.
-     * It'll only stop when it executes a syscall
+     * It'll only stop when it executes a syscall. The termination message
+     * (and profile, if built in) go to report
+     */
+    void start(int startI, ostream& report = cout);
+
+    /*
+     * Runs on from wherever the processor is until nInstrs more instructions
+     * have retired or the syscall has. Before the first call, setPc says
+     * where to start. Lets a run be done in pieces, measuring each
+     * returns true if it stopped at the syscall, which ends the program
+     */
+    bool runFor(unsigned long nInstrs);
+
+    /*
+     * as runFor, counting only instructions that are not nops. How many
+     * nops run in delay slots depends on the timing, the rest does not
+     */
+    bool runForOps(unsigned long nOps);
+
+    /*
+     * points the pc at startI, for runFor, and drops what the front end
+     * fetched ahead. Meant for an empty pipe
+     */
+    void setPc(data32 startI);
+
+    /*
+     * returns: the address the next fetch takes, the one to resume at once
+     *   the pipe is drained
      */
-    void start(int startI);
+    data32 getPc() const;
+
+    /*
+     * with on false, cycles take no more addresses from the pc, and the
+     * pipe drains: what is in it retires and a branch in it still moves
+     * the pc, skipping the delay slots not yet fetched, which are nops in
+     * this dialect. For a context switch
+     */
+    void setFetching(bool on);
+
+    /*
+     * returns: whether every stage is empty (see PipelinePhase::isEmpty)
+     */
+    bool isDrained() const;
+
+    /*
+     * sets hi and lo (hi in the upper word), for starting a program in the
+     * middle from a functional simulation's state
+     */
+    void setAccumulator(data64 value);
+    data64 getAccumulator() const;
+
+    /*
+     * records every instruction retired from now on into writer (see
+     * Trace.h), nullptr to stop. The writer is not owned
+     */
+    void setTraceWriter(trace::TraceWriter* writer);
+
+    /*
+     * runs syscalls on emulator (see Syscall.h) from now on, rather than
+     * ending at the first, nullptr to stop. The emulator is not owned
+     */
+    void setSyscalls(sys::SyscallEmulator* emulator);
+
+    /*
+     * times loads and stores by cache (see Coherence.h) from now on, for
+     * MultiCoreSim, nullptr to stop. The cache is not owned
+     */
+    void setDataCache(coherence::L1Cache* cache);
+
+    /*
+     * returns: the link ll sets and sc checks (see Atomics.h), for
+     *   MultiCoreSim to hand to its Arbiter. A copy starts unlinked
+     */
+    atomics::LinkRegister& getLinkRegister();
+
+    /*
+     * returns: the number of cycles this processor has simulated
+     */
+    unsigned int getCurrentCycle() const;
+
+    /*
+     * returns: the number of (non bubble) instructions retired by writeback
+     */
+    unsigned long getNRetired() const;
+
+    /*
+     * returns: the number of those that were not nops
+     */
+    unsigned long getNOps() const;
+
+    /*
+     * returns: the decoupled front end (see FrontEnd.h), nullptr if the
+     *   config has none
+     */
+    const frontend::FetchUnit* getFetchUnit() const;
 
     /*
      * close the log
@@ -59,9 +201,41 @@ struct SizedArr{
   size_t size;
 };
 
+/*
+ * A program as loaded from its file, terminating syscall included. It is
+ * never written, so any number of ProgramLoaders can share one
+ */
+typedef shared_ptr<const vector<data32>> ProgramImage;
+
 class MachineCodeFileReader{
   public:
+    /*
+     * reads a program as hex words, whitespace separated, in one pass, and
+     * appends the terminating syscall
+     */
     SizedArr<data32> loadFile(string filename);
+    /*
+     * returns: the program in filename as a shareable image
+     */
+    ProgramImage loadImage(string filename);
+};
+
+/*
+ * one of several programs a ProgramLoader put in its main memory, in words
+ * base to base + size, which the program sees as 0 to size (see
+ * RelocatedMem)
+ */
+struct LoadedProgram{
+  string filename;
+  data32 base;
+  data32 size;
+  /* in the program's addresses */
+  data32 entry;
+  data32 end;
+  /* the loader's ending syscall */
+  data32 exit;
+  /* what $31 starts as, for returning to the exit syscall */
+  data32 returnAddr;
 };
 
 class ProgramLoader{
@@ -70,10 +244,85 @@ class ProgramLoader{
     Processor5S p; //will be overwritten by constructor
     MemoryUnit* mainMem;
     MemoryUnit* rf;
+    data32 entry;
+    data32 end;
+    data32 exit;
+    vector<elf::Symbol> symbols;
+    vector<LoadedProgram> programs;
+
+    /*
+     * loads filename (or image) into mem, setting entry, end, exit and
+     * symbols
+     * returns: what $31 should start as
+     * throws: as loadProgram
+     */
+    data32 load(string filename, MemoryUnit& mem);
+    data32 load(const ProgramImage& image, MemoryUnit& mem);
   public:
-    ProgramLoader(MemoryUnit* mainMem, MemoryUnit* rf);
+    /*
+     * takes ownership of mainMem and rf. logFilename is the processor's
+     * stage trace, "" for none. config's mem.words is up to the caller, who
+     * sizes mainMem
+     */
+    ProgramLoader(MemoryUnit* mainMem, MemoryUnit* rf,
+        string logFilename = "pipeline.log",
+        const SimConfig& config = SimConfig());
+    /*
+     * loads filename, an ELF executable (see Elf.h) or hex words as
+     * MachineCodeFileReader reads them
+     * throws: exception if an ELF file is broken or doesn't fit in memory
+     */
     void loadProgram(string filename);
-    void run();
+    /*
+     * copies a (possibly shared) image into this loader's main memory
+     */
+    void loadProgram(const ProgramImage& image);
+    /*
+     * loads filename as above, but into words base to base + size of main
+     * memory, to run from 0 as its own. Any number of programs can be
+     * loaded so, into regions apart, for MultiProgramSim (see
+     * MultiProgram.h). The registers are left alone, getEntry, getEnd and
+     * getSymbols are the program's in its own addresses
+     * throws: exception if the region is past the end of main memory or
+     *   overlaps another program's, or the program doesn't fit in it
+     */
+    void loadProgram(string filename, data32 base, data32 size);
+    /*
+     * returns: the programs loaded into regions, in the order they were
+     */
+    const vector<LoadedProgram>& getPrograms() const;
+    /*
+     * returns: where run starts, e_entry for ELF files, 0 otherwise
+     */
+    data32 getEntry() const;
+    /*
+     * returns: the first word past the program and its exit syscall, where
+     * a heap could start
+     */
+    data32 getEnd() const;
+    /*
+     * returns: where the syscall the loader put after the program is, for
+     *   SyscallEmulator::setEndMarker
+     */
+    data32 getExit() const;
+    /*
+     * returns: the ELF file's symbols by address, none for hex programs
+     */
+    const vector<elf::Symbol>& getSymbols() const;
+    void run(ostream& report = cout);
+    /*
+     * returns: the processor, e.g. to read its cycle counts after run
+     */
+    const Processor5S& getProcessor() const;
+    Processor5S& getProcessor();
+    /*
+     * returns: the register file, where programs leave their results
+     */
+    MemoryUnit& getRegisterFile();
+    /*
+     * returns: main memory, with the program in it once loaded
+     */
+    MemoryUnit& getMainMemory();
     ~ProgramLoader();
 };
 #endif
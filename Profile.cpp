@@ -0,0 +1,171 @@
+#include "Profile.h"
+#ifdef CCA_PROFILE
+#include <x86intrin.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+using namespace std;
+
+namespace profile{
+
+  static const char* COMPONENT_NAMES[N_COMPONENTS] = {
+    "IF::execute", "IF::getOut",
+    "ID::execute", "ID::getOut",
+    "EX::execute", "EX::getOut",
+    "MA::execute", "MA::getOut",
+    "WB::execute", "WB::getOut",
+    "MemoryUnit::ld", "MemoryUnit::sw",
+    "trace"
+  };
+
+  struct Counter{
+    unsigned long calls = 0;
+    unsigned long tsc = 0;
+    unsigned long misses = 0;
+  };
+
+  /*
+   * All the state of the profiler. One per thread so simulations on different
+   * threads don't fight over it.
+   */
+  struct ProfileState{
+    array<Counter, N_COMPONENTS> counters;
+    ScopedTimer* current = nullptr;
+    unsigned long startTsc;
+    chrono::steady_clock::time_point startTime;
+    int missFd = -1;
+    bool missesAvailable = false;
+
+    ProfileState(){
+      startTsc = __rdtsc();
+      startTime = chrono::steady_clock::now();
+      if(getenv("CCA_PROFILE_MISSES") != nullptr){
+        openMissCounter();
+      }
+    }
+
+    /*
+     * tries to open a host cache miss counter for this thread. Leaves
+     * missesAvailable false if perf isn't allowed (containers, paranoid
+     * kernels...)
+     */
+    void openMissCounter(){
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      missFd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+      missesAvailable = missFd >= 0;
+    }
+
+    unsigned long readMisses(){
+      if(!missesAvailable){
+        return 0;
+      }
+      unsigned long count = 0;
+      if(read(missFd, &count, sizeof(count)) != sizeof(count)){
+        return 0;
+      }
+      return count;
+    }
+
+    ~ProfileState(){
+      if(missFd >= 0){
+        close(missFd);
+      }
+    }
+  };
+
+  static thread_local ProfileState state;
+
+  ScopedTimer::ScopedTimer(Component component) : component{component},
+    childTsc{0}, childMisses{0}, parent{state.current} {
+    state.current = this;
+    startMisses = state.readMisses();
+    startTsc = __rdtsc();
+  }
+
+  ScopedTimer::~ScopedTimer(){
+    unsigned long elapsed = __rdtsc() - startTsc;
+    unsigned long misses = state.readMisses() - startMisses;
+    Counter& counter = state.counters[component];
+    counter.calls++;
+    //exclusive time, children charge themselves
+    counter.tsc += elapsed - childTsc;
+    counter.misses += misses - childMisses;
+    if(parent != nullptr){
+      parent->childTsc += elapsed;
+      parent->childMisses += misses;
+    }
+    state.current = parent;
+  }
+
+  void report(ostream& out, unsigned long nInstrs){
+    //calibrate the tsc against the wall clock over the whole run
+    double ns = chrono::duration<double, nano>(
+        chrono::steady_clock::now() - state.startTime).count();
+    double nsPerTick = ns / (double) (__rdtsc() - state.startTsc);
+    double perInstr = nInstrs == 0 ? 0 : 1.0 / nInstrs;
+
+    vector<int> order(N_COMPONENTS);
+    for(int i = 0; i < N_COMPONENTS; i++)
+      order[i] = i;
+    sort(order.begin(), order.end(), [](int a, int b){
+      return state.counters[a].tsc > state.counters[b].tsc;
+    });
+
+    unsigned long totalTsc = 0;
+    for(const Counter& c : state.counters)
+      totalTsc += c.tsc;
+
+    out << "==== host profile (" << nInstrs << " simulated instructions, "
+      << fixed << setprecision(1) << ns * perInstr << " ns/instr overall) ===="
+      << endl;
+    out << left << setw(16) << "component" << right << setw(12) << "calls"
+      << setw(12) << "total ms" << setw(10) << "share" << setw(12)
+      << "ns/call" << setw(12) << "ns/instr";
+    if(state.missesAvailable)
+      out << setw(14) << "misses/instr";
+    out << endl;
+    for(int i : order){
+      const Counter& c = state.counters[i];
+      if(c.calls == 0)
+        continue;
+      double cNs = c.tsc * nsPerTick;
+      out << left << setw(16) << COMPONENT_NAMES[i] << right << setw(12)
+        << c.calls << setw(12) << setprecision(2) << cNs / 1e6
+        << setw(9) << setprecision(1) << 100.0 * c.tsc / totalTsc << "%"
+        << setw(12) << cNs / c.calls << setw(12) << cNs * perInstr;
+      if(state.missesAvailable)
+        out << setw(14) << setprecision(3) << c.misses * perInstr;
+      out << endl;
+    }
+    if(!state.missesAvailable && state.missFd < 0 &&
+        getenv("CCA_PROFILE_MISSES") != nullptr){
+      out << "(host cache misses unavailable: perf_event_open refused)"
+        << endl;
+    }
+    out << defaultfloat;
+  }
+
+  void reset(){
+    for(Counter& c : state.counters)
+      c = Counter();
+    state.startTsc = __rdtsc();
+    state.startTime = chrono::steady_clock::now();
+  }
+}
+#endif
@@ -0,0 +1,84 @@
+#ifndef PROFILE_H_INCLUDED
+#define PROFILE_H_INCLUDED
+#include <ostream>
+/*
+ * Host-side self profiling of the simulator. This is about where the *host*
+ * spends its time, not about simulated cycles.
+ *
+ * Everything in here is only compiled in when CCA_PROFILE is defined
+ * (make PROFILE=1). Otherwise the macros expand to nothing, so the
+ * instrumented code is exactly the uninstrumented code.
+ *
+ * Usage:
+ *   PROFILE_SCOPE(MEM_LD); //times the rest of the enclosing block
+ *   PROFILE_REPORT(cout, nInstrs); //prints the ranked table
+ *
+ * Timing is taken with rdtsc and converted to ns against steady_clock.
+ * Times are exclusive, so time spent in a nested scope (like a ld inside of
+ * MemoryAccess::getOut) is only charged to the inner component.
+ * If the environment variable CCA_PROFILE_MISSES is set, host cache misses
+ * are also counted with perf_event_open when the kernel lets us.
+ */
+#ifdef CCA_PROFILE
+namespace profile{
+
+  enum Component {
+    IF_EXECUTE, IF_GETOUT,
+    ID_EXECUTE, ID_GETOUT,
+    EX_EXECUTE, EX_GETOUT,
+    MA_EXECUTE, MA_GETOUT,
+    WB_EXECUTE, WB_GETOUT,
+    MEM_LD, MEM_SW,
+    TRACE,
+    N_COMPONENTS
+  };
+
+  /*
+   * Times a scope and charges it to a component. Don't use directly, use
+   * PROFILE_SCOPE
+   */
+  class ScopedTimer{
+    private:
+      Component component;
+      unsigned long startTsc;
+      unsigned long startMisses;
+      unsigned long childTsc;
+      unsigned long childMisses;
+      ScopedTimer* parent;
+
+    public:
+      ScopedTimer(Component component);
+      ~ScopedTimer();
+  };
+
+  /*
+   * prints a table of components ranked by host time.
+   * params:
+   *   out: the stream to print to
+   *   nInstrs: the number of simulated instructions for the per instruction
+   *     columns
+   */
+  void report(std::ostream& out, unsigned long nInstrs);
+
+  /*
+   * zeroes all the counters of this thread
+   */
+  void reset();
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(component) \
+  profile::ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)( \
+      profile::component)
+#define PROFILE_REPORT(out, nInstrs) profile::report(out, nInstrs)
+#define PROFILE_RESET() profile::reset()
+
+#else
+
+#define PROFILE_SCOPE(component)
+#define PROFILE_REPORT(out, nInstrs)
+#define PROFILE_RESET()
+
+#endif
+#endif
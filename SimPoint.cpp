@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include "SimPoint.h"
+#include "Functional.h"
+
+using namespace std;
+using namespace functional;
+
+namespace simpoint{
+
+  namespace {
+    typedef vector<double> Point;
+
+    /* k-means runs per k, the best is kept */
+    const int RESTARTS = 5;
+    const int MAX_ITERATIONS = 100;
+    /* SimPoint's rule: the smallest k scoring this share of the BIC range */
+    const double BIC_THRESHOLD = 0.9;
+
+    double distance2(const Point& a, const Point& b){
+      double sum = 0;
+      for(size_t d = 0; d < a.size(); d++)
+        sum += (a[d] - b[d]) * (a[d] - b[d]);
+      return sum;
+    }
+
+    /*
+     * each BBV as a fraction of its interval, times a random matrix with
+     * one row per block, drawn in [-1, 1] from the block's pc and the seed
+     */
+    vector<Point> project(const vector<BBV>& bbvs, unsigned int dims,
+        unsigned int seed){
+      unordered_map<data32, Point> rows;
+      vector<Point> points;
+      for(const BBV& bbv : bbvs){
+        double total = 0;
+        for(const pair<data32, uint32_t>& block : bbv)
+          total += block.second;
+        Point p(dims, 0);
+        for(const pair<data32, uint32_t>& block : bbv){
+          Point& row = rows[block.first];
+          if(row.empty()){
+            mt19937_64 gen(((uint64_t) seed << 32) ^ block.first);
+            uniform_real_distribution<double> dist(-1, 1);
+            for(unsigned int d = 0; d < dims; d++)
+              row.push_back(dist(gen));
+          }
+          for(unsigned int d = 0; d < dims; d++)
+            p[d] += row[d] * block.second / total;
+        }
+        points.push_back(p);
+      }
+      return points;
+    }
+
+    struct KMeans{
+      vector<Point> centroids;
+      vector<unsigned int> assignment;
+      double sse;
+    };
+
+    /*
+     * Lloyd's algorithm from a k-means++ start
+     */
+    KMeans kMeans(const vector<Point>& points, unsigned int k,
+        mt19937_64& gen){
+      KMeans result;
+      //k-means++: each next centroid a point picked by squared distance
+      result.centroids.push_back(
+          points[uniform_int_distribution<size_t>(0, points.size() - 1)(gen)]);
+      vector<double> nearest(points.size(), numeric_limits<double>::max());
+      while(result.centroids.size() < k){
+        double total = 0;
+        for(size_t i = 0; i < points.size(); i++){
+          nearest[i] = min(nearest[i],
+              distance2(points[i], result.centroids.back()));
+          total += nearest[i];
+        }
+        double pick = uniform_real_distribution<double>(0, total)(gen);
+        size_t chosen = 0;
+        while(chosen + 1 < points.size() && pick >= nearest[chosen]){
+          pick -= nearest[chosen];
+          chosen++;
+        }
+        result.centroids.push_back(points[chosen]);
+      }
+
+      result.assignment.assign(points.size(), 0);
+      for(int iteration = 0; iteration < MAX_ITERATIONS; iteration++){
+        bool changed = iteration == 0;
+        for(size_t i = 0; i < points.size(); i++){
+          unsigned int best = 0;
+          for(unsigned int c = 1; c < k; c++)
+            if(distance2(points[i], result.centroids[c]) <
+                distance2(points[i], result.centroids[best]))
+              best = c;
+          changed = changed || best != result.assignment[i];
+          result.assignment[i] = best;
+        }
+        if(!changed)
+          break;
+        vector<Point> sums(k, Point(points[0].size(), 0));
+        vector<size_t> counts(k, 0);
+        for(size_t i = 0; i < points.size(); i++){
+          counts[result.assignment[i]]++;
+          for(size_t d = 0; d < points[i].size(); d++)
+            sums[result.assignment[i]][d] += points[i][d];
+        }
+        //an emptied cluster keeps its old centroid
+        for(unsigned int c = 0; c < k; c++)
+          if(counts[c] > 0)
+            for(size_t d = 0; d < sums[c].size(); d++)
+              result.centroids[c][d] = sums[c][d] / counts[c];
+      }
+      //k above the distinct points leaves clusters empty, whose centroids
+      //would have no interval to represent them. Drop and renumber them
+      vector<unsigned int> renumber(k, k);
+      vector<Point> kept;
+      for(unsigned int a : result.assignment){
+        if(renumber[a] == k){
+          renumber[a] = kept.size();
+          kept.push_back(result.centroids[a]);
+        }
+      }
+      result.centroids = move(kept);
+      for(unsigned int& a : result.assignment)
+        a = renumber[a];
+      result.sse = 0;
+      for(size_t i = 0; i < points.size(); i++)
+        result.sse += distance2(points[i],
+            result.centroids[result.assignment[i]]);
+      return result;
+    }
+
+    /*
+     * the Bayesian information criterion of a clustering, for spherical
+     * Gaussians of one shared variance (Pelleg and Moore's X-means)
+     */
+    double bic(const KMeans& km, size_t n, size_t dims){
+      size_t k = km.centroids.size();
+      if(n <= k)
+        return -numeric_limits<double>::max();
+      double variance = max(km.sse / (n - k), 1e-12);
+      vector<size_t> counts(k, 0);
+      for(unsigned int a : km.assignment)
+        counts[a]++;
+      double likelihood = 0;
+      for(size_t count : counts){
+        if(count == 0)
+          continue;
+        likelihood += count * log((double) count / n) -
+          count * dims / 2.0 * log(2 * M_PI * variance) -
+          (count - 1) * dims / 2.0;
+      }
+      double parameters = (k - 1) + k * dims + 1;
+      return likelihood - parameters / 2 * log((double) n);
+    }
+
+    /*
+     * copies memory a word at a time, the only way MemoryUnit allows
+     */
+    unique_ptr<DRAM> copyOf(MemoryUnit& from, const string& name){
+      vector<data32> words(from.getSize());
+      for(size_t i = 0; i < words.size(); i++)
+        words[i] = from.ld(i);
+      auto to = make_unique<DRAM>(words.size(), name);
+      to->storeBlock(0, words.data(), words.size());
+      return to;
+    }
+  }
+
+  vector<BBV> profile(MemoryUnit& mainMem, MemoryUnit& rf,
+      unsigned long intervalLength){
+    FunctionalCore core(mainMem, rf, 0);
+    vector<BBV> bbvs;
+    unordered_map<data32, uint32_t> counts;
+    TraceRecord r;
+    data32 block = 0;
+    data32 last = (data32) -1;
+    unsigned long inInterval = 0;
+    bool running = true;
+    while(running){
+      running = core.step(r);
+      //a block starts wherever the pc did not just move on by one
+      if(r.pc != last + 1)
+        block = r.pc;
+      last = r.pc;
+      counts[block]++;
+      if(++inInterval == intervalLength || !running){
+        bbvs.push_back(BBV(counts.begin(), counts.end()));
+        sort(bbvs.back().begin(), bbvs.back().end());
+        counts.clear();
+        inInterval = 0;
+      }
+    }
+    return bbvs;
+  }
+
+  Clustering cluster(const vector<BBV>& bbvs, unsigned int maxK,
+      unsigned int dims, unsigned int seed, unsigned int minK){
+    vector<Point> points = project(bbvs, dims, seed);
+    mt19937_64 gen(seed);
+    maxK = max(1u, min(maxK, (unsigned int) points.size()));
+    minK = max(1u, min(minK, maxK));
+    vector<KMeans> best;
+    vector<double> scores;
+    for(unsigned int k = minK; k <= maxK; k++){
+      KMeans bestK;
+      bestK.sse = numeric_limits<double>::max();
+      for(int restart = 0; restart < RESTARTS; restart++){
+        KMeans km = kMeans(points, k, gen);
+        if(km.sse < bestK.sse)
+          bestK = km;
+      }
+      best.push_back(bestK);
+      scores.push_back(bic(bestK, points.size(), dims));
+    }
+    //scores of -max are k = n, where BIC is undefined, leave them out
+    double low = numeric_limits<double>::max();
+    double high = -numeric_limits<double>::max();
+    for(double s : scores){
+      if(s == -numeric_limits<double>::max())
+        continue;
+      low = min(low, s);
+      high = max(high, s);
+    }
+    unsigned int chosen = 0;
+    if(low <= high)
+      while(scores[chosen] < low + BIC_THRESHOLD * (high - low))
+        chosen++;
+
+    Clustering c;
+    const KMeans& km = best[chosen];
+    c.k = km.centroids.size();
+    c.assignment = km.assignment;
+    c.representatives.assign(c.k, (size_t) -1);
+    vector<double> closest(c.k, numeric_limits<double>::max());
+    for(size_t i = 0; i < points.size(); i++){
+      unsigned int a = km.assignment[i];
+      double d = distance2(points[i], km.centroids[a]);
+      if(d < closest[a]){
+        closest[a] = d;
+        c.representatives[a] = i;
+      }
+    }
+    return c;
+  }
+
+  SampledSim::SampledSim(const ProgramImage& image, const SimConfig& config,
+      const SimPointConfig& simPoint) : image{image}, config{config},
+    simPoint{simPoint} {}
+
+  pair<unique_ptr<DRAM>, unique_ptr<DRAM>> SampledSim::load() const{
+    auto mainMem = make_unique<DRAM>(config.memWords, "MainMem");
+    auto rf = make_unique<DRAM>(0b100000, "rf");
+    //as ProgramLoader::loadProgram
+    mainMem->storeBlock(0, const_cast<data32*>(image->data()), image->size());
+    rf->sw(31, image->size() - 1);
+    return {move(mainMem), move(rf)};
+  }
+
+  Estimate SampledSim::run(){
+    Estimate estimate;
+    auto profiled = load();
+    vector<BBV> bbvs = profile(*profiled.first, *profiled.second,
+        simPoint.intervalLength);
+    profiled = {};
+    Clustering c = cluster(bbvs, simPoint.maxK, simPoint.dims, simPoint.seed,
+        simPoint.minK);
+    estimate.nIntervals = bbvs.size();
+
+    //the phases, and which intervals to simulate for each
+    mt19937_64 gen(simPoint.seed);
+    vector<vector<size_t>> members(c.k);
+    for(size_t i = 0; i < c.assignment.size(); i++)
+      members[c.assignment[i]].push_back(i);
+    //interval -> (phase, index in its simulated)
+    vector<pair<size_t, size_t>> chosen;
+    for(unsigned int p = 0; p < c.k; p++){
+      Phase phase;
+      phase.nIntervals = members[p].size();
+      phase.weight = (double) phase.nIntervals / bbvs.size();
+      phase.simulated.push_back(c.representatives[p]);
+      vector<size_t> others;
+      for(size_t i : members[p])
+        if(i != c.representatives[p])
+          others.push_back(i);
+      shuffle(others.begin(), others.end(), gen);
+      for(size_t i = 0; i + 1 < simPoint.samples && i < others.size(); i++)
+        phase.simulated.push_back(others[i]);
+      phase.cpis.assign(phase.simulated.size(), 0);
+      for(size_t s = 0; s < phase.simulated.size(); s++)
+        chosen.push_back({phase.simulated[s], p * simPoint.samples + s});
+      estimate.phases.push_back(phase);
+    }
+    sort(chosen.begin(), chosen.end());
+
+    //one functional pass, stopping at each chosen interval's warmup
+    auto state = load();
+    FunctionalCore core(*state.first, *state.second, 0);
+    TraceRecord r;
+    bool running = true;
+    estimate.nDetailed = 0;
+    for(const pair<size_t, size_t>& interval : chosen){
+      unsigned long start = interval.first * simPoint.intervalLength;
+      unsigned long from = start > simPoint.warmup ? start - simPoint.warmup
+        : 0;
+      //an empty pipe can only start where nothing is in flight
+      while(running && (core.getNExecuted() < from || !core.isQuiet()))
+        running = core.step(r);
+
+      unique_ptr<DRAM> mainMem = copyOf(*state.first, "MainMem");
+      DRAM rf(0b100000, "rf");
+      array<data32, 32> regs = core.getRegisters();
+      for(data32 i = 0; i < 32; i++)
+        rf.sw(i, regs[i]);
+      Processor5S p("MIPSProcessor", *mainMem, rf, 0, "", config);
+      p.setAccumulator(core.getAccumulator());
+      p.setPc(core.getPc());
+      unsigned long warmup = start > core.getNExecuted() ?
+        start - core.getNExecuted() : 0;
+      bool quit = warmup > 0 && p.runFor(warmup);
+      unsigned long cycles = p.getCurrentCycle();
+      unsigned long retired = p.getNRetired();
+      if(!quit)
+        p.runFor(simPoint.intervalLength);
+      estimate.nDetailed += p.getNRetired();
+      double cpi = p.getNRetired() > retired ?
+        (double) (p.getCurrentCycle() - cycles) / (p.getNRetired() - retired)
+        : 0;
+      size_t phase = interval.second / simPoint.samples;
+      estimate.phases[phase].cpis[interval.second % simPoint.samples] = cpi;
+    }
+    while(running)
+      running = core.step(r);
+    estimate.nInstrs = core.getNExecuted();
+
+    //stratified: each phase's mean, and its variance shrunk by sampling
+    //without replacement
+    estimate.cpi = 0;
+    double variance = 0;
+    bool bounded = true;
+    for(Phase& phase : estimate.phases){
+      size_t m = phase.cpis.size();
+      double mean = 0;
+      for(double cpi : phase.cpis)
+        mean += cpi / m;
+      phase.cpi = mean;
+      estimate.cpi += phase.weight * mean;
+      if(m == phase.nIntervals)
+        continue;
+      if(m < 2){
+        bounded = false;
+        continue;
+      }
+      double s2 = 0;
+      for(double cpi : phase.cpis)
+        s2 += (cpi - mean) * (cpi - mean) / (m - 1);
+      variance += phase.weight * phase.weight *
+        (1 - (double) m / phase.nIntervals) * s2 / m;
+    }
+    estimate.bound = bounded ? 2 * sqrt(variance) : -1;
+    return estimate;
+  }
+}
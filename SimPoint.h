@@ -0,0 +1,125 @@
+#ifndef SIMPOINT_H_INCLUDED
+#define SIMPOINT_H_INCLUDED
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Mem.h"
+#include "Config.h"
+#include "Processor.h"
+
+using namespace std;
+using namespace mem;
+using namespace config;
+/*
+ * SimPoint style sampled simulation: estimate a long run's CPI from detailed
+ * simulation of a few representative slices of it.
+ *
+ * A functional pass (FunctionalCore, see Functional.h) cuts the run into
+ * intervals of a fixed number of instructions and counts, per interval, the
+ * instructions executed in each basic block: its basic block vector (BBV).
+ * The BBVs are randomly projected down to a few dimensions and clustered
+ * with k-means, k picked by the Bayesian information criterion as SimPoint
+ * does. Intervals in a cluster run the same code, so they should time alike:
+ * each cluster is a phase, weighted by its share of the intervals.
+ *
+ * SampledSim then runs the program functionally again, and at each chosen
+ * interval hands a copy of the state to a Processor5S. That simulates a
+ * warmup, then the interval, in detail. Every phase gets its representative
+ * (the interval closest to the centroid) and, for an error bound, a few
+ * more of its intervals at random. The estimate is the weighted mean of the
+ * phases' CPIs. The bound treats the phases as strata of a stratified
+ * sample: twice the standard error, so roughly 95%.
+ */
+namespace simpoint{
+
+  /* instructions executed per basic block, by the block's first pc */
+  typedef vector<pair<data32, uint32_t>> BBV;
+
+  struct SimPointConfig{
+    /* instructions per interval */
+    unsigned long intervalLength = 10000;
+    /* the fewest and most clusters tried, equal to fix k */
+    unsigned int minK = 1;
+    unsigned int maxK = 10;
+    /* dimensions BBVs are projected to */
+    unsigned int dims = 15;
+    /* intervals simulated per phase, 1 for just the representative */
+    unsigned int samples = 2;
+    /* instructions simulated in detail before each interval */
+    unsigned long warmup = 1000;
+    unsigned int seed = 1;
+  };
+
+  /*
+   * runs a program functionally to its syscall
+   * params:
+   *   mainMem, rf: loaded with the program, as ProgramLoader does. Both are
+   *     changed by the run
+   * returns: one BBV per interval, the last one maybe short
+   */
+  vector<BBV> profile(MemoryUnit& mainMem, MemoryUnit& rf,
+      unsigned long intervalLength);
+
+  struct Clustering{
+    /* clusters with at least one interval, maybe fewer than tried */
+    unsigned int k;
+    /* each interval's cluster */
+    vector<unsigned int> assignment;
+    /* each cluster's interval closest to its centroid */
+    vector<size_t> representatives;
+  };
+
+  /*
+   * projects and clusters BBVs, trying minK to maxK clusters. Clusters
+   * k-means leaves empty, as it does with k above the distinct BBVs, are
+   * dropped
+   */
+  Clustering cluster(const vector<BBV>& bbvs, unsigned int maxK,
+      unsigned int dims, unsigned int seed, unsigned int minK = 1);
+
+  struct Phase{
+    /* share of the intervals */
+    double weight;
+    size_t nIntervals;
+    /* the intervals simulated, representative first, and their CPIs */
+    vector<size_t> simulated;
+    vector<double> cpis;
+    double cpi;
+  };
+
+  struct Estimate{
+    double cpi;
+    /* half width of the ~95% interval around cpi, -1 if not known */
+    double bound;
+    vector<Phase> phases;
+    size_t nIntervals;
+    /* instructions of the whole run, counted functionally */
+    unsigned long nInstrs;
+    /* instructions simulated in detail, warmups included */
+    unsigned long nDetailed;
+  };
+
+  class SampledSim{
+    private:
+      ProgramImage image;
+      SimConfig config;
+      SimPointConfig simPoint;
+
+      /*
+       * a fresh main memory and register file with the program loaded
+       */
+      pair<unique_ptr<DRAM>, unique_ptr<DRAM>> load() const;
+
+    public:
+      SampledSim(const ProgramImage& image, const SimConfig& config,
+          const SimPointConfig& simPoint);
+
+      /*
+       * profiles, clusters and simulates the chosen intervals
+       * throws: exception if the program does
+       */
+      Estimate run();
+  };
+}
+#endif
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include "Sliced.h"
+#include "Checkpoint.h"
+#include "Functional.h"
+#include "Mem.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace mem;
+using namespace pool;
+using namespace functional;
+using namespace checkpoint;
+
+namespace sliced{
+
+  namespace {
+    /* the end of a slice that runs to the syscall */
+    const unsigned long TO_END = ULONG_MAX;
+  }
+
+  SlicedSim::SlicedSim(const ProgramImage& image, const SimConfig& config,
+      const SliceConfig& slicing) : image{image}, config{config},
+    slicing{slicing} {}
+
+  SlicedResult SlicedSim::run(){
+    WorkStealingPool workers(slicing.nThreads);
+    mutex lock;
+    vector<Slice> slices;
+    atomic<bool> failed{false};
+
+    //one slice in detail, from op start to op end of the program, from
+    //checkpoint c at op cOps
+    auto simulate = [&](size_t index, shared_ptr<const Checkpoint> c,
+        unsigned long cOps, unsigned long start, unsigned long end){
+      try{
+        DRAM mainMem(config.memWords, "MainMem");
+        DRAM rf(0b100000, "rf");
+        restore(*c, image, mainMem, rf);
+        Processor5S p("MIPSProcessor", mainMem, rf, 0, "", config);
+        checkpoint::start(*c, p);
+        Slice s;
+        s.start = start;
+        p.runForOps(start - cOps);
+        s.warmup = p.getNRetired();
+
+        unsigned long cycles = p.getCurrentCycle();
+        unsigned long retired = p.getNRetired();
+        unsigned long length = end == TO_END ? TO_END : end - start;
+        unsigned long head = min(slicing.checkLength, length);
+        bool quit = p.runForOps(head);
+        s.headCycles = p.getCurrentCycle() - cycles;
+        if(!quit)
+          quit = p.runForOps(length - head);
+        s.nInstrs = p.getNRetired() - retired;
+        s.nOps = end == TO_END ? p.getNOps() - (start - cOps) : length;
+        s.cycles = p.getCurrentCycle() - cycles;
+        s.tailCycles = ~0ul;
+        if(!quit){
+          unsigned long endCycles = p.getCurrentCycle();
+          p.runForOps(slicing.checkLength);
+          s.tailCycles = p.getCurrentCycle() - endCycles;
+        }
+        lock_guard<mutex> guard(lock);
+        if(slices.size() <= index)
+          slices.resize(index + 1);
+        slices[index] = s;
+      } catch(const std::exception&){
+        failed = true;
+      }
+    };
+
+    //the functional pass, handing each slice over once its end is known
+    workers.submit([&](){
+      try{
+        DRAM backing(config.memWords, "MainMem");
+        DirtyTrackingMem mainMem(backing);
+        DRAM rf(0b100000, "rf");
+        //as ProgramLoader::loadProgram
+        backing.storeBlock(0, const_cast<data32*>(image->data()),
+            image->size());
+        rf.sw(31, image->size() - 1);
+        Checkpointer checkpointer(mainMem);
+        FunctionalCore core(mainMem, rf, 0);
+        TraceRecord r;
+        bool running = true;
+        unsigned long ops = 0;
+        auto step = [&](){
+          running = core.step(r);
+          if(r.word != 0)
+            ops++;
+        };
+        shared_ptr<const Checkpoint> pending = checkpointer.take(core);
+        unsigned long pendingOps = 0;
+        unsigned long pendingStart = 0;
+        size_t index = 0;
+        for(unsigned long i = 1; running; i++){
+          unsigned long target = i * slicing.sliceLength;
+          unsigned long from = target > slicing.warmup ?
+            target - slicing.warmup : 0;
+          while(running && (core.getNExecuted() < from || !core.isQuiet()))
+            step();
+          if(!running)
+            break;
+          shared_ptr<const Checkpoint> c = checkpointer.take(core);
+          unsigned long cOps = ops;
+          //a slice only starts if the program gets there
+          while(running && core.getNExecuted() < target)
+            step();
+          if(!running)
+            break;
+          //slices end at ops, where the detailed runs agree with this one
+          unsigned long start = ops;
+          if(start == pendingStart)
+            continue;
+          workers.submit(bind(simulate, index++, pending, pendingOps,
+                pendingStart, start));
+          pending = c;
+          pendingOps = cOps;
+          pendingStart = start;
+        }
+        workers.submit(bind(simulate, index++, pending, pendingOps,
+              pendingStart, TO_END));
+      } catch(const std::exception&){
+        failed = true;
+      }
+    });
+    workers.wait();
+    if(failed){
+      //already logged as fatal where it was thrown
+      throw std::exception();
+    }
+
+    SlicedResult result;
+    result.nInstrs = 0;
+    result.cycles = 0;
+    result.boundaryError = 0;
+    result.boundaryErrorAbs = 0;
+    for(size_t i = 0; i < slices.size(); i++){
+      result.nInstrs += slices[i].nInstrs;
+      result.cycles += slices[i].cycles;
+      //comparable if both timed the same instructions: all checkLength, or
+      //up to the syscall
+      bool whole = slices[i].nOps >= slicing.checkLength ||
+        i + 1 == slices.size();
+      if(i > 0 && slices[i - 1].tailCycles != ~0ul && whole){
+        long error = (long) slices[i].headCycles -
+          (long) slices[i - 1].tailCycles;
+        result.boundaryError += error;
+        result.boundaryErrorAbs += labs(error);
+      }
+    }
+    result.slices = move(slices);
+    return result;
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef SLICED_H_INCLUDED
+#define SLICED_H_INCLUDED
+#include <vector>
+#include "Config.h"
+#include "Processor.h"
+
+using namespace std;
+using namespace config;
+/*
+ * Checkpoint sliced simulation: one program's detailed simulation split
+ * across threads.
+ *
+ * A functional pass (FunctionalCore) takes a checkpoint (Checkpoint.h)
+ * every sliceLength instructions, warmup instructions before the slice
+ * starts, or at the first point after that with no branch in flight. Each
+ * slice is then simulated in detail by its own Processor5S on a
+ * WorkStealingPool: the warmup from the checkpoint, uncounted, then the
+ * slice. Slices go to the pool as soon as the next checkpoint marks where
+ * they end, so they overlap the functional pass. The slices' instructions
+ * and cycles add up to the whole program's.
+ *
+ * The functional pass runs at full speed, and away from it fewer nops run
+ * in delay slots (see TraceReplayer), so where slices start and end is
+ * counted in ops, the instructions other than nops, which all timings run
+ * alike.
+ *
+ * The error is at the boundaries: a slice starts with an empty pipe where
+ * the whole run has one in flight, and the warmup only makes up for part
+ * of that. To measure it, every slice simulates checkLength ops past its
+ * end, which the next slice also times from its own start. The difference
+ * at each boundary is its error. A link in flight at a checkpoint, returned
+ * to in the slice, is the full speed one, so may run a few nops more than
+ * the whole run would; that is not measured.
+ */
+namespace sliced{
+
+  struct SliceConfig{
+    /* instructions per slice */
+    unsigned long sliceLength = 100000;
+    /* instructions simulated, uncounted, before each slice */
+    unsigned long warmup = 1000;
+    /* ops both sides of a boundary time */
+    unsigned long checkLength = 256;
+    /* threads, 0 for one per hardware thread */
+    size_t nThreads = 0;
+  };
+
+  struct Slice{
+    /* the op it starts at */
+    unsigned long start;
+    unsigned long nOps;
+    /* instructions retired, nops included */
+    unsigned long nInstrs;
+    unsigned long cycles;
+    /* instructions simulated before it, short if no checkpoint was
+     * possible */
+    unsigned long warmup;
+    /* cycles for its first checkLength ops */
+    unsigned long headCycles;
+    /* cycles for the checkLength ops after it, ~0 if none */
+    unsigned long tailCycles;
+  };
+
+  struct SlicedResult{
+    unsigned long nInstrs;
+    unsigned long cycles;
+    vector<Slice> slices;
+    /* the sum over boundaries of head less the previous slice's tail */
+    long boundaryError;
+    /* the same, in absolute values */
+    unsigned long boundaryErrorAbs;
+  };
+
+  class SlicedSim{
+    private:
+      ProgramImage image;
+      SimConfig config;
+      SliceConfig slicing;
+
+    public:
+      SlicedSim(const ProgramImage& image, const SimConfig& config,
+          const SliceConfig& slicing);
+
+      /*
+       * throws: exception if the program does, on either side
+       */
+      SlicedResult run();
+  };
+}
+#endif
@@ -0,0 +1,108 @@
+#ifndef SPSC_QUEUE_H_INCLUDED
+#define SPSC_QUEUE_H_INCLUDED
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+/*
+ * A bounded lock free queue between exactly one producer thread and one
+ * consumer thread. A ring of slots with a head only the consumer moves and a
+ * tail only the producer moves, each on its own cache line. Each side keeps
+ * a copy of the other's index and only rereads it when the ring looks full
+ * (or empty), so the shared lines are touched once per lap, not per item.
+ *
+ * Items are moved in and out, so big items (a batch of work) are fine. push
+ * and pop spin, yielding, while the ring is full or empty. That is the
+ * backpressure: a producer can't run more than the capacity ahead.
+ */
+namespace pool{
+
+  template<typename T>
+  class SpscQueue{
+    private:
+      static const size_t LINE = 64;
+
+      vector<T> slots;
+      size_t mask;
+      /* next slot to pop, written by the consumer */
+      alignas(LINE) atomic<size_t> head;
+      /* the producer's copy of head */
+      alignas(LINE) size_t cachedHead;
+      /* next slot to push, written by the producer */
+      alignas(LINE) atomic<size_t> tail;
+      /* the consumer's copy of tail */
+      alignas(LINE) size_t cachedTail;
+
+    public:
+      /*
+       * params:
+       *   capacity: slots, rounded up to a power of 2
+       */
+      SpscQueue(size_t capacity) : head{0}, cachedHead{0}, tail{0},
+        cachedTail{0} {
+        size_t size = 1;
+        while(size < capacity)
+          size *= 2;
+        slots.resize(size);
+        mask = size - 1;
+      }
+
+      /*
+       * producer only
+       * returns: false, leaving item alone, if the ring is full
+       */
+      bool tryPush(T& item){
+        size_t t = tail.load(memory_order_relaxed);
+        if(t - cachedHead > mask){
+          cachedHead = head.load(memory_order_acquire);
+          if(t - cachedHead > mask)
+            return false;
+        }
+        slots[t & mask] = move(item);
+        tail.store(t + 1, memory_order_release);
+        return true;
+      }
+
+      /*
+       * producer only, waits for room
+       */
+      void push(T item){
+        while(!tryPush(item))
+          this_thread::yield();
+      }
+
+      /*
+       * consumer only
+       * returns: false if the ring is empty
+       */
+      bool tryPop(T& item){
+        size_t h = head.load(memory_order_relaxed);
+        if(h == cachedTail){
+          cachedTail = tail.load(memory_order_acquire);
+          if(h == cachedTail)
+            return false;
+        }
+        item = move(slots[h & mask]);
+        head.store(h + 1, memory_order_release);
+        return true;
+      }
+
+      /*
+       * consumer only, waits for an item
+       */
+      T pop(){
+        T item;
+        while(!tryPop(item))
+          this_thread::yield();
+        return item;
+      }
+
+      size_t getCapacity() const{
+        return mask + 1;
+      }
+  };
+}
+#endif
@@ -0,0 +1,166 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <exception>
+#include "StackDistance.h"
+
+using namespace std;
+
+namespace stackdist{
+
+  namespace {
+    /* smallest tree a set starts with */
+    const uint32_t MIN_TIMES = 64;
+    /* last access time of a line known to be maxWays or more deep */
+    const uint32_t FAR = UINT32_MAX;
+    /* lines per page of lastTimes */
+    const unsigned int PAGE_BITS = 12;
+
+    bool isPowerOf2(unsigned int n){
+      return n != 0 && (n & (n - 1)) == 0;
+    }
+  }
+
+  StackDistance::StackDistance(unsigned int lineWords,
+      const vector<unsigned int>& setCounts, unsigned int maxWays) :
+    lineWords{lineWords}, maxWays{maxWays}, nAccesses{0} {
+    if(!isPowerOf2(lineWords) || maxWays == 0 || setCounts.empty()){
+      BOOST_LOG_TRIVIAL(fatal) << "<<StackDistance>> bad line size " <<
+        lineWords << " or associativity " << maxWays << endl;
+      throw std::exception();
+    }
+    for(unsigned int nSets : setCounts){
+      if(!isPowerOf2(nSets)){
+        BOOST_LOG_TRIVIAL(fatal) << "<<StackDistance>> " << nSets <<
+          " sets is not a power of 2" << endl;
+        throw std::exception();
+      }
+      Level level;
+      level.nSets = nSets;
+      level.sets.resize(nSets);
+      level.hist.assign(maxWays + 1, 0);
+      levels.push_back(level);
+    }
+  }
+
+  void StackDistance::add(SetStack& s, uint32_t time, int delta){
+    for(; time < s.tree.size(); time += time & -time)
+      s.tree[time] += delta;
+  }
+
+  uint32_t StackDistance::prefix(const SetStack& s, uint32_t time) const{
+    uint32_t sum = 0;
+    for(; time > 0; time -= time & -time)
+      sum += s.tree[time];
+    return sum;
+  }
+
+  uint32_t* StackDistance::times(data32 line){
+    size_t page = line >> PAGE_BITS;
+    if(page >= lastTimes.size())
+      lastTimes.resize(page + 1);
+    if(lastTimes[page].empty())
+      lastTimes[page].assign(levels.size() << PAGE_BITS, 0);
+    return &lastTimes[page][(line & ((1 << PAGE_BITS) - 1)) * levels.size()];
+  }
+
+  void StackDistance::compact(size_t level, SetStack& s){
+    //the times that are still some line's last, in order
+    vector<data32> kept;
+    kept.reserve(s.live);
+    for(uint32_t t = 1; t < s.now; t++){
+      data32 line = s.lineAt[t];
+      if(times(line)[level] == t)
+        kept.push_back(line);
+    }
+    //lines with maxWays newer ones in the set miss whatever comes next, so
+    //they don't need a mark. That keeps every tree O(maxWays)
+    size_t nFar = kept.size() > maxWays ? kept.size() - maxWays : 0;
+    for(size_t k = 0; k < nFar; k++)
+      times(kept[k])[level] = FAR;
+    kept.erase(kept.begin(), kept.begin() + nFar);
+
+    uint32_t size = max(MIN_TIMES, (uint32_t) kept.size() + 4 * maxWays);
+    s.tree.assign(size + 1, 0);
+    s.lineAt.assign(size + 1, 0);
+    for(uint32_t t = 1; t <= kept.size(); t++){
+      s.lineAt[t] = kept[t - 1];
+      times(kept[t - 1])[level] = t;
+      s.tree[t] = 1;
+    }
+    //linear time Fenwick build
+    for(uint32_t t = 1; t <= size; t++){
+      uint32_t parent = t + (t & -t);
+      if(parent <= size)
+        s.tree[parent] += s.tree[t];
+    }
+    s.now = kept.size() + 1;
+    s.live = kept.size();
+  }
+
+  void StackDistance::access(data32 address){
+    nAccesses++;
+    data32 line = address / lineWords;
+    uint32_t* lineTimes = times(line);
+
+    for(size_t l = 0; l < levels.size(); l++){
+      Level& level = levels[l];
+      SetStack& s = level.sets[line & (level.nSets - 1)];
+      uint32_t last = lineTimes[l];
+      if(last != 0 && last == s.now - 1){
+        //the set's most recent line again, its mark can stay
+        level.hist[0]++;
+        continue;
+      }
+      if(last == 0){
+        level.cold++;
+      } else if(last == FAR){
+        level.hist[maxWays]++;
+      } else {
+        uint32_t distance = s.live - prefix(s, last);
+        level.hist[min(distance, maxWays)]++;
+        add(s, last, -1);
+        s.live--;
+        lineTimes[l] = 0;
+      }
+      if(s.now >= s.tree.size())
+        compact(l, s);
+      s.lineAt[s.now] = line;
+      add(s, s.now, 1);
+      s.live++;
+      lineTimes[l] = s.now;
+      s.now++;
+    }
+  }
+
+  uint64_t StackDistance::getNAccesses() const{
+    return nAccesses;
+  }
+
+  uint64_t StackDistance::getMisses(unsigned int nSets,
+      unsigned int ways) const{
+    for(const Level& level : levels){
+      if(level.nSets != nSets || ways > maxWays)
+        continue;
+      uint64_t misses = level.cold;
+      for(size_t d = ways; d < level.hist.size(); d++)
+        misses += level.hist[d];
+      return misses;
+    }
+    BOOST_LOG_TRIVIAL(fatal) << "<<StackDistance>> " << nSets << " sets, " <<
+      ways << " ways was not profiled" << endl;
+    throw std::exception();
+  }
+
+  void StackDistance::writeCsv(ostream& out, const string& stream) const{
+    for(const Level& level : levels){
+      for(unsigned int ways = 1; ways <= maxWays; ways *= 2){
+        uint64_t misses = getMisses(level.nSets, ways);
+        out << stream << "," << level.nSets << "," << ways << "," <<
+          lineWords << "," << (uint64_t) level.nSets * ways * lineWords <<
+          "," << nAccesses << "," << misses << "," <<
+          (nAccesses ? (double) misses / nAccesses : 0) << "\n";
+      }
+    }
+  }
+}
@@ -0,0 +1,105 @@
+#ifndef STACKDISTANCE_H_INCLUDED
+#define STACKDISTANCE_H_INCLUDED
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Mem.h"
+
+using namespace std;
+using namespace mem;
+/*
+ * Miss ratio curves for every cache size from one pass over an address
+ * stream, instead of one simulation per size.
+ *
+ * An LRU cache with S sets and A ways hits exactly when fewer than A other
+ * lines of the same set were touched since the line was last touched (its
+ * stack distance). So one histogram of stack distances per set count gives
+ * the misses of every associativity at that set count, and with it every
+ * capacity S * A * line size.
+ *
+ * Distances are counted with a Fenwick tree per set over that set's access
+ * times: every line marks the time of its last access, the distance is the
+ * number of marks after the previous one. That is O(log maxWays) an access
+ * per set count: when a tree fills up it is compacted down to the newest
+ * maxWays marks, older lines can only miss anyway.
+ */
+namespace stackdist{
+
+  class StackDistance{
+    private:
+      /* one set's LRU stack, as marks on its access times */
+      struct SetStack{
+        vector<uint32_t> tree;
+        /* the line accessed at each time, to renumber on compaction */
+        vector<data32> lineAt;
+        /* next time, times start at 1 */
+        uint32_t now = 1;
+        uint32_t live = 0;
+      };
+
+      /* all the sets of one set count, and their histogram */
+      struct Level{
+        unsigned int nSets;
+        vector<SetStack> sets;
+        /* hist[d] accesses at distance d, the last bucket is >= maxWays */
+        vector<uint64_t> hist;
+        uint64_t cold = 0;
+      };
+
+      unsigned int lineWords;
+      unsigned int maxWays;
+      vector<Level> levels;
+      /*
+       * last access time of each line in each level, 0 for never, FAR for
+       * too long ago to matter. Paged by line number, pages are allocated
+       * when first touched
+       */
+      vector<vector<uint32_t>> lastTimes;
+      uint64_t nAccesses;
+
+      /*
+       * returns: the line's last access times, one per level
+       */
+      uint32_t* times(data32 line);
+
+      void add(SetStack& s, uint32_t time, int delta);
+      uint32_t prefix(const SetStack& s, uint32_t time) const;
+      void compact(size_t level, SetStack& s);
+
+    public:
+      /*
+       * params:
+       *   lineWords: words per cache line, a power of 2
+       *   setCounts: the numbers of sets to profile, each a power of 2
+       *   maxWays: distances from here on are lumped together, so curves are
+       *     exact up to this associativity
+       * throws: exception if a count isn't a power of 2
+       */
+      StackDistance(unsigned int lineWords,
+          const vector<unsigned int>& setCounts, unsigned int maxWays);
+
+      /*
+       * one access to the word at address
+       */
+      void access(data32 address);
+
+      uint64_t getNAccesses() const;
+
+      /*
+       * returns: the misses of an LRU cache with the given geometry, which
+       *   must be a profiled set count and at most maxWays
+       * throws: exception otherwise
+       */
+      uint64_t getMisses(unsigned int nSets, unsigned int ways) const;
+
+      /*
+       * writes one line per set count and power of 2 associativity:
+       *   stream,sets,ways,lineWords,words,accesses,misses,missRatio
+       * params:
+       *   stream: the first column, to tell streams apart in one file
+       */
+      void writeCsv(ostream& out, const string& stream) const;
+  };
+}
+#endif
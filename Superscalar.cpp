@@ -0,0 +1,284 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <climits>
+#include <exception>
+#include "Superscalar.h"
+
+using namespace std;
+
+namespace superscalar{
+
+  namespace {
+    /* instructions fetched behind a branch before it redirects */
+    const unsigned long DELAY_SLOTS = 5;
+    const int IF = 0;
+    const int ID = 1;
+    const int EX = 2;
+    const int MA = 3;
+    const int WB = 4;
+    /* hi/lo, as a register for the checks within a group */
+    const int HILO = 32;
+
+    const char* FAILURE_NAMES[N_PAIR_FAILURES] = {"dependence", "memory",
+      "mul/div", "branch", "syscall", "operand"};
+
+    bool writesTo(const TraceRecord& r, int reg){
+      if(r.op == OP_MUL || r.op == OP_DIV)
+        return reg == HILO;
+      return r.dest >= 0 && r.dest == reg;
+    }
+
+    bool readsFrom(const TraceRecord& r, int reg){
+      return r.srcs[0] == reg || r.srcs[1] == reg ||
+        (reg == HILO && readsHiLo(r));
+    }
+  }
+
+  ProcessorSS::ProcessorSS(string name, MemoryUnit& mainMem,
+      MemoryUnit& rf, data32 instrStart, const SimConfig& config) :
+    name{name}, mainMem{mainMem}, rf{rf}, config{config},
+    syscalls{nullptr}, currentCycle{0}, nRetired{0}, nOps{0},
+    haveLast{false}, lastSeq{0}, nFetched{0}, done{false} {
+    stats.issued.assign(config.ssWidth + 1, 0);
+    busy.fill(0);
+    setPc(instrStart);
+  }
+
+  bool ProcessorSS::produce(){
+    if(!stream.empty())
+      return true;
+    if(haveLast)
+      return false;
+    TraceRecord r;
+    if(!core->step(r)){
+      haveLast = true;
+      lastSeq = nFetched;
+    }
+    stream.push_back(r);
+    return true;
+  }
+
+  unsigned int ProcessorSS::latency(int stage, const vector<Slot>& group)
+    const{
+    unsigned int longest = 1;
+    for(const Slot& s : group){
+      const TraceRecord& r = s.r;
+      unsigned int l;
+      switch(stage){
+        case IF: l = config.ifLatency; break;
+        case ID: l = config.idLatency; break;
+        case EX: l = r.op == OP_MUL ? config.mulLatency :
+                 r.op == OP_DIV ? config.divLatency : config.exLatency;
+                 break;
+        case MA: l = r.op == OP_LOAD || r.op == OP_STORE ?
+                 config.memLatency : config.maLatency;
+                 break;
+        default: l = r.op == OP_SYSCALL ?
+                 max(config.wbLatency, config.syscallLatency) :
+                 config.wbLatency;
+      }
+      longest = max(longest, l);
+    }
+    return longest;
+  }
+
+  size_t ProcessorSS::pairable(){
+    const vector<Slot>& group = groups[ID];
+    unsigned int nMem = 0;
+    unsigned int nMulDiv = 0;
+    unsigned int nBranches = 0;
+    for(size_t k = 0; k < group.size(); k++){
+      const TraceRecord& r = group[k].r;
+      int failure = -1;
+      if(r.op == OP_SYSCALL && k > 0)
+        failure = PAIR_SYSCALL;
+      for(size_t j = 0; j < k && failure < 0; j++)
+        for(int reg : {(int) r.srcs[0], (int) r.srcs[1], HILO})
+          if(reg >= 0 && readsFrom(r, reg) && writesTo(group[j].r, reg))
+            failure = PAIR_DEPENDENCE;
+      //nothing is forwarded, a write is read once it is in writeback
+      for(int s = EX; s <= MA && failure < 0; s++)
+        for(const Slot& older : groups[s])
+          for(int reg : r.srcs)
+            if(reg > 0 && writesTo(older.r, reg))
+              failure = PAIR_OPERAND;
+      if(failure < 0){
+        bool memory = r.op == OP_LOAD || r.op == OP_STORE;
+        bool mulDiv = r.op == OP_MUL || r.op == OP_DIV;
+        bool branch = r.op == OP_BRANCH || r.op == OP_JUMP;
+        if(memory && nMem++ == config.ssMemOps)
+          failure = PAIR_MEMORY;
+        else if(mulDiv && nMulDiv++ == config.ssMulDivOps)
+          failure = PAIR_MULDIV;
+        else if(branch && nBranches++ == config.ssBranches)
+          failure = PAIR_BRANCH;
+      }
+      if(failure >= 0){
+        if(k == 0)
+          stats.operandStalls++;
+        else
+          stats.pairingFailures[failure]++;
+        return k;
+      }
+      if(r.op == OP_SYSCALL){
+        if(group.size() > 1)
+          stats.pairingFailures[PAIR_SYSCALL]++;
+        return 1;
+      }
+    }
+    return group.size();
+  }
+
+  void ProcessorSS::fetch(){
+    vector<Slot>& group = groups[IF];
+    data32 block = 0;
+    while(group.size() < config.ssWidth && produce()){
+      const TraceRecord& r = stream.front();
+      if(!redirects.empty()){
+        unsigned long left = redirects.front().second;
+        bool redirected = left != 0 && left < currentCycle;
+        //past a taken branch's delay slots, wait for it to leave writeback
+        if(nFetched > redirects.front().first + DELAY_SLOTS){
+          if(!redirected){
+            if(group.empty())
+              stats.redirectStalls++;
+            break;
+          }
+          redirects.pop_front();
+          continue;
+        }
+        //it left before fetch got through them, the nops left are not
+        //fetched, as Processor5S's pc is already past them
+        if(redirected && r.op == OP_NOP){
+          stats.nSkipped++;
+          nFetched++;
+          stream.pop_front();
+          continue;
+        }
+      }
+      if(!group.empty() && (r.pc != group.back().r.pc + 1 ||
+            r.pc / config.ssWidth != block))
+        break;
+      block = r.pc / config.ssWidth;
+      if(r.redirect)
+        redirects.push_back({nFetched, 0});
+      group.push_back({r, nFetched++});
+      stream.pop_front();
+    }
+    if(!group.empty())
+      busy[IF] = latency(IF, group);
+  }
+
+  bool ProcessorSS::step(){
+    if(done)
+      return true;
+    for(unsigned int& b : busy)
+      b = b > 0 ? b - 1 : 0;
+
+    if(!groups[WB].empty() && busy[WB] == 0){
+      for(const Slot& s : groups[WB]){
+        nRetired++;
+        if(s.r.op != OP_NOP)
+          nOps++;
+        for(pair<unsigned long, unsigned long>& redirect : redirects)
+          if(redirect.first == s.seq)
+            redirect.second = currentCycle;
+        if(haveLast && s.seq == lastSeq)
+          done = true;
+      }
+      groups[WB].clear();
+    }
+    for(int s = MA; s >= EX; s--){
+      if(!groups[s].empty() && busy[s] == 0 && groups[s + 1].empty()){
+        swap(groups[s], groups[s + 1]);
+        busy[s + 1] = latency(s + 1, groups[s + 1]);
+      }
+    }
+    size_t nIssued = 0;
+    if(!groups[ID].empty() && busy[ID] == 0 && groups[EX].empty()){
+      nIssued = pairable();
+      vector<Slot>& group = groups[ID];
+      groups[EX].assign(group.begin(), group.begin() + nIssued);
+      group.erase(group.begin(), group.begin() + nIssued);
+      if(nIssued > 0)
+        busy[EX] = latency(EX, groups[EX]);
+    }
+    stats.issued[nIssued]++;
+    if(!groups[IF].empty() && busy[IF] == 0 && groups[ID].empty()){
+      swap(groups[IF], groups[ID]);
+      busy[ID] = latency(ID, groups[ID]);
+    }
+    if(groups[IF].empty() && !done)
+      fetch();
+    currentCycle++;
+    if(done)
+      core->drain();
+    return done;
+  }
+
+  void ProcessorSS::start(data32 startI, ostream& report){
+    setPc(startI);
+    runFor(ULONG_MAX);
+    report << "Program Terminating" << endl;
+  }
+
+  bool ProcessorSS::runFor(unsigned long nInstrs){
+    unsigned long until = nInstrs > ULONG_MAX - nRetired ? ULONG_MAX :
+      nRetired + nInstrs;
+    bool quit = done;
+    while(!quit && nRetired < until){
+      quit = step();
+    }
+    return quit;
+  }
+
+  void ProcessorSS::setPc(data32 startI){
+    core = make_unique<functional::FunctionalCore>(mainMem, rf, startI);
+    core->setSyscalls(syscalls);
+  }
+
+  void ProcessorSS::setSyscalls(sys::SyscallEmulator* emulator){
+    syscalls = emulator;
+    core->setSyscalls(emulator);
+  }
+
+  unsigned long ProcessorSS::getCurrentCycle() const{
+    return currentCycle;
+  }
+
+  unsigned long ProcessorSS::getNRetired() const{
+    return nRetired;
+  }
+
+  unsigned long ProcessorSS::getNOps() const{
+    return nOps;
+  }
+
+  const SuperscalarStats& ProcessorSS::getStats() const{
+    return stats;
+  }
+
+  double ProcessorSS::getSlotUtilization() const{
+    unsigned long used = 0;
+    for(size_t k = 0; k < stats.issued.size(); k++)
+      used += k * stats.issued[k];
+    return currentCycle ? (double) used / ((double) config.ssWidth *
+        currentCycle) : 0;
+  }
+
+  void ProcessorSS::report(ostream& out) const{
+    out << nRetired << " instructions in " << currentCycle << " cycles, IPC "
+      << (currentCycle ? (double) nRetired / currentCycle : 0) <<
+      ", issue slots used " << 100 * getSlotUtilization() << "%" << endl;
+    out << "cycles issuing";
+    for(size_t k = 0; k < stats.issued.size(); k++)
+      out << " " << k << ": " << stats.issued[k];
+    out << endl << "groups split by";
+    for(int f = 0; f < N_PAIR_FAILURES; f++)
+      out << " " << FAILURE_NAMES[f] << ": " << stats.pairingFailures[f];
+    out << endl << "stall cycles: operands " << stats.operandStalls <<
+      ", taken branches " << stats.redirectStalls << ", delay slots not "
+      "fetched " << stats.nSkipped << endl;
+  }
+}
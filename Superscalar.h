@@ -0,0 +1,164 @@
+#ifndef SUPERSCALAR_H_INCLUDED
+#define SUPERSCALAR_H_INCLUDED
+#include <array>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "Mem.h"
+#include "Config.h"
+#include "Trace.h"
+#include "Functional.h"
+#include "Syscall.h"
+
+using namespace std;
+using namespace mem;
+using namespace config;
+using namespace trace;
+/*
+ * An in order superscalar version of Processor5S: the same five stages
+ * with the same latencies, each holding a group of up to ss.width
+ * instructions rather than one. A group moves on when all of it is done,
+ * so it takes the longest of its instructions' latencies in each stage, and
+ * a busy stage holds up the ones before it, as in Processor5S.
+ *
+ *   - fetch takes the next instructions up to the end of the aligned block
+ *     of ss.width words they start in, and stops at a discontinuity. As in
+ *     Processor5S, it goes on through a taken branch's delay slots and then
+ *     waits for the branch to leave writeback. Slots it has not reached by
+ *     then are not fetched, if they are nops, as TraceReplayer skips them
+ *   - decode issues the longest prefix of its group that pairs: nothing
+ *     reading what an earlier one in the prefix writes (hi/lo included), at
+ *     most ss.memOps loads and stores, ss.mulDivOps multiplies and divides
+ *     and ss.branches branches and jumps, and a syscall only on its own.
+ *     The rest stays in decode for the next cycle
+ *   - registers are still read in decode and written in writeback, with
+ *     nothing forwarded, but wider groups close the distance the assembler
+ *     pads to, so decode also waits while an older group in execute or
+ *     memory access writes what it reads
+ * At width 1 that is Processor5S's timing.
+ *
+ * As ProcessorOoO (see OoO.h), it is timing on top of a FunctionalCore,
+ * which gives the results, links included.
+ */
+namespace superscalar{
+
+  /* why decode issued less than all of its group */
+  enum PairingFailure{
+    PAIR_DEPENDENCE, PAIR_MEMORY, PAIR_MULDIV, PAIR_BRANCH, PAIR_SYSCALL,
+    PAIR_OPERAND, N_PAIR_FAILURES
+  };
+
+  struct SuperscalarStats{
+    /* cycles decode issued 0, 1, ... width instructions */
+    vector<unsigned long> issued;
+    /* groups split, by the instruction that could not go */
+    array<unsigned long, N_PAIR_FAILURES> pairingFailures{};
+    /* cycles a whole group waited in decode for an older one's write */
+    unsigned long operandStalls = 0;
+    /* cycles fetch waited on a taken branch */
+    unsigned long redirectStalls = 0;
+    /* delay slot nops the branch redirected before fetch reached */
+    unsigned long nSkipped = 0;
+  };
+
+  class ProcessorSS{
+    private:
+      static const int N_STAGES = 5;
+
+      /* a fetched instruction and its place in fetch order */
+      struct Slot{
+        TraceRecord r;
+        unsigned long seq;
+      };
+
+      string name;
+      MemoryUnit& mainMem;
+      MemoryUnit& rf;
+      SimConfig config;
+      unique_ptr<functional::FunctionalCore> core;
+      sys::SyscallEmulator* syscalls;
+      unsigned long currentCycle;
+      unsigned long nRetired;
+      unsigned long nOps;
+      SuperscalarStats stats;
+
+      /* what the core has run and fetch has not taken yet */
+      deque<TraceRecord> stream;
+      /* the fetch count of the program's last record, once the core has
+       * run it */
+      bool haveLast;
+      unsigned long lastSeq;
+      unsigned long nFetched;
+      /* each stage's group and the cycles it has left there */
+      array<vector<Slot>, N_STAGES> groups;
+      array<unsigned int, N_STAGES> busy;
+      /* taken branches fetched, and the cycle each left writeback, 0 until
+       * it has */
+      deque<pair<unsigned long, unsigned long>> redirects;
+      bool done;
+
+      /* makes sure there is a record to fetch, if there is one */
+      bool produce();
+
+      /* returns: the group's latency in stage */
+      unsigned int latency(int stage, const vector<Slot>& group) const;
+
+      /* returns: how many of decode's group can go on to execute */
+      size_t pairable();
+
+      void fetch();
+
+    public:
+      /*
+       * params as ProcessorOoO's
+       */
+      ProcessorSS(string name, MemoryUnit& mainMem, MemoryUnit& rf,
+          data32 instrStart, const SimConfig& config = SimConfig());
+
+      /*
+       * advances one cycle
+       * returns: true once the program has ended
+       * throws: exception as FunctionalCore::step
+       */
+      bool step();
+
+      /*
+       * runs from startI to the syscall that ends the program, then writes
+       * "Program Terminating" to report
+       */
+      void start(data32 startI, ostream& report = cout);
+
+      /*
+       * as Processor5S::runFor
+       */
+      bool runFor(unsigned long nInstrs);
+
+      /*
+       * starts over at startI. Meant for before the first run
+       */
+      void setPc(data32 startI);
+
+      /*
+       * as Processor5S::setSyscalls. The emulator is not owned
+       */
+      void setSyscalls(sys::SyscallEmulator* emulator);
+
+      unsigned long getCurrentCycle() const;
+      unsigned long getNRetired() const;
+      unsigned long getNOps() const;
+      const SuperscalarStats& getStats() const;
+
+      /*
+       * returns: the share of issue slots (width a cycle) used
+       */
+      double getSlotUtilization() const;
+
+      /*
+       * writes the retired count, cycles, IPC, slot utilization and why
+       * groups were split to out
+       */
+      void report(ostream& out) const;
+  };
+}
+#endif
@@ -0,0 +1,167 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include "Synth.h"
+#include "Debug.h"
+
+using namespace std;
+
+namespace synth{
+
+  namespace {
+    enum Kind { ALU, MUL, LOAD, STORE, BRANCH };
+    const unsigned int WINDOW_REG = 20;
+    const size_t WINDOW_WORDS = 0x10000;
+    const unsigned int ALU_FUNCS[] = {0x21, 0x23, 0x24, 0x25, 0x26, 0x2a};
+  }
+
+  SynthProgram::SynthProgram(const SynthConfig& config){
+    const InstrMix& mix = config.mix;
+    if(config.depDistance > N_POOL || config.footprint == 0 ||
+        config.footprint > MAX_FOOTPRINT || config.takenRate < 0 ||
+        config.takenRate > 1 || mix.alu + mix.mul + mix.load + mix.store +
+        mix.branch <= 0){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Synth>> config out of range" << endl;
+      throw std::exception();
+    }
+    mt19937 gen(config.seed);
+    discrete_distribution<int> kinds(
+        {mix.alu, mix.mul, mix.load, mix.store, mix.branch});
+    bernoulli_distribution taken(config.takenRate);
+    uniform_int_distribution<unsigned int> poolReg(1, N_POOL);
+    uniform_int_distribution<unsigned int> aluFunc(0, 6);
+    uniform_int_distribution<unsigned int> small(0, 31);
+
+    //the data follows the code: prologue, body, syscall and its slots
+    const size_t prologue = 8 + HAZARD_DISTANCE;
+    dataBase = prologue + config.nInstrs + 1 + DELAY_SLOTS;
+    footprint = config.footprint;
+
+    //window bases sit mid window, as lw/sw sign extend their offsets
+    for(unsigned int w = 0; w < 4; w++){
+      data32 base = dataBase + w * WINDOW_WORDS + WINDOW_WORDS / 2;
+      code.push_back(constructIInstr(0xf, 0, WINDOW_REG + w,
+            (base - (signedData32) (short) (base & 0xffff)) >> 16));
+    }
+    for(unsigned int w = 0; w < 4; w++){
+      data32 base = dataBase + w * WINDOW_WORDS + WINDOW_WORDS / 2;
+      code.push_back(constructIInstr(0x9, WINDOW_REG + w, WINDOW_REG + w,
+            base & 0xffff));
+    }
+    code.insert(code.end(), HAZARD_DISTANCE, 0);
+
+    //dest of each body instruction, 0 for none
+    vector<unsigned int> dests;
+    dests.reserve(config.nInstrs);
+    unsigned int nextDest = 0;
+    size_t access = 0;
+    size_t nSkipped = 0;
+    //no branches in the delay slots or skipped part of another one
+    size_t branchOk = 0;
+
+    auto source = [&](){
+      size_t i = dests.size();
+      if(config.depDistance > 0 && i >= config.depDistance &&
+          dests[i - config.depDistance] != 0)
+        return dests[i - config.depDistance];
+      return poolReg(gen);
+    };
+    auto dest = [&](){
+      nextDest = nextDest % N_POOL + 1;
+      return nextDest;
+    };
+    auto push = [&](data32 instr, unsigned int rd){
+      code.push_back(instr);
+      dests.push_back(rd);
+    };
+
+    while(dests.size() < config.nInstrs){
+      size_t left = config.nInstrs - dests.size();
+      int kind = kinds(gen);
+      if((kind == MUL && left < 2) || (kind == BRANCH &&
+            (left <= DELAY_SLOTS + config.branchSkip ||
+             dests.size() < branchOk)))
+        kind = ALU;
+
+      switch(kind){
+        case ALU: {
+          unsigned int f = aluFunc(gen);
+          unsigned int rs = source();
+          unsigned int rd = dest();
+          if(f == 6)
+            push(constructIInstr(0x9, rs, rd, small(gen)), rd);
+          else if(small(gen) < 4)
+            push(constructRInstr(rs, 0, rd, small(gen), 0x0), rd);
+          else
+            push(constructRInstr(rs, poolReg(gen), rd, 0, ALU_FUNCS[f]), rd);
+          break;
+        }
+        case MUL: {
+          push(constructRInstr(source(), poolReg(gen), 0, 0, 0x18), 0);
+          unsigned int rd = dest();
+          push(constructRInstr(0, 0, rd, 0, 0x12), rd);
+          break;
+        }
+        case LOAD:
+        case STORE: {
+          size_t offset = (access++ * config.stride) % config.footprint;
+          unsigned int base = WINDOW_REG + offset / WINDOW_WORDS;
+          unsigned short imm = (offset % WINDOW_WORDS) - WINDOW_WORDS / 2;
+          if(kind == LOAD){
+            unsigned int rd = dest();
+            push(constructIInstr(0x23, base, rd, imm), rd);
+          } else {
+            push(constructIInstr(0x2b, source(), base, imm), 0);
+          }
+          break;
+        }
+        case BRANCH: {
+          //a taken branch to x continues at x + 1
+          data32 target = code.size() + DELAY_SLOTS + config.branchSkip;
+          if(taken(gen)){
+            if(target <= 0xffff)
+              push(constructIInstr(0x4, 0, 0, target), 0);
+            else
+              push(constructJInstr(0x2, target), 0);
+            nSkipped += config.branchSkip;
+          } else {
+            push(constructIInstr(0x5, 0, 0, target & 0xffff), 0);
+          }
+          branchOk = dests.size() + DELAY_SLOTS + config.branchSkip;
+          break;
+        }
+      }
+    }
+
+    code.push_back(constructRInstr(0, 0, 0, 0, 0xc));
+    //fetched behind the syscall before it quits
+    code.insert(code.end(), DELAY_SLOTS, 0);
+    nExecuted = prologue + config.nInstrs - nSkipped + 1;
+  }
+
+  const vector<data32>& SynthProgram::getCode() const{
+    return code;
+  }
+
+  size_t SynthProgram::getMemWords() const{
+    return dataBase + footprint;
+  }
+
+  size_t SynthProgram::getNExecuted() const{
+    return nExecuted;
+  }
+
+  void SynthProgram::load(MemoryUnit& mem) const{
+    mem.storeBlock(0, const_cast<data32*>(code.data()), code.size());
+  }
+
+  void SynthProgram::writeHex(const string& filename) const{
+    ofstream out(filename);
+    out << hex << setfill('0');
+    for(data32 w : code)
+      out << setw(8) << w << "\n";
+  }
+}
@@ -0,0 +1,101 @@
+#ifndef SYNTH_H_INCLUDED
+#define SYNTH_H_INCLUDED
+#include <string>
+#include <vector>
+#include "Mem.h"
+
+using namespace std;
+using namespace mem;
+/*
+ * Synthetic instruction streams for stressing particular paths of the
+ * simulator: dependency chains, load-use pairs, branch patterns, multiply
+ * bursts and memory footprints. Programs are straight line code (branches
+ * only skip forward), so they always terminate and scale to millions of
+ * instructions. Only the instruction encoders from Debug.h are used.
+ *
+ * Layout: a prologue sets the window base registers, then the body, then a
+ * syscall. The data region starts right after the code and is not part of
+ * the image, it reads as zeros.
+ */
+namespace synth{
+
+  /*
+   * relative weights of each kind of instruction in the body
+   */
+  struct InstrMix{
+    double alu = 6;     //addu, subu, and, or, xor, slt, sll, addiu
+    double mul = 1;     //mult followed by mflo
+    double load = 2;    //lw
+    double store = 1;   //sw
+    double branch = 1;  //beq/bne/j, see takenRate
+  };
+
+  struct SynthConfig{
+    /* instructions in the body */
+    size_t nInstrs = 1 << 12;
+    InstrMix mix;
+    /*
+     * each instruction reads the register written depDistance instructions
+     * before it, when that one wrote any. 0 reads random registers. Below
+     * HAZARD_DISTANCE (4) the read sees the stale value, since nothing is
+     * forwarded. At most N_POOL
+     */
+    unsigned int depDistance = 4;
+    /* fraction of branches that are taken */
+    double takenRate = 0.5;
+    /* instructions a taken branch skips, after its delay slots */
+    unsigned int branchSkip = 2;
+    /* words of data the loads and stores walk over. At most MAX_FOOTPRINT */
+    size_t footprint = 1 << 10;
+    /* words between consecutive accesses, wrapping at the footprint */
+    size_t stride = 1;
+    unsigned int seed = 1;
+  };
+
+  class SynthProgram{
+    private:
+      vector<data32> code;
+      data32 dataBase;
+      size_t footprint;
+      size_t nExecuted;
+    public:
+      /* registers the body writes round robin, $1 to $N_POOL */
+      static const unsigned int N_POOL = 15;
+      /* instructions between a writer and reader of a register */
+      static const int HAZARD_DISTANCE = 4;
+      /* instructions executed behind a branch, jump or syscall */
+      static const int DELAY_SLOTS = 5;
+      /* data is reached through $20 to $23, each covering 0x10000 words */
+      static const size_t MAX_FOOTPRINT = 4 * 0x10000;
+
+      /*
+       * generates the program. The same config always gives the same program
+       * throws: exception if the config is out of range
+       */
+      SynthProgram(const SynthConfig& config);
+
+      /*
+       * returns: the program image, to be loaded at address 0
+       */
+      const vector<data32>& getCode() const;
+      /*
+       * returns: words of main memory needed for code and data
+       */
+      size_t getMemWords() const;
+      /*
+       * returns: the instructions that retire before the syscall quits,
+       * syscall included
+       */
+      size_t getNExecuted() const;
+
+      /*
+       * stores the image at address 0 of mem
+       */
+      void load(MemoryUnit& mem) const;
+      /*
+       * writes the image in the format MachineCodeFileReader reads
+       */
+      void writeHex(const string& filename) const;
+  };
+}
+#endif
@@ -0,0 +1,319 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <cerrno>
+#include <exception>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include "Syscall.h"
+
+using namespace std;
+
+namespace sys{
+
+  namespace {
+    /* registers */
+    const data32 V0 = 2;
+    const data32 A0 = 4;
+    const data32 A1 = 5;
+    const data32 A2 = 6;
+    const data32 A3 = 7;
+
+    /* Linux o32 open flags, which are not the host's */
+    const data32 O32_ACCMODE = 0x3;
+    const data32 O32_APPEND = 0x8;
+    const data32 O32_CREAT = 0x100;
+    const data32 O32_TRUNC = 0x200;
+    const data32 O32_EXCL = 0x400;
+
+    int hostFlagsO32(data32 flags){
+      int host = (flags & O32_ACCMODE) == 1 ? O_WRONLY :
+        (flags & O32_ACCMODE) == 2 ? O_RDWR : O_RDONLY;
+      if(flags & O32_APPEND)
+        host |= O_APPEND;
+      if(flags & O32_CREAT)
+        host |= O_CREAT;
+      if(flags & O32_TRUNC)
+        host |= O_TRUNC;
+      if(flags & O32_EXCL)
+        host |= O_EXCL;
+      return host;
+    }
+
+    /* MARS: 0 read, 1 write, 9 append */
+    int hostFlagsSpim(data32 flags){
+      if(flags == 0)
+        return O_RDONLY;
+      if(flags & 0x8)
+        return O_WRONLY | O_CREAT | O_APPEND;
+      return O_WRONLY | O_CREAT | O_TRUNC;
+    }
+  }
+
+  SyscallEmulator::SyscallEmulator(data32 heapStart, istream& in,
+      ostream& out, ostream& err) : brk{heapStart * 4},
+    endMarker{NO_END_MARKER}, exited{false}, exitCode{0}, nCalls{0} {
+    files.push_back({true, -1, &in, nullptr, {}});
+    files.push_back({true, -1, nullptr, &out, {}});
+    files.push_back({true, -1, nullptr, &err, {}});
+  }
+
+  SyscallEmulator::File* SyscallEmulator::file(data32 fd){
+    if(fd >= files.size() || !files[fd].open)
+      return nullptr;
+    return &files[fd];
+  }
+
+  bool SyscallEmulator::flush(File& f){
+    if(f.buffer.empty())
+      return true;
+    bool ok = true;
+    if(f.out){
+      f.out->write(f.buffer.data(), f.buffer.size());
+      f.out->flush();
+      ok = (bool) *f.out;
+    } else {
+      size_t done = 0;
+      while(ok && done < f.buffer.size()){
+        ssize_t n = ::write(f.hostFd, f.buffer.data() + done,
+            f.buffer.size() - done);
+        ok = n > 0;
+        done += ok ? n : 0;
+      }
+    }
+    f.buffer.clear();
+    return ok;
+  }
+
+  void SyscallEmulator::flush(){
+    for(File& f : files)
+      if(f.open)
+        flush(f);
+  }
+
+  string SyscallEmulator::readString(MemoryUnit& mainMem, data32 addr){
+    string s;
+    for(char c = mainMem.ldByte(addr); c != 0; c = mainMem.ldByte(++addr))
+      s += c;
+    return s;
+  }
+
+  long SyscallEmulator::write(MemoryUnit& mainMem, data32 fd, data32 buf,
+      data32 count){
+    File* f = file(fd);
+    if(!f || f->in)
+      return -1;
+    data32 end = buf + count;
+    data32 addr = buf;
+    while(addr < end){
+      //whole words with one load, most significant byte first
+      if((addr & 3) == 0 && end - addr >= 4){
+        data32 word = mainMem.ld(addr >> 2);
+        for(int shift = 24; shift >= 0; shift -= 8)
+          f->buffer.push_back((char) (word >> shift));
+        addr += 4;
+      } else {
+        f->buffer.push_back((char) mainMem.ldByte(addr++));
+      }
+    }
+    if(f->buffer.size() >= BUFFER_BYTES && !flush(*f))
+      return -1;
+    return count;
+  }
+
+  long SyscallEmulator::read(MemoryUnit& mainMem, data32 fd, data32 buf,
+      data32 count){
+    File* f = file(fd);
+    if(!f || f->out)
+      return -1;
+    vector<char> bytes(count);
+    long n;
+    if(f->in){
+      //the prompt goes out before the guest waits on the answer
+      flush();
+      f->in->read(bytes.data(), count);
+      n = f->in->gcount();
+      f->in->clear();
+    } else {
+      flush(*f);
+      n = ::read(f->hostFd, bytes.data(), count);
+      if(n < 0)
+        return -1;
+    }
+    for(long i = 0; i < n; i++)
+      mainMem.stByte(buf + i, bytes[i]);
+    return n;
+  }
+
+  long SyscallEmulator::open(const string& path, int hostFlags, data32 mode){
+    int hostFd = ::open(path.c_str(), hostFlags, (mode_t) mode);
+    if(hostFd < 0)
+      return -1;
+    files.push_back({true, hostFd, nullptr, nullptr, {}});
+    return files.size() - 1;
+  }
+
+  long SyscallEmulator::close(data32 fd){
+    File* f = file(fd);
+    if(!f)
+      return -1;
+    bool ok = flush(*f);
+    if(f->hostFd >= 0)
+      ok = ::close(f->hostFd) == 0 && ok;
+    f->open = false;
+    return ok ? 0 : -1;
+  }
+
+  void SyscallEmulator::exit(int code){
+    exited = true;
+    exitCode = code;
+    flush();
+  }
+
+  bool SyscallEmulator::handle(MemoryUnit& mainMem, MemoryUnit& rf){
+    lock_guard<mutex> held(lock);
+    nCalls++;
+    data32 code = rf.ld(V0);
+    data32 a0 = rf.ld(A0);
+    data32 a1 = rf.ld(A1);
+    data32 a2 = rf.ld(A2);
+    //o32 calls report errors in $a3 and the errno in $v0
+    auto o32 = [&](long result){
+      bool failed = result < 0;
+      rf.sw(A3, failed);
+      rf.sw(V0, failed ? errno : result);
+    };
+    switch(code){
+      case 1: {
+        string s = to_string((signedData32) a0);
+        files[1].buffer.insert(files[1].buffer.end(), s.begin(), s.end());
+        break;
+      }
+      case 4: {
+        string s = readString(mainMem, a0);
+        files[1].buffer.insert(files[1].buffer.end(), s.begin(), s.end());
+        break;
+      }
+      case 11:
+        files[1].buffer.push_back((char) a0);
+        break;
+      case 5: {
+        flush();
+        signedData32 n = 0;
+        *files[0].in >> n;
+        files[0].in->clear();
+        rf.sw(V0, n);
+        break;
+      }
+      case 8: {
+        //up to a1 - 1 characters of a line, newline kept, then a 0
+        flush();
+        data32 i = 0;
+        char c;
+        while(i + 1 < a1 && files[0].in->get(c)){
+          mainMem.stByte(a0 + i++, c);
+          if(c == '\n')
+            break;
+        }
+        files[0].in->clear();
+        if(a1 > 0)
+          mainMem.stByte(a0 + i, 0);
+        break;
+      }
+      case 12: {
+        flush();
+        char c = 0;
+        files[0].in->get(c);
+        files[0].in->clear();
+        rf.sw(V0, (data32) c);
+        break;
+      }
+      case 9: {
+        data32 old = brk;
+        data32 grown = brk + ((signedData32) a0 + 3) / 4 * 4;
+        if(grown / 4 > mainMem.getSize()){
+          rf.sw(V0, (data32) -1);
+        } else {
+          brk = grown;
+          rf.sw(V0, old);
+        }
+        break;
+      }
+      case 4045: {
+        //brk(0) asks where the break is, others move it
+        if(a0 != 0 && a0 / 4 <= mainMem.getSize())
+          brk = (a0 + 3) / 4 * 4;
+        rf.sw(A3, 0);
+        rf.sw(V0, brk);
+        break;
+      }
+      case 10:
+        exit(0);
+        break;
+      case 17: case 4001: case 4246:
+        exit((signedData32) a0);
+        break;
+      case 13:
+        rf.sw(V0, open(readString(mainMem, a0), hostFlagsSpim(a1), 0644));
+        break;
+      case 4005:
+        o32(open(readString(mainMem, a0), hostFlagsO32(a1), a2));
+        break;
+      case 14:
+        rf.sw(V0, read(mainMem, a0, a1, a2));
+        break;
+      case 4003:
+        errno = EBADF;
+        o32(read(mainMem, a0, a1, a2));
+        break;
+      case 15:
+        rf.sw(V0, write(mainMem, a0, a1, a2));
+        break;
+      case 4004:
+        errno = EBADF;
+        o32(write(mainMem, a0, a1, a2));
+        break;
+      case 16:
+        rf.sw(V0, close(a0));
+        break;
+      case 4006:
+        errno = EBADF;
+        o32(close(a0));
+        break;
+      default:
+        BOOST_LOG_TRIVIAL(fatal) << "<<SyscallEmulator>> unknown syscall " <<
+          code << endl;
+        throw std::exception();
+    }
+    if(files[1].buffer.size() >= BUFFER_BYTES)
+      flush(files[1]);
+    return exited;
+  }
+
+  void SyscallEmulator::setEndMarker(data32 addr){
+    endMarker = addr;
+  }
+
+  bool SyscallEmulator::isEndMarker(data32 addr) const{
+    return addr == endMarker;
+  }
+
+  bool SyscallEmulator::hasExited() const{
+    return exited;
+  }
+
+  int SyscallEmulator::getExitCode() const{
+    return exitCode;
+  }
+
+  unsigned long SyscallEmulator::getNCalls() const{
+    return nCalls;
+  }
+
+  SyscallEmulator::~SyscallEmulator(){
+    flush();
+    for(File& f : files)
+      if(f.open && f.hostFd >= 0)
+        ::close(f.hostFd);
+  }
+}
@@ -0,0 +1,129 @@
+#ifndef SYSCALL_H_INCLUDED
+#define SYSCALL_H_INCLUDED
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Mem.h"
+
+using namespace std;
+using namespace mem;
+/*
+ * Syscall emulation. Without it every syscall ends the program. With a
+ * SyscallEmulator attached (Processor5S::setSyscalls,
+ * FunctionalCore::setSyscalls) a syscall does what $v0 ($2) asks, with its
+ * arguments in $a0-$a3 ($4-$7), taking both SPIM/MARS and Linux o32 codes:
+ *
+ *   SPIM   1 print_int   4 print_string   5 read_int   8 read_string
+ *          9 sbrk   10 exit   11 print_char   12 read_char   13 open
+ *          14 read   15 write   16 close   17 exit2
+ *   o32    4001 exit   4003 read   4004 write   4005 open   4006 close
+ *          4045 brk   4246 exit_group
+ *
+ * Results go to $v0. SPIM calls return -1 on an error, o32 ones set $a3 to
+ * 1 and return the errno in $v0, or set $a3 to 0. Any other code throws.
+ *
+ * Pointers (strings, buffers, the heap) are byte addresses, as lb and sb
+ * take them (see Mem.h); sbrk and brk hand out word aligned ones. Guest
+ * descriptors 0, 1 and 2 are the streams given, others host files opened
+ * on behalf of the guest. Writes are buffered per descriptor, BUFFER_BYTES
+ * at a time, and only go out when that fills, on close, on exit, or before
+ * a read of stdin, so printing costs no host call per syscall.
+ *
+ * The instructions behind a syscall do not see what it wrote, as for any
+ * write (see Assembler.h), and should not touch memory it reads. The
+ * Assembler pads them with nops.
+ *
+ * The syscall ProgramLoader writes past a program to end it is not one the
+ * program asked for, whatever is in $v0 by then. Given its address
+ * (setEndMarker), the cores end the program there without handling it.
+ */
+namespace sys{
+
+  class SyscallEmulator{
+    private:
+      /* a guest descriptor */
+      struct File{
+        bool open;
+        /* -1 for the streams */
+        int hostFd;
+        istream* in;
+        ostream* out;
+        vector<char> buffer;
+      };
+
+      vector<File> files;
+      /* the program break, a byte address */
+      data32 brk;
+      /* the loader's syscall, NO_END_MARKER if none */
+      data32 endMarker;
+      bool exited;
+      int exitCode;
+      unsigned long nCalls;
+      /* held through handle, for cores on several threads */
+      mutex lock;
+
+      File* file(data32 fd);
+      bool flush(File& f);
+      string readString(MemoryUnit& mainMem, data32 addr);
+      /* returns: bytes written, or -1 */
+      long write(MemoryUnit& mainMem, data32 fd, data32 buf, data32 count);
+      /* returns: bytes read, or -1 */
+      long read(MemoryUnit& mainMem, data32 fd, data32 buf, data32 count);
+      /* returns: the guest descriptor, or -1 */
+      long open(const string& path, int hostFlags, data32 mode);
+      /* returns: 0, or -1 */
+      long close(data32 fd);
+      void exit(int code);
+
+    public:
+      static const size_t BUFFER_BYTES = 1 << 16;
+      static const data32 NO_END_MARKER = (data32) -1;
+
+      /*
+       * params:
+       *   heapStart: the first word past the program, where sbrk starts
+       *   in, out, err: guest descriptors 0, 1 and 2
+       */
+      SyscallEmulator(data32 heapStart, istream& in = cin,
+          ostream& out = cout, ostream& err = cerr);
+
+      /*
+       * runs the syscall the registers ask for. Calls from several threads
+       * (see MultiCore.h) run one at a time
+       * params:
+       *   mainMem: the guest's memory
+       *   rf: the register file, every write before the syscall in it
+       * returns: true if it ended the program
+       * throws: exception on a code it doesn't know
+       */
+      bool handle(MemoryUnit& mainMem, MemoryUnit& rf);
+
+      /*
+       * sets where the loader's ending syscall is, ProgramLoader::getExit
+       */
+      void setEndMarker(data32 addr);
+
+      /*
+       * returns: whether the syscall at addr ends the program without
+       *   being handled, being the loader's
+       */
+      bool isEndMarker(data32 addr) const;
+
+      /*
+       * writes out what every descriptor has buffered
+       */
+      void flush();
+
+      bool hasExited() const;
+      /* what the program passed to exit, 0 if it didn't */
+      int getExitCode() const;
+      unsigned long getNCalls() const;
+
+      /*
+       * flushes, and closes the host files the guest left open
+       */
+      ~SyscallEmulator();
+  };
+}
+#endif
@@ -0,0 +1,127 @@
+#include <thread>
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace pool{
+
+  namespace {
+    /* the worker the current thread is, so jobs submit to their own deque */
+    thread_local long currentWorker = -1;
+
+    /* calls its function on the way out of a scope, even by an exception */
+    class ScopeGuard{
+      private:
+        function<void()> onExit;
+      public:
+        ScopeGuard(function<void()> onExit) : onExit{move(onExit)} {}
+        ~ScopeGuard(){ onExit(); }
+        ScopeGuard(const ScopeGuard&) = delete;
+        ScopeGuard& operator=(const ScopeGuard&) = delete;
+    };
+  }
+
+  WorkStealingPool::WorkStealingPool(size_t nThreads) : nextWorker{0},
+    unfinished{0}, queued{0} {
+    if(nThreads == 0)
+      nThreads = thread::hardware_concurrency();
+    if(nThreads == 0)
+      nThreads = 1;
+    for(size_t i = 0; i < nThreads; i++)
+      workers.push_back(make_unique<Worker>());
+  }
+
+  void WorkStealingPool::submit(function<void()> job){
+    size_t i;
+    if(currentWorker >= 0){
+      i = currentWorker;
+    } else {
+      i = nextWorker;
+      nextWorker = (nextWorker + 1) % workers.size();
+    }
+    unfinished++;
+    {
+      //counted before it can be taken, so queued never drops below zero
+      lock_guard<mutex> guard(workers[i]->lock);
+      queued++;
+      workers[i]->jobs.push_back(move(job));
+    }
+    wake(false);
+  }
+
+  void WorkStealingPool::wake(bool all){
+    //taking the lock orders the change before a waiter's check, so the
+    //notify can't fall between its check and its sleep
+    {
+      lock_guard<mutex> guard(idleLock);
+    }
+    if(all)
+      idle.notify_all();
+    else
+      idle.notify_one();
+  }
+
+  void WorkStealingPool::finished(){
+    if(--unfinished == 0)
+      wake(true);
+  }
+
+  function<void()> WorkStealingPool::take(size_t i){
+    {
+      Worker& own = *workers[i];
+      lock_guard<mutex> guard(own.lock);
+      if(!own.jobs.empty()){
+        function<void()> job = move(own.jobs.back());
+        own.jobs.pop_back();
+        queued--;
+        return job;
+      }
+    }
+    for(size_t n = 1; n < workers.size(); n++){
+      Worker& victim = *workers[(i + n) % workers.size()];
+      lock_guard<mutex> guard(victim.lock);
+      if(!victim.jobs.empty()){
+        function<void()> job = move(victim.jobs.front());
+        victim.jobs.pop_front();
+        queued--;
+        return job;
+      }
+    }
+    return function<void()>();
+  }
+
+  void WorkStealingPool::work(size_t i){
+    currentWorker = i;
+    //a job can only be submitted by a running job, so once none are left
+    //running or queued there will be no more
+    while(true){
+      function<void()> job = take(i);
+      if(job){
+        ScopeGuard done([this]{ finished(); });
+        job();
+        continue;
+      }
+      unique_lock<mutex> guard(idleLock);
+      idle.wait(guard, [this]{ return queued.load() > 0 ||
+          unfinished.load() == 0; });
+      //another worker may have taken what woke this one, so only quit once
+      //nothing is left running either
+      if(unfinished.load() == 0 && queued.load() == 0)
+        break;
+    }
+    currentWorker = -1;
+  }
+
+  void WorkStealingPool::wait(){
+    vector<thread> threads;
+    for(size_t i = 1; i < workers.size(); i++)
+      threads.emplace_back(&WorkStealingPool::work, this, i);
+    work(0);
+    for(thread& t : threads)
+      t.join();
+  }
+
+  size_t WorkStealingPool::getNThreads() const{
+    return workers.size();
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+/*
+ * A work stealing thread pool for batches of independent jobs, like the
+ * simulations of a sweep. Every worker has its own deque. A worker takes
+ * from the back of its own and, when that runs dry, steals from the front
+ * of the others, so long jobs don't leave threads idle behind them.
+ *
+ * Jobs are submitted, then wait runs them all and returns once every job
+ * has finished. A running job may submit more, and idle workers sleep until
+ * one is queued or nothing is left running.
+ */
+namespace pool{
+
+  class WorkStealingPool{
+    private:
+      struct Worker{
+        mutex lock;
+        deque<function<void()>> jobs;
+      };
+      vector<unique_ptr<Worker>> workers;
+      /* where the next job from outside the pool goes */
+      size_t nextWorker;
+      /* jobs submitted and not yet finished */
+      atomic<size_t> unfinished;
+      /* jobs submitted and not yet taken by a worker */
+      atomic<size_t> queued;
+      /* idle workers wait on this for a submit or the last job finishing */
+      mutex idleLock;
+      condition_variable idle;
+
+      /*
+       * wakes idle workers after queued or unfinished changed
+       * params:
+       *   all: wake every worker rather than one
+       */
+      void wake(bool all);
+
+      /*
+       * marks a job finished, waking everyone if it was the last
+       */
+      void finished();
+
+      /*
+       * returns: a job from worker i's own deque or stolen from another,
+       * or an empty function when there are none left anywhere
+       */
+      function<void()> take(size_t i);
+
+      /*
+       * the loop each thread runs until there is nothing left
+       */
+      void work(size_t i);
+
+    public:
+      /*
+       * params:
+       *   nThreads: number of workers, 0 for one per hardware thread
+       */
+      WorkStealingPool(size_t nThreads = 0);
+
+      /*
+       * queues a job. Jobs must not throw, catch inside the job
+       */
+      void submit(function<void()> job);
+
+      /*
+       * runs every submitted job on the workers and returns when all are done
+       */
+      void wait();
+
+      size_t getNThreads() const;
+  };
+}
+#endif
@@ -0,0 +1,497 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Trace.h"
+#include "FrontEnd.h"
+
+using namespace std;
+
+namespace trace{
+
+  namespace {
+    const char MAGIC[8] = {'C', 'C', 'A', 'T', 'R', 'A', 'C', 'E'};
+    const uint32_t VERSION = 1;
+
+    struct Header{
+      char magic[8];
+      uint32_t version;
+      uint32_t unused;
+      uint64_t nRecords;
+      uint64_t unused2;
+    };
+
+    //record flags
+    const unsigned char SEQUENTIAL = 1;
+    const unsigned char SAME_WORD = 2;
+    const unsigned char ADDRESS = 4;
+    const unsigned char REDIRECT = 8;
+
+    const size_t N_WORDS = 4096;
+    const size_t FLUSH_BYTES = 1 << 20;
+    /* how far behind the reader pages are dropped */
+    const size_t RELEASE_BYTES = 64 << 20;
+    /* instructions Processor5S fetches behind a branch at full speed */
+    const int DELAY_SLOTS = 5;
+    const int N_STAGES = 5;
+
+    /*
+     * memory of config's size that reads as nops, for a FetchUnit whose
+     * words the replay takes from the trace. Only its addresses are timed
+     */
+    class BlankMem : public MemoryUnit{
+      private:
+        size_t size;
+      public:
+        BlankMem(size_t size) : MemoryUnit{"BlankMem"}, size{size} {}
+        data32 ld(unsigned int){ return 0; }
+        void sw(unsigned int, data32){}
+        void storeBlock(data32, data32*, size_t){}
+        size_t getSize(){ return size; }
+    };
+
+    bool isMemOp(data32 word){
+      return (word >> 26) >= 0x20;
+    }
+
+    bool isJal(data32 word){
+      return (word >> 26) == 0x3;
+    }
+
+    bool isJr(data32 word){
+      return (word >> 26) == 0 && (word & 0x3f) == 0x8;
+    }
+
+    void putVarint(vector<char>& out, int64_t value){
+      uint64_t zigzag = ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+      while(zigzag >= 0x80){
+        out.push_back((char) (zigzag | 0x80));
+        zigzag >>= 7;
+      }
+      out.push_back((char) zigzag);
+    }
+
+    void truncated(){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Trace>> trace is truncated" << endl;
+      throw std::exception();
+    }
+  }
+
+  void decode(TraceRecord& r){
+    data32 w = r.word;
+    unsigned int opcode = w >> 26;
+    int8_t rs = (w >> 21) & 0x1f;
+    int8_t rt = (w >> 16) & 0x1f;
+    int8_t rd = (w >> 11) & 0x1f;
+    unsigned int func = w & 0x3f;
+    r.srcs[0] = r.srcs[1] = r.dest = -1;
+    if(w == 0){
+      r.op = OP_NOP;
+    } else if(opcode == 0){
+      if(func == 0xc){
+        r.op = OP_SYSCALL;
+      } else if(func == 0x8 || func == 0x9){
+        r.op = OP_JUMP;
+        r.srcs[0] = rs;
+        if(func == 0x9)
+          r.dest = rd;
+      } else if(func == 0xf){
+        //sync, an ordering point with no operands
+        r.op = OP_ALU;
+      } else if(func >= 0x18 && func <= 0x1b){
+        r.op = func <= 0x19 ? OP_MUL : OP_DIV;
+        r.srcs[0] = rs;
+        r.srcs[1] = rt;
+      } else if(func == 0x10 || func == 0x12){
+        r.op = OP_ALU;
+        r.dest = rd;
+      } else {
+        r.op = OP_ALU;
+        r.srcs[0] = rs;
+        r.srcs[1] = rt;
+        r.dest = rd;
+      }
+    } else if(opcode == 0x2 || opcode == 0x3){
+      r.op = OP_JUMP;
+      if(opcode == 0x3)
+        r.dest = 31;
+    } else if(opcode == 0x1 || opcode == 0x4 || opcode == 0x5){
+      r.op = OP_BRANCH;
+      r.srcs[0] = rs;
+      if(opcode != 0x1)
+        r.srcs[1] = rt;
+    } else if(opcode == 0x38){
+      //sc stores rt at rs + imm and writes rt, value first as for sw
+      r.op = OP_STORE;
+      r.srcs[0] = rt;
+      r.srcs[1] = rs;
+      r.dest = rt;
+    } else if(opcode >= 0x20){
+      //sw stores rs at rt + imm, lw (and ll) loads rs + imm into rt
+      if(opcode & 0x8){
+        r.op = OP_STORE;
+        r.srcs[0] = rs;
+        r.srcs[1] = rt;
+      } else {
+        r.op = OP_LOAD;
+        r.srcs[0] = rs;
+        r.dest = rt;
+      }
+    } else {
+      r.op = OP_ALU;
+      if(opcode != 0xf)
+        r.srcs[0] = rs;
+      r.dest = rt;
+    }
+    if(r.dest == 0)
+      r.dest = -1;
+  }
+
+  bool readsHiLo(const TraceRecord& r){
+    unsigned int func = r.word & 0x3f;
+    return r.word >> 26 == 0 && (func == 0x10 || func == 0x12);
+  }
+
+  bool isSync(const TraceRecord& r){
+    return r.word >> 26 == 0 && (r.word & 0x3f) == 0xf;
+  }
+
+  TraceWriter::TraceWriter(const string& filename) : out{filename,
+    ios::binary}, nRecords{0}, lastPc{(data32) -1}, lastAddress{0},
+    words(N_WORDS, {(data32) -1, 0}){
+    if(!out){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Trace>> can't write " << filename <<
+        endl;
+      throw std::exception();
+    }
+    //the count is filled in by close
+    Header h = {};
+    out.write((const char*) &h, sizeof(h));
+  }
+
+  void TraceWriter::record(data32 pc, data32 word, data32 address,
+      bool redirect, data32 target){
+    unsigned char flags = 0;
+    size_t flagsAt = buffer.size();
+    buffer.push_back(0);
+    if(pc == lastPc + 1)
+      flags |= SEQUENTIAL;
+    else
+      putVarint(buffer, (int64_t) pc - ((int64_t) lastPc + 1));
+    pair<data32, data32>& cached = words[pc % N_WORDS];
+    if(cached.first == pc && cached.second == word){
+      flags |= SAME_WORD;
+    } else {
+      cached = {pc, word};
+      buffer.insert(buffer.end(), (char*) &word, (char*) &word + 4);
+    }
+    if(isMemOp(word)){
+      flags |= ADDRESS;
+      putVarint(buffer, (int64_t) address - (int64_t) lastAddress);
+      lastAddress = address;
+    } else if(isJal(word)){
+      flags |= ADDRESS;
+      putVarint(buffer, (int64_t) address - (int64_t) pc);
+    }
+    if(redirect){
+      flags |= REDIRECT;
+      putVarint(buffer, (int64_t) target - (int64_t) pc);
+    }
+    buffer[flagsAt] = flags;
+    lastPc = pc;
+    nRecords++;
+    if(buffer.size() >= FLUSH_BYTES)
+      flush();
+  }
+
+  void TraceWriter::flush(){
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+
+  void TraceWriter::close(){
+    if(!out.is_open())
+      return;
+    flush();
+    Header h = {};
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.nRecords = nRecords;
+    out.seekp(0);
+    out.write((const char*) &h, sizeof(h));
+    out.close();
+  }
+
+  uint64_t TraceWriter::getNRecords() const{
+    return nRecords;
+  }
+
+  TraceWriter::~TraceWriter(){
+    close();
+  }
+
+  TraceReader::TraceReader(const string& filename) : fd{-1}, base{nullptr},
+    size{0}, offset{sizeof(Header)}, released{0}, nRecords{0}, nRead{0},
+    lastPc{(data32) -1}, lastAddress{0}, words(N_WORDS, {(data32) -1, 0}){
+    fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header)){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Trace>> can't read " << filename << endl;
+      if(fd >= 0)
+        ::close(fd);
+      throw std::exception();
+    }
+    size = st.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapped == MAP_FAILED){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Trace>> can't map " << filename << endl;
+      ::close(fd);
+      throw std::exception();
+    }
+    base = (const unsigned char*) mapped;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    Header h;
+    memcpy(&h, base, sizeof(h));
+    if(memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION){
+      BOOST_LOG_TRIVIAL(fatal) << "<<Trace>> " << filename << " is not a "
+        "finished trace" << endl;
+      munmap(mapped, size);
+      ::close(fd);
+      throw std::exception();
+    }
+    nRecords = h.nRecords;
+  }
+
+  bool TraceReader::next(TraceRecord& r){
+    if(nRead == nRecords)
+      return false;
+    auto varint = [&](){
+      uint64_t v = 0;
+      for(int shift = 0; ; shift += 7){
+        if(offset >= size || shift > 63)
+          truncated();
+        unsigned char b = base[offset++];
+        v |= (uint64_t) (b & 0x7f) << shift;
+        if(!(b & 0x80))
+          break;
+      }
+      return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+    };
+
+    if(offset >= size)
+      truncated();
+    unsigned char flags = base[offset++];
+    r.pc = flags & SEQUENTIAL ? lastPc + 1 : lastPc + 1 + varint();
+    pair<data32, data32>& cached = words[r.pc % N_WORDS];
+    if(flags & SAME_WORD){
+      r.word = cached.second;
+    } else {
+      if(offset + 4 > size)
+        truncated();
+      memcpy(&r.word, base + offset, 4);
+      offset += 4;
+      cached = {r.pc, r.word};
+    }
+    r.address = 0;
+    if(flags & ADDRESS && isJal(r.word)){
+      r.address = r.pc + varint();
+    } else if(flags & ADDRESS){
+      lastAddress += varint();
+      r.address = lastAddress;
+    }
+    r.redirect = flags & REDIRECT;
+    r.target = r.redirect ? r.pc + varint() : 0;
+    decode(r);
+    lastPc = r.pc;
+    nRead++;
+
+    //streaming: hand the pages behind us back
+    if(offset - released >= 2 * RELEASE_BYTES){
+      size_t page = sysconf(_SC_PAGESIZE);
+      size_t upTo = (offset - RELEASE_BYTES) / page * page;
+      madvise((void*) (base + released), upTo - released, MADV_DONTNEED);
+      released = upTo;
+    }
+    return true;
+  }
+
+  uint64_t TraceReader::getNRecords() const{
+    return nRecords;
+  }
+
+  TraceReader::~TraceReader(){
+    munmap((void*) base, size);
+    ::close(fd);
+  }
+
+  TraceReplayer::TraceReplayer(RecordSource& reader,
+      const SimConfig& config) :
+    reader{reader}, config{config}, currentCycle{0}, nRetired{0},
+    nSkipped{0}, havePending{false} {}
+
+  void TraceReplayer::run(){
+    //what each stage holds, and for how many more cycles. The same initial
+    //state as Processor5S
+    bool valid[N_STAGES] = {};
+    TraceRecord held[N_STAGES];
+    int busy[N_STAGES] = {0, 1, 1, 1, 1};
+    data32 pc = 0;
+    //pcs this replay fetches that the capture did not, after a return
+    data32 gapStart = 0;
+    data32 gapEnd = 0;
+    //the front end as Processor5S has it, timing its fetches instead of
+    //if.latency, and the address fetch waits on it for
+    BlankMem blank(config.memWords);
+    unique_ptr<frontend::FetchUnit> fetchUnit;
+    if(config.fetchQueueWords > 0)
+      fetchUnit = make_unique<frontend::FetchUnit>(blank,
+          config.fetchLineWords, config.fetchQueueWords, config.ifLatency,
+          config.loopBufferWords);
+    bool fetchWaiting = false;
+    data32 fetchAddr = 0;
+
+    auto latency = [&](int stage, bool isValid, const TraceRecord& r){
+      if(!isValid)
+        return 1u;
+      switch(stage){
+        case 0: return fetchUnit != nullptr ? 1u : config.ifLatency;
+        case 1: return config.idLatency;
+        case 2: return r.op == OP_MUL ? config.mulLatency :
+                r.op == OP_DIV ? config.divLatency : config.exLatency;
+        case 3: return r.op == OP_LOAD || r.op == OP_STORE ?
+                config.memLatency : config.maLatency;
+        default: return r.op == OP_SYSCALL ?
+                 max(config.wbLatency, config.syscallLatency) :
+                 config.wbLatency;
+      }
+    };
+
+    bool quit = false;
+    bool exhausted = false;
+    while(!quit){
+      for(int i = 0; i < N_STAGES; i++)
+        busy[i] = busy[i] > 0 ? busy[i] - 1 : 0;
+      if(fetchUnit != nullptr)
+        fetchUnit->tick();
+      int firstStalling = N_STAGES - 1;
+      while(firstStalling > 0 && busy[firstStalling] == 0)
+        firstStalling--;
+      if(firstStalling == 0 && busy[0] == 0 && !(fetchUnit != nullptr &&
+            fetchWaiting && !fetchUnit->has(fetchAddr)))
+        firstStalling--;
+      bool fetched = firstStalling < 0;
+
+      //the fetch binds the pc to the next record
+      bool outValid = false;
+      TraceRecord out;
+      if(fetched && !exhausted){
+        if(!havePending)
+          havePending = reader.next(pending);
+        int skipped = 0;
+        //returned short of the capture, the nops it didn't fetch
+        bool madeUp = pc >= gapStart && pc < gapEnd && nops.count(pc);
+        while(!madeUp && havePending && pending.pc != pc){
+          if(pending.op != OP_NOP || skipped == DELAY_SLOTS){
+            BOOST_LOG_TRIVIAL(fatal) << "<<TraceReplayer>> fetched " << pc <<
+              " but the trace has " << pending.pc << ", it does not fit "
+              "this config" << endl;
+            throw std::exception();
+          }
+          nops.insert(pending.pc);
+          skipped++;
+          nSkipped++;
+          havePending = reader.next(pending);
+        }
+        if(madeUp){
+          out = TraceRecord{};
+          out.pc = pc;
+          decode(out);
+          outValid = true;
+        } else if(havePending){
+          out = pending;
+          outValid = true;
+          havePending = false;
+          if(out.op == OP_NOP)
+            nops.insert(out.pc);
+        } else {
+          //past the end, the rest of the fetches are bubbles
+          exhausted = true;
+        }
+      }
+
+      if(fetched && fetchUnit != nullptr){
+        //the word fetch held leaves it, and the next is asked for
+        if(fetchWaiting)
+          fetchUnit->take(fetchAddr);
+        fetchUnit->request(pc);
+        fetchWaiting = true;
+        fetchAddr = pc;
+      }
+      for(int i = firstStalling + 1; i < N_STAGES; i++){
+        bool tempValid = valid[i];
+        TraceRecord temp = held[i];
+        valid[i] = outValid;
+        held[i] = out;
+        busy[i] = latency(i, outValid, out);
+        //Execute links the pc as it is when the jal leaves it
+        if(i == 3 && outValid && isJal(out.word))
+          links[out.address] = pc + 2;
+        outValid = tempValid;
+        out = temp;
+      }
+      currentCycle++;
+
+      bool redirected = false;
+      if(firstStalling < N_STAGES - 1 && outValid){
+        nRetired++;
+        //an emulated syscall (see Syscall.h) ends it only if it is the last
+        if(out.op == OP_SYSCALL){
+          if(!havePending && !exhausted)
+            havePending = reader.next(pending);
+          quit = !havePending;
+        }
+        if(out.redirect){
+          pc = out.target;
+          redirected = true;
+          auto link = isJr(out.word) ? links.find(pc) : links.end();
+          if(link != links.end()){
+            pc = link->second;
+            //the capture went on from target + 1
+            gapStart = pc + 1;
+            gapEnd = out.target + 1;
+          }
+        }
+      }
+      if(fetched || redirected)
+        pc++;
+
+      if(!quit && exhausted){
+        bool empty = true;
+        for(int i = 0; i < N_STAGES; i++)
+          empty = empty && !valid[i];
+        if(empty){
+          BOOST_LOG_TRIVIAL(fatal) << "<<TraceReplayer>> the trace ended "
+            "without a syscall" << endl;
+          throw std::exception();
+        }
+      }
+    }
+  }
+
+  unsigned long TraceReplayer::getCurrentCycle() const{
+    return currentCycle;
+  }
+
+  unsigned long TraceReplayer::getNRetired() const{
+    return nRetired;
+  }
+
+  unsigned long TraceReplayer::getNSkipped() const{
+    return nSkipped;
+  }
+}
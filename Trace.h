@@ -0,0 +1,212 @@
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "Mem.h"
+#include "Config.h"
+
+using namespace std;
+using namespace mem;
+using namespace config;
+/*
+ * Capture and replay of the dynamic instruction stream.
+ *
+ * A TraceWriter attached to a Processor5S records every retired instruction:
+ * its pc, the instruction word, the effective address of loads and stores and
+ * where a branch or jump sent the pc. The op and register dependences are
+ * decoded from the word when read back. Records are delta encoded:
+ *
+ *   flags    1 byte, the bits below
+ *   pc       zigzag varint of pc - (last pc + 1), unless SEQUENTIAL
+ *   word     4 bytes, unless SAME_WORD (same word as last time at this pc)
+ *   address  zigzag varint of address - last address, if ADDRESS, or of
+ *            address - pc for a jal
+ *   target   zigzag varint of target - pc, if REDIRECT
+ *
+ * after a 32 byte header (magic, version, record count). Multi byte fields are
+ * in host byte order.
+ *
+ * A TraceReader streams a trace through a read only mmap and drops pages
+ * behind it, so traces larger than RAM replay fine. TraceReplayer pushes a
+ * trace through a timing only copy of Processor5S's pipeline. It never
+ * executes anything, it only needs the latencies from a SimConfig.
+ */
+namespace trace{
+
+  enum OpClass : uint8_t {
+    OP_NOP, OP_ALU, OP_MUL, OP_DIV, OP_LOAD, OP_STORE, OP_BRANCH, OP_JUMP,
+    OP_SYSCALL
+  };
+
+  struct TraceRecord{
+    data32 pc;
+    data32 word;
+    /* the effective address for loads and stores, the link for jal */
+    data32 address;
+    /* whether this instruction set the pc, and to what */
+    bool redirect;
+    data32 target;
+    //decoded from word
+    OpClass op;
+    /* source registers, -1 for none */
+    int8_t srcs[2];
+    /* register written, -1 for none (hi/lo are not registers here) */
+    int8_t dest;
+  };
+
+  /*
+   * fills in op, srcs and dest of a record from its word
+   */
+  void decode(TraceRecord& r);
+
+  /*
+   * returns: whether a record reads hi/lo (mfhi, mflo), which decode leaves
+   *   out of srcs. mult, multu, div and divu write it
+   */
+  bool readsHiLo(const TraceRecord& r);
+
+  /*
+   * returns: whether a record is a sync, which decode leaves an OP_ALU
+   *   with no operands
+   */
+  bool isSync(const TraceRecord& r);
+
+  class TraceWriter{
+    private:
+      ofstream out;
+      uint64_t nRecords;
+      data32 lastPc;
+      data32 lastAddress;
+      /* direct mapped pc -> word, to skip repeated words */
+      vector<pair<data32, data32>> words;
+      vector<char> buffer;
+
+      void flush();
+
+    public:
+      /*
+       * throws: exception if filename can't be written
+       */
+      TraceWriter(const string& filename);
+
+      /*
+       * appends one retired instruction
+       * params:
+       *   pc: its address
+       *   word: the instruction
+       *   address: the effective address, only kept for loads and stores
+       *   redirect: whether it set the pc
+       *   target: the pc it set
+       */
+      void record(data32 pc, data32 word, data32 address, bool redirect,
+          data32 target);
+
+      /*
+       * writes out the rest and the record count. Called by the destructor
+       */
+      void close();
+
+      uint64_t getNRecords() const;
+
+      ~TraceWriter();
+  };
+
+  /*
+   * where a TraceReplayer gets its records: a trace file or, see
+   * Functional.h, a functional simulation running ahead
+   */
+  class RecordSource{
+    public:
+      /*
+       * returns: false once there are no more records
+       */
+      virtual bool next(TraceRecord& r) = 0;
+
+      virtual ~RecordSource() = default;
+  };
+
+  class TraceReader : public RecordSource{
+    private:
+      int fd;
+      const unsigned char* base;
+      size_t size;
+      size_t offset;
+      /* everything before this has been handed back to the kernel */
+      size_t released;
+      uint64_t nRecords;
+      uint64_t nRead;
+      data32 lastPc;
+      data32 lastAddress;
+      vector<pair<data32, data32>> words;
+
+    public:
+      /*
+       * throws: exception if filename isn't a readable trace
+       */
+      TraceReader(const string& filename);
+
+      /*
+       * reads the next record
+       * returns: false at the end of the trace
+       * throws: exception if the trace is truncated
+       */
+      bool next(TraceRecord& r) override;
+
+      uint64_t getNRecords() const;
+
+      ~TraceReader();
+  };
+
+  /*
+   * Replays a trace with Processor5S's timing: the same five stages and
+   * latencies, the same stall rule and the pc redirected when a branch leaves
+   * writeback. With fe.queueWords > 0 fetches are timed by a FetchUnit as
+   * Processor5S's are (see FrontEnd.h), on the addresses alone.
+   *
+   * A slower config fetches fewer instructions behind a branch before it
+   * resolves than the capture did. Those records are skipped, which is only
+   * faithful when they are nops, as the assembler emits them. Anything else
+   * throws, as does a config that would fetch past what the trace holds. So
+   * capture with the fastest config (all latencies 1) of a sweep.
+   *
+   * jal links the fetch pc as it executes plus 2, which also moves with the
+   * timing. The replay links its own pc and a jr to a link the capture made
+   * returns to the replay's instead. Returning earlier fetches nops that were
+   * in the trace as the jal's delay slots but not after the return, those
+   * are made up from the ones seen.
+   */
+  class TraceReplayer{
+    private:
+      RecordSource& reader;
+      SimConfig config;
+      unsigned long currentCycle;
+      unsigned long nRetired;
+      unsigned long nSkipped;
+      bool havePending;
+      TraceRecord pending;
+      /* link the capture made -> link this replay made */
+      unordered_map<data32, data32> links;
+      /* pcs seen holding a nop */
+      unordered_set<data32> nops;
+
+    public:
+      TraceReplayer(RecordSource& reader, const SimConfig& config);
+
+      /*
+       * runs to the syscall that ends the trace
+       * throws: exception if the trace does not fit the config, see above
+       */
+      void run();
+
+      unsigned long getCurrentCycle() const;
+      unsigned long getNRetired() const;
+      /* trace records dropped as unfetched branch delay slots */
+      unsigned long getNSkipped() const;
+  };
+}
+#endif
@@ -0,0 +1,79 @@
+#include <atomic>
+#include <exception>
+#include <thread>
+#include "WhatIf.h"
+
+using namespace std;
+
+namespace whatif{
+
+  Simulation::Simulation(unique_ptr<CowMem> mainMem, unique_ptr<DRAM> rf,
+      const SimConfig& config) : mainMem{move(mainMem)}, rf{move(rf)},
+    config{config} {}
+
+  Simulation::Simulation(const ProgramImage& image, const SimConfig& config)
+    : Simulation(make_unique<CowMem>(config.memWords, "MainMem"),
+        make_unique<DRAM>(0b100000, "rf"), config) {
+    //as ProgramLoader::loadProgram
+    mainMem->storeBlock(0, const_cast<data32*>(image->data()), image->size());
+    rf->sw(31, image->size() - 1);
+    p = make_unique<Processor5S>("MIPSProcessor", *mainMem, *rf, 0, "",
+        config);
+  }
+
+  unique_ptr<Simulation> Simulation::clone(const SimConfig& config){
+    auto rfCopy = make_unique<DRAM>(rf->getSize(), "rf");
+    for(data32 i = 0; i < rf->getSize(); i++)
+      rfCopy->sw(i, rf->ld(i));
+    unique_ptr<Simulation> c(new Simulation(mainMem->clone(), move(rfCopy),
+          config));
+    c->p = make_unique<Processor5S>(*p, *c->mainMem, *c->rf, "", config);
+    return c;
+  }
+
+  Processor5S& Simulation::getProcessor(){
+    return *p;
+  }
+
+  CowMem& Simulation::getMainMemory(){
+    return *mainMem;
+  }
+
+  MemoryUnit& Simulation::getRegisterFile(){
+    return *rf;
+  }
+
+  const SimConfig& Simulation::getConfig() const{
+    return config;
+  }
+
+  vector<Outcome> runAll(vector<unique_ptr<Simulation>>& simulations,
+      unsigned long nInstrs){
+    vector<Outcome> outcomes(simulations.size());
+    atomic<bool> failed{false};
+    vector<thread> threads;
+    for(size_t i = 0; i < simulations.size(); i++){
+      threads.emplace_back([&, i](){
+        Processor5S& p = simulations[i]->getProcessor();
+        Outcome& o = outcomes[i];
+        unsigned long retired = p.getNRetired();
+        unsigned long cycles = p.getCurrentCycle();
+        try{
+          o.finished = p.runFor(nInstrs);
+        } catch(const std::exception&){
+          failed = true;
+        }
+        o.nInstrs = p.getNRetired() - retired;
+        o.cycles = p.getCurrentCycle() - cycles;
+        o.ownedPages = simulations[i]->getMainMemory().getNOwnedPages();
+      });
+    }
+    for(thread& t : threads)
+      t.join();
+    if(failed){
+      //already logged as fatal where it was thrown
+      throw std::exception();
+    }
+    return outcomes;
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef WHAT_IF_H_INCLUDED
+#define WHAT_IF_H_INCLUDED
+#include <memory>
+#include <vector>
+#include "Config.h"
+#include "Mem.h"
+#include "Processor.h"
+
+using namespace std;
+using namespace config;
+using namespace mem;
+/*
+ * What if comparisons from one warmed state: warm a simulation up once,
+ * clone it for each variant of the configuration, and run the clones side
+ * by side, each on its own thread.
+ *
+ * A clone shares main memory with the simulation it came from, copy on
+ * write (CowMem), and copies the register file and the pipeline with the
+ * instructions in flight. Those finish on the timing they started with;
+ * everything after goes by the clone's configuration. There are no caches
+ * or predictors in Processor5S, so the pipeline is all the timing state
+ * there is to carry over.
+ */
+namespace whatif{
+
+  class Simulation{
+    private:
+      unique_ptr<CowMem> mainMem;
+      unique_ptr<DRAM> rf;
+      SimConfig config;
+      unique_ptr<Processor5S> p;
+
+      Simulation(unique_ptr<CowMem> mainMem, unique_ptr<DRAM> rf,
+          const SimConfig& config);
+
+    public:
+      /*
+       * image loaded as ProgramLoader does, ready to run from 0
+       */
+      Simulation(const ProgramImage& image, const SimConfig& config);
+
+      /*
+       * returns: a copy of this simulation as it is, to go on by config.
+       *   This one must not be running meanwhile
+       */
+      unique_ptr<Simulation> clone(const SimConfig& config);
+
+      Processor5S& getProcessor();
+      CowMem& getMainMemory();
+      MemoryUnit& getRegisterFile();
+      const SimConfig& getConfig() const;
+  };
+
+  struct Outcome{
+    /* instructions and cycles of this run, not counting before it */
+    unsigned long nInstrs;
+    unsigned long cycles;
+    /* whether it reached the syscall */
+    bool finished;
+    /* pages of main memory it holds copies of its own */
+    size_t ownedPages;
+  };
+
+  /*
+   * runs each simulation on a thread of its own for nInstrs more
+   * instructions, or to the syscall
+   * throws: exception if any of them does
+   */
+  vector<Outcome> runAll(vector<unique_ptr<Simulation>>& simulations,
+      unsigned long nInstrs);
+}
+#endif
@@ -0,0 +1,306 @@
+#define BOOST_LOG_DYN_LINK
+#include "Pipeline.h"
+#include "Mem.h"
+#include "Instruction.h"
+#include "Debug.h"
+#include "Processor.h"
+#include "Synth.h"
+
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+using namespace mem;
+using namespace pipeline;
+using namespace std;
+using namespace instruction;
+using namespace synth;
+/*
+ * Microbenchmarks for the simulator's hot components. Build and run with
+ * make bench. Times are host ns per operation. Benchmarks that push
+ * instructions through also report sim_instrs, the rate of simulated
+ * instructions, which reads as simulated MIPS.
+ *
+ * make bench-baseline stores a baseline json, make bench-compare flags
+ * regressions against it (see benchCompare.py)
+ */
+
+namespace {
+
+  /*
+   * a mix of instructions roughly in the proportions a compiled loop has.
+   * All operands stay in small registers/addresses, so they can be pushed
+   * through any stage without faulting
+   */
+  vector<data32> instrMix(){
+    return {
+      constructRInstr(1, 2, 3, 0, 0x21),  //addu
+      constructIInstr(0x9, 3, 4, 7),      //addiu
+      constructIInstr(0x23, 0, 5, 16),    //lw
+      constructRInstr(4, 5, 6, 0, 0x24),  //and
+      constructRInstr(6, 0, 7, 2, 0x0),   //sll
+      constructIInstr(0x2b, 7, 0, 32),    //sw
+      constructRInstr(1, 2, 0, 0, 0x18),  //mult
+      constructRInstr(0, 0, 8, 0, 0x12),  //mflo
+      constructIInstr(0xa, 8, 9, 100),    //slti
+      constructIInstr(0x5, 9, 0, 0),      //bne (never taken, $9 = $0)
+    };
+  }
+
+  /*
+   * fills a vector with random word addresses below size
+   */
+  vector<data32> randomAddrs(size_t n, size_t size){
+    mt19937 gen(42);
+    uniform_int_distribution<data32> dist(0, size - 1);
+    vector<data32> addrs(n);
+    for(data32& a : addrs)
+      a = dist(gen);
+    return addrs;
+  }
+
+  const size_t MEM_WORDS = 1 << 16;
+  const size_t N_RANDOM = 1 << 12;
+}
+
+static void BM_DRAMLoadSequential(benchmark::State& state){
+  DRAM dram(MEM_WORDS, "bench");
+  data32 addr = 0;
+  for(auto _ : state){
+    benchmark::DoNotOptimize(dram.ld(addr));
+    addr = (addr + 1) & (MEM_WORDS - 1);
+  }
+}
+BENCHMARK(BM_DRAMLoadSequential);
+
+static void BM_DRAMStoreSequential(benchmark::State& state){
+  DRAM dram(MEM_WORDS, "bench");
+  data32 addr = 0;
+  for(auto _ : state){
+    dram.sw(addr, addr);
+    addr = (addr + 1) & (MEM_WORDS - 1);
+  }
+}
+BENCHMARK(BM_DRAMStoreSequential);
+
+static void BM_DRAMLoadRandom(benchmark::State& state){
+  DRAM dram(MEM_WORDS, "bench");
+  vector<data32> addrs = randomAddrs(N_RANDOM, MEM_WORDS);
+  size_t i = 0;
+  for(auto _ : state){
+    benchmark::DoNotOptimize(dram.ld(addrs[i]));
+    i = (i + 1) & (N_RANDOM - 1);
+  }
+}
+BENCHMARK(BM_DRAMLoadRandom);
+
+static void BM_VirtualMemSequential(benchmark::State& state){
+  VirtualMem vmem(new DRAM(MEM_WORDS, "bench"));
+  data32 addr = 0;
+  for(auto _ : state){
+    vmem.sw(addr, addr);
+    benchmark::DoNotOptimize(vmem.ld(addr));
+    addr = (addr + 1) & (MEM_WORDS - 1);
+  }
+}
+BENCHMARK(BM_VirtualMemSequential);
+
+static void BM_VirtualMemRandom(benchmark::State& state){
+  VirtualMem vmem(new DRAM(MEM_WORDS, "bench"));
+  //sparse virtual addresses over the whole 32 bit space, but only as many
+  //distinct ones as the backing DRAM can hold
+  mt19937 gen(42);
+  uniform_int_distribution<data32> dist;
+  vector<data32> addrs(N_RANDOM);
+  for(data32& a : addrs)
+    a = dist(gen);
+  size_t i = 0;
+  for(auto _ : state){
+    vmem.sw(addrs[i], i);
+    benchmark::DoNotOptimize(vmem.ld(addrs[i]));
+    i = (i + 1) & (N_RANDOM - 1);
+  }
+}
+BENCHMARK(BM_VirtualMemRandom);
+
+static void BM_InstructionGetType(benchmark::State& state){
+  vector<data32> mix = instrMix();
+  size_t i = 0;
+  for(auto _ : state){
+    Instruction instr(mix[i]);
+    benchmark::DoNotOptimize(instr.getType());
+    i = (i + 1) % mix.size();
+  }
+}
+BENCHMARK(BM_InstructionGetType);
+
+static void BM_InstructionGetFuncType(benchmark::State& state){
+  Instruction instr(constructRInstr(1, 2, 3, 0, 0x21));
+  for(auto _ : state){
+    benchmark::DoNotOptimize(instr.getFuncType());
+  }
+}
+BENCHMARK(BM_InstructionGetFuncType);
+
+static void BM_InstructionGetSlice(benchmark::State& state){
+  Instruction instr(constructRInstr(1, 2, 3, 4, 0x21));
+  for(auto _ : state){
+    benchmark::DoNotOptimize(instr.getSlice<21,26>());
+    benchmark::DoNotOptimize(instr.getSlice<0,16>());
+  }
+}
+BENCHMARK(BM_InstructionGetSlice);
+
+/*
+ * pushes one item through a stage, the way Processor5S drives it:
+ * execute, pass a cycle, getOut
+ */
+static void driveStage(benchmark::State& state, PipelinePhase& stage,
+    const vector<StageOut*>& protos, StageOut* (*copy)(StageOut*)){
+  size_t i = 0;
+  stage.updateCycle(1); //burn the initial bubble
+  for(auto _ : state){
+    StageOut* args = copy(protos[i]);
+    stage.execute(&args);
+    stage.updateCycle(1);
+    StageOut* out = stage.getOut();
+    benchmark::DoNotOptimize(out);
+    delete out;
+    i = (i + 1) % protos.size();
+  }
+  state.counters["sim_instrs"] = benchmark::Counter(state.iterations(),
+      benchmark::Counter::kIsRate);
+  for(StageOut* p : protos)
+    delete p;
+}
+
+static void BM_StageIF(benchmark::State& state){
+  ofstream log("/dev/null");
+  DRAM m(MEM_WORDS, "MainMem");
+  vector<data32> mix = instrMix();
+  m.storeBlock(0, mix.data(), mix.size());
+  InstructionFetch stage("IF", m, log);
+  vector<StageOut*> protos;
+  for(data32 a = 0; a < mix.size(); a++)
+    protos.push_back(new StageOut(a));
+  driveStage(state, stage, protos,
+      [](StageOut* p) -> StageOut* { return new StageOut(*p); });
+}
+BENCHMARK(BM_StageIF);
+
+static void BM_StageID(benchmark::State& state){
+  ofstream log("/dev/null");
+  DRAM rf(32, "rf");
+  InstructionDecode stage("ID", rf, log);
+  vector<StageOut*> protos;
+  for(data32 w : instrMix())
+    protos.push_back(new IFOut(0, Instruction(w)));
+  driveStage(state, stage, protos,
+      [](StageOut* p) -> StageOut* { return new IFOut(*(IFOut*) p); });
+}
+BENCHMARK(BM_StageID);
+
+static void BM_StageEX(benchmark::State& state){
+  ofstream log("/dev/null");
+  PC pc("PC", 0);
+  Execute stage("EX", pc, log);
+  vector<StageOut*> protos;
+  for(data32 w : instrMix())
+    protos.push_back(new IDOut(0, Instruction(w), {3, 5, 7}));
+  driveStage(state, stage, protos,
+      [](StageOut* p) -> StageOut* { return new IDOut(*(IDOut*) p); });
+}
+BENCHMARK(BM_StageEX);
+
+static void BM_StageMA(benchmark::State& state){
+  ofstream log("/dev/null");
+  DRAM m(MEM_WORDS, "MainMem");
+  MemoryAccess stage("MA", m, log);
+  vector<StageOut*> protos;
+  data64 comp = 16;
+  for(data32 w : instrMix())
+    protos.push_back(new EXOut(0, Instruction(w), {3, 5, 7}, comp++));
+  driveStage(state, stage, protos,
+      [](StageOut* p) -> StageOut* { return new EXOut(*(EXOut*) p); });
+}
+BENCHMARK(BM_StageMA);
+
+static void BM_StageWB(benchmark::State& state){
+  ofstream log("/dev/null");
+  DRAM rf(32, "rf");
+  PC pc("PC", 0);
+  data64 acc = 0;
+  WriteBack stage("WB", rf, acc, pc, log);
+  vector<StageOut*> protos;
+  for(data32 w : instrMix())
+    protos.push_back(new MAOut(0, Instruction(w), {3, 5, 7}, 1, 9));
+  driveStage(state, stage, protos,
+      [](StageOut* p) -> StageOut* { return new MAOut(*(MAOut*) p); });
+}
+BENCHMARK(BM_StageWB);
+
+/*
+ * whole processor cycles (updateCycle plus the pc) on an endless loop of
+ * the instruction mix. Body starts at 1, because a jump to x continues at
+ * x + 1
+ */
+static void BM_Processor5SUpdateCycle(benchmark::State& state){
+  DRAM m(MEM_WORDS, "MainMem");
+  DRAM rf(32, "rf");
+  vector<data32> program = {0};
+  for(data32 w : instrMix())
+    program.push_back(w);
+  program.push_back(constructJInstr(0x2, 0));
+  //the delay slots behind the jump
+  for(int i = 0; i < 5; i++)
+    program.push_back(0);
+  m.storeBlock(0, program.data(), program.size());
+  Processor5S p("bench", m, rf, 1, "/dev/null");
+  unsigned long retiredBefore = p.getNRetired();
+  for(auto _ : state){
+    benchmark::DoNotOptimize(p.step());
+  }
+  state.counters["sim_instrs"] = benchmark::Counter(
+      p.getNRetired() - retiredBefore, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Processor5SUpdateCycle);
+
+/*
+ * whole synthetic programs (see Synth.h) run to the syscall, over code size
+ * (first arg, instructions) and data footprint (second arg, words), to show
+ * how throughput holds up as both grow
+ */
+static void BM_SynthProgram(benchmark::State& state){
+  SynthConfig config;
+  config.nInstrs = state.range(0);
+  config.footprint = state.range(1);
+  config.stride = 17;
+  SynthProgram program(config);
+  unsigned long retired = 0;
+  for(auto _ : state){
+    state.PauseTiming();
+    DRAM m(program.getMemWords(), "MainMem");
+    DRAM rf(32, "rf");
+    program.load(m);
+    Processor5S p("bench", m, rf, 0, "/dev/null");
+    state.ResumeTiming();
+    while(!p.step());
+    retired += p.getNRetired();
+  }
+  state.counters["sim_instrs"] = benchmark::Counter(
+      retired, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SynthProgram)
+  ->ArgsProduct({{1 << 12, 1 << 16, 1 << 20}, {1 << 10, 1 << 18}})
+  ->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv){
+  //debug records would measure the console, not the simulator
+  boost::log::core::get()->set_logging_enabled(false);
+  benchmark::Initialize(&argc, argv);
+  if(benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
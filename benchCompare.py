@@ -0,0 +1,58 @@
+"""
+Compares a Google Benchmark json run against a stored baseline and flags
+regressions.
+
+Usage:
+    python3 benchCompare.py <baseline.json> <current.json> [threshold]
+
+threshold is the allowed slowdown as a fraction (default 0.10, so 10%).
+Exits with 1 if any benchmark regressed, so make bench-compare fails.
+"""
+import json
+from sys import argv, exit
+
+def loadTimes(filename):
+    """
+    returns {benchmark name: (cpu ns per iteration, sim_instrs rate or None)}
+    """
+    with open(filename) as f:
+        run = json.load(f)
+    times = {}
+    for b in run["benchmarks"]:
+        if b.get("run_type", "iteration") != "iteration":
+            continue
+        scale = {"ns": 1, "us": 1e3, "ms": 1e6, "s": 1e9}[b["time_unit"]]
+        times[b["name"]] = (b["cpu_time"] * scale, b.get("sim_instrs"))
+    return times
+
+def main():
+    if len(argv) < 3:
+        print(__doc__)
+        exit(2)
+    baseline = loadTimes(argv[1])
+    current = loadTimes(argv[2])
+    threshold = float(argv[3]) if len(argv) > 3 else 0.10
+
+    regressed = False
+    print("{:<32}{:>14}{:>14}{:>10}{:>12}".format(
+        "benchmark", "base ns/op", "now ns/op", "change", "sim MIPS"))
+    for name, (nowNs, nowRate) in current.items():
+        if name not in baseline:
+            print("{:<32}{:>14}{:>14.1f}{:>10}".format(name, "-", nowNs, "new"))
+            continue
+        baseNs = baseline[name][0]
+        change = (nowNs - baseNs) / baseNs
+        mips = "" if nowRate is None else "{:.3f}".format(nowRate / 1e6)
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressed = True
+        print("{:<32}{:>14.1f}{:>14.1f}{:>+9.1f}%{:>12}{}".format(
+            name, baseNs, nowNs, 100 * change, mips, flag))
+    for name in baseline:
+        if name not in current:
+            print("{:<32} missing from current run".format(name))
+    exit(1 if regressed else 0)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,79 @@
+#define BOOST_LOG_DYN_LINK
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "Cache.h"
+#include "Trace.h"
+
+using namespace std;
+using namespace cache;
+using namespace trace;
+/*
+ * Simulates one cache over a captured trace (main --capture), with the sets
+ * split across threads (see Cache.h).
+ *
+ * Usage:
+ *   cacheSim <trace> [--stream inst|data] [--sets n] [--ways n] [--line words]
+ *     [--threads n]
+ * inst feeds the fetched pcs, data (the default) the load and store
+ * addresses. The default cache is 256 sets of 4 ways of 4 words, threads
+ * default to one per hardware thread.
+ */
+int main(int argc, char** argv){
+  if(argc < 2 || argc % 2 != 0){
+    cerr << "usage: cacheSim <trace> [--stream inst|data] [--sets n] "
+      "[--ways n] [--line words] [--threads n]" << endl;
+    return 2;
+  }
+  bool data = true;
+  unsigned int nSets = 256;
+  unsigned int ways = 4;
+  unsigned int lineWords = 4;
+  unsigned int nThreads = 0;
+  for(int i = 2; i < argc; i += 2){
+    string option = argv[i];
+    string value = argv[i + 1];
+    if(option == "--stream" && (value == "inst" || value == "data")){
+      data = value == "data";
+    } else if(option == "--sets"){
+      nSets = stoul(value, nullptr, 0);
+    } else if(option == "--ways"){
+      ways = stoul(value, nullptr, 0);
+    } else if(option == "--line"){
+      lineWords = stoul(value, nullptr, 0);
+    } else if(option == "--threads"){
+      nThreads = stoul(value, nullptr, 0);
+    } else {
+      cerr << "bad option " << option << " " << value << endl;
+      return 2;
+    }
+  }
+
+  ShardedCacheSim sim(nSets, ways, lineWords, nThreads);
+  TraceReader reader(argv[1]);
+  TraceRecord r;
+  auto start = chrono::steady_clock::now();
+  while(reader.next(r)){
+    if(!data)
+      sim.access(r.pc);
+    else if(r.op == OP_LOAD || r.op == OP_STORE)
+      sim.access(r.address);
+  }
+  CacheStats stats = sim.finish();
+  auto end = chrono::steady_clock::now();
+  double seconds = chrono::duration<double>(end - start).count();
+
+  cout << nSets << " sets x " << ways << " ways x " << lineWords <<
+    " words, " << (data ? "data" : "inst") << ": " << stats.accesses <<
+    " accesses, " << stats.misses << " misses, miss ratio " << fixed <<
+    setprecision(4) << stats.missRatio() << endl;
+  cout << sim.getNShards() << " shards, accesses per shard:";
+  for(size_t i = 0; i < sim.getNShards(); i++)
+    cout << " " << sim.getShardStats(i).accesses;
+  cout << endl << setprecision(2) << seconds << " s, " <<
+    (seconds > 0 ? stats.accesses / seconds / 1e6 : 0) << " M accesses/s"
+    << endl;
+  return 0;
+}
@@ -0,0 +1,76 @@
+#define BOOST_LOG_DYN_LINK
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include "Synth.h"
+
+using namespace std;
+using namespace synth;
+/*
+ * Writes a synthetic program (see Synth.h) in the format ProgramLoader reads.
+ *
+ * Usage:
+ *   genSynth <out.hex> [--instrs n] [--mix alu,mul,load,store,branch]
+ *     [--dep d] [--taken rate] [--skip n] [--footprint words]
+ *     [--stride words] [--seed s]
+ * Prints the words of main memory the program needs, code plus data.
+ */
+
+namespace {
+  void usage(){
+    cerr << "usage: genSynth <out.hex> [--instrs n] "
+      "[--mix alu,mul,load,store,branch] [--dep d] [--taken rate] "
+      "[--skip n] [--footprint words] [--stride words] [--seed s]" << endl;
+    exit(2);
+  }
+
+  InstrMix parseMix(const string& s){
+    InstrMix mix;
+    double* weights[] = {&mix.alu, &mix.mul, &mix.load, &mix.store,
+      &mix.branch};
+    size_t start = 0;
+    for(double* w : weights){
+      if(start > s.size())
+        usage();
+      size_t comma = s.find(',', start);
+      *w = stod(s.substr(start, comma - start));
+      start = comma == string::npos ? s.size() + 1 : comma + 1;
+    }
+    return mix;
+  }
+}
+
+int main(int argc, char** argv){
+  if(argc < 2 || argc % 2 != 0)
+    usage();
+  SynthConfig config;
+  for(int i = 2; i < argc; i += 2){
+    string flag = argv[i];
+    string value = argv[i + 1];
+    if(flag == "--instrs")
+      config.nInstrs = stoul(value);
+    else if(flag == "--mix")
+      config.mix = parseMix(value);
+    else if(flag == "--dep")
+      config.depDistance = stoul(value);
+    else if(flag == "--taken")
+      config.takenRate = stod(value);
+    else if(flag == "--skip")
+      config.branchSkip = stoul(value);
+    else if(flag == "--footprint")
+      config.footprint = stoul(value);
+    else if(flag == "--stride")
+      config.stride = stoul(value);
+    else if(flag == "--seed")
+      config.seed = stoul(value);
+    else
+      usage();
+  }
+  SynthProgram program(config);
+  program.writeHex(argv[1]);
+  cout << "wrote " << program.getCode().size() << " words to " << argv[1]
+    << ", needs " << program.getMemWords() << " words of memory, executes "
+    << program.getNExecuted() << " instructions" << endl;
+  return 0;
+}
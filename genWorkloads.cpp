@@ -0,0 +1,508 @@
+#define BOOST_LOG_DYN_LINK
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Assembler.h"
+
+using namespace std;
+using namespace assembler;
+/*
+ * Builds the end to end workload suite in workloads/. The .hex files are
+ * checked in, so nothing here runs at test time. Rerun with make workloads
+ * after changing a workload (or the assembler).
+ *
+ * Every workload leaves its result in $2 (v0) and ends by jumping to the
+ * syscall the loader puts after it, which ends the program with syscalls
+ * emulated too (see SyscallEmulator::setEndMarker). The expected value is
+ * computed here by a plain C++ version of the same algorithm and written to
+ * workloads/manifest.txt, which runWorkloads checks against.
+ */
+
+namespace {
+
+  /* register names used below */
+  const Reg ZERO = 0, V0 = 2, A0 = 4, A1 = 5, SP = 29, RA = 31;
+
+  /*
+   * the deterministic input generator shared by the program data and the
+   * C++ reference
+   */
+  class Lcg{
+    private:
+      data32 state;
+    public:
+      Lcg(data32 seed) : state{seed}{}
+      data32 next(){
+        state = state * 1664525u + 1013904223u;
+        return state;
+      }
+      /* a value in [0, n) */
+      data32 below(data32 n){
+        return (next() >> 8) % n;
+      }
+  };
+
+  /*
+   * labels the word past the data, where the loader puts its syscall, as
+   * "exit", and assembles
+   */
+  vector<data32> finish(Assembler& as){
+    as.dataLabel("exit");
+    return as.assemble();
+  }
+
+  struct Workload{
+    string name;
+    vector<data32> image;
+    data32 expected;
+  };
+
+  Workload matmul(){
+    const int N = 12;
+    Lcg lcg(1);
+    vector<data32> a(N * N), b(N * N);
+    for(data32& x : a) x = lcg.below(16);
+    for(data32& x : b) x = lcg.below(16);
+    data32 expected = 0;
+    for(int i = 0; i < N; i++)
+      for(int j = 0; j < N; j++){
+        data32 sum = 0;
+        for(int k = 0; k < N; k++)
+          sum += a[i * N + k] * b[k * N + j];
+        expected += sum * (i * N + j + 1);
+      }
+
+    Assembler as;
+    as.la(16, "A");
+    as.la(17, "B");
+    as.la(18, "C");
+    as.li(21, N);
+    as.li(V0, 0);
+    as.move(19, 16);              //row of A
+    as.li(8, 0);                  //i
+    as.li(23, 1);                 //weight, the index of C + 1
+    as.label("i");
+    as.li(9, 0);                  //j
+    as.label("j");
+    as.move(12, 19);              //&A[i][0]
+    as.addu(13, 17, 9);           //&B[0][j]
+    as.li(14, 0);                 //sum
+    as.li(10, N);                 //k countdown
+    as.label("k");
+    as.lw(5, 12, 0);
+    as.lw(6, 13, 0);
+    as.mult(5, 6);
+    as.mflo(7);
+    as.addu(14, 14, 7);
+    as.addiu(12, 12, 1);
+    as.addiu(13, 13, N);
+    as.addiu(10, 10, -1);
+    as.bne(10, ZERO, "k");
+    as.sw(14, 18, 0);
+    as.mult(14, 23);
+    as.mflo(7);
+    as.addu(V0, V0, 7);
+    as.addiu(18, 18, 1);
+    as.addiu(23, 23, 1);
+    as.addiu(9, 9, 1);
+    as.bne(9, 21, "j");
+    as.addu(19, 19, 21);
+    as.addiu(8, 8, 1);
+    as.bne(8, 21, "i");
+    as.j("exit");
+    as.dataLabel("A");
+    as.words(a);
+    as.dataLabel("B");
+    as.words(b);
+    as.dataLabel("C");
+    as.space(N * N);
+    return {"matmul", finish(as), expected};
+  }
+
+  Workload quicksort(){
+    const int N = 160;
+    Lcg lcg(2);
+    vector<data32> arr(N);
+    for(data32& x : arr) x = lcg.below(10000);
+    vector<data32> sorted = arr;
+    sort(sorted.begin(), sorted.end());
+    data32 expected = 0;
+    for(int i = 0; i < N; i++)
+      expected += sorted[i] * (i + 1);
+
+    Assembler as;
+    as.la(SP, "stackTop");
+    as.la(A0, "arr");
+    as.la(A1, "arr", N - 1);
+    as.jal("qsort");
+    //checksum the sorted array
+    as.la(8, "arr");
+    as.li(9, 1);
+    as.li(10, N + 1);
+    as.li(V0, 0);
+    as.label("sum");
+    as.lw(11, 8, 0);
+    as.mult(11, 9);
+    as.mflo(12);
+    as.addu(V0, V0, 12);
+    as.addiu(8, 8, 1);
+    as.addiu(9, 9, 1);
+    as.bne(9, 10, "sum");
+    as.j("exit");
+
+    //qsort(lo = a0, hi = a1), both inclusive word addresses. Lomuto
+    as.label("qsort");
+    as.slt(8, A0, A1);
+    as.beq(8, ZERO, "ret");
+    as.lw(9, A1, 0);              //pivot
+    as.addiu(10, A0, -1);         //i
+    as.move(11, A0);              //j
+    as.label("part");
+    as.slt(8, 11, A1);
+    as.beq(8, ZERO, "partDone");
+    as.lw(12, 11, 0);
+    as.slt(8, 9, 12);             //pivot < a[j]
+    as.bne(8, ZERO, "next");
+    as.addiu(10, 10, 1);
+    as.lw(13, 10, 0);
+    as.sw(12, 10, 0);
+    as.sw(13, 11, 0);
+    as.label("next");
+    as.addiu(11, 11, 1);
+    as.j("part");
+    as.label("partDone");
+    as.addiu(10, 10, 1);          //pivot's final place
+    as.lw(13, 10, 0);
+    as.sw(9, 10, 0);
+    as.sw(13, A1, 0);
+    as.addiu(SP, SP, -3);
+    as.sw(RA, SP, 0);
+    as.sw(10, SP, 1);
+    as.sw(A1, SP, 2);
+    as.addiu(A1, 10, -1);
+    as.jal("qsort");
+    as.lw(RA, SP, 0);
+    as.lw(10, SP, 1);
+    as.lw(A1, SP, 2);
+    as.addiu(SP, SP, 3);
+    as.addiu(A0, 10, 1);
+    as.j("qsort");                //tail call keeps the caller's ra
+    as.label("ret");
+    as.jr(RA);
+
+    as.dataLabel("arr");
+    as.words(arr);
+    as.space(3 * N);
+    as.dataLabel("stackTop");
+    return {"quicksort", finish(as), expected};
+  }
+
+  Workload crc32(){
+    const int N = 96;
+    const data32 POLY = 0xedb88320;
+    Lcg lcg(3);
+    vector<data32> words(N);
+    for(data32& x : words) x = lcg.next();
+    data32 crc = 0xffffffff;
+    for(data32 w : words){
+      crc ^= w;
+      for(int b = 0; b < 32; b++)
+        crc = (crc >> 1) ^ (POLY & (0 - (crc & 1)));
+    }
+    data32 expected = ~crc;
+
+    Assembler as;
+    as.li(V0, 0xffffffff);
+    as.la(8, "data");
+    as.li(9, N);
+    as.li(15, POLY);
+    as.label("word");
+    as.lw(10, 8, 0);
+    as.xor_(V0, V0, 10);
+    as.li(11, 32);
+    as.label("bit");
+    as.andi(12, V0, 1);
+    as.subu(12, ZERO, 12);        //all ones if the low bit was set
+    as.and_(12, 12, 15);
+    as.srl(V0, V0, 1);
+    as.xor_(V0, V0, 12);
+    as.addiu(11, 11, -1);
+    as.bne(11, ZERO, "bit");
+    as.addiu(8, 8, 1);
+    as.addiu(9, 9, -1);
+    as.bne(9, ZERO, "word");
+    as.nor(V0, V0, ZERO);
+    as.j("exit");
+    as.dataLabel("data");
+    as.words(words);
+    return {"crc32", finish(as), expected};
+  }
+
+  Workload linkedList(){
+    const int N = 512;
+    const int PASSES = 8;
+    Lcg lcg(4);
+    //visit the nodes in a shuffled order so the chase jumps around memory
+    vector<int> order(N);
+    for(int i = 0; i < N; i++) order[i] = i;
+    for(int i = N - 1; i > 0; i--)
+      swap(order[i], order[lcg.below(i + 1)]);
+    vector<data32> values(N);
+    data32 total = 0;
+    for(data32& v : values){
+      v = lcg.below(1000);
+      total += v;
+    }
+    vector<int> next(N, -1);
+    for(int i = 0; i + 1 < N; i++)
+      next[order[i]] = order[i + 1];
+    data32 expected = total * PASSES;
+
+    Assembler as;
+    as.li(V0, 0);
+    as.li(9, PASSES);
+    as.label("pass");
+    as.la(8, "nodes", 2 * order[0]);
+    as.label("node");
+    as.lw(10, 8, 0);
+    as.lw(8, 8, 1);
+    as.addu(V0, V0, 10);
+    as.bne(8, ZERO, "node");
+    as.addiu(9, 9, -1);
+    as.bne(9, ZERO, "pass");
+    as.j("exit");
+    //node is {value, next}
+    as.dataLabel("nodes");
+    for(int i = 0; i < N; i++){
+      as.word(values[i]);
+      if(next[i] < 0)
+        as.word(0);
+      else
+        as.wordLabel("nodes", 2 * next[i]);
+    }
+    return {"linkedlist", finish(as), expected};
+  }
+
+  Workload fir(){
+    const int TAPS = 16;
+    const int N = 256;
+    Lcg lcg(5);
+    vector<data32> h(TAPS), x(N);
+    for(data32& v : h) v = (data32) ((signedData32) lcg.below(64) - 32);
+    for(data32& v : x) v = (data32) ((signedData32) lcg.below(2048) - 1024);
+    data32 expected = 0;
+    for(int n = 0; n + TAPS <= N; n++){
+      data32 y = 0;
+      for(int k = 0; k < TAPS; k++)
+        y += (data32) ((signedData32) h[k] * (signedData32) x[n + k]);
+      expected ^= y + n;
+    }
+
+    Assembler as;
+    as.li(V0, 0);
+    as.la(8, "x");                //&x[n]
+    as.la(16, "y");
+    as.li(9, 0);                  //n
+    as.li(17, N - TAPS + 1);
+    as.label("sample");
+    as.la(12, "h");
+    as.move(13, 8);
+    as.li(14, 0);                 //y
+    as.li(10, TAPS);
+    as.label("tap");
+    as.lw(5, 12, 0);
+    as.lw(6, 13, 0);
+    as.mult(5, 6);
+    as.mflo(7);
+    as.addu(14, 14, 7);
+    as.addiu(12, 12, 1);
+    as.addiu(13, 13, 1);
+    as.addiu(10, 10, -1);
+    as.bne(10, ZERO, "tap");
+    as.sw(14, 16, 0);
+    as.addu(15, 14, 9);
+    as.xor_(V0, V0, 15);
+    as.addiu(16, 16, 1);
+    as.addiu(8, 8, 1);
+    as.addiu(9, 9, 1);
+    as.bne(9, 17, "sample");
+    as.j("exit");
+    as.dataLabel("h");
+    as.words(h);
+    as.dataLabel("x");
+    as.words(x);
+    as.dataLabel("y");
+    as.space(N);
+    return {"fir", finish(as), expected};
+  }
+
+  Workload stringSearch(){
+    const int T = 1024;
+    const int P = 4;
+    Lcg lcg(6);
+    //one character per word, this machine has no byte loads
+    vector<data32> text(T);
+    for(data32& c : text) c = 'a' + lcg.below(4);
+    vector<data32> pat(text.begin() + 100, text.begin() + 100 + P);
+    data32 expected = 0;
+    for(int i = 0; i + P <= T; i++)
+      if(equal(pat.begin(), pat.end(), text.begin() + i))
+        expected += i + 1;
+
+    Assembler as;
+    as.li(V0, 0);
+    as.la(8, "text");
+    as.li(17, 1);                 //position + 1
+    as.li(18, T - P + 2);
+    as.li(19, P);
+    as.label("pos");
+    as.li(10, 0);
+    as.move(11, 8);
+    as.la(12, "pat");
+    as.label("cmp");
+    as.lw(13, 11, 0);
+    as.lw(14, 12, 0);
+    as.bne(13, 14, "miss");
+    as.addiu(11, 11, 1);
+    as.addiu(12, 12, 1);
+    as.addiu(10, 10, 1);
+    as.bne(10, 19, "cmp");
+    as.addu(V0, V0, 17);
+    as.label("miss");
+    as.addiu(8, 8, 1);
+    as.addiu(17, 17, 1);
+    as.bne(17, 18, "pos");
+    as.j("exit");
+    as.dataLabel("text");
+    as.words(text);
+    as.dataLabel("pat");
+    as.words(pat);
+    return {"strsearch", finish(as), expected};
+  }
+
+  /*
+   * a little accumulator bytecode machine. Every bytecode is 3 words,
+   * {op, a, b}
+   */
+  enum ByteOp { HALT, LOADI, ADDI, STORE, LOAD, ADD, DJNZ, XOR, SHL1 };
+
+  Workload interpreter(){
+    const data32 ITERS = 200;
+    //bytecode indices, DJNZ jumps to index LOOP
+    const int LOOP = 4;
+    vector<array<data32, 3>> code = {
+      {LOADI, ITERS, 0}, {STORE, 0, 0},
+      {LOADI, 1, 0}, {STORE, 1, 0},
+      {LOAD, 1, 0}, {SHL1, 0, 0}, {XOR, 0, 0}, {ADDI, 7, 0}, {STORE, 1, 0},
+      {LOAD, 2, 0}, {ADD, 1, 0}, {STORE, 2, 0}, {DJNZ, 0, LOOP},
+      {LOAD, 2, 0}, {HALT, 0, 0}
+    };
+    //reference interpreter
+    data32 regs[8] = {0};
+    data32 acc = 0;
+    for(size_t pc = 0; code[pc][0] != HALT;){
+      const array<data32, 3>& c = code[pc++];
+      switch(c[0]){
+        case LOADI: acc = c[1]; break;
+        case ADDI: acc += c[1]; break;
+        case STORE: regs[c[1]] = acc; break;
+        case LOAD: acc = regs[c[1]]; break;
+        case ADD: acc += regs[c[1]]; break;
+        case DJNZ: if(--regs[c[1]] != 0) pc = c[2]; break;
+        case XOR: acc ^= regs[c[1]]; break;
+        case SHL1: acc <<= 1; break;
+      }
+    }
+    data32 expected = acc;
+
+    Assembler as;
+    as.la(20, "bytecode");        //vm pc
+    as.la(22, "vmregs");
+    as.li(21, 0);                 //acc
+    as.label("dispatch");
+    as.lw(8, 20, 0);
+    as.lw(9, 20, 1);
+    as.lw(10, 20, 2);
+    as.addiu(20, 20, 3);
+    //a chain of compares, deliberately branchy
+    const vector<pair<ByteOp, string>> handlers = {
+      {LOADI, "loadi"}, {ADDI, "addi"}, {STORE, "store"}, {LOAD, "load"},
+      {ADD, "add"}, {DJNZ, "djnz"}, {XOR, "xor"}, {SHL1, "shl1"}
+    };
+    for(const auto& h : handlers){
+      as.li(11, h.first);
+      as.beq(8, 11, h.second);
+    }
+    as.move(V0, 21);              //HALT
+    as.j("exit");
+    as.label("loadi");
+    as.move(21, 9);
+    as.j("dispatch");
+    as.label("addi");
+    as.addu(21, 21, 9);
+    as.j("dispatch");
+    as.label("store");
+    as.addu(12, 22, 9);
+    as.sw(21, 12, 0);
+    as.j("dispatch");
+    as.label("load");
+    as.addu(12, 22, 9);
+    as.lw(21, 12, 0);
+    as.j("dispatch");
+    as.label("add");
+    as.addu(12, 22, 9);
+    as.lw(13, 12, 0);
+    as.addu(21, 21, 13);
+    as.j("dispatch");
+    as.label("djnz");
+    as.addu(12, 22, 9);
+    as.lw(13, 12, 0);
+    as.addiu(13, 13, -1);
+    as.sw(13, 12, 0);
+    as.beq(13, ZERO, "dispatch");
+    as.move(20, 10);
+    as.j("dispatch");
+    as.label("xor");
+    as.addu(12, 22, 9);
+    as.lw(13, 12, 0);
+    as.xor_(21, 21, 13);
+    as.j("dispatch");
+    as.label("shl1");
+    as.sll(21, 21, 1);
+    as.j("dispatch");
+
+    as.dataLabel("bytecode");
+    for(const array<data32, 3>& c : code){
+      as.word(c[0]);
+      as.word(c[1]);
+      //jump targets are stored as addresses
+      if(c[0] == DJNZ)
+        as.wordLabel("bytecode", 3 * c[2]);
+      else
+        as.word(c[2]);
+    }
+    as.dataLabel("vmregs");
+    as.space(8);
+    return {"interpreter", finish(as), expected};
+  }
+}
+
+int main(int argc, char** argv){
+  string dir = argc > 1 ? argv[1] : "workloads";
+  vector<function<Workload()>> builders = {
+    matmul, quicksort, crc32, linkedList, fir, stringSearch, interpreter
+  };
+  ofstream manifest(dir + "/manifest.txt");
+  manifest << "#name expected_v0 (generated by genWorkloads, do not edit)"
+    << endl;
+  for(auto& build : builders){
+    Workload w = build();
+    Assembler::writeHex(dir + "/" + w.name + ".hex", w.image);
+    manifest << w.name << " " << w.expected << endl;
+    cout << w.name << ": " << w.image.size() << " words, expects v0 = "
+      << w.expected << endl;
+  }
+}
@@ -1,14 +1,287 @@
+#include <chrono>
+#include <climits>
+#include <memory>
+#include <string>
 #include "Pipeline.h"
 #include "Processor.h"
 #include "Mem.h"
+#include "Config.h"
+#include "Trace.h"
+#include "Functional.h"
+#include "Sliced.h"
+#include "Checkpoint.h"
+#include "Accel.h"
+#include "OoO.h"
+#include "Superscalar.h"
+#include "MultiCore.h"
+#include "MultiProgram.h"
 
 using namespace std;
 using namespace pipeline;
 using namespace mem;
+using namespace config;
 
-int main(){
-  ProgramLoader loader( new VirtualMem(new DRAM(0x100, "MainMem")),
-      new DRAM(0b100000, "rf"));
-  loader.loadProgram("out");
+/*
+ * Usage:
+ *   main [--config file.ini] [--trace file] [--capture file.trc]
+ *     [--decoupled] [--ooo] [--superscalar] [--multicore] [--multiprogram]
+ *     [--sliced length]
+ *     [--save-checkpoints file.ckpt [--at n] [--every n] [--accelerate]
+ *     [--accel-map file]]
+ *     [--restore file.ckpt[:i]] [--syscalls] [key=value ...] [program]
+ * runs program (default "out"), an ELF executable or hex words, tracing
+ * to pipeline.log by default. See Config.h for the keys. Overrides apply on
+ * top of the config file.
+ * --capture records the retired instruction stream for replayTrace.
+ * --decoupled runs functional first on two threads instead of Processor5S
+ * (see Functional.h), without a stage trace. --ooo runs the out of order
+ * core (see OoO.h) instead, and reports its stalls, --superscalar the in
+ * order superscalar one (see Superscalar.h). --multicore runs mc.cores
+ * Processor5S cores on the program, each on a host thread and all starting
+ * at its entry (see MultiCore.h), and reports each. --sliced simulates
+ * slices of length instructions in parallel from checkpoints (see Sliced.h)
+ * and reports the error at their boundaries. --multiprogram time slices
+ * every program given on one Processor5S, each loaded into its own share of
+ * main memory (see MultiProgram.h), and reports each.
+ * --save-checkpoints runs functionally, checkpointing at instruction n
+ * (default 0) and then every n (default never) to the end, into one file
+ * (see Checkpoint.h). --accelerate runs memcpy, memset, strlen and memcmp on
+ * the host on the way to n, found by the program's ELF symbols and the
+ * --accel-map file if given (see Accel.h). --restore runs Processor5S from
+ * checkpoint i (default the last) of such a file, the program and its memory
+ * size coming from it.
+ * --syscalls emulates syscalls (see Syscall.h) rather than ending at the
+ * first, and exits with the program's exit code
+ */
+int main(int argc, char** argv){
+  string program = "out";
+  string traceFile = "pipeline.log";
+  string configFile;
+  string captureFile;
+  bool decoupled = false;
+  bool outOfOrder = false;
+  bool wide = false;
+  bool multiCore = false;
+  bool multiProgram = false;
+  vector<string> programs;
+  unsigned long sliceLength = 0;
+  string saveFile;
+  unsigned long saveAt = 0;
+  unsigned long saveEvery = 0;
+  string restoreFile;
+  bool emulate = false;
+  bool accelerate = false;
+  string accelMap;
+  vector<string> overrides;
+  for(int i = 1; i < argc; i++){
+    string arg = argv[i];
+    if(arg == "--config" && i + 1 < argc)
+      configFile = argv[++i];
+    else if(arg == "--trace" && i + 1 < argc)
+      traceFile = argv[++i];
+    else if(arg == "--capture" && i + 1 < argc)
+      captureFile = argv[++i];
+    else if(arg == "--decoupled")
+      decoupled = true;
+    else if(arg == "--ooo")
+      outOfOrder = true;
+    else if(arg == "--superscalar")
+      wide = true;
+    else if(arg == "--multicore")
+      multiCore = true;
+    else if(arg == "--multiprogram")
+      multiProgram = true;
+    else if(arg == "--sliced" && i + 1 < argc)
+      sliceLength = stoul(argv[++i], nullptr, 0);
+    else if(arg == "--save-checkpoints" && i + 1 < argc)
+      saveFile = argv[++i];
+    else if(arg == "--at" && i + 1 < argc)
+      saveAt = stoul(argv[++i], nullptr, 0);
+    else if(arg == "--every" && i + 1 < argc)
+      saveEvery = stoul(argv[++i], nullptr, 0);
+    else if(arg == "--restore" && i + 1 < argc)
+      restoreFile = argv[++i];
+    else if(arg == "--syscalls")
+      emulate = true;
+    else if(arg == "--accelerate")
+      accelerate = true;
+    else if(arg == "--accel-map" && i + 1 < argc){
+      accelMap = argv[++i];
+      accelerate = true;
+    }
+    else if(arg.find('=') != string::npos)
+      overrides.push_back(arg);
+    else{
+      program = arg;
+      programs.push_back(arg);
+    }
+  }
+  SimConfig config;
+  //the main memory main has always run with
+  config.memWords = 0x100;
+  if(!configFile.empty())
+    config.loadFile(configFile);
+  for(const string& o : overrides)
+    config.set(o);
+
+  if(!saveFile.empty()){
+    DRAM backing(config.memWords, "MainMem");
+    DirtyTrackingMem* mainMem = new DirtyTrackingMem(backing);
+    ProgramLoader loader(mainMem, new DRAM(0b100000, "rf"), "", config);
+    checkpoint::CheckpointWriter writer(saveFile, *mainMem);
+    //through the tracking, so the first checkpoint has the program
+    loader.loadProgram(program);
+    functional::FunctionalCore core(*mainMem, loader.getRegisterFile(),
+        loader.getEntry());
+    accel::Accelerator accelerator;
+    if(accelerate){
+      accelerator.addSymbols(loader.getSymbols());
+      if(!accelMap.empty())
+        accelerator.loadMap(accelMap);
+      core.setAccelerator(&accelerator);
+    }
+    trace::TraceRecord r;
+    bool running = true;
+    unsigned long next = saveAt;
+    while(running){
+      if(core.getNExecuted() >= next && core.isQuiet()){
+        //the region of interest is simulated in full
+        core.setAccelerator(nullptr);
+        writer.write(core);
+        cout << "checkpoint " << writer.getNWritten() - 1 << " at " <<
+          core.getNExecuted() << endl;
+        if(saveEvery == 0)
+          break;
+        next += saveEvery;
+      }
+      running = core.step(r);
+    }
+    return 0;
+  }
+
+  if(!restoreFile.empty()){
+    size_t colon = restoreFile.rfind(':');
+    checkpoint::CheckpointReader reader(restoreFile.substr(0, colon));
+    size_t index = colon == string::npos ?
+      reader.getNCheckpoints() - 1 :
+      stoul(restoreFile.substr(colon + 1), nullptr, 0);
+    auto start = chrono::steady_clock::now();
+    DRAM rf(0b100000, "rf");
+    unique_ptr<MappedMem> mainMem = reader.restore(index, rf);
+    Processor5S p("MIPSProcessor", *mainMem, rf, 0, traceFile, config);
+    checkpoint::start(reader.getState(index), p);
+    double ms = chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count();
+    p.runFor(ULONG_MAX);
+    cout << "Program Terminating" << endl;
+    cout << "restored checkpoint " << index << " (instruction " <<
+      reader.getState(index).nExecuted << ") in " << ms << " ms, then " <<
+      p.getNRetired() << " instructions in " << p.getCurrentCycle() <<
+      " cycles" << endl;
+    return 0;
+  }
+
+  if(sliceLength > 0){
+    sliced::SliceConfig slicing;
+    slicing.sliceLength = sliceLength;
+    sliced::SlicedSim sim(MachineCodeFileReader().loadImage(program), config,
+        slicing);
+    sliced::SlicedResult result = sim.run();
+    cout << "Program Terminating" << endl;
+    cout << result.nInstrs << " instructions in " << result.cycles <<
+      " cycles, " << result.slices.size() << " slices" << endl;
+    cout << "boundary error " << result.boundaryError << " cycles, " <<
+      result.boundaryErrorAbs << " absolute, " <<
+      100.0 * result.boundaryErrorAbs / result.cycles << "%" << endl;
+    return 0;
+  }
+
+  if(multiCore){
+    //the cores read it from their threads, which a VirtualMem can't take
+    ProgramLoader loader(new DRAM(config.memWords, "MainMem"),
+        new DRAM(0b100000, "rf"), "", config);
+    loader.loadProgram(program);
+    unique_ptr<sys::SyscallEmulator> syscalls;
+    if(emulate){
+      syscalls = make_unique<sys::SyscallEmulator>(loader.getEnd());
+      syscalls->setEndMarker(loader.getExit());
+    }
+    multicore::MultiCoreSim sim(loader.getMainMemory(),
+        loader.getRegisterFile(), loader.getEntry(), config);
+    sim.setSyscalls(syscalls.get());
+    sim.run();
+    cout << "Program Terminating" << endl;
+    sim.report(cout);
+    return syscalls ? syscalls->getExitCode() : 0;
+  }
+
+  if(multiProgram){
+    if(programs.empty())
+      programs.push_back(program);
+    ProgramLoader loader(new DRAM(config.memWords, "MainMem"),
+        new DRAM(0b100000, "rf"), "", config);
+    data32 region = config.memWords / programs.size();
+    for(size_t i = 0; i < programs.size(); i++)
+      loader.loadProgram(programs[i], i * region, region);
+    vector<unique_ptr<sys::SyscallEmulator>> syscalls;
+    multiprogram::MultiProgramSim sim(loader.getMainMemory(),
+        loader.getRegisterFile(), loader.getPrograms(), config);
+    for(size_t i = 0; emulate && i < programs.size(); i++){
+      syscalls.push_back(make_unique<sys::SyscallEmulator>(
+            loader.getPrograms()[i].end));
+      syscalls.back()->setEndMarker(loader.getPrograms()[i].exit);
+      sim.setSyscalls(i, syscalls.back().get());
+    }
+    sim.run();
+    cout << "Program Terminating" << endl;
+    sim.report(cout);
+    return syscalls.empty() ? 0 : syscalls.front()->getExitCode();
+  }
+
+  ProgramLoader loader( new VirtualMem(new DRAM(config.memWords, "MainMem")),
+      new DRAM(0b100000, "rf"), traceFile, config);
+  loader.loadProgram(program);
+  unique_ptr<sys::SyscallEmulator> syscalls;
+  if(emulate){
+    syscalls = make_unique<sys::SyscallEmulator>(loader.getEnd());
+    syscalls->setEndMarker(loader.getExit());
+  }
+  if(decoupled){
+    functional::DecoupledSim sim(loader.getMainMemory(),
+        loader.getRegisterFile(), config);
+    sim.setSyscalls(syscalls.get());
+    sim.run(loader.getEntry());
+    cout << "Program Terminating" << endl;
+    cout << sim.getNRetired() << " instructions in " <<
+      sim.getCurrentCycle() << " cycles" << endl;
+    return syscalls ? syscalls->getExitCode() : 0;
+  }
+  if(outOfOrder){
+    ooo::ProcessorOoO p("MIPSProcessor", loader.getMainMemory(),
+        loader.getRegisterFile(), loader.getEntry(), config);
+    p.setSyscalls(syscalls.get());
+    p.start(loader.getEntry());
+    p.report(cout);
+    return syscalls ? syscalls->getExitCode() : 0;
+  }
+  if(wide){
+    superscalar::ProcessorSS p("MIPSProcessor", loader.getMainMemory(),
+        loader.getRegisterFile(), loader.getEntry(), config);
+    p.setSyscalls(syscalls.get());
+    p.start(loader.getEntry());
+    p.report(cout);
+    return syscalls ? syscalls->getExitCode() : 0;
+  }
+  unique_ptr<trace::TraceWriter> capture;
+  if(!captureFile.empty()){
+    capture = make_unique<trace::TraceWriter>(captureFile);
+    loader.getProcessor().setTraceWriter(capture.get());
+  }
+  loader.getProcessor().setSyscalls(syscalls.get());
   loader.run();
+  const frontend::FetchUnit* fetchUnit =
+    loader.getProcessor().getFetchUnit();
+  if(fetchUnit != nullptr)
+    fetchUnit->report(cout);
+  return syscalls ? syscalls->getExitCode() : 0;
 }
@@ -0,0 +1,77 @@
+#define BOOST_LOG_DYN_LINK
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "StackDistance.h"
+#include "Trace.h"
+
+using namespace std;
+using namespace stackdist;
+using namespace trace;
+/*
+ * Miss ratio curves of a captured trace (main --capture), for an instruction
+ * cache fed by the fetched pcs and a data cache fed by the load and store
+ * addresses, over every geometry at once (see StackDistance.h).
+ *
+ * Usage:
+ *   missCurves <trace> [--line words] [--sets max] [--ways max] [--csv file]
+ * Set counts 1, 2, 4 ... up to --sets (default 1024), associativities up to
+ * --ways (default 64), lines of --line words (default 4). The curves go to
+ * --csv, default missCurves.csv.
+ */
+int main(int argc, char** argv){
+  if(argc < 2 || argc % 2 != 0){
+    cerr << "usage: missCurves <trace> [--line words] [--sets max] "
+      "[--ways max] [--csv file]" << endl;
+    return 2;
+  }
+  unsigned int lineWords = 4;
+  unsigned int maxSets = 1024;
+  unsigned int maxWays = 64;
+  string csvFile = "missCurves.csv";
+  for(int i = 2; i < argc; i += 2){
+    string option = argv[i];
+    if(option == "--line"){
+      lineWords = stoul(argv[i + 1], nullptr, 0);
+    } else if(option == "--sets"){
+      maxSets = stoul(argv[i + 1], nullptr, 0);
+    } else if(option == "--ways"){
+      maxWays = stoul(argv[i + 1], nullptr, 0);
+    } else if(option == "--csv"){
+      csvFile = argv[i + 1];
+    } else {
+      cerr << "unknown option " << option << endl;
+      return 2;
+    }
+  }
+  vector<unsigned int> setCounts;
+  for(unsigned int sets = 1; sets <= maxSets; sets *= 2)
+    setCounts.push_back(sets);
+
+  StackDistance inst(lineWords, setCounts, maxWays);
+  StackDistance data(lineWords, setCounts, maxWays);
+  TraceReader reader(argv[1]);
+  TraceRecord r;
+  auto start = chrono::steady_clock::now();
+  while(reader.next(r)){
+    inst.access(r.pc);
+    if(r.op == OP_LOAD || r.op == OP_STORE)
+      data.access(r.address);
+  }
+  auto end = chrono::steady_clock::now();
+
+  ofstream csv(csvFile);
+  csv << "stream,sets,ways,lineWords,words,accesses,misses,missRatio" << endl;
+  inst.writeCsv(csv, "inst");
+  data.writeCsv(csv, "data");
+  cout << inst.getNAccesses() << " fetches, " << data.getNAccesses() <<
+    " loads and stores, " << setCounts.size() << " set counts x up to " <<
+    maxWays << " ways in " << fixed << setprecision(2) <<
+    chrono::duration<double>(end - start).count() << " s, curves in " <<
+    csvFile << endl;
+  return 0;
+}
@@ -0,0 +1,42 @@
+#define BOOST_LOG_DYN_LINK
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "Config.h"
+#include "Trace.h"
+
+using namespace std;
+using namespace config;
+using namespace trace;
+/*
+ * Replays a captured trace (main --capture) under a timing config, without
+ * executing it. See Trace.h for when that is faithful.
+ *
+ * Usage:
+ *   replayTrace <trace> [--config file.ini] [key=value ...]
+ */
+int main(int argc, char** argv){
+  if(argc < 2){
+    cerr << "usage: replayTrace <trace> [--config file.ini] [key=value ...]"
+      << endl;
+    return 2;
+  }
+  SimConfig config;
+  for(int i = 2; i < argc; i++){
+    string arg = argv[i];
+    if(arg == "--config" && i + 1 < argc)
+      config.loadFile(argv[++i]);
+    else
+      config.set(arg);
+  }
+  TraceReader reader(argv[1]);
+  TraceReplayer replayer(reader, config);
+  replayer.run();
+  cout << reader.getNRecords() << " records, " << replayer.getNRetired()
+    << " instructions retired (" << replayer.getNSkipped() << " delay slots "
+    "skipped) in " << replayer.getCurrentCycle() << " cycles, CPI " << fixed
+    << setprecision(3)
+    << (double) replayer.getCurrentCycle() / replayer.getNRetired() << endl;
+  return 0;
+}
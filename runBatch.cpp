@@ -0,0 +1,187 @@
+#define BOOST_LOG_DYN_LINK
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Processor.h"
+#include "Mem.h"
+#include "ThreadPool.h"
+#include "Config.h"
+#include "Functional.h"
+
+using namespace std;
+using namespace mem;
+using namespace pool;
+using namespace config;
+using namespace functional;
+/*
+ * Runs a list of simulation jobs side by side on a work stealing pool (see
+ * ThreadPool.h), each in its own ProgramLoader, and prints one table of
+ * results. Programs are read once and the image is shared by every job that
+ * runs it.
+ *
+ * Usage:
+ *   runBatch <job file> [--threads n] [--decoupled]
+ * --decoupled runs every job functional first (see Functional.h), which is
+ * two threads a job. One job per line, # starts a comment:
+ *   name program [key=value ...] [expect=v0]
+ * The key=values configure the job (see Config.h). With expect the job's $2
+ * is checked and runBatch exits with 1 if any check fails or any job throws.
+ */
+
+namespace {
+  struct Job{
+    string name;
+    string program;
+    SimConfig config;
+    bool check = false;
+    data32 expected = 0;
+  };
+
+  struct Result{
+    bool ran = false;
+    unsigned long instrs = 0;
+    unsigned int cycles = 0;
+    data32 v0 = 0;
+    double hostSeconds = 0;
+  };
+
+  void usage(){
+    cerr << "usage: runBatch <job file> [--threads n] [--decoupled]" << endl;
+    exit(2);
+  }
+
+  vector<Job> readJobs(const string& filename){
+    ifstream file(filename);
+    if(!file){
+      cerr << "can't open " << filename << endl;
+      exit(2);
+    }
+    vector<Job> jobs;
+    string line;
+    while(getline(file, line)){
+      istringstream fields(line.substr(0, line.find('#')));
+      Job job;
+      if(!(fields >> job.name))
+        continue;
+      if(!(fields >> job.program)){
+        cerr << "job " << job.name << " has no program" << endl;
+        exit(2);
+      }
+      string setting;
+      while(fields >> setting){
+        if(setting.compare(0, 7, "expect=") == 0){
+          job.check = true;
+          job.expected = stoul(setting.substr(7), nullptr, 0);
+        } else {
+          try{
+            job.config.set(setting);
+          } catch(const std::exception&){
+            cerr << "job " << job.name << ": bad setting " << setting << endl;
+            exit(2);
+          }
+        }
+      }
+      jobs.push_back(job);
+    }
+    return jobs;
+  }
+
+  /*
+   * one job, start to finish, touching nothing shared but the image
+   */
+  Result runJob(const Job& job, const ProgramImage& image, bool decoupled){
+    Result r;
+    try{
+      ProgramLoader loader(
+          new VirtualMem(new DRAM(job.config.memWords, "MainMem")),
+          new DRAM(0b100000, "rf"), "", job.config);
+      loader.loadProgram(image);
+      ostringstream report;
+      auto start = chrono::steady_clock::now();
+      if(decoupled){
+        DecoupledSim sim(loader.getMainMemory(), loader.getRegisterFile(),
+            job.config);
+        sim.run(0);
+        r.instrs = sim.getNRetired();
+        r.cycles = sim.getCurrentCycle();
+      } else {
+        loader.run(report);
+        r.instrs = loader.getProcessor().getNRetired();
+        r.cycles = loader.getProcessor().getCurrentCycle();
+      }
+      auto end = chrono::steady_clock::now();
+      r.ran = true;
+      r.v0 = loader.getRegisterFile().ld(2);
+      r.hostSeconds = chrono::duration<double>(end - start).count();
+    } catch(const std::exception&){
+      //already logged as fatal where it was thrown
+    }
+    return r;
+  }
+}
+
+int main(int argc, char** argv){
+  if(argc < 2)
+    usage();
+  size_t nThreads = 0;
+  bool decoupled = false;
+  for(int i = 2; i < argc; i++){
+    string arg = argv[i];
+    if(arg == "--threads" && i + 1 < argc)
+      nThreads = stoul(argv[++i]);
+    else if(arg == "--decoupled")
+      decoupled = true;
+    else
+      usage();
+  }
+  vector<Job> jobs = readJobs(argv[1]);
+
+  map<string, ProgramImage> images;
+  MachineCodeFileReader reader;
+  for(const Job& job : jobs){
+    if(images.count(job.program) == 0){
+      if(!ifstream(job.program)){
+        cerr << "can't open " << job.program << endl;
+        return 2;
+      }
+      images[job.program] = reader.loadImage(job.program);
+    }
+  }
+
+  vector<Result> results(jobs.size());
+  WorkStealingPool pool(nThreads);
+  for(size_t i = 0; i < jobs.size(); i++){
+    pool.submit([&, i](){
+      results[i] = runJob(jobs[i], images.at(jobs[i].program), decoupled);
+    });
+  }
+  auto start = chrono::steady_clock::now();
+  pool.wait();
+  auto end = chrono::steady_clock::now();
+
+  bool allOk = true;
+  cout << left << setw(16) << "job" << right << setw(12) << "instrs"
+    << setw(12) << "cycles" << setw(8) << "IPC" << setw(12) << "v0"
+    << setw(12) << "host ms" << setw(8) << "check" << endl;
+  for(size_t i = 0; i < jobs.size(); i++){
+    const Result& r = results[i];
+    string check = !r.ran ? "ERROR" : !jobs[i].check ? "-" :
+      r.v0 == jobs[i].expected ? "ok" : "WRONG";
+    allOk = allOk && check != "ERROR" && check != "WRONG";
+    cout << left << setw(16) << jobs[i].name << right << setw(12) << r.instrs
+      << setw(12) << r.cycles << setw(8) << fixed << setprecision(3)
+      << (r.cycles ? (double) r.instrs / r.cycles : 0) << setw(12) << r.v0
+      << setw(12) << setprecision(1) << r.hostSeconds * 1e3 << setw(8)
+      << check << endl;
+  }
+  cout << jobs.size() << " jobs on " << pool.getNThreads() << " threads in "
+    << setprecision(1) << chrono::duration<double>(end - start).count() * 1e3
+    << " ms" << endl;
+  return allOk ? 0 : 1;
+}
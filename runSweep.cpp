@@ -0,0 +1,317 @@
+#define BOOST_LOG_DYN_LINK
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Processor.h"
+#include "Mem.h"
+#include "ThreadPool.h"
+#include "Config.h"
+
+using namespace std;
+using namespace mem;
+using namespace pool;
+using namespace config;
+/*
+ * Sweeps configurations (see Config.h) over a set of programs. Runs are
+ * scheduled on a work stealing pool and cached by a hash of the
+ * configuration, program and MODEL_VERSION, so a re-run only simulates what
+ * changed. Every configuration gets a CPI, its summed cycles over its summed
+ * instructions for all programs, and a cost (SimConfig::cost). The
+ * configurations nobody beats on both are printed as the Pareto front, and
+ * all of them go to a csv.
+ *
+ * Usage:
+ *   runSweep <sweep file> [--threads n]
+ * The sweep file has one directive per line, # starts a comment:
+ *   program <file>        a program to run every config on, repeatable
+ *   config <file.ini>     base config
+ *   set key=value         base config override, repeatable
+ *   axis key v1 v2 ...    values for one key, the grid is every combination
+ *   sample n [seed]       only n random points of the grid
+ *   cache <file>          result cache, default sweepCache.txt
+ *   csv <file>            all results, default sweep.csv
+ */
+
+namespace {
+
+  struct Axis{
+    string key;
+    vector<string> values;
+  };
+
+  struct Sweep{
+    vector<string> programs;
+    SimConfig base;
+    vector<Axis> axes;
+    size_t nSamples = 0;
+    unsigned int seed = 1;
+    string cacheFile = "sweepCache.txt";
+    string csvFile = "sweep.csv";
+  };
+
+  struct Run{
+    bool ok = false;
+    unsigned long instrs = 0;
+    unsigned long cycles = 0;
+  };
+
+  struct Point{
+    /* index into each axis' values */
+    vector<size_t> choice;
+    SimConfig config;
+    double cost = 0;
+    double cpi = 0;
+    bool ok = true;
+    bool pareto = false;
+  };
+
+  void fail(const string& message){
+    cerr << message << endl;
+    exit(2);
+  }
+
+  Sweep readSweep(const string& filename){
+    ifstream file(filename);
+    if(!file)
+      fail("can't open " + filename);
+    Sweep sweep;
+    string line;
+    while(getline(file, line)){
+      istringstream fields(line.substr(0, line.find('#')));
+      string directive, arg;
+      if(!(fields >> directive))
+        continue;
+      try{
+        if(directive == "program" && fields >> arg){
+          sweep.programs.push_back(arg);
+        } else if(directive == "config" && fields >> arg){
+          sweep.base.loadFile(arg);
+        } else if(directive == "set" && fields >> arg){
+          sweep.base.set(arg);
+        } else if(directive == "axis" && fields >> arg){
+          Axis axis{arg, {}};
+          string value;
+          while(fields >> value){
+            //check it now rather than in the middle of the sweep
+            SimConfig().set(axis.key, value);
+            axis.values.push_back(value);
+          }
+          if(axis.values.empty())
+            fail("axis " + axis.key + " has no values");
+          sweep.axes.push_back(axis);
+        } else if(directive == "sample" && fields >> sweep.nSamples){
+          fields >> sweep.seed;
+        } else if(directive == "cache" && fields >> arg){
+          sweep.cacheFile = arg;
+        } else if(directive == "csv" && fields >> arg){
+          sweep.csvFile = arg;
+        } else {
+          fail("bad line in " + filename + ": " + line);
+        }
+      } catch(const std::exception&){
+        fail("bad setting in " + filename + ": " + line);
+      }
+    }
+    if(sweep.programs.empty())
+      fail(filename + " names no programs");
+    return sweep;
+  }
+
+  /*
+   * returns: the grid points, all of them or a sample
+   */
+  vector<Point> expand(const Sweep& sweep){
+    size_t total = 1;
+    for(const Axis& a : sweep.axes)
+      total *= a.values.size();
+    vector<size_t> indices;
+    if(sweep.nSamples == 0 || sweep.nSamples >= total){
+      for(size_t i = 0; i < total; i++)
+        indices.push_back(i);
+    } else {
+      mt19937_64 gen(sweep.seed);
+      uniform_int_distribution<size_t> dist(0, total - 1);
+      set<size_t> picked;
+      while(picked.size() < sweep.nSamples)
+        picked.insert(dist(gen));
+      indices.assign(picked.begin(), picked.end());
+    }
+
+    vector<Point> points;
+    for(size_t index : indices){
+      Point p;
+      p.config = sweep.base;
+      //the index in mixed radix, one digit per axis
+      for(const Axis& a : sweep.axes){
+        size_t choice = index % a.values.size();
+        index /= a.values.size();
+        p.choice.push_back(choice);
+        p.config.set(a.key, a.values[choice]);
+      }
+      p.cost = p.config.cost();
+      points.push_back(p);
+    }
+    return points;
+  }
+
+  map<uint64_t, Run> readCache(const string& filename){
+    map<uint64_t, Run> cache;
+    ifstream file(filename);
+    uint64_t key;
+    Run run;
+    while(file >> hex >> key >> dec >> run.instrs >> run.cycles){
+      run.ok = true;
+      cache[key] = run;
+    }
+    return cache;
+  }
+
+  Run simulate(const SimConfig& config, const ProgramImage& image){
+    Run run;
+    try{
+      ProgramLoader loader(
+          new VirtualMem(new DRAM(config.memWords, "MainMem")),
+          new DRAM(0b100000, "rf"), "", config);
+      loader.loadProgram(image);
+      ostringstream report;
+      loader.run(report);
+      run.instrs = loader.getProcessor().getNRetired();
+      run.cycles = loader.getProcessor().getCurrentCycle();
+      run.ok = true;
+    } catch(const std::exception&){
+      //already logged as fatal where it was thrown
+    }
+    return run;
+  }
+}
+
+int main(int argc, char** argv){
+  if(argc != 2 && !(argc == 4 && string(argv[2]) == "--threads"))
+    fail("usage: runSweep <sweep file> [--threads n]");
+  size_t nThreads = argc == 4 ? stoul(argv[3]) : 0;
+  Sweep sweep = readSweep(argv[1]);
+  vector<Point> points = expand(sweep);
+
+  MachineCodeFileReader reader;
+  vector<ProgramImage> images;
+  vector<uint64_t> imageHashes;
+  for(const string& program : sweep.programs){
+    if(!ifstream(program))
+      fail("can't open " + program);
+    images.push_back(reader.loadImage(program));
+    imageHashes.push_back(fnv1a(images.back()->data(),
+          images.back()->size() * sizeof(data32)));
+  }
+
+  //a run is known by its config, its program's contents and the version of
+  //the timing model that ran it
+  map<uint64_t, Run> cache = readCache(sweep.cacheFile);
+  vector<vector<uint64_t>> keys(points.size());
+  vector<vector<Run>> runs(points.size(), vector<Run>(images.size()));
+  ofstream cacheOut(sweep.cacheFile, ios::app);
+  mutex cacheLock;
+  WorkStealingPool pool(nThreads);
+  size_t nCached = 0;
+  size_t nToRun = 0;
+  for(size_t p = 0; p < points.size(); p++){
+    for(size_t i = 0; i < images.size(); i++){
+      uint64_t key = fnv1a(&imageHashes[i], sizeof(uint64_t),
+          points[p].config.hash());
+      key = fnv1a(&MODEL_VERSION, sizeof(uint64_t), key);
+      auto hit = cache.find(key);
+      if(hit != cache.end()){
+        runs[p][i] = hit->second;
+        nCached++;
+        continue;
+      }
+      nToRun++;
+      pool.submit([&, p, i, key](){
+        Run run = simulate(points[p].config, images[i]);
+        runs[p][i] = run;
+        if(run.ok){
+          lock_guard<mutex> guard(cacheLock);
+          cacheOut << hex << key << dec << " " << run.instrs << " " <<
+            run.cycles << endl;
+        }
+      });
+    }
+  }
+  auto start = chrono::steady_clock::now();
+  pool.wait();
+  auto end = chrono::steady_clock::now();
+
+  for(size_t p = 0; p < points.size(); p++){
+    unsigned long instrs = 0, cycles = 0;
+    for(const Run& run : runs[p]){
+      points[p].ok = points[p].ok && run.ok;
+      instrs += run.instrs;
+      cycles += run.cycles;
+    }
+    points[p].cpi = instrs ? (double) cycles / instrs : 0;
+  }
+
+  //the front: by cost, each point that is faster than everything cheaper
+  vector<size_t> order;
+  for(size_t p = 0; p < points.size(); p++)
+    if(points[p].ok)
+      order.push_back(p);
+  sort(order.begin(), order.end(), [&](size_t a, size_t b){
+    return points[a].cost != points[b].cost ? points[a].cost < points[b].cost
+      : points[a].cpi < points[b].cpi;
+  });
+  double bestCpi = -1;
+  for(size_t p : order){
+    if(bestCpi < 0 || points[p].cpi < bestCpi){
+      points[p].pareto = true;
+      bestCpi = points[p].cpi;
+    }
+  }
+
+  ofstream csv(sweep.csvFile);
+  for(const Axis& a : sweep.axes)
+    csv << a.key << ",";
+  csv << "cost,cpi,pareto" << endl;
+  for(const Point& point : points){
+    for(size_t a = 0; a < sweep.axes.size(); a++)
+      csv << sweep.axes[a].values[point.choice[a]] << ",";
+    if(point.ok)
+      csv << point.cost << "," << point.cpi << "," << point.pareto << endl;
+    else
+      csv << point.cost << ",error,0" << endl;
+  }
+
+  cout << points.size() << " configs x " << images.size() << " programs: "
+    << nToRun << " simulated, " << nCached << " from " << sweep.cacheFile
+    << " (" << fixed << setprecision(1)
+    << chrono::duration<double>(end - start).count() << " s on "
+    << pool.getNThreads() << " threads)" << endl;
+  cout << "Pareto front, CPI vs cost:" << endl;
+  cout << right << setw(10) << "cost" << setw(10) << "CPI" << "  config"
+    << endl;
+  for(size_t p : order){
+    if(!points[p].pareto)
+      continue;
+    cout << setw(10) << setprecision(3) << points[p].cost << setw(10)
+      << points[p].cpi << " ";
+    for(size_t a = 0; a < sweep.axes.size(); a++)
+      cout << " " << sweep.axes[a].key << "="
+        << sweep.axes[a].values[points[p].choice[a]];
+    cout << endl;
+  }
+  size_t nFailed = count_if(points.begin(), points.end(),
+      [](const Point& p){ return !p.ok; });
+  if(nFailed > 0)
+    cout << nFailed << " configs failed, see the log" << endl;
+  cout << "all results in " << sweep.csvFile << endl;
+  return nFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+#define BOOST_LOG_DYN_LINK
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Processor.h"
+#include "Mem.h"
+
+using namespace std;
+using namespace mem;
+/*
+ * Runs the end to end workload suite (workloads/manifest.txt, built by
+ * genWorkloads) through ProgramLoader and reports simulated cycles, IPC,
+ * host wall time and simulated instructions per host second. Each result is
+ * checked against the expected $2 in the manifest.
+ *
+ * Usage:
+ *   runWorkloads [workload names...]    (default: all of them)
+ * Exits with 1 if any workload computed the wrong answer.
+ *
+ * The simulated columns are deterministic, so they track timing model
+ * changes. The host columns track simulator speed.
+ */
+
+namespace {
+  /* words of backing store behind each workload's VirtualMem */
+  const size_t MEM_WORDS = 1 << 20;
+  const string DIR = "workloads/";
+
+  struct Result{
+    string name;
+    unsigned long instrs;
+    unsigned int cycles;
+    double hostSeconds;
+    bool correct;
+  };
+}
+
+int main(int argc, char** argv){
+  //the debug records would be measuring the console
+  boost::log::core::get()->set_filter(
+      boost::log::trivial::severity >= boost::log::trivial::error);
+
+  vector<string> wanted(argv + 1, argv + argc);
+  ifstream manifest(DIR + "manifest.txt");
+  if(!manifest){
+    cerr << "can't open " << DIR << "manifest.txt, run make workloads" << endl;
+    return 2;
+  }
+
+  vector<Result> results;
+  string line;
+  while(getline(manifest, line)){
+    if(line.empty() || line[0] == '#')
+      continue;
+    istringstream fields(line);
+    string name;
+    data32 expected;
+    fields >> name >> expected;
+    if(!wanted.empty() && find(wanted.begin(), wanted.end(), name) ==
+        wanted.end())
+      continue;
+
+    ProgramLoader loader(new VirtualMem(new DRAM(MEM_WORDS, "MainMem")),
+        new DRAM(0b100000, "rf"), "");
+    loader.loadProgram(DIR + name + ".hex");
+    auto start = chrono::steady_clock::now();
+    loader.run();
+    auto end = chrono::steady_clock::now();
+
+    const Processor5S& p = loader.getProcessor();
+    results.push_back({name, p.getNRetired(), p.getCurrentCycle(),
+        chrono::duration<double>(end - start).count(),
+        loader.getRegisterFile().ld(2) == expected});
+  }
+
+  bool allCorrect = true;
+  cout << left << setw(14) << "workload" << right << setw(12) << "instrs"
+    << setw(12) << "cycles" << setw(8) << "IPC" << setw(12) << "host ms"
+    << setw(14) << "sim instr/s" << setw(8) << "check" << endl;
+  for(const Result& r : results){
+    allCorrect = allCorrect && r.correct;
+    cout << left << setw(14) << r.name << right << setw(12) << r.instrs
+      << setw(12) << r.cycles << setw(8) << fixed << setprecision(3)
+      << (double) r.instrs / r.cycles << setw(12) << setprecision(1)
+      << r.hostSeconds * 1e3 << setw(14) << setprecision(0)
+      << r.instrs / r.hostSeconds << setw(8) << (r.correct ? "ok" : "WRONG")
+      << endl;
+  }
+  return allCorrect ? 0 : 1;
+}
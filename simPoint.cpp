@@ -0,0 +1,112 @@
+#define BOOST_LOG_DYN_LINK
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "Config.h"
+#include "Mem.h"
+#include "Processor.h"
+#include "SimPoint.h"
+
+using namespace std;
+using namespace config;
+using namespace mem;
+using namespace simpoint;
+/*
+ * Estimates a program's CPI by SimPoint style sampling (see SimPoint.h).
+ *
+ * Usage:
+ *   simPoint <program> [--interval n] [--maxk k] [--samples m] [--warmup n]
+ *     [--seed s] [--config file.ini] [--full] [key=value ...]
+ * key=value are SimConfig overrides (see Config.h). --full also runs the
+ * whole program on Processor5S and reports how far off the estimate is.
+ */
+int main(int argc, char** argv){
+  if(argc < 2){
+    cerr << "usage: simPoint <program> [--interval n] [--maxk k] "
+      "[--samples m] [--warmup n] [--seed s] [--config file.ini] [--full] "
+      "[key=value ...]" << endl;
+    return 2;
+  }
+  SimPointConfig simPoint;
+  SimConfig config;
+  string configFile;
+  bool full = false;
+  vector<string> overrides;
+  for(int i = 2; i < argc; i++){
+    string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if(arg == "--interval" && hasValue)
+      simPoint.intervalLength = stoul(argv[++i], nullptr, 0);
+    else if(arg == "--maxk" && hasValue)
+      simPoint.maxK = stoul(argv[++i], nullptr, 0);
+    else if(arg == "--samples" && hasValue)
+      simPoint.samples = stoul(argv[++i], nullptr, 0);
+    else if(arg == "--warmup" && hasValue)
+      simPoint.warmup = stoul(argv[++i], nullptr, 0);
+    else if(arg == "--seed" && hasValue)
+      simPoint.seed = stoul(argv[++i], nullptr, 0);
+    else if(arg == "--config" && hasValue)
+      configFile = argv[++i];
+    else if(arg == "--full")
+      full = true;
+    else if(arg.find('=') != string::npos)
+      overrides.push_back(arg);
+    else {
+      cerr << "bad option " << arg << endl;
+      return 2;
+    }
+  }
+  if(simPoint.intervalLength == 0 || simPoint.samples == 0){
+    cerr << "--interval and --samples must be positive" << endl;
+    return 2;
+  }
+  if(!configFile.empty())
+    config.loadFile(configFile);
+  for(const string& o : overrides)
+    config.set(o);
+
+  ProgramImage image = MachineCodeFileReader().loadImage(argv[1]);
+  SampledSim sim(image, config, simPoint);
+  auto start = chrono::steady_clock::now();
+  Estimate e = sim.run();
+  double seconds = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+
+  cout << e.nInstrs << " instructions in " << e.nIntervals <<
+    " intervals of " << simPoint.intervalLength << ", " << e.phases.size() <<
+    " phases" << endl;
+  cout << fixed << setprecision(4);
+  for(size_t p = 0; p < e.phases.size(); p++){
+    const Phase& phase = e.phases[p];
+    cout << "  phase " << p << ": weight " << phase.weight << ", cpi " <<
+      phase.cpi << ", intervals";
+    for(size_t s = 0; s < phase.simulated.size(); s++)
+      cout << " " << phase.simulated[s] << " (" << phase.cpis[s] << ")";
+    cout << endl;
+  }
+  cout << "estimated cpi " << e.cpi;
+  if(e.bound >= 0)
+    cout << " +- " << e.bound;
+  cout << ", " << e.nDetailed << " instructions in detail, " <<
+    setprecision(2) << seconds << " s" << endl;
+
+  if(full){
+    ProgramLoader loader(new DRAM(config.memWords, "MainMem"),
+        new DRAM(0b100000, "rf"), "", config);
+    loader.loadProgram(image);
+    start = chrono::steady_clock::now();
+    Processor5S& p = loader.getProcessor();
+    p.setPc(0);
+    p.runFor((unsigned long) -1);
+    seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    double cpi = (double) p.getCurrentCycle() / p.getNRetired();
+    cout << "full cpi " << setprecision(4) << cpi << ", error " <<
+      setprecision(2) << 100 * fabs(e.cpi - cpi) / cpi << "%, " <<
+      seconds << " s" << endl;
+  }
+  return 0;
+}
@@ -3,6 +3,25 @@
 #include "Instruction.h"
 #include "Debug.h"
 #include "Processor.h"
+#include "Assembler.h"
+#include "Synth.h"
+#include "ThreadPool.h"
+#include "Config.h"
+#include "Trace.h"
+#include "StackDistance.h"
+#include "Cache.h"
+#include "Functional.h"
+#include "SimPoint.h"
+#include "Sliced.h"
+#include "Checkpoint.h"
+#include "WhatIf.h"
+#include "Elf.h"
+#include "Syscall.h"
+#include "Accel.h"
+#include "OoO.h"
+#include "Superscalar.h"
+#include "MultiCore.h"
+#include "MultiProgram.h"
 
 #define BOOST_TEST_MODULE Pipeline Tests
 #define BOOST_TEST_DYN_LINK
@@ -12,11 +31,29 @@
 #include <exception>
 #include <string>
 #include <math.h>
+#include <atomic>
+#include <climits>
+#include <fstream>
+#include <list>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <elf.h>
+#include <endian.h>
 
 using namespace mem;
 using namespace pipeline;
 using namespace std;
 using namespace instruction;
+using namespace assembler;
+using namespace synth;
+using namespace pool;
+using namespace config;
+using namespace trace;
+using namespace stackdist;
+using namespace cache;
+using namespace functional;
 // this runs it 'g++ test.cpp  -lboost_unit_test_framework'
 
 BOOST_AUTO_TEST_SUITE( TestInstruction )
@@ -128,6 +165,65 @@ BOOST_AUTO_TEST_SUITE( TestMemory )
     delete m3;
   }
 
+  BOOST_AUTO_TEST_CASE( TestDirtyTrackingMem ){
+    DRAM backing(3 * DirtyTrackingMem::PAGE_WORDS, "backing");
+    DirtyTrackingMem m(backing);
+    m.sw(5, 1);
+    m.sw(2 * DirtyTrackingMem::PAGE_WORDS + 1, 2);
+    m.sw(6, 3);
+    BOOST_CHECK_EQUAL(m.ld(6), 3);
+    BOOST_CHECK_EQUAL(backing.ld(6), 3);
+    vector<data32> expected = {0, 2};
+    BOOST_CHECK(m.takeDirty() == expected);
+    BOOST_CHECK(m.takeDirty().empty());
+    //a block across a page boundary dirties both
+    data32 words[4] = {1, 2, 3, 4};
+    m.storeBlock(2 * DirtyTrackingMem::PAGE_WORDS - 2, words, 4);
+    expected = {1, 2};
+    BOOST_CHECK(m.takeDirty() == expected);
+  }
+
+  BOOST_AUTO_TEST_CASE( TestSizedAccess ){
+    DRAM dram(0x10, "dram");
+    DRAM backing(0x10, "backing");
+    //the DRAM fast path, through VirtualMem, and the ld/sw fallback
+    VirtualMem* virt = new VirtualMem(new DRAM(0x10, "virtual"));
+    DirtyTrackingMem tracking(backing);
+    for(MemoryUnit* m : vector<MemoryUnit*>{&dram, virt, &tracking}){
+      m->sw(1, 0x11223344);
+      BOOST_CHECK_EQUAL(m->ldByte(4), 0x11);
+      BOOST_CHECK_EQUAL(m->ldByte(7), 0x44);
+      BOOST_CHECK_EQUAL(m->ldHalf(4), 0x1122);
+      BOOST_CHECK_EQUAL(m->ldHalf(6), 0x3344);
+      m->stByte(5, 0xaa);
+      m->stHalf(6, 0xbeef);
+      BOOST_CHECK_EQUAL(m->ld(1), 0x11aabeef);
+      BOOST_CHECK_EQUAL(m->ld(0), 0);
+      BOOST_CHECK_EQUAL(m->ld(2), 0);
+      BOOST_CHECK_THROW(m->ldHalf(5), std::exception);
+    }
+    delete virt;
+  }
+
+  BOOST_AUTO_TEST_CASE( TestCowMem ){
+    CowMem m(4 * CowMem::PAGE_WORDS, "m");
+    BOOST_CHECK_EQUAL(m.ld(7), 0);
+    m.sw(7, 1);
+    m.sw(CowMem::PAGE_WORDS + 7, 2);
+    BOOST_CHECK_EQUAL(m.getNOwnedPages(), 2);
+    unique_ptr<CowMem> c = m.clone();
+    BOOST_CHECK_EQUAL(m.getNOwnedPages(), 0);
+    BOOST_CHECK_EQUAL(c->ld(CowMem::PAGE_WORDS + 7), 2);
+    //each side's writes stay its own
+    c->sw(7, 3);
+    m.sw(8, 4);
+    BOOST_CHECK_EQUAL(m.ld(7), 1);
+    BOOST_CHECK_EQUAL(c->ld(7), 3);
+    BOOST_CHECK_EQUAL(c->ld(8), 0);
+    BOOST_CHECK_EQUAL(c->getNOwnedPages(), 1);
+    BOOST_CHECK_THROW(m.ld(4 * CowMem::PAGE_WORDS), std::exception);
+  }
+
 BOOST_AUTO_TEST_SUITE_END()
 
 
@@ -870,3 +966,1902 @@ BOOST_AUTO_TEST_SUITE( TestProcessor )
     reader.loadFile("out");
   }
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestAssembler )
+  BOOST_AUTO_TEST_CASE( TestLoopCallAndData ){
+    //sums a table through a function call, then stores the sum
+    Assembler a;
+    a.la(4, "table");
+    a.li(5, 4);
+    a.jal("sum");
+    a.la(8, "result");
+    a.sw(2, 8, 0);
+    a.syscall();
+    a.label("sum");
+    a.li(2, 0);
+    a.label("loop");
+    a.lw(9, 4, 0);
+    a.addu(2, 2, 9);
+    a.addiu(4, 4, 1);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.jr(31);
+    a.dataLabel("table");
+    a.words({3, 0x10000, 0xfffffffe, 40});
+    a.dataLabel("result");
+    a.space(1);
+    vector<data32> image = a.assemble();
+
+    MemoryUnit* mem = new DRAM(0x400, "MainMem");
+    MemoryUnit* rf = new DRAM(0b100000, "RegisterFile");
+    mem->storeBlock(0, image.data(), image.size());
+    Processor5S p("MIPSProcessor", *mem, *rf, 0, "pipeline.log");
+    p.start(0);
+    BOOST_CHECK_EQUAL(rf->ld(2), 0x10000 + 41);
+    BOOST_CHECK_EQUAL(mem->ld(a.dataAddress("result")), 0x10000 + 41);
+    delete mem;
+    delete rf;
+  }
+  BOOST_AUTO_TEST_CASE( TestUndefinedLabel ){
+    Assembler a;
+    a.j("nowhere");
+    BOOST_CHECK_THROW(a.assemble(), std::exception);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestSynth )
+  BOOST_AUTO_TEST_CASE( TestRunsToSyscall ){
+    SynthConfig config;
+    config.nInstrs = 2000;
+    config.depDistance = 2;
+    config.takenRate = 0.7;
+    config.footprint = 0x18000; //spans two windows
+    config.stride = 0x101;
+    SynthProgram program(config);
+    BOOST_CHECK(program.getCode() == SynthProgram(config).getCode());
+
+    MemoryUnit* mem = new DRAM(program.getMemWords(), "MainMem");
+    MemoryUnit* rf = new DRAM(0b100000, "RegisterFile");
+    program.load(*mem);
+    Processor5S p("MIPSProcessor", *mem, *rf, 0, "pipeline.log");
+    p.start(0);
+    BOOST_CHECK_EQUAL(p.getNRetired(), program.getNExecuted());
+    delete mem;
+    delete rf;
+  }
+  BOOST_AUTO_TEST_CASE( TestBadConfig ){
+    SynthConfig config;
+    config.footprint = SynthProgram::MAX_FOOTPRINT + 1;
+    BOOST_CHECK_THROW(SynthProgram program(config), std::exception);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestThreadPool )
+  BOOST_AUTO_TEST_CASE( TestRunsEveryJob ){
+    WorkStealingPool pool(4);
+    atomic<int> count(0);
+    for(int i = 0; i < 100; i++){
+      pool.submit([&](){
+        count++;
+        //jobs may queue more jobs
+        pool.submit([&](){ count++; });
+      });
+    }
+    pool.wait();
+    BOOST_CHECK_EQUAL(count, 200);
+  }
+  BOOST_AUTO_TEST_CASE( TestIdleWorkersWakeForLateJobs ){
+    WorkStealingPool pool(4);
+    atomic<int> count(0);
+    //the other workers go idle before the job is queued
+    pool.submit([&](){
+      this_thread::sleep_for(chrono::milliseconds(20));
+      for(int i = 0; i < 8; i++)
+        pool.submit([&](){ count++; });
+    });
+    pool.wait();
+    BOOST_CHECK_EQUAL(count, 8);
+  }
+  BOOST_AUTO_TEST_CASE( TestProcessorsSideBySide ){
+    SynthConfig config;
+    config.nInstrs = 500;
+    SynthProgram program(config);
+    ProgramImage image = make_shared<const vector<data32>>(program.getCode());
+    vector<unsigned long> retired(8);
+    WorkStealingPool pool(4);
+    for(int i = 0; i < 8; i++){
+      pool.submit([&, i](){
+        ProgramLoader loader(new DRAM(program.getMemWords(), "MainMem"),
+            new DRAM(0b100000, "rf"), "");
+        loader.loadProgram(image);
+        ostringstream report;
+        loader.run(report);
+        retired[i] = loader.getProcessor().getNRetired();
+      });
+    }
+    pool.wait();
+    for(unsigned long r : retired)
+      BOOST_CHECK_EQUAL(r, program.getNExecuted());
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestConfig )
+  BOOST_AUTO_TEST_CASE( TestFileAndOverrides ){
+    ofstream("test_config.ini") << "; a comment\n[ex]\nmulLatency = 4\n"
+      "[mem]\nwords = 0x400 # words\n";
+    SimConfig config;
+    config.loadFile("test_config.ini");
+    config.set("ex.mulLatency=6");
+    BOOST_CHECK_EQUAL(config.mulLatency, 6);
+    BOOST_CHECK_EQUAL(config.memWords, 0x400);
+    BOOST_CHECK_EQUAL(config.exLatency, 1);
+    BOOST_CHECK(config.hash() != SimConfig().hash());
+    BOOST_CHECK(config.cost() < SimConfig().cost());
+    BOOST_CHECK_THROW(config.set("ex.speed=2"), std::exception);
+    BOOST_CHECK_THROW(config.set("ex.latency=0"), std::exception);
+    BOOST_CHECK_THROW(config.set("if.latency=4294967297"), std::exception);
+    BOOST_CHECK_THROW(config.set("mem.words=0"), std::exception);
+    BOOST_CHECK_EQUAL(config.ifLatency, 1);
+    BOOST_CHECK_EQUAL(config.memWords, 0x400);
+    remove("test_config.ini");
+  }
+  BOOST_AUTO_TEST_CASE( TestLatenciesKeepResults ){
+    //a loop with a multiply and memory traffic, run fast and slow
+    Assembler a;
+    a.li(2, 0);
+    a.li(5, 10);
+    a.la(4, "table");
+    a.label("loop");
+    a.lw(9, 4, 0);
+    a.mult(9, 5);
+    a.mflo(10);
+    a.addu(2, 2, 10);
+    a.sw(2, 4, 0);
+    a.addiu(4, 4, 1);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.syscall();
+    a.dataLabel("table");
+    a.words({1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+    vector<data32> image = a.assemble();
+
+    SimConfig slow;
+    slow.set("if.latency=2");
+    slow.set("ex.mulLatency=5");
+    slow.set("ma.memLatency=3");
+    unsigned int cycles[2];
+    SimConfig configs[2] = {SimConfig(), slow};
+    for(int i = 0; i < 2; i++){
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      Processor5S p("MIPSProcessor", mem, rf, 0, "", configs[i]);
+      ostringstream report;
+      p.start(0, report);
+      //sum of k * (11 - k) for k = 1..10
+      BOOST_CHECK_EQUAL(rf.ld(2), 220);
+      cycles[i] = p.getCurrentCycle();
+    }
+    BOOST_CHECK(cycles[1] > 2 * cycles[0]);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestTrace )
+  BOOST_AUTO_TEST_CASE( TestReplayMatchesProcessor ){
+    //a loop calling a function that multiplies and stores
+    Assembler a;
+    a.li(2, 0);
+    a.li(5, 6);
+    a.la(4, "table");
+    a.label("loop");
+    a.jal("scale");
+    a.addiu(4, 4, 1);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.syscall();
+    a.label("scale");
+    a.lw(9, 4, 0);
+    a.mult(9, 5);
+    a.mflo(10);
+    a.addu(2, 2, 10);
+    a.sw(10, 4, 0);
+    a.jr(31);
+    a.dataLabel("table");
+    a.words({1, 2, 3, 4, 5, 6});
+    vector<data32> image = a.assemble();
+
+    SimConfig slow;
+    slow.set("if.latency=2");
+    slow.set("ex.mulLatency=5");
+    slow.set("ma.memLatency=4");
+    slow.set("wb.latency=2");
+    SimConfig configs[2] = {SimConfig(), slow};
+    for(int i = 0; i < 2; i++){
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      Processor5S p("MIPSProcessor", mem, rf, 0, "", configs[i]);
+      //only the fastest config is captured, see TraceReplayer
+      TraceWriter* writer = nullptr;
+      if(i == 0){
+        writer = new TraceWriter("test_trace.trc");
+        p.setTraceWriter(writer);
+      }
+      ostringstream report;
+      p.start(0, report);
+      BOOST_CHECK_EQUAL(rf.ld(2), 56);
+      if(writer != nullptr){
+        BOOST_CHECK_EQUAL(writer->getNRecords(), p.getNRetired());
+        delete writer;
+      }
+
+      TraceReader reader("test_trace.trc");
+      TraceReplayer replayer(reader, configs[i]);
+      replayer.run();
+      BOOST_CHECK_EQUAL(replayer.getNRetired(), p.getNRetired());
+      BOOST_CHECK_EQUAL(replayer.getCurrentCycle(), p.getCurrentCycle());
+    }
+    remove("test_trace.trc");
+  }
+  BOOST_AUTO_TEST_CASE( TestRecordsRoundTrip ){
+    {
+      TraceWriter writer("test_trace.trc");
+      writer.record(0, 0x8c890000, 0x1000, false, 0); //lw $9, 0($4)
+      writer.record(1, 0x0c000010, 6, true, 0x10);  //jal 0x10
+      writer.record(0x11, 0, 0, false, 0);
+      writer.record(0, 0x8c890000, 0xff0, false, 0);
+    }
+    TraceReader reader("test_trace.trc");
+    BOOST_CHECK_EQUAL(reader.getNRecords(), 4);
+    TraceRecord r;
+    BOOST_REQUIRE(reader.next(r));
+    BOOST_CHECK_EQUAL(r.op, OP_LOAD);
+    BOOST_CHECK_EQUAL(r.address, 0x1000);
+    BOOST_CHECK_EQUAL(r.dest, 9);
+    BOOST_REQUIRE(reader.next(r));
+    BOOST_CHECK_EQUAL(r.op, OP_JUMP);
+    BOOST_CHECK(r.redirect);
+    BOOST_CHECK_EQUAL(r.target, 0x10);
+    BOOST_CHECK_EQUAL(r.address, 6);
+    BOOST_REQUIRE(reader.next(r));
+    BOOST_CHECK_EQUAL(r.pc, 0x11);
+    BOOST_CHECK_EQUAL(r.op, OP_NOP);
+    BOOST_REQUIRE(reader.next(r));
+    BOOST_CHECK_EQUAL(r.word, 0x8c890000);
+    BOOST_CHECK_EQUAL(r.address, 0xff0);
+    BOOST_CHECK(!reader.next(r));
+    remove("test_trace.trc");
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestStackDistance )
+  BOOST_AUTO_TEST_CASE( TestMatchesLruCaches ){
+    //loops over a few arrays with some random traffic, long enough to
+    //compact the trees many times
+    vector<data32> stream;
+    mt19937 gen(7);
+    for(int i = 0; i < 20000; i++){
+      stream.push_back(i % 97);
+      stream.push_back(0x1000 + (i * 5) % 300);
+      if(gen() % 4 == 0)
+        stream.push_back(gen() % 0x4000);
+    }
+    vector<unsigned int> setCounts = {1, 4, 16};
+    StackDistance profile(2, setCounts, 8);
+    for(data32 address : stream)
+      profile.access(address);
+    BOOST_CHECK_EQUAL(profile.getNAccesses(), stream.size());
+
+    for(unsigned int nSets : setCounts){
+      for(unsigned int ways = 1; ways <= 8; ways++){
+        //the cache itself, most recent line first in each set
+        vector<list<data32>> sets(nSets);
+        uint64_t misses = 0;
+        for(data32 address : stream){
+          data32 line = address / 2;
+          list<data32>& set = sets[line % nSets];
+          auto hit = find(set.begin(), set.end(), line);
+          if(hit == set.end()){
+            misses++;
+            if(set.size() == ways)
+              set.pop_back();
+          } else {
+            set.erase(hit);
+          }
+          set.push_front(line);
+        }
+        BOOST_CHECK_EQUAL(profile.getMisses(nSets, ways), misses);
+      }
+    }
+    BOOST_CHECK_THROW(profile.getMisses(2, 1), std::exception);
+    BOOST_CHECK_THROW(StackDistance(2, {3}, 8), std::exception);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestCache )
+  BOOST_AUTO_TEST_CASE( TestShardsMatchOneCache ){
+    vector<data32> stream;
+    mt19937 gen(3);
+    for(int i = 0; i < 50000; i++)
+      stream.push_back(gen() % 4 == 0 ? gen() % 0x10000 : i % 3000);
+
+    Cache one(64, 4, 4);
+    for(data32 address : stream)
+      one.access(address);
+    StackDistance profile(4, {64}, 4);
+    for(data32 address : stream)
+      profile.access(address);
+    BOOST_CHECK_EQUAL(one.getStats().misses, profile.getMisses(64, 4));
+
+    for(unsigned int nShards : {1, 4, 8}){
+      ShardedCacheSim sim(64, 4, 4, nShards);
+      for(data32 address : stream)
+        sim.access(address);
+      CacheStats stats = sim.finish();
+      BOOST_CHECK_EQUAL(sim.getNShards(), nShards);
+      BOOST_CHECK_EQUAL(stats.accesses, stream.size());
+      BOOST_CHECK_EQUAL(stats.misses, one.getStats().misses);
+    }
+    BOOST_CHECK_THROW(Cache(48, 4, 4), std::exception);
+  }
+  BOOST_AUTO_TEST_CASE( TestSpscQueueKeepsOrder ){
+    SpscQueue<int> queue(8);
+    long sum = 0;
+    bool inOrder = true;
+    thread consumer([&](){
+      for(int i = 0; i < 100000; i++){
+        int v = queue.pop();
+        inOrder = inOrder && v == i;
+        sum += v;
+      }
+    });
+    for(int i = 0; i < 100000; i++)
+      queue.push(i);
+    consumer.join();
+    BOOST_CHECK(inOrder);
+    BOOST_CHECK_EQUAL(sum, 100000L * 99999 / 2);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestFunctional )
+  BOOST_AUTO_TEST_CASE( TestDecoupledMatchesProcessor ){
+    //calls, multiplies, a divide, loads and stores
+    Assembler a;
+    a.li(2, 0);
+    a.li(5, 6);
+    a.la(4, "table");
+    a.label("loop");
+    a.jal("scale");
+    a.addiu(4, 4, 1);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.li(9, 7);
+    a.divu(2, 9);
+    a.mfhi(3);
+    a.syscall();
+    a.label("scale");
+    a.lw(9, 4, 0);
+    a.mult(9, 5);
+    a.mflo(10);
+    a.addu(2, 2, 10);
+    a.sw(10, 4, 0);
+    a.jr(31);
+    a.dataLabel("table");
+    a.words({1, 2, 3, 4, 5, 6});
+    vector<data32> image = a.assemble();
+
+    SimConfig slow;
+    slow.set("if.latency=3");
+    slow.set("ex.mulLatency=4");
+    slow.set("ex.divLatency=9");
+    slow.set("ma.memLatency=2");
+    for(const SimConfig& config : {SimConfig(), slow}){
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      Processor5S p("MIPSProcessor", mem, rf, 0, "", config);
+      ostringstream report;
+      p.start(0, report);
+
+      DRAM decoupledMem(0x100, "MainMem");
+      DRAM decoupledRf(0b100000, "RegisterFile");
+      decoupledMem.storeBlock(0, image.data(), image.size());
+      DecoupledSim sim(decoupledMem, decoupledRf, config);
+      sim.run(0);
+      BOOST_CHECK_EQUAL(sim.getNRetired(), p.getNRetired());
+      BOOST_CHECK_EQUAL(sim.getCurrentCycle(), p.getCurrentCycle());
+      //but $31, the link moves with the timing (see Functional.h)
+      for(data32 r = 0; r < 31; r++)
+        BOOST_CHECK_EQUAL(decoupledRf.ld(r), rf.ld(r));
+      for(data32 i = 0; i < 6; i++){
+        data32 at = a.dataAddress("table") + i;
+        BOOST_CHECK_EQUAL(decoupledMem.ld(at), mem.ld(at));
+      }
+    }
+  }
+  BOOST_AUTO_TEST_CASE( TestByteOpsMatchProcessor ){
+    Assembler a;
+    a.la(4, "table");
+    a.sll(4, 4, 2);
+    a.lb(2, 4, 0);
+    a.lbu(3, 4, 1);
+    a.lh(5, 4, 2);
+    a.lhu(6, 4, 2);
+    a.lbu(7, 4, 7);
+    a.sb(7, 4, 8);
+    a.sh(6, 4, 10);
+    a.syscall();
+    a.dataLabel("table");
+    a.words({0x8081fffe, 0x41424344});
+    a.dataLabel("out");
+    a.space(1);
+    vector<data32> image = a.assemble();
+    data32 out = a.dataAddress("out");
+
+    DRAM mem(0x100, "MainMem");
+    DRAM rf(0b100000, "RegisterFile");
+    mem.storeBlock(0, image.data(), image.size());
+    Processor5S p("MIPSProcessor", mem, rf, 0, "");
+    ostringstream report;
+    p.start(0, report);
+    BOOST_CHECK_EQUAL(rf.ld(2), 0xffffff80);
+    BOOST_CHECK_EQUAL(rf.ld(3), 0x81);
+    BOOST_CHECK_EQUAL(rf.ld(5), 0xfffffffe);
+    BOOST_CHECK_EQUAL(rf.ld(6), 0xfffe);
+    BOOST_CHECK_EQUAL(rf.ld(7), 0x44);
+    BOOST_CHECK_EQUAL(mem.ld(out), 0x4400fffe);
+
+    DRAM decoupledMem(0x100, "MainMem");
+    DRAM decoupledRf(0b100000, "RegisterFile");
+    decoupledMem.storeBlock(0, image.data(), image.size());
+    DecoupledSim sim(decoupledMem, decoupledRf, SimConfig());
+    sim.run(0);
+    BOOST_CHECK_EQUAL(sim.getCurrentCycle(), p.getCurrentCycle());
+    for(data32 r = 0; r < 31; r++)
+      BOOST_CHECK_EQUAL(decoupledRf.ld(r), rf.ld(r));
+    BOOST_CHECK_EQUAL(decoupledMem.ld(out), mem.ld(out));
+  }
+  BOOST_AUTO_TEST_CASE( TestBadInstructionThrows ){
+    DRAM mem(0x100, "MainMem");
+    DRAM rf(0b100000, "RegisterFile");
+    mem.sw(0, 0xfc000000);
+    DecoupledSim sim(mem, rf, SimConfig());
+    BOOST_CHECK_THROW(sim.run(0), std::exception);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestSimPoint )
+  BOOST_AUTO_TEST_CASE( TestClusterSeparatesPhases ){
+    //intervals alternating between two sets of blocks
+    vector<simpoint::BBV> bbvs;
+    for(int i = 0; i < 12; i++){
+      if(i % 3 == 0)
+        bbvs.push_back({{100, 900}, {140, 100}});
+      else
+        bbvs.push_back({{0, 500}, {20, 500}});
+    }
+    simpoint::Clustering c = simpoint::cluster(bbvs, 5, 15, 1);
+    BOOST_CHECK_EQUAL(c.k, 2);
+    for(size_t i = 0; i < bbvs.size(); i++)
+      BOOST_CHECK_EQUAL(c.assignment[i] == c.assignment[0], i % 3 == 0);
+    for(unsigned int k = 0; k < c.k; k++)
+      BOOST_CHECK_EQUAL(c.assignment[c.representatives[k]], k);
+  }
+  BOOST_AUTO_TEST_CASE( TestEmptyClustersAreDropped ){
+    //two distinct BBVs, but k fixed at four
+    vector<simpoint::BBV> bbvs;
+    for(int i = 0; i < 8; i++){
+      if(i % 2 == 0)
+        bbvs.push_back({{100, 900}, {140, 100}});
+      else
+        bbvs.push_back({{0, 500}, {20, 500}});
+    }
+    simpoint::Clustering c = simpoint::cluster(bbvs, 4, 15, 1, 4);
+    BOOST_CHECK_EQUAL(c.k, 2);
+    BOOST_REQUIRE_EQUAL(c.representatives.size(), c.k);
+    for(unsigned int k = 0; k < c.k; k++){
+      BOOST_REQUIRE_LT(c.representatives[k], bbvs.size());
+      BOOST_CHECK_EQUAL(c.assignment[c.representatives[k]], k);
+    }
+    for(unsigned int a : c.assignment)
+      BOOST_CHECK_LT(a, c.k);
+
+    //one loop throughout, so every interval is alike
+    Assembler a;
+    a.li(5, 3000);
+    a.label("adds");
+    a.addiu(2, 2, 3);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "adds");
+    a.syscall();
+    ProgramImage image = make_shared<const vector<data32>>(a.assemble());
+    SimConfig config;
+    config.memWords = 0x100;
+    simpoint::SimPointConfig simPoint;
+    simPoint.intervalLength = 2000;
+    simPoint.warmup = 200;
+    simPoint.minK = simPoint.maxK = 5;
+    simpoint::Estimate e = simpoint::SampledSim(image, config, simPoint).run();
+    double weight = 0;
+    for(const simpoint::Phase& phase : e.phases){
+      BOOST_CHECK_GT(phase.nIntervals, 0);
+      for(size_t i : phase.simulated)
+        BOOST_CHECK_LT(i, e.nIntervals);
+      weight += phase.weight;
+    }
+    BOOST_CHECK_CLOSE(weight, 1, 1e-9);
+    BOOST_CHECK_LT(e.nDetailed, e.nInstrs);
+  }
+  BOOST_AUTO_TEST_CASE( TestEstimateMatchesFullRun ){
+    //a phase of adds, then a slower phase of multiplies
+    Assembler a;
+    a.li(5, 3000);
+    a.label("adds");
+    a.addiu(2, 2, 3);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "adds");
+    a.li(5, 2000);
+    a.label("mults");
+    a.mult(5, 5);
+    a.mflo(3);
+    a.addu(2, 2, 3);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "mults");
+    a.syscall();
+    ProgramImage image = make_shared<const vector<data32>>(a.assemble());
+
+    SimConfig config;
+    config.memWords = 0x100;
+    config.set("ex.mulLatency=6");
+    simpoint::SimPointConfig simPoint;
+    simPoint.intervalLength = 2000;
+    simPoint.warmup = 200;
+    simpoint::SampledSim sim(image, config, simPoint);
+    simpoint::Estimate e = sim.run();
+
+    ProgramLoader loader(new DRAM(0x100, "MainMem"),
+        new DRAM(0b100000, "RegisterFile"), "", config);
+    loader.loadProgram(image);
+    Processor5S& p = loader.getProcessor();
+    p.runFor((unsigned long) -1);
+    double cpi = (double) p.getCurrentCycle() / p.getNRetired();
+    BOOST_CHECK_EQUAL(e.nInstrs, p.getNRetired());
+    BOOST_CHECK_GE(e.phases.size(), 2);
+    BOOST_CHECK_LT(e.nDetailed, e.nInstrs);
+    BOOST_CHECK_CLOSE(e.cpi, cpi, 2);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestSliced )
+  BOOST_AUTO_TEST_CASE( TestSlicesAddUpToFullRun ){
+    //calls, multiplies, loads and stores, over many slices
+    Assembler a;
+    a.li(2, 0);
+    a.li(5, 120);
+    a.la(4, "table");
+    a.label("loop");
+    a.jal("scale");
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.syscall();
+    a.label("scale");
+    a.lw(9, 4, 0);
+    a.mult(9, 5);
+    a.mflo(10);
+    a.addu(2, 2, 10);
+    a.sw(10, 4, 0);
+    a.jr(31);
+    a.dataLabel("table");
+    a.words({3});
+    ProgramImage image = make_shared<const vector<data32>>(a.assemble());
+
+    SimConfig slow;
+    slow.memWords = 0x100;
+    slow.set("if.latency=2");
+    slow.set("ex.mulLatency=4");
+    slow.set("ma.memLatency=3");
+    ProgramLoader loader(new DRAM(0x100, "MainMem"),
+        new DRAM(0b100000, "RegisterFile"), "", slow);
+    loader.loadProgram(image);
+    Processor5S& p = loader.getProcessor();
+    p.runFor(ULONG_MAX);
+
+    sliced::SliceConfig slicing;
+    slicing.sliceLength = 300;
+    slicing.warmup = 50;
+    slicing.checkLength = 20;
+    slicing.nThreads = 2;
+    sliced::SlicedSim sim(image, slow, slicing);
+    sliced::SlicedResult result = sim.run();
+    BOOST_CHECK_GT(result.slices.size(), 5);
+    BOOST_CHECK_EQUAL(result.nInstrs, p.getNRetired());
+    BOOST_CHECK_EQUAL(result.cycles, p.getCurrentCycle());
+    BOOST_CHECK_EQUAL(result.boundaryErrorAbs, 0);
+    unsigned long ops = 0;
+    for(const sliced::Slice& s : result.slices){
+      BOOST_CHECK_EQUAL(s.start, ops);
+      ops += s.nOps;
+    }
+    BOOST_CHECK_EQUAL(ops, p.getNOps());
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestCheckpoint )
+  BOOST_AUTO_TEST_CASE( TestRestoredRunsFinishAlike ){
+    Assembler a;
+    a.li(2, 0);
+    a.li(5, 60);
+    a.la(4, "table");
+    a.label("loop");
+    a.lw(9, 4, 0);
+    a.mult(9, 5);
+    a.mflo(10);
+    a.addu(2, 2, 10);
+    a.sw(10, 4, 0);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.syscall();
+    a.dataLabel("table");
+    a.words({3});
+    vector<data32> image = a.assemble();
+    data32 table = a.dataAddress("table");
+
+    //the whole run
+    DRAM mem(0x800, "MainMem");
+    DRAM rf(0b100000, "RegisterFile");
+    mem.storeBlock(0, image.data(), image.size());
+    Processor5S p("MIPSProcessor", mem, rf, 0, "");
+    p.runFor(ULONG_MAX);
+
+    string filename = "testCheckpoint.ckpt";
+    {
+      DRAM backing(0x800, "MainMem");
+      DirtyTrackingMem tracked(backing);
+      DRAM functionalRf(0b100000, "RegisterFile");
+      checkpoint::CheckpointWriter writer(filename, tracked);
+      tracked.storeBlock(0, image.data(), image.size());
+      FunctionalCore core(tracked, functionalRf, 0);
+      TraceRecord r;
+      bool running = true;
+      unsigned long next = 0;
+      while(running){
+        if(core.getNExecuted() >= next && core.isQuiet()){
+          writer.write(core);
+          next += 150;
+        }
+        running = core.step(r);
+      }
+    }
+
+    checkpoint::CheckpointReader reader(filename);
+    BOOST_CHECK_GT(reader.getNCheckpoints(), 3);
+    BOOST_CHECK_EQUAL(reader.getMemWords(), 0x800);
+    for(size_t i = 0; i < reader.getNCheckpoints(); i++){
+      DRAM restoredRf(0b100000, "RegisterFile");
+      unique_ptr<MappedMem> restored = reader.restore(i, restoredRf);
+      Processor5S q("MIPSProcessor", *restored, restoredRf, 0, "");
+      checkpoint::start(reader.getState(i), q);
+      q.runFor(ULONG_MAX);
+      BOOST_CHECK_EQUAL(reader.getState(i).nExecuted + q.getNRetired(),
+          p.getNRetired());
+      BOOST_CHECK_EQUAL(restoredRf.ld(2), rf.ld(2));
+      BOOST_CHECK_EQUAL(restored->ld(table), mem.ld(table));
+    }
+    //writes to a restored memory stay out of the file
+    DRAM restoredRf(0b100000, "RegisterFile");
+    unique_ptr<MappedMem> first = reader.restore(0, restoredRf);
+    first->sw(table, 12345);
+    BOOST_CHECK_EQUAL(reader.restore(0, restoredRf)->ld(table), 3);
+    remove(filename.c_str());
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestWhatIf )
+  BOOST_AUTO_TEST_CASE( TestClonesGoOnAlike ){
+    Assembler a;
+    a.li(2, 0);
+    a.li(5, 80);
+    a.la(4, "table");
+    a.label("loop");
+    a.lw(9, 4, 0);
+    a.mult(9, 5);
+    a.mflo(10);
+    a.addu(2, 2, 10);
+    a.sw(10, 4, 0);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.syscall();
+    a.dataLabel("table");
+    a.words({3});
+    ProgramImage image = make_shared<const vector<data32>>(a.assemble());
+    data32 table = a.dataAddress("table");
+    SimConfig config;
+    config.memWords = 0x100;
+    config.set("ma.memLatency=2");
+    SimConfig slow = config;
+    slow.set("ex.mulLatency=5");
+
+    whatif::Simulation whole(image, config);
+    whole.getProcessor().runFor(ULONG_MAX);
+
+    //stopped mid loop, with instructions in flight
+    whatif::Simulation warmed(image, config);
+    warmed.getProcessor().runFor(301);
+    vector<unique_ptr<whatif::Simulation>> clones;
+    clones.push_back(warmed.clone(config));
+    clones.push_back(warmed.clone(slow));
+    vector<whatif::Outcome> outcomes = whatif::runAll(clones, ULONG_MAX);
+
+    //the same configuration goes on as if never cloned
+    Processor5S& same = clones[0]->getProcessor();
+    BOOST_CHECK(outcomes[0].finished);
+    BOOST_CHECK_EQUAL(same.getNRetired(), whole.getProcessor().getNRetired());
+    BOOST_CHECK_EQUAL(same.getCurrentCycle(),
+        whole.getProcessor().getCurrentCycle());
+    BOOST_CHECK_EQUAL(clones[0]->getRegisterFile().ld(2),
+        whole.getRegisterFile().ld(2));
+    BOOST_CHECK_EQUAL(clones[0]->getMainMemory().ld(table),
+        whole.getMainMemory().ld(table));
+    //the slower one computes the same, later
+    BOOST_CHECK(outcomes[1].finished);
+    BOOST_CHECK_GT(outcomes[1].cycles, outcomes[0].cycles);
+    BOOST_CHECK_EQUAL(clones[1]->getRegisterFile().ld(2),
+        whole.getRegisterFile().ld(2));
+    BOOST_CHECK_EQUAL(outcomes[0].ownedPages, 1);
+    //and the original is untouched
+    BOOST_CHECK_EQUAL(warmed.getProcessor().getNRetired(), 301);
+    BOOST_CHECK(warmed.getMainMemory().ld(table) !=
+        whole.getMainMemory().ld(table));
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestElf )
+  BOOST_AUTO_TEST_CASE( TestElfRunsLikeHex ){
+    Assembler a;
+    a.la(4, "table");
+    a.li(5, 4);
+    a.jal("sum");
+    a.la(8, "result");
+    a.sw(2, 8, 0);
+    a.syscall();
+    a.label("sum");
+    a.li(2, 0);
+    a.label("loop");
+    a.lw(9, 4, 0);
+    a.addu(2, 2, 9);
+    a.addiu(4, 4, 1);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.jr(31);
+    a.dataLabel("table");
+    a.words({3, 0x10000, 0xfffffffe, 40});
+    a.dataLabel("result");
+    a.space(64);
+    Assembler::writeHex("elfTest.hex", a.assemble());
+    a.writeElf("elfTest.elf");
+    BOOST_CHECK(elf::ElfFile::isElf("elfTest.elf"));
+    BOOST_CHECK(!elf::ElfFile::isElf("elfTest.hex"));
+
+    elf::ElfFile file("elfTest.elf");
+    data32 result = a.dataAddress("result");
+    BOOST_CHECK_EQUAL(file.getEntry(), 0);
+    BOOST_CHECK_EQUAL(file.getEnd(), result + 64);
+    const elf::Symbol* loop = file.symbolAt(a.dataAddress("loop") + 1);
+    BOOST_REQUIRE(loop);
+    BOOST_CHECK_EQUAL(loop->name, "loop");
+    BOOST_CHECK(loop->function);
+    const elf::Symbol* bss = file.symbolAt(result + 10);
+    BOOST_REQUIRE(bss);
+    BOOST_CHECK_EQUAL(bss->name, "result");
+    BOOST_CHECK(!bss->function);
+
+    ProgramLoader hex(new DRAM(0x100, "MainMem"), new DRAM(0b100000, "rf"),
+        "");
+    hex.loadProgram("elfTest.hex");
+    //.bss is left to read as zero, not written
+    DRAM* mem = new DRAM(0x100, "MainMem");
+    mem->sw(result + 1, 7);
+    ProgramLoader loaded(mem, new DRAM(0b100000, "rf"), "");
+    loaded.loadProgram("elfTest.elf");
+    BOOST_CHECK_EQUAL(mem->ld(result + 1), 7);
+    BOOST_CHECK_EQUAL(loaded.getSymbols().size(), file.getSymbols().size());
+    ostringstream report;
+    hex.run(report);
+    loaded.run(report);
+    BOOST_CHECK_EQUAL(loaded.getRegisterFile().ld(2), 0x10000 + 41);
+    BOOST_CHECK_EQUAL(mem->ld(result), 0x10000 + 41);
+    BOOST_CHECK_EQUAL(loaded.getProcessor().getNRetired(),
+        hex.getProcessor().getNRetired());
+    BOOST_CHECK_EQUAL(loaded.getProcessor().getCurrentCycle(),
+        hex.getProcessor().getCurrentCycle());
+    remove("elfTest.hex");
+    remove("elfTest.elf");
+  }
+  BOOST_AUTO_TEST_CASE( TestPartialLastWord ){
+    Assembler a;
+    a.li(2, 1);
+    a.syscall();
+    a.addiu(3, 3, 0x1234);
+    a.dataLabel("table");
+    a.words({0xffffffff});
+    vector<data32> image = a.assemble();
+    a.writeElf("elfTest.elf");
+    //cut the code segment to half its last word, which the data follows
+    string bytes;
+    {
+      ifstream in("elfTest.elf", ios::binary);
+      bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    Elf32_Ehdr eh;
+    memcpy(&eh, bytes.data(), sizeof(eh));
+    Elf32_Phdr ph;
+    size_t at = be32toh(eh.e_phoff);
+    memcpy(&ph, bytes.data() + at, sizeof(ph));
+    ph.p_filesz = htobe32(be32toh(ph.p_filesz) - 2);
+    memcpy(&bytes[at], &ph, sizeof(ph));
+    ofstream("elfTest.elf", ios::binary) << bytes;
+
+    DRAM mem(0x100, "MainMem");
+    elf::ElfFile("elfTest.elf").load(mem);
+    data32 last = a.dataAddress("table") - 1;
+    BOOST_CHECK_EQUAL(mem.ld(last), image[last] & 0xffff0000);
+    BOOST_CHECK_EQUAL(mem.ld(last + 1), 0xffffffff);
+    remove("elfTest.elf");
+  }
+  BOOST_AUTO_TEST_CASE( TestNotAnElf ){
+    ofstream("elfTest.bad") << "\x7f" "ELF and nothing else";
+    BOOST_CHECK(elf::ElfFile::isElf("elfTest.bad"));
+    BOOST_CHECK_THROW(elf::ElfFile("elfTest.bad"), std::exception);
+    remove("elfTest.bad");
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestSyscall )
+  //prints through SPIM and o32 calls, grows the heap, exits with 3
+  vector<data32> ioProgram(data32& msg){
+    Assembler a;
+    a.la(4, "msg");
+    a.sll(4, 4, 2);
+    a.li(2, 4);
+    a.syscall();
+    a.li(4, (data32) -5);
+    a.li(2, 1);
+    a.syscall();
+    a.li(4, 8);
+    a.li(2, 9);
+    a.syscall();
+    a.move(16, 2);
+    a.li(4, 1);
+    a.la(5, "msg");
+    a.sll(5, 5, 2);
+    a.li(6, 3);
+    a.li(2, 4004);
+    a.syscall();
+    a.move(17, 2);
+    a.li(4, 3);
+    a.li(2, 17);
+    a.syscall();
+    a.dataLabel("msg");
+    a.words({0x68690a00});
+    vector<data32> image = a.assemble();
+    msg = a.dataAddress("msg");
+    return image;
+  }
+
+  BOOST_AUTO_TEST_CASE( TestEmulatedIo ){
+    data32 msg;
+    vector<data32> image = ioProgram(msg);
+    data32 heap = image.size();
+    SimConfig slow;
+    slow.set("wb.syscallLatency=20");
+    unsigned long cycles[2];
+    int i = 0;
+    for(const SimConfig& config : {SimConfig(), slow}){
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      istringstream in;
+      ostringstream out;
+      sys::SyscallEmulator emulator(heap, in, out);
+      Processor5S p("MIPSProcessor", mem, rf, 0, "", config);
+      p.setSyscalls(&emulator);
+      ostringstream report;
+      p.start(0, report);
+      BOOST_CHECK_EQUAL(out.str(), "hi\n-5hi\n");
+      BOOST_CHECK(emulator.hasExited());
+      BOOST_CHECK_EQUAL(emulator.getExitCode(), 3);
+      BOOST_CHECK_EQUAL(emulator.getNCalls(), 5);
+      BOOST_CHECK_EQUAL(rf.ld(16), heap * 4);
+      BOOST_CHECK_EQUAL(rf.ld(17), 3);
+      cycles[i++] = p.getCurrentCycle();
+
+      //the functional side runs them alike
+      DRAM decoupledMem(0x100, "MainMem");
+      DRAM decoupledRf(0b100000, "RegisterFile");
+      decoupledMem.storeBlock(0, image.data(), image.size());
+      ostringstream decoupledOut;
+      sys::SyscallEmulator decoupledEmulator(heap, in, decoupledOut);
+      DecoupledSim sim(decoupledMem, decoupledRf, config);
+      sim.setSyscalls(&decoupledEmulator);
+      sim.run(0);
+      BOOST_CHECK_EQUAL(decoupledOut.str(), out.str());
+      BOOST_CHECK_EQUAL(decoupledEmulator.getExitCode(), 3);
+      BOOST_CHECK_EQUAL(sim.getNRetired(), p.getNRetired());
+      BOOST_CHECK_EQUAL(sim.getCurrentCycle(), p.getCurrentCycle());
+    }
+    BOOST_CHECK_GE(cycles[1], cycles[0] + 5 * 19);
+  }
+
+  BOOST_AUTO_TEST_CASE( TestReadAndBadCalls ){
+    DRAM mem(0x10, "MainMem");
+    DRAM rf(0b100000, "RegisterFile");
+    istringstream in("42\nabc");
+    ostringstream out;
+    sys::SyscallEmulator emulator(8, in, out);
+    rf.sw(2, 5);
+    BOOST_CHECK(!emulator.handle(mem, rf));
+    BOOST_CHECK_EQUAL(rf.ld(2), 42);
+    //o32 read from stdin into bytes 4..
+    rf.sw(2, 4003);
+    rf.sw(4, 0);
+    rf.sw(5, 4);
+    rf.sw(6, 8);
+    emulator.handle(mem, rf);
+    BOOST_CHECK_EQUAL(rf.ld(7), 0);
+    BOOST_CHECK_EQUAL(rf.ld(2), 4);
+    BOOST_CHECK_EQUAL(mem.ld(1), 0x0a616263);
+    //a descriptor never opened
+    rf.sw(2, 4004);
+    rf.sw(4, 9);
+    emulator.handle(mem, rf);
+    BOOST_CHECK_EQUAL(rf.ld(7), 1);
+    rf.sw(2, 12345);
+    BOOST_CHECK_THROW(emulator.handle(mem, rf), std::exception);
+    rf.sw(2, 10);
+    BOOST_CHECK(emulator.handle(mem, rf));
+  }
+
+  BOOST_AUTO_TEST_CASE( TestWorkloadEndsAtLoaderSyscall ){
+    //crc32 leaves its checksum in $v0 as it reaches the loader's syscall
+    SimConfig config;
+    config.memWords = 0x10000;
+    ProgramLoader loader(new DRAM(config.memWords, "MainMem"),
+        new DRAM(0b100000, "rf"), "", config);
+    loader.loadProgram("workloads/crc32.hex");
+    BOOST_CHECK_EQUAL(loader.getExit(), loader.getEnd() - 1);
+    sys::SyscallEmulator emulator(loader.getEnd());
+    emulator.setEndMarker(loader.getExit());
+    loader.getProcessor().setSyscalls(&emulator);
+    ostringstream report;
+    loader.run(report);
+    BOOST_CHECK_EQUAL(loader.getRegisterFile().ld(2), 2389613914u);
+    BOOST_CHECK_EQUAL(emulator.getNCalls(), 0);
+    BOOST_CHECK_EQUAL(emulator.getExitCode(), 0);
+
+    ProgramLoader functional(new DRAM(config.memWords, "MainMem"),
+        new DRAM(0b100000, "rf"), "", config);
+    functional.loadProgram("workloads/crc32.hex");
+    sys::SyscallEmulator functionalEmulator(functional.getEnd());
+    functionalEmulator.setEndMarker(functional.getExit());
+    DecoupledSim sim(functional.getMainMemory(),
+        functional.getRegisterFile(), config);
+    sim.setSyscalls(&functionalEmulator);
+    sim.run(functional.getEntry());
+    BOOST_CHECK_EQUAL(functional.getRegisterFile().ld(2), 2389613914u);
+    BOOST_CHECK_EQUAL(sim.getNRetired(),
+        loader.getProcessor().getNRetired());
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestAccel )
+  BOOST_AUTO_TEST_CASE( TestHostLibcMatchesGuest ){
+    //copies a string with a guest memcpy, then measures it with strlen
+    Assembler a;
+    a.la(4, "dst");
+    a.sll(4, 4, 2);
+    a.la(5, "src");
+    a.sll(5, 5, 2);
+    a.li(6, 11);
+    a.jal("memcpy");
+    a.la(4, "dst");
+    a.sll(4, 4, 2);
+    a.jal("strlen");
+    a.move(16, 2);
+    a.syscall();
+    a.label("memcpy");
+    a.move(2, 4);
+    a.beq(6, 0, "copied");
+    a.label("copy");
+    a.lbu(9, 5, 0);
+    a.sb(9, 4, 0);
+    a.addiu(4, 4, 1);
+    a.addiu(5, 5, 1);
+    a.addiu(6, 6, -1);
+    a.bne(6, 0, "copy");
+    a.label("copied");
+    a.jr(31);
+    a.label("strlen");
+    a.li(2, 0);
+    a.label("count");
+    a.addu(9, 4, 2);
+    a.lbu(9, 9, 0);
+    a.beq(9, 0, "counted");
+    a.addiu(2, 2, 1);
+    a.j("count");
+    a.label("counted");
+    a.jr(31);
+    a.dataLabel("src");
+    //"hello world" and its 0
+    a.words({0x68656c6c, 0x6f20776f, 0x726c6400});
+    a.dataLabel("dst");
+    a.space(3);
+    a.writeElf("accelTest.elf");
+    data32 dst = a.dataAddress("dst");
+
+    unsigned long executed[2];
+    for(int accelerated = 0; accelerated < 2; accelerated++){
+      ProgramLoader loader(new DRAM(0x100, "MainMem"),
+          new DRAM(0b100000, "rf"), "");
+      loader.loadProgram("accelTest.elf");
+      accel::Accelerator accelerator;
+      accelerator.addSymbols(loader.getSymbols());
+      FunctionalCore core(loader.getMainMemory(), loader.getRegisterFile(),
+          loader.getEntry());
+      if(accelerated)
+        core.setAccelerator(&accelerator);
+      TraceRecord r;
+      while(core.step(r));
+      core.drain();
+      BOOST_CHECK_EQUAL(loader.getRegisterFile().ld(16), 11);
+      for(data32 i = 0; i < 3; i++)
+        BOOST_CHECK_EQUAL(loader.getMainMemory().ld(dst + i),
+            loader.getMainMemory().ld(a.dataAddress("src") + i));
+      BOOST_CHECK_EQUAL(accelerator.getNCalls(accel::MEMCPY), accelerated);
+      BOOST_CHECK_EQUAL(accelerator.getNCalls(accel::STRLEN), accelerated);
+      executed[accelerated] = core.getNExecuted();
+    }
+    //33 bytes touched and 2 calls, against the guest's loops
+    BOOST_CHECK_LT(executed[1], executed[0]);
+    remove("accelTest.elf");
+  }
+  BOOST_AUTO_TEST_CASE( TestMapFile ){
+    ofstream("accelTest.map") << "# guest libc\nmemset 0x40\nmemcmp 80\n";
+    accel::Accelerator accelerator;
+    accelerator.loadMap("accelTest.map");
+    BOOST_CHECK(accelerator.intercepts(0x40));
+    BOOST_CHECK(accelerator.intercepts(80));
+    BOOST_CHECK(!accelerator.intercepts(0x41));
+    DRAM mem(0x10, "MainMem");
+    DRAM rf(0b100000, "rf");
+    rf.sw(4, 5);
+    rf.sw(5, 0xab);
+    rf.sw(6, 9);
+    accelerator.call(0x40, mem, rf);
+    BOOST_CHECK_EQUAL(mem.ld(1), 0x00ababab);
+    BOOST_CHECK_EQUAL(mem.ld(2), 0xabababab);
+    BOOST_CHECK_EQUAL(mem.ld(3), 0xabab0000);
+    rf.sw(4, 4);
+    rf.sw(5, 8);
+    rf.sw(6, 4);
+    accelerator.call(80, mem, rf);
+    BOOST_CHECK_EQUAL((signedData32) rf.ld(2), -0xab);
+    ofstream("accelTest.map") << "strcpy 0x40\n";
+    BOOST_CHECK_THROW(accelerator.loadMap("accelTest.map"), std::exception);
+    remove("accelTest.map");
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestOoO )
+  BOOST_AUTO_TEST_CASE( TestMatchesProcessor ){
+    //calls, stores read straight back, multiplies and a divide
+    Assembler a;
+    a.li(2, 0);
+    a.li(3, 0);
+    a.li(5, 6);
+    a.la(4, "table");
+    a.label("loop");
+    a.jal("scale");
+    a.addiu(4, 4, 1);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.li(9, 7);
+    a.divu(2, 9);
+    a.mfhi(3);
+    a.syscall();
+    a.label("scale");
+    a.lw(9, 4, 0);
+    a.mult(9, 5);
+    a.mflo(10);
+    a.sw(10, 4, 0);
+    a.lw(11, 4, 0);
+    a.addu(2, 2, 11);
+    a.jr(31);
+    a.dataLabel("table");
+    a.words({1, 2, 3, 4, 5, 6});
+    vector<data32> image = a.assemble();
+
+    SimConfig slow;
+    slow.set("if.latency=3");
+    slow.set("ex.mulLatency=4");
+    slow.set("ex.divLatency=9");
+    slow.set("ma.memLatency=2");
+    SimConfig split = slow;
+    split.set("ooo.queues=3");
+    split.set("ooo.width=2");
+    for(const SimConfig& config : {SimConfig(), slow, split}){
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      Processor5S p("MIPSProcessor", mem, rf, 0, "", config);
+      ostringstream report;
+      p.start(0, report);
+
+      DRAM oooMem(0x100, "MainMem");
+      DRAM oooRf(0b100000, "RegisterFile");
+      oooMem.storeBlock(0, image.data(), image.size());
+      ooo::ProcessorOoO o("MIPSProcessor", oooMem, oooRf, 0, config);
+      o.start(0, report);
+      //a slow Processor5S fetches fewer nops behind branches
+      BOOST_CHECK_EQUAL(o.getNOps(), p.getNOps());
+      //slower fetch lets the store retire before the load issues
+      if(config.ifLatency == 1)
+        BOOST_CHECK_GT(o.getStats().nForwarded, 0);
+      //$31 is the full speed link, as for DecoupledSim
+      for(data32 r = 0; r < 31; r++)
+        BOOST_CHECK_EQUAL(oooRf.ld(r), rf.ld(r));
+      for(data32 i = 0; i < 6; i++){
+        data32 at = a.dataAddress("table") + i;
+        BOOST_CHECK_EQUAL(oooMem.ld(at), mem.ld(at));
+      }
+    }
+  }
+  BOOST_AUTO_TEST_CASE( TestWiderIsFaster ){
+    //eight independent chains
+    Assembler a;
+    for(int i = 0; i < 64; i++)
+      for(Reg r = 8; r < 16; r++)
+        a.addiu(r, r, 1);
+    a.syscall();
+    vector<data32> image = a.assemble();
+
+    DRAM mem(0x400, "MainMem");
+    DRAM rf(0b100000, "RegisterFile");
+    mem.storeBlock(0, image.data(), image.size());
+    Processor5S p("MIPSProcessor", mem, rf, 0, "");
+    ostringstream report;
+    p.start(0, report);
+
+    unsigned long cycles[2];
+    for(unsigned int width : {1, 4}){
+      SimConfig config;
+      config.set("ooo.width", to_string(width));
+      DRAM oooMem(0x400, "MainMem");
+      DRAM oooRf(0b100000, "RegisterFile");
+      oooMem.storeBlock(0, image.data(), image.size());
+      ooo::ProcessorOoO o("MIPSProcessor", oooMem, oooRf, 0, config);
+      o.start(0, report);
+      for(Reg r = 8; r < 16; r++)
+        BOOST_CHECK_EQUAL(oooRf.ld(r), 64);
+      BOOST_CHECK_LE(o.getNRetired(), o.getCurrentCycle() * width);
+      cycles[width == 4] = o.getCurrentCycle();
+    }
+    BOOST_CHECK_LT(cycles[1] * 3, p.getCurrentCycle());
+    BOOST_CHECK_LT(cycles[1] * 3, cycles[0]);
+  }
+  BOOST_AUTO_TEST_CASE( TestLoadPassingStoreSquashes ){
+    //the store's address comes out of a slow divide, the load's is known
+    Assembler a;
+    a.li(2, 0);
+    a.li(6, 1);
+    a.li(8, 4);
+    a.li(12, 10);
+    a.la(4, "cell");
+    a.la(7, "cell");
+    a.label("loop");
+    a.divu(7, 6);
+    a.mflo(11);
+    a.sw(12, 11, 0);
+    a.lw(13, 4, 0);
+    a.addu(2, 2, 13);
+    a.addiu(12, 12, 1);
+    a.addiu(8, 8, -1);
+    a.bne(8, 0, "loop");
+    a.syscall();
+    a.dataLabel("cell");
+    a.word(0);
+    vector<data32> image = a.assemble();
+
+    SimConfig config;
+    config.set("ex.divLatency=12");
+    DRAM mem(0x100, "MainMem");
+    DRAM rf(0b100000, "RegisterFile");
+    mem.storeBlock(0, image.data(), image.size());
+    ooo::ProcessorOoO o("MIPSProcessor", mem, rf, 0, config);
+    ostringstream report;
+    o.start(0, report);
+    BOOST_CHECK_EQUAL(rf.ld(2), 10 + 11 + 12 + 13);
+    BOOST_CHECK_EQUAL(mem.ld(a.dataAddress("cell")), 13);
+    //once caught, the load waits for the store
+    BOOST_CHECK_EQUAL(o.getStats().nViolations, 1);
+    BOOST_CHECK_GT(o.getStats().nSquashed, 0);
+
+    config.set("ooo.queues=2");
+    BOOST_CHECK_THROW(ooo::ProcessorOoO("MIPSProcessor", mem, rf, 0, config),
+        std::exception);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestSuperscalar )
+  BOOST_AUTO_TEST_CASE( TestWidthOneIsProcessor ){
+    Assembler a;
+    a.li(2, 0);
+    a.li(5, 6);
+    a.la(4, "table");
+    a.label("loop");
+    a.jal("scale");
+    a.addiu(4, 4, 1);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.li(9, 7);
+    a.divu(2, 9);
+    a.mfhi(3);
+    a.syscall();
+    a.label("scale");
+    a.lw(9, 4, 0);
+    a.mult(9, 5);
+    a.mflo(10);
+    a.addu(2, 2, 10);
+    a.sw(10, 4, 0);
+    a.jr(31);
+    a.dataLabel("table");
+    a.words({1, 2, 3, 4, 5, 6});
+    vector<data32> image = a.assemble();
+
+    SimConfig slow;
+    slow.set("ss.width=1");
+    slow.set("ex.latency=2");
+    slow.set("ma.memLatency=3");
+    DRAM mem(0x100, "MainMem");
+    DRAM rf(0b100000, "RegisterFile");
+    mem.storeBlock(0, image.data(), image.size());
+    Processor5S p("MIPSProcessor", mem, rf, 0, "");
+    ostringstream report;
+    p.start(0, report);
+
+    //slower, Processor5S fetches fewer of the delay slots
+    DRAM slowMem(0x100, "MainMem");
+    DRAM slowRf(0b100000, "RegisterFile");
+    slowMem.storeBlock(0, image.data(), image.size());
+    Processor5S q("MIPSProcessor", slowMem, slowRf, 0, "", slow);
+    q.start(0, report);
+    BOOST_CHECK_LT(q.getNRetired(), p.getNRetired());
+    DRAM ssSlowMem(0x100, "MainMem");
+    DRAM ssSlowRf(0b100000, "RegisterFile");
+    ssSlowMem.storeBlock(0, image.data(), image.size());
+    superscalar::ProcessorSS t("MIPSProcessor", ssSlowMem, ssSlowRf, 0, slow);
+    t.start(0, report);
+    BOOST_CHECK_EQUAL(t.getNRetired(), q.getNRetired());
+    BOOST_CHECK_EQUAL(t.getCurrentCycle(), q.getCurrentCycle());
+    BOOST_CHECK_GT(t.getStats().nSkipped, 0);
+
+    for(unsigned int width : {1, 2, 4}){
+      SimConfig config;
+      config.set("ss.width", to_string(width));
+      DRAM ssMem(0x100, "MainMem");
+      DRAM ssRf(0b100000, "RegisterFile");
+      ssMem.storeBlock(0, image.data(), image.size());
+      superscalar::ProcessorSS s("MIPSProcessor", ssMem, ssRf, 0, config);
+      s.start(0, report);
+      BOOST_CHECK_EQUAL(s.getNRetired(), p.getNRetired());
+      if(width == 1)
+        BOOST_CHECK_EQUAL(s.getCurrentCycle(), p.getCurrentCycle());
+      else
+        BOOST_CHECK_LT(s.getCurrentCycle(), p.getCurrentCycle());
+      for(data32 r = 0; r < 31; r++)
+        BOOST_CHECK_EQUAL(ssRf.ld(r), rf.ld(r));
+      for(data32 i = 0; i < 6; i++){
+        data32 at = a.dataAddress("table") + i;
+        BOOST_CHECK_EQUAL(ssMem.ld(at), mem.ld(at));
+      }
+    }
+  }
+  BOOST_AUTO_TEST_CASE( TestPairingRules ){
+    //loads two at a time, then independent adds
+    Assembler a;
+    a.la(4, "table");
+    for(int i = 0; i < 8; i++)
+      a.lw(8 + i, 4, i);
+    for(int i = 0; i < 8; i++)
+      a.addiu(16 + i, 4, i);
+    a.syscall();
+    a.dataLabel("table");
+    a.words({1, 2, 3, 4, 5, 6, 7, 8});
+    vector<data32> image = a.assemble();
+
+    unsigned long cycles[2];
+    for(unsigned int memOps : {1, 2}){
+      SimConfig config;
+      config.set("ss.memOps", to_string(memOps));
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      superscalar::ProcessorSS s("MIPSProcessor", mem, rf, 0, config);
+      ostringstream report;
+      s.start(0, report);
+      for(int i = 0; i < 8; i++)
+        BOOST_CHECK_EQUAL(rf.ld(8 + i), i + 1);
+      const superscalar::SuperscalarStats& stats = s.getStats();
+      if(memOps == 1)
+        BOOST_CHECK_GT(stats.pairingFailures[superscalar::PAIR_MEMORY], 0);
+      else
+        BOOST_CHECK_EQUAL(stats.pairingFailures[superscalar::PAIR_MEMORY],
+            0);
+      BOOST_CHECK_GT(stats.issued[2], 0);
+      BOOST_CHECK_GT(s.getSlotUtilization(), 0.0);
+      BOOST_CHECK_LE(s.getSlotUtilization(), 1.0);
+      cycles[memOps - 1] = s.getCurrentCycle();
+    }
+    BOOST_CHECK_LT(cycles[1], cycles[0]);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestFrontEnd )
+  BOOST_AUTO_TEST_CASE( TestQueueHidesFetchLatency ){
+    Assembler a;
+    a.li(2, 0);
+    a.li(5, 20);
+    a.label("loop");
+    a.addu(2, 2, 5);
+    a.addiu(5, 5, -1);
+    a.bne(5, 0, "loop");
+    a.syscall();
+    vector<data32> image = a.assemble();
+
+    unsigned long cycles[3];
+    unsigned long bubbles[3] = {};
+    for(int i = 0; i < 3; i++){
+      SimConfig config;
+      config.set("if.latency=3");
+      if(i > 0){
+        config.set("fe.queueWords=8");
+        config.set("fe.lineWords=4");
+      }
+      if(i > 1)
+        config.set("fe.loopBufferWords=32");
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      Processor5S p("MIPSProcessor", mem, rf, 0, "", config);
+      ostringstream report;
+      p.start(0, report);
+      BOOST_CHECK_EQUAL(rf.ld(2), 210);
+      cycles[i] = p.getCurrentCycle();
+      const frontend::FetchUnit* unit = p.getFetchUnit();
+      BOOST_CHECK_EQUAL(unit != nullptr, i > 0);
+      if(unit != nullptr){
+        const frontend::FetchStats& stats = unit->getStats();
+        BOOST_CHECK_GT(stats.nRedirects, 0);
+        BOOST_CHECK_EQUAL(stats.nLoopBufferLines > 0, i > 1);
+        bubbles[i] = stats.redirectBubbles + stats.starvedBubbles;
+      }
+    }
+    BOOST_CHECK_LT(cycles[1], cycles[0]);
+    BOOST_CHECK_LT(cycles[2], cycles[1]);
+    //the loop buffer has the branch target at once
+    BOOST_CHECK_LT(bubbles[2], bubbles[1]);
+  }
+  BOOST_AUTO_TEST_CASE( TestQueueMustHoldALine ){
+    DRAM mem(0x10, "MainMem");
+    BOOST_CHECK_THROW(frontend::FetchUnit(mem, 8, 4, 1, 0), std::exception);
+    SimConfig config;
+    config.set("fe.queueWords=0");
+    BOOST_CHECK_THROW(config.set("fe.lineWords=0"), std::exception);
+  }
+  BOOST_AUTO_TEST_CASE( TestDecoupledTimesTheFrontEnd ){
+    SimConfig config;
+    config.memWords = 0x10000;
+    config.set("if.latency=3");
+    config.set("fe.queueWords=16");
+    config.set("fe.lineWords=8");
+    config.set("fe.loopBufferWords=32");
+    config.set("ex.latency=2");
+    for(const string workload : {"crc32", "interpreter"}){
+      string filename = "workloads/" + workload + ".hex";
+      ProgramLoader loader(new DRAM(config.memWords, "MainMem"),
+          new DRAM(0b100000, "rf"), "", config);
+      loader.loadProgram(filename);
+      ostringstream report;
+      loader.run(report);
+
+      ProgramLoader functional(new DRAM(config.memWords, "MainMem"),
+          new DRAM(0b100000, "rf"), "", config);
+      functional.loadProgram(filename);
+      DecoupledSim sim(functional.getMainMemory(),
+          functional.getRegisterFile(), config);
+      sim.run(functional.getEntry());
+      BOOST_CHECK_EQUAL(sim.getNRetired(),
+          loader.getProcessor().getNRetired());
+      BOOST_CHECK_EQUAL(sim.getCurrentCycle(),
+          loader.getProcessor().getCurrentCycle());
+    }
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestMultiCore )
+  BOOST_AUTO_TEST_CASE( TestPartitionedSum ){
+    //core $a0 sums 10 $a0 + 1 to 10 $a0 + 10 into results[$a0]
+    Assembler a;
+    a.li(2, 0);
+    a.sll(8, 4, 3);
+    a.sll(9, 4, 1);
+    a.addu(8, 8, 9);
+    a.addiu(8, 8, 1);
+    a.addiu(10, 8, 10);
+    a.label("loop");
+    a.addu(2, 2, 8);
+    a.addiu(8, 8, 1);
+    a.bne(8, 10, "loop");
+    a.la(11, "results");
+    a.addu(11, 11, 4);
+    a.sw(2, 11, 0);
+    a.syscall();
+    a.dataLabel("results");
+    a.space(4);
+    vector<data32> image = a.assemble();
+    data32 results = image.size() - 4;
+
+    unsigned long nQuanta[2];
+    for(int q = 0; q < 2; q++){
+      SimConfig config;
+      config.set("mc.cores=4");
+      config.set("mc.quantum", q == 0 ? "1" : "1000");
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      multicore::MultiCoreSim sim(mem, rf, 0, config);
+      sim.run();
+      BOOST_CHECK_EQUAL(sim.getNCores(), 4);
+      for(data32 i = 0; i < 4; i++){
+        BOOST_CHECK_EQUAL(mem.ld(results + i), 100 * i + 55);
+        BOOST_CHECK_EQUAL(sim.getRegisterFile(i).ld(4), i);
+        BOOST_CHECK_EQUAL(sim.getCoreStats(i).nStoresPublished, 1);
+        //nothing shared, so every core runs as it would alone
+        BOOST_CHECK_EQUAL(sim.getCoreStats(i).cycles,
+            sim.getCoreStats(0).cycles);
+      }
+      const multicore::MultiCoreStats& stats = sim.getStats();
+      BOOST_CHECK_EQUAL(stats.nRetired, 4 * sim.getCoreStats(0).nRetired);
+      BOOST_CHECK_EQUAL(stats.nRacingStores, 0);
+      nQuanta[q] = stats.nQuanta;
+    }
+    BOOST_CHECK_GT(nQuanta[0], nQuanta[1]);
+  }
+  BOOST_AUTO_TEST_CASE( TestStoresSeenAtBarriers ){
+    //core 0 raises a flag, core 1 waits for it, both store to shared
+    Assembler a;
+    a.la(9, "flag");
+    a.la(12, "shared");
+    a.addiu(13, 4, 1);
+    a.sw(13, 12, 0);
+    a.bne(4, 0, "waiter");
+    a.li(8, 1);
+    a.sw(8, 9, 0);
+    a.syscall();
+    a.label("waiter");
+    a.lw(8, 9, 0);
+    a.beq(8, 0, "waiter");
+    a.li(10, 7);
+    a.la(11, "done");
+    a.sw(10, 11, 0);
+    a.syscall();
+    a.dataLabel("flag");
+    a.word(0);
+    a.dataLabel("done");
+    a.word(0);
+    a.dataLabel("shared");
+    a.word(0);
+    vector<data32> image = a.assemble();
+
+    unsigned long waited[2];
+    for(int q = 0; q < 2; q++){
+      SimConfig config;
+      config.set("mc.quantum", q == 0 ? "1" : "200");
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      multicore::MultiCoreSim sim(mem, rf, 0, config);
+      sim.run();
+      BOOST_CHECK_EQUAL(mem.ld(image.size() - 2), 7);
+      //stored in the same quantum, core 1's last
+      BOOST_CHECK_EQUAL(mem.ld(image.size() - 1), 2);
+      BOOST_CHECK_EQUAL(sim.getStats().nRacingStores, 1);
+      waited[q] = sim.getCoreStats(1).cycles;
+      ostringstream report;
+      sim.report(report);
+      BOOST_CHECK_NE(report.str().find("2 cores"), string::npos);
+    }
+    //the flag is seen at the first barrier after it is stored
+    BOOST_CHECK_GT(waited[1], waited[0]);
+    BOOST_CHECK_GE(waited[1], 200);
+  }
+  BOOST_AUTO_TEST_CASE( TestByteStoresToOneWordMerge ){
+    //core $a0 stores 0x11 + $a0 to byte $a0 of word, then halfword 1
+    Assembler a;
+    a.la(8, "word");
+    a.sll(8, 8, 2);
+    a.addu(9, 8, 4);
+    a.addiu(10, 4, 0x11);
+    a.sb(10, 9, 0);
+    a.sll(11, 4, 1);
+    a.addu(11, 8, 11);
+    a.addiu(10, 4, 0x2200);
+    a.sh(10, 11, 4);
+    a.syscall();
+    a.dataLabel("word");
+    a.space(2);
+    vector<data32> image = a.assemble();
+    data32 word = a.dataAddress("word");
+
+    SimConfig config;
+    config.set("mc.cores=2");
+    config.set("mc.quantum=1000");
+    DRAM mem(0x100, "MainMem");
+    DRAM rf(0b100000, "RegisterFile");
+    mem.storeBlock(0, image.data(), image.size());
+    multicore::MultiCoreSim sim(mem, rf, 0, config);
+    sim.run();
+    BOOST_CHECK_EQUAL(mem.ld(word), 0x11120000);
+    BOOST_CHECK_EQUAL(mem.ld(word + 1), 0x22002201);
+    BOOST_CHECK_EQUAL(sim.getStats().nQuanta, 1);
+
+    //a core's own loads see its bytes over the shared word
+    multicore::CoreMem core(mem, "core");
+    core.stByte(word * 4 + 3, 0x33);
+    BOOST_CHECK_EQUAL(core.ld(word), 0x11120033);
+    mem.stByte(word * 4 + 2, 0x44);
+    BOOST_CHECK_EQUAL(core.ldByte(word * 4 + 2), 0x44);
+    unordered_map<data32, size_t> written;
+    core.publish(written, 0);
+    BOOST_CHECK_EQUAL(mem.ld(word), 0x11124433);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestCoherence )
+  BOOST_AUTO_TEST_CASE( TestMesiTransitions ){
+    SimConfig config;
+    config.set("coh.l1Sets=4");
+    config.set("coh.lineWords=8");
+    coherence::SharedL2 l2(2, config);
+    coherence::L1Cache& a = l2.getL1(0);
+    coherence::L1Cache& b = l2.getL1(1);
+    //a takes the line from memory in E, b from a, both then in S
+    a.setCycle(1);
+    BOOST_CHECK_EQUAL(a.access(0x10, false), config.cohMemLatency);
+    BOOST_CHECK_EQUAL(a.access(0x17, false), config.memLatency);
+    l2.resolve();
+    b.setCycle(2);
+    BOOST_CHECK_EQUAL(b.access(0x11, false), config.cohInterventionLatency);
+    l2.resolve();
+    //b's store invalidates a's copy
+    b.setCycle(3);
+    BOOST_CHECK_EQUAL(b.access(0x11, true),
+        config.memLatency + config.cohInvalidationLatency);
+    l2.resolve();
+    BOOST_CHECK_EQUAL(a.getStats().invalidations, 1);
+    //a wants a word b did not store: false sharing
+    a.setCycle(4);
+    BOOST_CHECK_EQUAL(a.access(0x10, false), config.cohInterventionLatency);
+    l2.resolve();
+    BOOST_CHECK_EQUAL(a.getStats().coherenceMisses, 1);
+    BOOST_CHECK_EQUAL(a.getStats().falseSharingMisses, 1);
+    //and then one it did: true sharing
+    b.setCycle(5);
+    b.access(0x11, true);
+    l2.resolve();
+    a.setCycle(6);
+    a.access(0x11, false);
+    l2.resolve();
+    BOOST_CHECK_EQUAL(a.getStats().coherenceMisses, 2);
+    BOOST_CHECK_EQUAL(a.getStats().falseSharingMisses, 1);
+    const coherence::LineStats& line = l2.getLineStats().at(2);
+    BOOST_CHECK_EQUAL(line.invalidations, 2);
+    BOOST_CHECK_EQUAL(line.coherenceMisses, 2);
+    BOOST_CHECK_EQUAL(l2.getTotals().upgrades, 2);
+  }
+  BOOST_AUTO_TEST_CASE( TestPaddingRemovesFalseSharing ){
+    unsigned long cycles[2];
+    for(int padded = 0; padded < 2; padded++){
+      //each core counts to 50 in its own word of counters
+      Assembler a;
+      a.la(8, "counters");
+      a.addiu(8, 8, 7);
+      a.srl(8, 8, 3);
+      a.sll(8, 8, 3);
+      a.sll(9, 4, padded ? 3 : 0);
+      a.addu(8, 8, 9);
+      a.li(10, 50);
+      a.label("loop");
+      a.lw(11, 8, 0);
+      a.addiu(11, 11, 1);
+      a.sw(11, 8, 0);
+      a.addiu(10, 10, -1);
+      a.bne(10, 0, "loop");
+      a.syscall();
+      a.dataLabel("counters");
+      a.space(24);
+      vector<data32> image = a.assemble();
+
+      SimConfig config;
+      config.set("mc.quantum=10");
+      config.set("coh.l1Sets=16");
+      config.set("coh.lineWords=8");
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      multicore::MultiCoreSim sim(mem, rf, 0, config);
+      sim.run();
+      data32 counters = (image.size() - 24 + 7) / 8 * 8;
+      BOOST_CHECK_EQUAL(mem.ld(counters), 50);
+      BOOST_CHECK_EQUAL(mem.ld(counters + (padded ? 8 : 1)), 50);
+      coherence::L1Stats totals = sim.getCaches()->getTotals();
+      if(padded){
+        BOOST_CHECK_EQUAL(totals.coherenceMisses, 0);
+      } else {
+        BOOST_CHECK_GT(totals.falseSharingMisses, 0);
+        BOOST_CHECK_EQUAL(totals.falseSharingMisses, totals.coherenceMisses);
+        BOOST_CHECK_GT(sim.getCaches()->getLineStats().at(counters / 8)
+            .falseSharingMisses, 0);
+      }
+      cycles[padded] = sim.getStats().cycles;
+    }
+    BOOST_CHECK_LT(cycles[1], cycles[0]);
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestAtomics )
+  BOOST_AUTO_TEST_CASE( TestLinkedPairOnOneCore ){
+    Assembler a;
+    a.la(9, "x");
+    a.ll(8, 9, 0);
+    a.addiu(8, 8, 1);
+    a.sc(8, 9, 0);
+    //the sc cleared the link, so this one stores nothing
+    a.li(10, 9);
+    a.sc(10, 9, 0);
+    a.sync();
+    a.ll(11, 9, 0);
+    a.syscall();
+    a.dataLabel("x");
+    a.word(5);
+    vector<data32> image = a.assemble();
+    data32 x = a.dataAddress("x");
+
+    DRAM mem(0x100, "MainMem");
+    DRAM rf(0b100000, "RegisterFile");
+    mem.storeBlock(0, image.data(), image.size());
+    Processor5S p("MIPSProcessor", mem, rf, 0, "");
+    p.runFor(ULONG_MAX);
+    BOOST_CHECK_EQUAL(mem.ld(x), 6);
+    BOOST_CHECK_EQUAL(rf.ld(8), 1);
+    BOOST_CHECK_EQUAL(rf.ld(10), 0);
+    BOOST_CHECK_EQUAL(rf.ld(11), 6);
+    const atomics::LockStats& s = p.getLinkRegister().getLockStats().at(x);
+    BOOST_CHECK_EQUAL(s.nLoadLinked, 2);
+    BOOST_CHECK_EQUAL(s.nStoreConditional, 2);
+    BOOST_CHECK_EQUAL(s.nFailed, 1);
+    BOOST_CHECK_EQUAL(s.nAcquired, 1);
+    BOOST_CHECK_GT(s.spinCycles, 0);
+    BOOST_CHECK_EQUAL(p.getLinkRegister().getNSyncs(), 1);
+
+    //the functional and out of order cores agree
+    DRAM functionalMem(0x100, "MainMem");
+    DRAM functionalRf(0b100000, "RegisterFile");
+    functionalMem.storeBlock(0, image.data(), image.size());
+    FunctionalCore core(functionalMem, functionalRf, 0);
+    TraceRecord r;
+    while(core.step(r));
+    core.drain();
+    BOOST_CHECK_EQUAL(functionalMem.ld(x), 6);
+    BOOST_CHECK_EQUAL(functionalRf.ld(8), 1);
+    BOOST_CHECK_EQUAL(functionalRf.ld(10), 0);
+    BOOST_CHECK_EQUAL(functionalRf.ld(11), 6);
+
+    DRAM oooMem(0x100, "MainMem");
+    DRAM oooRf(0b100000, "RegisterFile");
+    oooMem.storeBlock(0, image.data(), image.size());
+    ooo::ProcessorOoO q("MIPSProcessor", oooMem, oooRf, 0, SimConfig());
+    ostringstream report;
+    q.start(0, report);
+    BOOST_CHECK_EQUAL(oooMem.ld(x), 6);
+    BOOST_CHECK_EQUAL(oooRf.ld(10), 0);
+  }
+  BOOST_AUTO_TEST_CASE( TestSpinlockCounter ){
+    //every core takes the lock 20 times to add 1 to count
+    Assembler a;
+    a.la(9, "lock");
+    a.la(12, "count");
+    a.li(10, 20);
+    a.label("acquire");
+    a.ll(8, 9, 0);
+    a.bne(8, 0, "acquire");
+    a.li(8, 1);
+    a.sc(8, 9, 0);
+    a.beq(8, 0, "acquire");
+    a.lw(11, 12, 0);
+    a.addiu(11, 11, 1);
+    a.sw(11, 12, 0);
+    //count is seen before the lock is free
+    a.sync();
+    a.sw(0, 9, 0);
+    a.addiu(10, 10, -1);
+    a.bne(10, 0, "acquire");
+    a.syscall();
+    a.dataLabel("lock");
+    a.word(0);
+    a.dataLabel("count");
+    a.word(0);
+    vector<data32> image = a.assemble();
+    data32 lock = a.dataAddress("lock");
+
+    for(int cached = 0; cached < 2; cached++){
+      SimConfig config;
+      config.set("mc.cores=4");
+      config.set("mc.quantum=20");
+      if(cached)
+        config.set("coh.l1Sets=16");
+      DRAM mem(0x100, "MainMem");
+      DRAM rf(0b100000, "RegisterFile");
+      mem.storeBlock(0, image.data(), image.size());
+      multicore::MultiCoreSim sim(mem, rf, 0, config);
+      sim.run();
+      BOOST_CHECK_EQUAL(mem.ld(a.dataAddress("count")), 80);
+      BOOST_CHECK_EQUAL(mem.ld(lock), 0);
+      map<data32, atomics::LockStats> locks = sim.getArbiter().getLockStats();
+      const atomics::LockStats& s = locks.at(lock);
+      BOOST_CHECK_EQUAL(s.nAcquired, 80);
+      BOOST_CHECK_GT(s.nFailed, 0);
+      BOOST_CHECK_EQUAL(s.nStoreConditional, s.nAcquired + s.nFailed);
+      BOOST_CHECK_GT(s.spinCycles, 0);
+      ostringstream report;
+      sim.report(report);
+      BOOST_CHECK_NE(report.str().find("lock at word"), string::npos);
+    }
+  }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( TestMultiProgram )
+  BOOST_AUTO_TEST_CASE( TestContextsSurviveSwitches ){
+    //both keep their counts in $2, $8 and $9
+    Assembler sum;
+    sum.li(8, 60);
+    sum.li(2, 0);
+    sum.label("loop");
+    sum.addu(2, 2, 8);
+    sum.addiu(8, 8, -1);
+    sum.bne(8, 0, "loop");
+    sum.la(9, "result");
+    sum.sw(2, 9, 0);
+    sum.syscall();
+    sum.dataLabel("result");
+    sum.word(0);
+    Assembler::writeHex("mpSum.hex", sum.assemble());
+    Assembler fill;
+    fill.la(9, "table");
+    fill.li(8, 16);
+    fill.li(2, 0);
+    fill.label("loop");
+    fill.addiu(2, 2, 3);
+    fill.sw(2, 9, 0);
+    fill.addiu(9, 9, 1);
+    fill.addiu(8, 8, -1);
+    fill.bne(8, 0, "loop");
+    fill.syscall();
+    fill.dataLabel("table");
+    fill.space(16);
+    Assembler::writeHex("mpFill.hex", fill.assemble());
+
+    unsigned long cycles[2], nSwitches[2];
+    for(int cost = 0; cost < 2; cost++){
+      SimConfig config;
+      config.set("mp.quantum=50");
+      config.set(cost ? "mp.switchCost=50" : "mp.switchCost=0");
+      DRAM* mem = new DRAM(0x200, "MainMem");
+      ProgramLoader loader(mem, new DRAM(0b100000, "rf"), "", config);
+      loader.loadProgram("mpSum.hex", 0, 0x100);
+      loader.loadProgram("mpFill.hex", 0x100, 0x100);
+      multiprogram::MultiProgramSim sim(loader.getMainMemory(),
+          loader.getRegisterFile(), loader.getPrograms(), config);
+      sim.run();
+      BOOST_CHECK_EQUAL(mem->ld(sum.dataAddress("result")), 1830);
+      BOOST_CHECK_EQUAL(sim.getRegisters(0)[2], 1830);
+      BOOST_CHECK_EQUAL(sim.getRegisters(0)[8], 0);
+      data32 table = 0x100 + fill.dataAddress("table");
+      BOOST_CHECK_EQUAL(mem->ld(table), 3);
+      BOOST_CHECK_EQUAL(mem->ld(table + 15), 48);
+      BOOST_CHECK_EQUAL(sim.getRegisters(1)[2], 48);
+      BOOST_CHECK_EQUAL(sim.getRegisters(1)[9],
+          fill.dataAddress("table") + 16);
+
+      const multiprogram::MultiProgramStats& s = sim.getStats();
+      BOOST_CHECK_GT(s.nSwitches, 0);
+      BOOST_CHECK_EQUAL(s.switchCycles, cost ? 50 * s.nSwitches : 0);
+      unsigned long processCycles = 0, nRetired = 0;
+      for(size_t i = 0; i < sim.getNProcesses(); i++){
+        BOOST_CHECK_GT(sim.getProcessStats(i).nSlices, 1);
+        processCycles += sim.getProcessStats(i).cycles;
+        nRetired += sim.getProcessStats(i).nRetired;
+      }
+      BOOST_CHECK_EQUAL(processCycles + s.switchCycles, s.cycles);
+      BOOST_CHECK_EQUAL(nRetired, s.nRetired);
+      cycles[cost] = s.cycles;
+      nSwitches[cost] = s.nSwitches;
+    }
+    BOOST_CHECK_EQUAL(nSwitches[0], nSwitches[1]);
+    BOOST_CHECK_EQUAL(cycles[1] - cycles[0], 50 * nSwitches[1]);
+    remove("mpSum.hex");
+    remove("mpFill.hex");
+  }
+  BOOST_AUTO_TEST_CASE( TestCoRunnerThrashesCache ){
+    //reads one word of each of 4 lines, 40 times over
+    Assembler reuse;
+    reuse.li(10, 40);
+    reuse.label("pass");
+    reuse.la(9, "lines");
+    reuse.li(8, 4);
+    reuse.label("loop");
+    reuse.lw(11, 9, 0);
+    reuse.addiu(9, 9, 8);
+    reuse.addiu(8, 8, -1);
+    reuse.bne(8, 0, "loop");
+    reuse.addiu(10, 10, -1);
+    reuse.bne(10, 0, "pass");
+    reuse.syscall();
+    reuse.dataLabel("lines");
+    reuse.space(40);
+    Assembler::writeHex("mpReuse.hex", reuse.assemble());
+    //walks 32 lines, more than the L1 holds
+    Assembler walk;
+    walk.li(10, 10);
+    walk.label("pass");
+    walk.la(9, "lines");
+    walk.li(8, 32);
+    walk.label("loop");
+    walk.lw(11, 9, 0);
+    walk.addiu(9, 9, 8);
+    walk.addiu(8, 8, -1);
+    walk.bne(8, 0, "loop");
+    walk.addiu(10, 10, -1);
+    walk.bne(10, 0, "pass");
+    walk.syscall();
+    walk.dataLabel("lines");
+    walk.space(264);
+    Assembler::writeHex("mpWalk.hex", walk.assemble());
+
+    unsigned long misses[2];
+    for(int shared = 0; shared < 2; shared++){
+      SimConfig config;
+      //long enough for the walk to go through every set
+      config.set("mp.quantum=2000");
+      config.set("coh.l1Sets=4");
+      ProgramLoader loader(new DRAM(0x400, "MainMem"),
+          new DRAM(0b100000, "rf"), "", config);
+      loader.loadProgram("mpReuse.hex", 0, 0x200);
+      if(shared)
+        loader.loadProgram("mpWalk.hex", 0x200, 0x200);
+      multiprogram::MultiProgramSim sim(loader.getMainMemory(),
+          loader.getRegisterFile(), loader.getPrograms(), config);
+      sim.run();
+      const coherence::L1Stats& cache = sim.getProcessStats(0).cache;
+      BOOST_CHECK_EQUAL(cache.accesses, 160);
+      misses[shared] = cache.misses;
+      ostringstream report;
+      sim.report(report);
+      BOOST_CHECK_NE(report.str().find("program 0 (mpReuse.hex)"),
+          string::npos);
+    }
+    BOOST_CHECK_EQUAL(misses[0], 4);
+    BOOST_CHECK_GT(misses[1], misses[0]);
+    remove("mpReuse.hex");
+    remove("mpWalk.hex");
+  }
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,106 @@
+#define BOOST_LOG_DYN_LINK
+#include <chrono>
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "Config.h"
+#include "Processor.h"
+#include "WhatIf.h"
+
+using namespace std;
+using namespace config;
+using namespace whatif;
+/*
+ * Warms a program up once, then runs it on under several configurations
+ * side by side from that state (see WhatIf.h).
+ *
+ * Usage:
+ *   whatIf <program> [--warm n] [--run n] [--config file.ini]
+ *     [key=value ...] --variant key=value[,key=value...] ...
+ * key=value before any --variant set the base configuration, which warms
+ * up for n instructions (default 10000). Each variant is the base with its
+ * overrides, run for --run n more instructions (default to the end). With
+ * no --variant, the base runs on alone.
+ */
+int main(int argc, char** argv){
+  if(argc < 2){
+    cerr << "usage: whatIf <program> [--warm n] [--run n] "
+      "[--config file.ini] [key=value ...] --variant key=value[,...] ..."
+      << endl;
+    return 2;
+  }
+  unsigned long warm = 10000;
+  unsigned long run = ULONG_MAX;
+  string configFile;
+  vector<string> overrides;
+  vector<string> variants;
+  for(int i = 2; i < argc; i++){
+    string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if(arg == "--warm" && hasValue)
+      warm = stoul(argv[++i], nullptr, 0);
+    else if(arg == "--run" && hasValue)
+      run = stoul(argv[++i], nullptr, 0);
+    else if(arg == "--config" && hasValue)
+      configFile = argv[++i];
+    else if(arg == "--variant" && hasValue)
+      variants.push_back(argv[++i]);
+    else if(arg.find('=') != string::npos)
+      overrides.push_back(arg);
+    else {
+      cerr << "bad option " << arg << endl;
+      return 2;
+    }
+  }
+  SimConfig base;
+  if(!configFile.empty())
+    base.loadFile(configFile);
+  for(const string& o : overrides)
+    base.set(o);
+  if(variants.empty())
+    variants.push_back("");
+
+  ProgramImage image = MachineCodeFileReader().loadImage(argv[1]);
+  Simulation warmed(image, base);
+  auto start = chrono::steady_clock::now();
+  bool ended = warmed.getProcessor().runFor(warm);
+  double warmSeconds = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+  cout << "warmed " << warmed.getProcessor().getNRetired() <<
+    " instructions in " << warmed.getProcessor().getCurrentCycle() <<
+    " cycles, " << fixed << setprecision(3) << warmSeconds << " s" << endl;
+  if(ended){
+    cout << "the program ended while warming up" << endl;
+    return 0;
+  }
+
+  vector<unique_ptr<Simulation>> clones;
+  for(const string& variant : variants){
+    SimConfig config = base;
+    stringstream assignments(variant);
+    string assignment;
+    while(getline(assignments, assignment, ','))
+      if(!assignment.empty())
+        config.set(assignment);
+    clones.push_back(warmed.clone(config));
+  }
+  start = chrono::steady_clock::now();
+  vector<Outcome> outcomes = runAll(clones, run);
+  double seconds = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+
+  for(size_t i = 0; i < variants.size(); i++){
+    const Outcome& o = outcomes[i];
+    cout << (variants[i].empty() ? "base" : variants[i]) << ": " <<
+      o.nInstrs << " instructions in " << o.cycles << " cycles, cpi " <<
+      setprecision(4) << (o.nInstrs > 0 ? (double) o.cycles / o.nInstrs : 0)
+      << (o.finished ? "" : " (not finished)") << ", " << o.ownedPages <<
+      " pages copied" << endl;
+  }
+  cout << variants.size() << " variants in " << setprecision(3) << seconds <<
+    " s" << endl;
+  return 0;
+}